@@ -0,0 +1,41 @@
+#ifndef AWAKE_LOCK_H
+#define AWAKE_LOCK_H
+
+#include <esp_pm.h>
+#include <atomic>
+
+// Keeps the chip out of automatic light sleep while held, for timing that light sleep would break.
+// Does nothing when power management is not built in (see PowerManager)
+class AwakeLock
+{
+private:
+    esp_pm_lock_handle_t handle = nullptr;
+    std::atomic<bool> isHeld{false};
+
+public:
+    explicit AwakeLock(const char* name)
+    {
+        if (esp_pm_lock_create(ESP_PM_NO_LIGHT_SLEEP, 0, name, &handle) != ESP_OK)
+        {
+            handle = nullptr;
+        }
+    }
+
+    void acquire()
+    {
+        if (handle != nullptr && !isHeld.exchange(true))
+        {
+            esp_pm_lock_acquire(handle);
+        }
+    }
+
+    void release()
+    {
+        if (handle != nullptr && isHeld.exchange(false))
+        {
+            esp_pm_lock_release(handle);
+        }
+    }
+};
+
+#endif // AWAKE_LOCK_H
@@ -0,0 +1,302 @@
+#ifndef BACKEND_CONNECTION_H
+#define BACKEND_CONNECTION_H
+
+#include <Arduino.h>
+#include <WiFi.h>
+#include <WiFiClientSecure.h>
+#include <HTTPClient.h>
+#include "FeederHal.h"
+#include "FeederMetrics.h"
+#include "FeederLog.h"
+
+// Keeps one TLS connection to the backend open across requests (HTTP keep-alive), so command
+// polling and uploads do not pay for DNS and a full TLS handshake every time. The resolved
+// address is cached, and a dropped connection is re-opened transparently on the next request.
+// Used from the networking task only.
+class BackendConnection
+{
+public:
+    static constexpr const char* HOST = "dev.bull-software.com";
+
+    // Backend scripts, counted apart so the load of a fleet can be sized per endpoint
+    enum Endpoint : uint8_t
+    {
+        ENDPOINT_GET_ESP32_COMMAND,
+        ENDPOINT_GET_FEEDER,
+        ENDPOINT_ADD_EVENTS_BATCH,
+        ENDPOINT_ADD_GATE_EVENT,
+        ENDPOINT_ADD_FOOD_DISPENSE_EVENT,
+        ENDPOINT_UPDATE_FOOD_WEIGHT,
+        NUM_OF_ENDPOINTS
+    };
+
+    static const char* const ENDPOINT_NAMES[NUM_OF_ENDPOINTS];
+
+    // Bytes are the URL and the bodies; HTTP headers and TLS records are not counted
+    struct EndpointStats
+    {
+        uint32_t requests = 0;
+        uint32_t failures = 0;
+        uint32_t bytesSent = 0;
+        uint32_t bytesReceived = 0;
+        uint32_t latencyCounts[FeederMetrics::NUM_OF_BUCKETS + 1] = {}; // Same buckets as the stages, not cumulative
+        uint64_t latencySumMicros = 0;
+    };
+
+    struct Stats
+    {
+        uint32_t requests = 0;        // Requests sent
+        uint32_t failures = 0;        // Requests without an HTTP response
+        uint32_t connects = 0;        // TLS handshakes (first connection and reconnects)
+        uint32_t dnsLookups = 0;      // DNS resolutions of HOST
+        uint32_t totalLatencyMs = 0;  // Sum of request latencies, including handshakes
+        uint32_t maxLatencyMs = 0;
+        uint32_t lastLatencyMs = 0;
+        uint32_t lastConnectMs = 0;   // Duration of the last TLS handshake
+        EndpointStats endpoints[NUM_OF_ENDPOINTS];
+    };
+
+private:
+    static constexpr uint16_t PORT = 443;
+    static constexpr unsigned long DNS_CACHE_TTL = 3600000;      // Re-resolve HOST every hour (ms)
+    static constexpr uint16_t REQUEST_TIMEOUT = 5000;            // ms
+    static constexpr unsigned long STATS_REPORT_INTERVAL = 3600000; // Log the counters every hour (ms)
+
+    WiFiClientSecure client;
+    HTTPClient http;
+
+    IPAddress cachedAddress;
+    bool hasCachedAddress = false;
+    unsigned long cachedAddressTime = 0;
+
+    Stats stats;
+    unsigned long lastStatsReportTime = 0;
+
+    // Date header of the last response, with the FeederClock times the request was sent and answered
+    String lastDateHeader;
+    int64_t lastRequestSentMicros = 0;
+    int64_t lastResponseMicros = 0;
+
+    bool resolveHost()
+    {
+        if (hasCachedAddress && FeederClock::millis() - cachedAddressTime < DNS_CACHE_TTL)
+        {
+            return true;
+        }
+
+        stats.dnsLookups++;
+        if (!WiFi.hostByName(HOST, cachedAddress))
+        {
+            LOG_WARN(LOG_NETWORK, "BackendConnection: DNS lookup failed for %s", HOST);
+            hasCachedAddress = false;
+            return false;
+        }
+
+        hasCachedAddress = true;
+        cachedAddressTime = FeederClock::millis();
+        return true;
+    }
+
+    bool ensureConnected()
+    {
+        if (client.connected())
+        {
+            return true;
+        }
+
+        if (!resolveHost())
+        {
+            return false;
+        }
+
+        unsigned long connectStart = FeederClock::millis();
+        stats.connects++;
+
+        // Connect to the cached address while still sending HOST for SNI
+        if (!client.connect(cachedAddress, PORT, HOST, nullptr, nullptr, nullptr))
+        {
+            LOG_WARN(LOG_NETWORK, "BackendConnection: unable to connect to %s", HOST);
+            hasCachedAddress = false; // The address may have changed, resolve it again next time
+            return false;
+        }
+
+        stats.lastConnectMs = FeederClock::millis() - connectStart;
+        return true;
+    }
+
+    int sendOnce(const char* method, const String& url, const String& payload, const String& contentType, String& response)
+    {
+        if (!ensureConnected())
+        {
+            return HTTPC_ERROR_CONNECTION_REFUSED;
+        }
+
+        // HTTPClient reuses the already connected client instead of opening a new connection
+        http.begin(client, url);
+        if (payload.length() > 0)
+        {
+            http.addHeader("Content-Type", contentType);
+        }
+
+        const char* headerKeys[] = {"Date"};
+        http.collectHeaders(headerKeys, 1);
+
+        int64_t requestSentMicros = FeederClock::micros();
+        int httpResponseCode = http.sendRequest(method, payload);
+        if (httpResponseCode > 0)
+        {
+            lastResponseMicros = FeederClock::micros();
+            lastRequestSentMicros = requestSentMicros;
+            lastDateHeader = http.header("Date");
+            response = http.getString();
+        }
+
+        http.end(); // Keeps the connection open when the server allows keep-alive
+        return httpResponseCode;
+    }
+
+    // NUM_OF_ENDPOINTS for a URL that is not one of the scripts
+    static Endpoint getEndpoint(const String& url)
+    {
+        int pathStart = strlen("https://") + strlen(HOST) + 1;
+        int pathEnd = url.indexOf(".php", pathStart);
+        if (pathEnd < 0)
+        {
+            return NUM_OF_ENDPOINTS;
+        }
+
+        String script = url.substring(pathStart, pathEnd);
+        for (int endpoint = 0; endpoint < NUM_OF_ENDPOINTS; endpoint++)
+        {
+            if (script == ENDPOINT_NAMES[endpoint])
+            {
+                return (Endpoint)endpoint;
+            }
+        }
+
+        return NUM_OF_ENDPOINTS;
+    }
+
+    void countRequest(const String& url, const String& payload, const String& response, int httpResponseCode, int64_t latencyMicros)
+    {
+        Endpoint endpoint = getEndpoint(url);
+        if (endpoint == NUM_OF_ENDPOINTS)
+        {
+            return;
+        }
+        EndpointStats& endpointStats = stats.endpoints[endpoint];
+
+        int bucket = 0;
+        while (bucket < FeederMetrics::NUM_OF_BUCKETS && (uint64_t)latencyMicros > FeederMetrics::BUCKET_LIMITS[bucket])
+        {
+            bucket++;
+        }
+
+        endpointStats.requests++;
+        endpointStats.failures += httpResponseCode <= 0 ? 1 : 0;
+        endpointStats.bytesSent += url.length() + payload.length();
+        endpointStats.bytesReceived += response.length();
+        endpointStats.latencyCounts[bucket]++;
+        endpointStats.latencySumMicros += latencyMicros;
+    }
+
+    void reportStatsIfDue()
+    {
+        if (FeederClock::millis() - lastStatsReportTime < STATS_REPORT_INTERVAL)
+        {
+            return;
+        }
+        lastStatsReportTime = FeederClock::millis();
+
+        uint32_t averageLatencyMs = stats.requests > 0 ? stats.totalLatencyMs / stats.requests : 0;
+        LOG_INFO(LOG_NETWORK, "BackendConnection stats: requests=%u failures=%u connects=%u dnsLookups=%u avgLatencyMs=%u maxLatencyMs=%u lastConnectMs=%u",
+                      stats.requests, stats.failures, stats.connects, stats.dnsLookups, averageLatencyMs, stats.maxLatencyMs, stats.lastConnectMs);
+    }
+
+public:
+    BackendConnection()
+    {
+        // Same trust model as the previous per-request HTTPClient (no CA pinning)
+        client.setInsecure();
+        http.setReuse(true);
+        http.setTimeout(REQUEST_TIMEOUT);
+    }
+
+    static bool isBackendUrl(const String& url)
+    {
+        return url.startsWith("https://" + String(HOST) + "/");
+    }
+
+    // Send a request to the backend. Returns the HTTP status code, or a negative HTTPClient error
+    int request(const char* method, const String& url, const String& payload, const String& contentType, String& response)
+    {
+        unsigned long requestStart = FeederClock::millis();
+        int64_t requestStartMicros = FeederClock::micros();
+        bool reusedConnection = client.connected();
+
+        int httpResponseCode = sendOnce(method, url, payload, contentType, response);
+
+        if (httpResponseCode <= 0 && reusedConnection)
+        {
+            // The server may have closed the idle connection just before the request, retry on a fresh one
+            client.stop();
+            httpResponseCode = sendOnce(method, url, payload, contentType, response);
+        }
+
+        if (httpResponseCode <= 0)
+        {
+            stats.failures++;
+            client.stop();
+        }
+
+        uint32_t latencyMs = FeederClock::millis() - requestStart;
+        stats.requests++;
+        stats.totalLatencyMs += latencyMs;
+        stats.lastLatencyMs = latencyMs;
+        if (latencyMs > stats.maxLatencyMs)
+        {
+            stats.maxLatencyMs = latencyMs;
+        }
+        countRequest(url, payload, response, httpResponseCode, FeederClock::micros() - requestStartMicros);
+
+        reportStatsIfDue();
+        return httpResponseCode;
+    }
+
+    const Stats& getStats() const
+    {
+        return stats;
+    }
+
+    // Date header of the last response ("" if the server sent none)
+    const String& getLastDateHeader() const
+    {
+        return lastDateHeader;
+    }
+
+    int64_t getLastRequestSentMicros() const
+    {
+        return lastRequestSentMicros;
+    }
+
+    int64_t getLastResponseMicros() const
+    {
+        return lastResponseMicros;
+    }
+
+    void disconnect()
+    {
+        client.stop();
+    }
+};
+
+// Initialize static members. Script names without ".php", in the order of Endpoint
+const char* const BackendConnection::ENDPOINT_NAMES[BackendConnection::NUM_OF_ENDPOINTS] = {
+    "get_esp32_command",
+    "get_feeder",
+    "add_events_batch",
+    "add_gate_event",
+    "add_food_dispense_event",
+    "update_food_weight"};
+
+#endif // BACKEND_CONNECTION_H
@@ -0,0 +1,76 @@
+#ifndef BOOT_TRACE_H
+#define BOOT_TRACE_H
+
+#include <Arduino.h>
+#include "FeederHal.h"
+#include <freertos/FreeRTOS.h>
+#include "FeederLog.h"
+
+// Boot timeline. Each phase records when it ended, in microseconds since the application started
+// (FeederClock; esp_timer starts right after the bootloader). Phases finishing in the background tasks
+// (Wi-Fi, config fetch, scale tare) are marked from there, so they may interleave.
+struct BootTrace
+{
+    static constexpr int MAX_PHASES = 16;
+
+    struct Phase
+    {
+        const char* name; // String literal
+        int64_t micros;
+    };
+
+    static Phase phases[MAX_PHASES];
+    static int numOfPhases;
+    static portMUX_TYPE lock;
+
+    // Record the end of a boot phase
+    static void mark(const char* name)
+    {
+        int64_t now = FeederClock::micros();
+
+        portENTER_CRITICAL(&lock);
+        bool recorded = numOfPhases < MAX_PHASES;
+        if (recorded)
+        {
+            phases[numOfPhases++] = {name, now};
+        }
+        portEXIT_CRITICAL(&lock);
+
+        if (recorded)
+        {
+            LOG_INFO(LOG_SYSTEM, "Boot: %s at %ums", name, (uint32_t)(now / 1000));
+        }
+    }
+
+    // Milliseconds since power-on at which the phase ended, or -1 if it did not end yet
+    static int32_t getPhaseMillis(const char* name)
+    {
+        for (int i = 0; i < numOfPhases; i++)
+        {
+            if (strcmp(phases[i].name, name) == 0)
+            {
+                return phases[i].micros / 1000;
+            }
+        }
+        return -1;
+    }
+
+    // Log the phases recorded so far, with the time each one took since the previous mark
+    static void print()
+    {
+        int64_t previous = 0;
+
+        for (int i = 0; i < numOfPhases; i++)
+        {
+            LOG_INFO(LOG_SYSTEM, "BootTrace: %-18s %6ums (+%ums)", phases[i].name, (uint32_t)(phases[i].micros / 1000), (uint32_t)((phases[i].micros - previous) / 1000));
+            previous = phases[i].micros;
+        }
+    }
+};
+
+// Initialize static members
+BootTrace::Phase BootTrace::phases[BootTrace::MAX_PHASES];
+int BootTrace::numOfPhases = 0;
+portMUX_TYPE BootTrace::lock = portMUX_INITIALIZER_UNLOCKED;
+
+#endif // BOOT_TRACE_H
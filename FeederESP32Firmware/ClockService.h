@@ -0,0 +1,382 @@
+#ifndef CLOCK_SERVICE_H
+#define CLOCK_SERVICE_H
+
+#include <Arduino.h>
+#include <WiFi.h>
+#include <WiFiUdp.h>
+#include <esp_timer.h>
+#include <freertos/FreeRTOS.h>
+#include "FeederHal.h"
+#include "DeadlineQueue.h"
+#include "FeederLog.h"
+
+// Unix time for the whole firmware. SNTP sets the clock in a single UDP round-trip and, between
+// syncs, the time is extrapolated from FeederClock::micros() (64-bit microseconds, no millis() wrap),
+// corrected by the oscillator drift measured between consecutive SNTP syncs. The Date header of
+// backend responses is used as a fallback when SNTP is unreachable. The returned time never goes back.
+// loop() runs in the networking task; getUnixTime() may be called from any task.
+class ClockService
+{
+public:
+    enum class TimeSource : uint8_t
+    {
+        NONE,
+        HTTP_DATE,
+        SNTP
+    };
+
+private:
+    static constexpr int NUM_OF_SNTP_SERVERS = 3;
+    static constexpr const char* SNTP_SERVERS[NUM_OF_SNTP_SERVERS] = {"pool.ntp.org", "time.google.com", "time.cloudflare.com"};
+
+    static constexpr uint16_t NTP_PORT = 123;
+    static constexpr uint16_t NTP_LOCAL_PORT = 2390;
+    static constexpr int NTP_PACKET_SIZE = 48;
+    static constexpr uint32_t NTP_UNIX_EPOCH_OFFSET = 2208988800UL; // Seconds from 1900 to 1970
+
+    static constexpr int64_t SNTP_RESPONSE_TIMEOUT = 1000000LL;     // us
+    static constexpr unsigned long SNTP_RESPONSE_POLL = 50;         // Check for the reply of a pending request (ms)
+    static constexpr int64_t SNTP_SYNC_INTERVAL = 3600000000LL;     // Resync every hour (us)
+    static constexpr int64_t SNTP_MIN_RETRY_INTERVAL = 15000000LL;  // First retry after a failed sync (us)
+    static constexpr int64_t SNTP_MAX_RETRY_INTERVAL = 300000000LL; // Retry backoff cap (us)
+    static constexpr int64_t SNTP_MAX_ROUND_TRIP = 2000000LL;       // Slower replies are too inaccurate (us)
+    static constexpr int64_t SNTP_STALE_AFTER = 21600000000LL;      // Accept Date headers again after 6 h without SNTP (us)
+    static constexpr int64_t DRIFT_MIN_INTERVAL = 600000000LL;      // Shorter intervals are dominated by round-trip jitter (us)
+    static constexpr float DRIFT_GAIN = 0.5f;                       // Share of each measured drift error that is corrected
+    static constexpr float MAX_DRIFT_PPM = 500.0f;
+    static constexpr int64_t HTTP_DATE_TOLERANCE = 2000000LL;       // Date headers have 1 s resolution (us)
+
+    WiFiUDP udp;
+    bool udpStarted = false;
+    bool requestPending = false;
+    int64_t requestSentMicros = 0;
+    uint64_t requestTransmit = 0;  // Transmit timestamp of the pending request, echoed as the originate timestamp of its reply
+    int64_t nextSyncMicros = 0;
+    int64_t retryInterval = SNTP_MIN_RETRY_INTERVAL;
+    int serverIndex = 0;
+
+    // Clock model: unix = referenceUnixMicros + elapsed * (1 + driftPpm / 1e6), elapsed since referenceLocalMicros
+    portMUX_TYPE clockLock = portMUX_INITIALIZER_UNLOCKED;
+    int64_t referenceUnixMicros = 0;
+    int64_t referenceLocalMicros = 0;
+    float driftPpm = 0;
+    TimeSource source = TimeSource::NONE;
+    int64_t lastSntpLocalMicros = 0;
+    unsigned long lastReturnedTime = 0;
+
+    static int64_t localMicros()
+    {
+        return FeederClock::micros();
+    }
+
+    // Caller holds clockLock
+    int64_t estimateUnixMicros(int64_t atLocalMicros) const
+    {
+        int64_t elapsed = atLocalMicros - referenceLocalMicros;
+        return referenceUnixMicros + elapsed + (int64_t)(elapsed * (double)driftPpm / 1000000.0);
+    }
+
+    void setReference(int64_t unixMicros, int64_t atLocalMicros, TimeSource newSource)
+    {
+        portENTER_CRITICAL(&clockLock);
+        referenceUnixMicros = unixMicros;
+        referenceLocalMicros = atLocalMicros;
+        source = newSource;
+        portEXIT_CRITICAL(&clockLock);
+    }
+
+    void sendSntpRequest()
+    {
+        if (!udpStarted)
+        {
+            udpStarted = udp.begin(NTP_LOCAL_PORT);
+            if (!udpStarted)
+            {
+                return;
+            }
+        }
+
+        // A reply that came after the timeout would be taken for the reply to this request
+        while (udp.parsePacket() > 0)
+        {
+            udp.flush();
+        }
+
+        // The local send time as the transmit timestamp: a nonce the reply has to echo
+        uint8_t packet[NTP_PACKET_SIZE] = {};
+        packet[0] = 0x23; // LI 0, version 4, mode 3 (client)
+        requestTransmit = (uint64_t)localMicros();
+        for (int i = 0; i < 8; i++)
+        {
+            packet[40 + i] = (uint8_t)(requestTransmit >> (56 - i * 8));
+        }
+
+        if (!udp.beginPacket(SNTP_SERVERS[serverIndex], NTP_PORT))
+        {
+            LOG_WARN(LOG_TIME, "ClockService: unable to resolve %s", SNTP_SERVERS[serverIndex]);
+            scheduleRetry();
+            return;
+        }
+
+        udp.write(packet, NTP_PACKET_SIZE);
+        requestSentMicros = localMicros();
+        requestPending = udp.endPacket() == 1;
+
+        if (!requestPending)
+        {
+            scheduleRetry();
+        }
+    }
+
+    void scheduleRetry()
+    {
+        requestPending = false;
+        serverIndex = (serverIndex + 1) % NUM_OF_SNTP_SERVERS; // Next server on the next try
+        nextSyncMicros = localMicros() + retryInterval;
+        retryInterval = retryInterval * 2 < SNTP_MAX_RETRY_INTERVAL ? retryInterval * 2 : SNTP_MAX_RETRY_INTERVAL;
+    }
+
+    void receiveSntpResponse()
+    {
+        int64_t receivedMicros = localMicros();
+        uint8_t packet[NTP_PACKET_SIZE];
+        bool isReply = false;
+
+        // Skip datagrams that do not answer the pending request (late replies to an earlier one)
+        int size;
+        while (!isReply && (size = udp.parsePacket()) > 0)
+        {
+            isReply = size >= NTP_PACKET_SIZE && udp.read(packet, NTP_PACKET_SIZE) == NTP_PACKET_SIZE && readUint64(packet + 24) == requestTransmit;
+            udp.flush();
+        }
+
+        if (!isReply)
+        {
+            if (receivedMicros - requestSentMicros > SNTP_RESPONSE_TIMEOUT)
+            {
+                LOG_WARN(LOG_TIME, "ClockService: no SNTP reply from %s", SNTP_SERVERS[serverIndex]);
+                scheduleRetry();
+            }
+            return;
+        }
+
+        requestPending = false;
+
+        uint8_t leapIndicator = packet[0] >> 6;
+        uint8_t mode = packet[0] & 0x07;
+        uint8_t stratum = packet[1];
+        if (mode != 4 || stratum == 0 || leapIndicator == 3)
+        {
+            // Not a server reply, a kiss-o'-death or an unsynchronized server
+            LOG_WARN(LOG_TIME, "ClockService: SNTP reply rejected from %s", SNTP_SERVERS[serverIndex]);
+            scheduleRetry();
+            return;
+        }
+
+        int64_t serverReceiveMicros = ntpToUnixMicros(packet + 32);
+        int64_t serverTransmitMicros = ntpToUnixMicros(packet + 40);
+        int64_t roundTrip = (receivedMicros - requestSentMicros) - (serverTransmitMicros - serverReceiveMicros);
+
+        if (roundTrip < 0 || roundTrip > SNTP_MAX_ROUND_TRIP)
+        {
+            scheduleRetry();
+            return;
+        }
+
+        int64_t unixMicros = serverTransmitMicros + roundTrip / 2;
+        applySntpSync(unixMicros, receivedMicros, roundTrip);
+
+        retryInterval = SNTP_MIN_RETRY_INTERVAL;
+        nextSyncMicros = receivedMicros + SNTP_SYNC_INTERVAL;
+    }
+
+    void applySntpSync(int64_t unixMicros, int64_t atLocalMicros, int64_t roundTrip)
+    {
+        portENTER_CRITICAL(&clockLock);
+        bool hadSource = source != TimeSource::NONE;
+        int64_t correction = unixMicros - estimateUnixMicros(atLocalMicros);
+        int64_t sinceLastSntp = atLocalMicros - lastSntpLocalMicros;
+        bool canEstimateDrift = source == TimeSource::SNTP && sinceLastSntp >= DRIFT_MIN_INTERVAL;
+
+        if (canEstimateDrift)
+        {
+            // The estimate already included the current drift, so the correction is the remaining error
+            driftPpm += DRIFT_GAIN * (float)((double)correction * 1000000.0 / sinceLastSntp);
+            driftPpm = constrain(driftPpm, -MAX_DRIFT_PPM, MAX_DRIFT_PPM);
+        }
+
+        referenceUnixMicros = unixMicros;
+        referenceLocalMicros = atLocalMicros;
+        source = TimeSource::SNTP;
+        lastSntpLocalMicros = atLocalMicros;
+        float currentDriftPpm = driftPpm;
+        portEXIT_CRITICAL(&clockLock);
+
+        LOG_INFO(LOG_TIME, "ClockService: SNTP sync from %s, unix %lu, round trip %ldms, correction %ldms, drift %.1fppm", SNTP_SERVERS[serverIndex], (unsigned long)(unixMicros / 1000000LL),
+                 (long)(roundTrip / 1000), hadSource ? (long)(correction / 1000) : 0L, currentDriftPpm);
+    }
+
+    static uint64_t readUint64(const uint8_t* bytes)
+    {
+        uint64_t value = 0;
+        for (int i = 0; i < 8; i++)
+        {
+            value = (value << 8) | bytes[i];
+        }
+        return value;
+    }
+
+    static int monthFromName(const char* name)
+    {
+        static const char* const MONTHS = "JanFebMarAprMayJunJulAugSepOctNovDec";
+        for (int i = 0; i < 12; i++)
+        {
+            if (strncmp(name, MONTHS + i * 3, 3) == 0)
+            {
+                return i + 1;
+            }
+        }
+        return 0;
+    }
+
+    // Days since 1970-01-01 of a proleptic Gregorian date, without mktime() and its time zone
+    static long daysFromCivil(int year, int month, int day)
+    {
+        year -= month <= 2;
+        long era = (year >= 0 ? year : year - 399) / 400;
+        long yearOfEra = year - era * 400;
+        long dayOfYear = (153L * (month + (month > 2 ? -3 : 9)) + 2) / 5 + day - 1;
+        long dayOfEra = yearOfEra * 365 + yearOfEra / 4 - yearOfEra / 100 + dayOfYear;
+        return era * 146097L + dayOfEra - 719468L;
+    }
+
+public:
+    // NTP 64-bit timestamp (seconds since 1900 + 32-bit fraction) to unix microseconds
+    static int64_t ntpToUnixMicros(const uint8_t* timestamp)
+    {
+        uint32_t seconds = ((uint32_t)timestamp[0] << 24) | ((uint32_t)timestamp[1] << 16) | ((uint32_t)timestamp[2] << 8) | timestamp[3];
+        uint32_t fraction = ((uint32_t)timestamp[4] << 24) | ((uint32_t)timestamp[5] << 16) | ((uint32_t)timestamp[6] << 8) | timestamp[7];
+        return (int64_t)(seconds - NTP_UNIX_EPOCH_OFFSET) * 1000000LL + (((uint64_t)fraction * 1000000ULL) >> 32);
+    }
+
+    // Parse an HTTP date ("Sun, 06 Nov 1994 08:49:37 GMT"). Returns -1 on invalid input
+    static long parseHttpDate(const char* date)
+    {
+        int day, year, hour, minute, second;
+        char monthName[4];
+
+        if (date == nullptr || sscanf(date, "%*3s, %d %3s %d %d:%d:%d", &day, monthName, &year, &hour, &minute, &second) != 6)
+        {
+            return -1;
+        }
+
+        int month = monthFromName(monthName);
+        if (month == 0 || day < 1 || day > 31 || year < 1970 || hour > 23 || minute > 59 || second > 60)
+        {
+            return -1;
+        }
+
+        return daysFromCivil(year, month, day) * 86400L + hour * 3600L + minute * 60L + second;
+    }
+
+    // Run the SNTP exchange without blocking: send a request when a sync is due, pick up the reply later
+    void loop()
+    {
+        if (WiFi.status() != WL_CONNECTED)
+        {
+            return;
+        }
+
+        if (requestPending)
+        {
+            receiveSntpResponse();
+        }
+        else if (localMicros() >= nextSyncMicros)
+        {
+            sendSntpRequest();
+        }
+    }
+
+    // Time until loop() has to run again, DeadlineQueue::NEVER while offline (the reconnect wakes the caller)
+    unsigned long getMillisUntilDue()
+    {
+        if (WiFi.status() != WL_CONNECTED)
+        {
+            return DeadlineQueue::NEVER;
+        }
+
+        if (requestPending)
+        {
+            return SNTP_RESPONSE_POLL;
+        }
+
+        int64_t remaining = nextSyncMicros - localMicros();
+        return remaining > 0 ? (unsigned long)(remaining / 1000) + 1 : 0;
+    }
+
+    // Date header of a backend response. Used only while SNTP has not synced (or not for a long time).
+    // The header was generated between the request and the response, so the midpoint is the best estimate
+    void onHttpDate(const String& dateHeader, int64_t requestSentLocalMicros, int64_t responseLocalMicros)
+    {
+        long unixTime = parseHttpDate(dateHeader.c_str());
+        if (unixTime < 0)
+        {
+            return;
+        }
+
+        int64_t atLocalMicros = requestSentLocalMicros + (responseLocalMicros - requestSentLocalMicros) / 2;
+        int64_t unixMicros = unixTime * 1000000LL + 500000LL; // Middle of the reported second
+
+        portENTER_CRITICAL(&clockLock);
+        bool sntpIsFresh = source == TimeSource::SNTP && atLocalMicros - lastSntpLocalMicros < SNTP_STALE_AFTER;
+        int64_t error = unixMicros - estimateUnixMicros(atLocalMicros);
+        bool withinTolerance = source != TimeSource::NONE && error > -HTTP_DATE_TOLERANCE && error < HTTP_DATE_TOLERANCE;
+        portEXIT_CRITICAL(&clockLock);
+
+        if (sntpIsFresh || withinTolerance)
+        {
+            return; // The clock is already better than what a 1 s resolution header can tell
+        }
+
+        setReference(unixMicros, atLocalMicros, TimeSource::HTTP_DATE);
+        LOG_INFO(LOG_TIME, "ClockService: time set from the backend Date header: %lu", (unsigned long)unixTime);
+    }
+
+    bool isSynchronized()
+    {
+        return source != TimeSource::NONE;
+    }
+
+    TimeSource getSource() const
+    {
+        return source;
+    }
+
+    float getDriftPpm() const
+    {
+        return driftPpm;
+    }
+
+    // Current unix time in seconds (UTC), 0 while the clock was never set. Never decreases,
+    // a backward correction holds the time until the clock catches up
+    unsigned long getUnixTime()
+    {
+        portENTER_CRITICAL(&clockLock);
+        unsigned long unixTime = 0;
+        if (source != TimeSource::NONE)
+        {
+            unixTime = (unsigned long)(estimateUnixMicros(localMicros()) / 1000000LL);
+            if (unixTime < lastReturnedTime)
+            {
+                unixTime = lastReturnedTime;
+            }
+            lastReturnedTime = unixTime;
+        }
+        portEXIT_CRITICAL(&clockLock);
+        return unixTime;
+    }
+};
+
+constexpr const char* ClockService::SNTP_SERVERS[ClockService::NUM_OF_SNTP_SERVERS];
+
+#endif // CLOCK_SERVICE_H
@@ -0,0 +1,590 @@
+#ifndef COMMAND_CHANNEL_H
+#define COMMAND_CHANNEL_H
+
+#include <Arduino.h>
+#include <WiFi.h>
+#include <WiFiClientSecure.h>
+#include <lwip/sockets.h>
+#include <atomic>
+#include "DeadlineQueue.h"
+#include "FeederLog.h"
+
+// Broker used for pushed app commands. Override these at build time to test against a local
+// broker, e.g. -DFEEDER_MQTT_HOST=\"192.168.1.10\" -DFEEDER_MQTT_PORT=1883 -DFEEDER_MQTT_USE_TLS=0
+#ifndef FEEDER_MQTT_HOST
+#define FEEDER_MQTT_HOST "dev.bull-software.com"
+#endif
+
+#ifndef FEEDER_MQTT_PORT
+#define FEEDER_MQTT_PORT 8883
+#endif
+
+#ifndef FEEDER_MQTT_USE_TLS
+#define FEEDER_MQTT_USE_TLS 1
+#endif
+
+// Push channel for app commands: a minimal MQTT 3.1.1 client subscribed with QoS 1 to
+// "feeders/<ID>/command". The payload is the same command string get_esp32_command.php returns
+// (e.g. "DispenseNow_20"). The session is persistent, so commands sent while the feeder is
+// offline are delivered when it reconnects. Used from the networking task only; command polling
+// is kept as a fallback while this channel is down. A reader task (startReader()) waits on the socket,
+// so the networking task sleeps until bytes arrive or a keep-alive deadline is due.
+class CommandChannel
+{
+private:
+    static constexpr uint16_t KEEP_ALIVE_SECONDS = 60;
+    static constexpr unsigned long MIN_RECONNECT_INTERVAL = 5000;   // ms
+    static constexpr unsigned long MAX_RECONNECT_INTERVAL = 300000; // ms
+    static constexpr unsigned long PACKET_TIMEOUT = 2000;           // Max time for the rest of a started packet (ms)
+    static constexpr unsigned long SESSION_TIMEOUT = 10000;         // Max time for CONNACK and SUBACK (ms)
+    static constexpr unsigned long PING_INTERVAL = KEEP_ALIVE_SECONDS * 1000UL / 2;  // ms
+    static constexpr unsigned long KEEP_ALIVE_TIMEOUT = KEEP_ALIVE_SECONDS * 1500UL; // No packet for this long: the connection is dead (ms)
+    static constexpr unsigned long SOCKET_POLL_INTERVAL = 250;      // While no reader waits on the socket (ms)
+    static constexpr size_t MAX_PACKET_SIZE = 256;
+
+    // MQTT control packet types (upper nibble of the fixed header)
+    static constexpr uint8_t CONNECT = 0x10;
+    static constexpr uint8_t CONNACK = 0x20;
+    static constexpr uint8_t PUBLISH = 0x30;
+    static constexpr uint8_t PUBACK = 0x40;
+    static constexpr uint8_t SUBSCRIBE = 0x82; // Includes the reserved flags required by the spec
+    static constexpr uint8_t SUBACK = 0x90;
+    static constexpr uint8_t PINGREQ = 0xC0;
+
+    // The session opens over several loop() calls, so the networking task never waits on the broker
+    enum class SessionState : uint8_t
+    {
+        CLOSED,
+        CONNECTING,  // CONNECT sent, waiting for CONNACK
+        SUBSCRIBING, // SUBSCRIBE sent, waiting for SUBACK
+        OPEN
+    };
+
+    WiFiClientSecure secureClient;
+    WiFiClient plainClient;
+    Client* client = nullptr;
+
+    // Reader task: blocks in select() on the session socket and wakes the task running loop()
+    TaskHandle_t readerTask = nullptr;
+    TaskHandle_t loopTask = nullptr;
+    std::atomic<int> watchedSocket{-1};  // Socket loop() wants watched, -1 for none
+    std::atomic<int> selectedSocket{-1}; // Socket the reader is waiting on, -1 while it is not
+
+    String clientId;
+    String username;
+    String password;
+    String commandTopic;
+
+    SessionState sessionState = SessionState::CLOSED;
+    unsigned long sessionStateTime = 0;
+    unsigned long lastSendTime = 0;
+    unsigned long lastReceiveTime = 0;
+    unsigned long nextConnectTime = 0;
+    unsigned long reconnectInterval = MIN_RECONNECT_INTERVAL;
+    uint16_t lastDeliveredPacketId = 0;
+
+    // Packet being received. It is assembled from the bytes each loop() finds, so a partial packet
+    // never holds the networking task
+    uint8_t packet[MAX_PACKET_SIZE];
+    uint8_t packetHeader = 0;       // Fixed header byte, 0 until it arrived
+    size_t remainingLength = 0;
+    size_t lengthMultiplier = 1;
+    bool isLengthComplete = false;
+    size_t bodyReceived = 0;        // Bytes of the body read, those past MAX_PACKET_SIZE are dropped
+    unsigned long packetStartTime = 0;
+
+    // Append a length-prefixed string. Returns 0, with nothing written, when it does not fit
+    static size_t writeString(uint8_t* buffer, size_t bufferSize, size_t position, const String& value)
+    {
+        if (position + 2 + value.length() > bufferSize)
+        {
+            return 0;
+        }
+
+        buffer[position++] = value.length() >> 8;
+        buffer[position++] = value.length() & 0xFF;
+        memcpy(buffer + position, value.c_str(), value.length());
+        return position + value.length();
+    }
+
+    static size_t writeRemainingLength(uint8_t* buffer, size_t position, size_t length)
+    {
+        do
+        {
+            uint8_t encodedByte = length % 128;
+            length /= 128;
+            buffer[position++] = length > 0 ? (encodedByte | 0x80) : encodedByte;
+        } while (length > 0);
+
+        return position;
+    }
+
+    // Frame a control packet around a variable header + payload and send it
+    bool sendPacket(uint8_t header, const uint8_t* body, size_t bodyLength)
+    {
+        uint8_t fixedHeader[5];
+        fixedHeader[0] = header;
+        size_t fixedHeaderLength = writeRemainingLength(fixedHeader, 1, bodyLength);
+
+        if (client->write(fixedHeader, fixedHeaderLength) != fixedHeaderLength || (bodyLength > 0 && client->write(body, bodyLength) != bodyLength))
+        {
+            return false;
+        }
+
+        lastSendTime = FeederClock::millis();
+        return true;
+    }
+
+    enum class ReceiveResult : uint8_t
+    {
+        INCOMPLETE,
+        COMPLETE,
+        FAILED
+    };
+
+    // Take the bytes that have arrived, up to the end of the current packet. On COMPLETE, header and
+    // bodyLength describe the packet and its body is in `packet`. Bodies larger than MAX_PACKET_SIZE
+    // are consumed and reported with bodyLength = 0
+    ReceiveResult receivePacket(uint8_t& header, size_t& bodyLength)
+    {
+        while (client->available() > 0)
+        {
+            if (packetHeader == 0)
+            {
+                packetHeader = client->read();
+                remainingLength = 0;
+                lengthMultiplier = 1;
+                isLengthComplete = false;
+                bodyReceived = 0;
+                packetStartTime = FeederClock::millis();
+                if (packetHeader == 0)
+                {
+                    return ReceiveResult::FAILED; // Reserved packet type
+                }
+            }
+            else if (!isLengthComplete)
+            {
+                int encodedByte = client->read();
+                if (encodedByte < 0 || lengthMultiplier > 128 * 128 * 128)
+                {
+                    return ReceiveResult::FAILED;
+                }
+                remainingLength += (encodedByte & 0x7F) * lengthMultiplier;
+                lengthMultiplier *= 128;
+                isLengthComplete = (encodedByte & 0x80) == 0;
+            }
+            else
+            {
+                uint8_t dropped[32];
+                bool fits = remainingLength <= MAX_PACKET_SIZE;
+                size_t wanted = remainingLength - bodyReceived;
+                int count = client->read(fits ? packet + bodyReceived : dropped, fits ? wanted : min(wanted, sizeof(dropped)));
+                if (count <= 0)
+                {
+                    break;
+                }
+                bodyReceived += count;
+            }
+
+            if (isLengthComplete && bodyReceived == remainingLength)
+            {
+                header = packetHeader;
+                bodyLength = remainingLength <= MAX_PACKET_SIZE ? remainingLength : 0;
+                packetHeader = 0;
+                lastReceiveTime = FeederClock::millis();
+                return ReceiveResult::COMPLETE;
+            }
+        }
+
+        // A peer that stops in the middle of a packet is not going to finish it
+        if (packetHeader != 0 && FeederClock::millis() - packetStartTime > PACKET_TIMEOUT)
+        {
+            return ReceiveResult::FAILED;
+        }
+        return ReceiveResult::INCOMPLETE;
+    }
+
+    static void readerTaskEntry(void* parameter)
+    {
+        static_cast<CommandChannel*>(parameter)->runReader();
+    }
+
+    void runReader()
+    {
+        for (;;)
+        {
+            ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+            int socket = watchedSocket.load();
+            if (socket < 0)
+            {
+                continue;
+            }
+
+            // loop() runs at least once per ping interval and asks again, well before this timeout
+            fd_set readable;
+            FD_ZERO(&readable);
+            FD_SET(socket, &readable);
+            struct timeval timeout = {KEEP_ALIVE_SECONDS, 0};
+            selectedSocket.store(socket);
+            int result = lwip_select(socket + 1, &readable, nullptr, nullptr, &timeout);
+            selectedSocket.store(-1);
+
+            // Bytes, the peer's close, or the socket closed under us: loop() finds out which
+            if (result != 0)
+            {
+                xTaskNotifyGive(loopTask);
+            }
+        }
+    }
+
+    // Socket of the session, -1 without one (or when the client does not expose it)
+    int getSocket()
+    {
+#if FEEDER_MQTT_USE_TLS
+        return secureClient.fd();
+#else
+        return plainClient.fd();
+#endif
+    }
+
+    // Have the reader wait for the next bytes of the session
+    void watchSocket()
+    {
+        if (readerTask == nullptr)
+        {
+            return;
+        }
+
+        int socket = sessionState != SessionState::CLOSED && client->available() == 0 ? getSocket() : -1;
+        watchedSocket.store(socket);
+        if (socket >= 0)
+        {
+            loopTask = xTaskGetCurrentTaskHandle();
+            xTaskNotifyGive(readerTask);
+        }
+    }
+
+    static unsigned long getMillisUntil(unsigned long since, unsigned long interval)
+    {
+        unsigned long elapsed = FeederClock::millis() - since;
+        return elapsed < interval ? interval - elapsed : 0;
+    }
+
+    void setSessionState(SessionState state)
+    {
+        sessionState = state;
+        sessionStateTime = FeederClock::millis();
+    }
+
+    // Drop the connection. A session that failed to open is retried with backoff, a lost one right away
+    void closeSession(bool backOff)
+    {
+        client->stop();
+        setSessionState(SessionState::CLOSED);
+        packetHeader = 0;
+
+        if (backOff)
+        {
+            nextConnectTime = FeederClock::millis() + DeadlineQueue::withJitter(reconnectInterval);
+            reconnectInterval = reconnectInterval * 2 < MAX_RECONNECT_INTERVAL ? reconnectInterval * 2 : MAX_RECONNECT_INTERVAL;
+        }
+    }
+
+    // Connect and send CONNECT; the CONNACK is handled by loop()
+    bool openSession()
+    {
+        // CONNECT: protocol "MQTT" level 4, username + password, persistent session
+        uint8_t body[MAX_PACKET_SIZE];
+        size_t position = writeString(body, sizeof(body), 0, "MQTT");
+        body[position++] = 4;
+        body[position++] = 0x80 | 0x40; // Username and password, clean session off
+        body[position++] = KEEP_ALIVE_SECONDS >> 8;
+        body[position++] = KEEP_ALIVE_SECONDS & 0xFF;
+        position = writeString(body, sizeof(body), position, clientId);
+        position = position > 0 ? writeString(body, sizeof(body), position, username) : 0;
+        position = position > 0 ? writeString(body, sizeof(body), position, password) : 0;
+
+        // The portal limits the identity, so this only rejects one stored before it did
+        if (position == 0 || commandTopic.length() + 5 > sizeof(body))
+        {
+            LOG_ERROR(LOG_NETWORK, "CommandChannel: feeder ID or password too long for a session");
+            return false;
+        }
+
+        if (!client->connect(FEEDER_MQTT_HOST, FEEDER_MQTT_PORT))
+        {
+            LOG_WARN(LOG_NETWORK, "CommandChannel: unable to connect to %s", FEEDER_MQTT_HOST);
+            return false;
+        }
+
+        if (!sendPacket(CONNECT, body, position))
+        {
+            LOG_WARN(LOG_NETWORK, "CommandChannel: unable to send CONNECT");
+            return false;
+        }
+
+        packetHeader = 0;
+        lastReceiveTime = FeederClock::millis();
+        setSessionState(SessionState::CONNECTING);
+        return true;
+    }
+
+    // SUBSCRIBE to the command topic with QoS 1. Fits the buffer: checked by openSession()
+    bool subscribe()
+    {
+        uint8_t body[MAX_PACKET_SIZE];
+        size_t position = 0;
+        body[position++] = 0;
+        body[position++] = 1; // Packet id
+        position = writeString(body, sizeof(body), position, commandTopic);
+        body[position++] = 1;
+        return sendPacket(SUBSCRIBE, body, position);
+    }
+
+    // Handle a complete packet; returns the command of a PUBLISH, "" for anything else
+    String handlePacket(uint8_t header, size_t bodyLength)
+    {
+        switch (header & 0xF0)
+        {
+            case CONNACK:
+                if (sessionState != SessionState::CONNECTING || bodyLength != 2 || packet[1] != 0)
+                {
+                    LOG_WARN(LOG_NETWORK, "CommandChannel: broker refused the connection");
+                    closeSession(true);
+                }
+                else if (!subscribe())
+                {
+                    closeSession(true);
+                }
+                else
+                {
+                    setSessionState(SessionState::SUBSCRIBING);
+                }
+                return "";
+
+            case SUBACK:
+                if (sessionState != SessionState::SUBSCRIBING || bodyLength != 3 || packet[2] == 0x80)
+                {
+                    LOG_WARN(LOG_NETWORK, "CommandChannel: subscription to %s failed", commandTopic);
+                    closeSession(true);
+                    return "";
+                }
+                setSessionState(SessionState::OPEN);
+                reconnectInterval = MIN_RECONNECT_INTERVAL;
+                LOG_INFO(LOG_NETWORK, "CommandChannel: subscribed to %s", commandTopic);
+                return "";
+
+            case PUBLISH:
+                // The broker resends the unacknowledged commands of the session right after CONNACK,
+                // possibly before the SUBACK
+                return sessionState != SessionState::CONNECTING ? handlePublish(header, bodyLength) : "";
+
+            default:
+                return ""; // PINGRESP: lastReceiveTime is all it is for
+        }
+    }
+
+    // Handle an incoming PUBLISH; returns the command it carries ("" for duplicates)
+    String handlePublish(uint8_t header, size_t bodyLength)
+    {
+        if (bodyLength < 2)
+        {
+            return "";
+        }
+
+        uint8_t qos = (header >> 1) & 0x03;
+        size_t topicLength = (packet[0] << 8) | packet[1];
+        size_t position = 2 + topicLength;
+        uint16_t packetId = 0;
+
+        if (qos > 0)
+        {
+            if (position + 2 > bodyLength)
+            {
+                return "";
+            }
+            packetId = (packet[position] << 8) | packet[position + 1];
+            position += 2;
+
+            uint8_t ack[2] = {(uint8_t)(packetId >> 8), (uint8_t)(packetId & 0xFF)};
+            sendPacket(PUBACK, ack, sizeof(ack));
+        }
+
+        if (position > bodyLength)
+        {
+            return "";
+        }
+
+        // A QoS 1 redelivery of the command we just ran (our PUBACK got lost) must not run twice
+        bool isDuplicate = (header & 0x08) && packetId != 0 && packetId == lastDeliveredPacketId;
+        if (packetId != 0)
+        {
+            lastDeliveredPacketId = packetId;
+        }
+        if (isDuplicate)
+        {
+            return "";
+        }
+
+        String command;
+        command.concat((const char*)packet + position, bodyLength - position);
+        return command;
+    }
+
+    // The session step of loop()
+    String runSession()
+    {
+        if (WiFi.status() != WL_CONNECTED || clientId.isEmpty())
+        {
+            if (sessionState != SessionState::CLOSED)
+            {
+                closeSession(false);
+            }
+            return "";
+        }
+
+        if (sessionState == SessionState::CLOSED)
+        {
+            if ((long)(FeederClock::millis() - nextConnectTime) < 0)
+            {
+                return "";
+            }
+
+            if (!openSession())
+            {
+                closeSession(true);
+                return "";
+            }
+        }
+
+        if (!client->connected())
+        {
+            LOG_WARN(LOG_NETWORK, "CommandChannel: connection lost");
+            closeSession(sessionState != SessionState::OPEN);
+            return "";
+        }
+
+        uint8_t header = 0;
+        size_t bodyLength = 0;
+        ReceiveResult result = receivePacket(header, bodyLength);
+        if (result == ReceiveResult::FAILED)
+        {
+            LOG_WARN(LOG_NETWORK, "CommandChannel: connection lost");
+            closeSession(sessionState != SessionState::OPEN);
+            return "";
+        }
+
+        String command = result == ReceiveResult::COMPLETE ? handlePacket(header, bodyLength) : "";
+
+        if (sessionState == SessionState::CONNECTING || sessionState == SessionState::SUBSCRIBING)
+        {
+            if (FeederClock::millis() - sessionStateTime > SESSION_TIMEOUT)
+            {
+                LOG_WARN(LOG_NETWORK, "CommandChannel: no answer from the broker");
+                closeSession(true);
+            }
+            return command;
+        }
+
+        if (sessionState != SessionState::OPEN)
+        {
+            return command; // Closed by handlePacket()
+        }
+
+        if (FeederClock::millis() - lastSendTime >= PING_INTERVAL)
+        {
+            sendPacket(PINGREQ, nullptr, 0);
+        }
+
+        // No PINGRESP (or anything else) for a whole keep-alive period: the connection is dead
+        if (FeederClock::millis() - lastReceiveTime > KEEP_ALIVE_TIMEOUT)
+        {
+            LOG_WARN(LOG_NETWORK, "CommandChannel: keep-alive timeout");
+            closeSession(false);
+        }
+
+        return command;
+    }
+
+public:
+    CommandChannel(const String& feederId, const String& feederPassword)
+    {
+        clientId = feederId;
+        username = feederId;
+        password = feederPassword;
+        commandTopic = "feeders/" + feederId + "/command";
+
+#if FEEDER_MQTT_USE_TLS
+        // Same trust model as the HTTPS requests (no CA pinning)
+        secureClient.setInsecure();
+        client = &secureClient;
+#else
+        client = &plainClient;
+#endif
+    }
+
+    bool isConnected()
+    {
+        return sessionState == SessionState::OPEN && client->connected();
+    }
+
+    // Wait on the session socket from a task of its own, so loop() needs no socket polling
+    void startReader(UBaseType_t priority, BaseType_t core)
+    {
+        if (readerTask == nullptr)
+        {
+            xTaskCreatePinnedToCore(readerTaskEntry, "mqtt_reader", 2560, this, priority, &readerTask, core);
+        }
+    }
+
+    // Keep the session alive and return the next pushed command, or "" if there is none
+    String loop()
+    {
+        String command = runSession();
+        watchSocket();
+        return command;
+    }
+
+    // Time until loop() has to run again: right away while received bytes wait; while the reader waits
+    // on the socket, the next ping, keep-alive, handshake or packet deadline; the socket poll without
+    // the reader; the next reconnect when the session is closed
+    unsigned long getMillisUntilDue()
+    {
+        if (WiFi.status() != WL_CONNECTED || clientId.isEmpty())
+        {
+            return DeadlineQueue::NEVER;
+        }
+
+        if (sessionState == SessionState::CLOSED)
+        {
+            long remaining = (long)(nextConnectTime - FeederClock::millis());
+            return remaining > 0 ? (unsigned long)remaining : 0;
+        }
+
+        if (client->available() > 0)
+        {
+            return 0;
+        }
+
+        int socket = getSocket();
+        if (readerTask == nullptr || socket < 0 || selectedSocket.load() != socket)
+        {
+            return SOCKET_POLL_INTERVAL;
+        }
+
+        unsigned long due = sessionState == SessionState::OPEN ? min(getMillisUntil(lastSendTime, PING_INTERVAL), getMillisUntil(lastReceiveTime, KEEP_ALIVE_TIMEOUT + 1))
+                                                               : getMillisUntil(sessionStateTime, SESSION_TIMEOUT + 1);
+        if (packetHeader != 0)
+        {
+            due = min(due, getMillisUntil(packetStartTime, PACKET_TIMEOUT + 1));
+        }
+        return due;
+    }
+
+    void disconnect()
+    {
+        closeSession(false);
+    }
+};
+
+#endif // COMMAND_CHANNEL_H
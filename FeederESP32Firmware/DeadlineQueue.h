@@ -0,0 +1,103 @@
+#ifndef DEADLINE_QUEUE_H
+#define DEADLINE_QUEUE_H
+
+#include <Arduino.h>
+#include <freertos/FreeRTOS.h>
+#include "FeederHal.h"
+
+// Spread of the delays passed to DeadlineQueue::withJitter(), in percent either way. Feeders that boot
+// together (e.g. after a power cut) or see the same backend outage would otherwise poll and retry in step
+#ifndef FEEDER_POLL_JITTER_PERCENT
+#define FEEDER_POLL_JITTER_PERCENT 20
+#endif
+
+// Deadlines of the jobs run by one task. Each job registers when it next needs to run, and the task
+// blocks until the earliest one instead of waking on a fixed period. Times are FeederClock::millis()
+class DeadlineQueue
+{
+public:
+    static constexpr int MAX_JOBS = 16;
+    static constexpr unsigned long NEVER = 0xFFFFFFFFUL; // Delay of a job that waits for an event only
+
+    // Block time for a delay in ms. Waits are in real time, so they follow the clock speedup
+    static TickType_t toTicks(unsigned long delay)
+    {
+        if (delay == NEVER)
+        {
+            return portMAX_DELAY;
+        }
+
+        return pdMS_TO_TICKS(FeederClock::toTimerMicros((uint64_t)delay * 1000ULL) / 1000ULL);
+    }
+
+    // Random delay within FEEDER_POLL_JITTER_PERCENT of the given one, for the recurring backend requests
+    static unsigned long withJitter(unsigned long delay)
+    {
+        if (delay == NEVER)
+        {
+            return NEVER;
+        }
+
+        long spread = (long)((uint64_t)delay * FEEDER_POLL_JITTER_PERCENT / 100);
+        return (unsigned long)random((long)delay - spread, (long)delay + spread + 1);
+    }
+
+private:
+    unsigned long dueTimes[MAX_JOBS];
+    bool isJobArmed[MAX_JOBS] = {};
+
+public:
+    // Run the job after delay ms (0: on the next pass). Replaces its previous deadline; NEVER cancels it
+    void scheduleIn(int job, unsigned long delay)
+    {
+        isJobArmed[job] = delay != NEVER;
+        dueTimes[job] = FeederClock::millis() + delay;
+    }
+
+    void cancel(int job)
+    {
+        isJobArmed[job] = false;
+    }
+
+    bool isArmed(int job) const
+    {
+        return isJobArmed[job];
+    }
+
+    // True once the deadline passed. The job is disarmed until it is scheduled again
+    bool isDue(int job)
+    {
+        if (!isJobArmed[job] || (long)(FeederClock::millis() - dueTimes[job]) < 0)
+        {
+            return false;
+        }
+
+        isJobArmed[job] = false;
+        return true;
+    }
+
+    // Block time until the earliest deadline, portMAX_DELAY when no job is armed
+    TickType_t getWaitTicks() const
+    {
+        unsigned long now = FeederClock::millis();
+        unsigned long wait = NEVER;
+
+        for (int job = 0; job < MAX_JOBS; job++)
+        {
+            if (!isJobArmed[job])
+            {
+                continue;
+            }
+
+            long remaining = (long)(dueTimes[job] - now);
+            unsigned long jobWait = remaining > 0 ? (unsigned long)remaining : 0;
+            wait = jobWait < wait ? jobWait : wait;
+        }
+
+        return toTicks(wait);
+    }
+};
+
+constexpr unsigned long DeadlineQueue::NEVER;
+
+#endif // DEADLINE_QUEUE_H
@@ -0,0 +1,148 @@
+#ifndef DISPENSE_FLOW_MODEL_H
+#define DISPENSE_FLOW_MODEL_H
+
+#include <Arduino.h>
+#include "FeederDataTypes.h"
+#include "MemoryController.h"
+#include "FeederLog.h"
+
+// Learned flow model of the dispenser, used to stop the motor before the target weight is reached.
+// When the relay opens, the auger still coasts and the food already in the chute has not landed
+// yet, so the bowl keeps gaining weight for a while. The model predicts that in-flight mass as
+// flowRate * inFlightSeconds and learns both values from every dispense. It is persisted in NVS,
+// so each feeder keeps the model that matches its own auger, chute and kibble.
+class DispenseFlowModel
+{
+private:
+    static constexpr const char* NVS_NAMESPACE = "flow";
+    static constexpr const char* KEY_MODEL = "model";
+    static constexpr uint16_t MODEL_VERSION = 1;
+
+    static constexpr float DEFAULT_GRAMS_PER_SECOND = 2.0f;
+    static constexpr float DEFAULT_IN_FLIGHT_SECONDS = 0.5f; // Relay release + auger coast + fall time + scale filter lag
+    static constexpr float MAX_IN_FLIGHT_SECONDS = 3.0f;
+    static constexpr float LEARNING_RATE = 0.3f;            // Weight of the newest dispense in the learned values
+    static constexpr float MIN_LEARNING_FLOW_RATE = 0.2f;   // Slower flows say nothing about the in-flight time (g/s)
+    static constexpr int MIN_FLOW_SAMPLES = 3;
+    static constexpr unsigned long MIN_FLOW_SPAN = 200;     // Shortest sample span used for a flow estimate (ms)
+
+    struct Model
+    {
+        uint16_t version;
+        uint16_t learnedDispenses;
+        float gramsPerSecond;   // Average flow while the motor runs
+        float inFlightSeconds;  // Weight still landing after the cut-off, expressed as seconds of flow
+    };
+
+    Model model = {MODEL_VERSION, 0, DEFAULT_GRAMS_PER_SECOND, DEFAULT_IN_FLIGHT_SECONDS};
+
+public:
+    static constexpr int FLOW_WINDOW = 8; // Most recent samples used to estimate the current flow
+
+    struct FlowEstimate
+    {
+        float gramsPerSecond; // Current flow
+        float weight;         // Bowl weight at the newest sample, on the fitted line (less noise and lag than the filtered weight)
+    };
+
+    void load(MemoryController* memoryController)
+    {
+        Model loadedModel;
+        if (memoryController->loadBlob(NVS_NAMESPACE, KEY_MODEL, &loadedModel, sizeof(loadedModel)) && loadedModel.version == MODEL_VERSION)
+        {
+            model = loadedModel;
+        }
+
+        log();
+    }
+
+    void save(MemoryController* memoryController)
+    {
+        memoryController->saveBlob(NVS_NAMESPACE, KEY_MODEL, &model, sizeof(model));
+    }
+
+    // Least-squares line through the samples taken since sinceTime. Falls back to the learned
+    // flow and the newest sample until there are enough samples for a stable estimate
+    FlowEstimate estimateFlow(const WeightReading* samples, int count, unsigned long sinceTime) const
+    {
+        FlowEstimate estimate = {model.gramsPerSecond, count > 0 ? (float)samples[count - 1].weight : 0.0f};
+
+        int first = 0;
+        while (first < count && (long)(samples[first].timestamp - sinceTime) < 0)
+        {
+            first++;
+        }
+
+        int used = count - first;
+        if (used < MIN_FLOW_SAMPLES || samples[count - 1].timestamp - samples[first].timestamp < MIN_FLOW_SPAN)
+        {
+            return estimate;
+        }
+
+        // Timestamps relative to the first sample keep the sums small enough for float
+        float sumT = 0, sumW = 0, sumTT = 0, sumTW = 0;
+        for (int i = first; i < count; i++)
+        {
+            float t = (samples[i].timestamp - samples[first].timestamp) / 1000.0f;
+            float w = samples[i].weight;
+            sumT += t;
+            sumW += w;
+            sumTT += t * t;
+            sumTW += t * w;
+        }
+
+        float denominator = used * sumTT - sumT * sumT;
+        if (denominator <= 0)
+        {
+            return estimate;
+        }
+
+        float slope = (used * sumTW - sumT * sumW) / denominator;
+        float lastT = (samples[count - 1].timestamp - samples[first].timestamp) / 1000.0f;
+
+        estimate.gramsPerSecond = slope > 0 ? slope : 0;
+        estimate.weight = (sumW - slope * sumT) / used + slope * lastT;
+        return estimate;
+    }
+
+    // Grams that will still land in the bowl if the motor is stopped now
+    float predictInFlightGrams(float flowRate) const
+    {
+        return flowRate * model.inFlightSeconds;
+    }
+
+    bool shouldCutOff(const FlowEstimate& estimate, int targetWeight) const
+    {
+        return estimate.weight + predictInFlightGrams(estimate.gramsPerSecond) >= targetWeight;
+    }
+
+    // Update the model with a finished dispense. weightAtCutoff and flowRateAtCutoff are the values
+    // seen when the motor was stopped, settledWeight is the weight after the food landed
+    void learn(int initialWeight, float weightAtCutoff, int settledWeight, float flowRateAtCutoff, unsigned long motorMillis)
+    {
+        if (flowRateAtCutoff >= MIN_LEARNING_FLOW_RATE)
+        {
+            float observedInFlightSeconds = (settledWeight - weightAtCutoff) / flowRateAtCutoff;
+            observedInFlightSeconds = constrain(observedInFlightSeconds, 0.0f, MAX_IN_FLIGHT_SECONDS);
+            model.inFlightSeconds += LEARNING_RATE * (observedInFlightSeconds - model.inFlightSeconds);
+        }
+
+        if (motorMillis > 0 && settledWeight > initialWeight)
+        {
+            float observedGramsPerSecond = (settledWeight - initialWeight) * 1000.0f / motorMillis;
+            model.gramsPerSecond += LEARNING_RATE * (observedGramsPerSecond - model.gramsPerSecond);
+        }
+
+        if (model.learnedDispenses < 0xFFFF)
+        {
+            model.learnedDispenses++;
+        }
+    }
+
+    void log() const
+    {
+        LOG_INFO(LOG_FEEDER, "DispenseFlowModel: flow %.2f g/s, in flight %.2f s, learned from %u dispenses", model.gramsPerSecond, model.inFlightSeconds, (unsigned int)model.learnedDispenses);
+    }
+};
+
+#endif // DISPENSE_FLOW_MODEL_H
@@ -0,0 +1,338 @@
+#ifndef FEEDER_BENCHMARKS_H
+#define FEEDER_BENCHMARKS_H
+
+#include <Arduino.h>
+#include <algorithm>
+#include "FeederDataTypes.h"
+#include "DispenseFlowModel.h"
+#include "FeederController.h"
+#include "WebConnectionController.h"
+#include "ClockService.h"
+
+// Multiplies the iterations of the timed loops. The host build raises it, since its calls are too
+// fast for the microsecond clock at the device counts
+#ifndef FEEDER_BENCHMARK_REPEAT
+#define FEEDER_BENCHMARK_REPEAT 1
+#endif
+
+// On-device benchmarks, compiled only when FEEDER_BENCHMARKS is defined in FeederESP32Firmware.ino.
+// Results are printed as one JSON object per line so they can be collected from the serial log.
+// The first line identifies the build, so runs of different firmware versions can be compared.
+namespace FeederBenchmarks
+{
+    // Build a {"HH:MM": grams} schedule with the requested number of entries. Reversed by default,
+    // the worst case of the insertion sort
+    static String buildScheduleJson(int numOfEntries, bool reversed = true)
+    {
+        String json;
+        json.reserve(numOfEntries * 12 + 2);
+        json += "{";
+
+        for (int i = 0; i < numOfEntries; i++)
+        {
+            int minute = i * MAX_ENTRIES_NUM / numOfEntries;
+            minute = reversed ? MAX_ENTRIES_NUM - 1 - minute : minute;
+            char pair[24];
+            snprintf(pair, sizeof(pair), "%s\"%02d:%02d\":%d", i == 0 ? "" : ",", minute / 60, minute % 60, 10 + i % 40);
+            json += pair;
+        }
+
+        json += "}";
+        return json;
+    }
+
+    // Results of the timed calls are stored here, so they are not optimized out
+    static volatile int64_t sink = 0;
+
+    // Average nanoseconds per call, from the total time of the calls
+    static uint32_t nanosPerCall(unsigned long totalMicros, uint32_t calls)
+    {
+        return (uint32_t)((uint64_t)totalMicros * 1000ULL / calls);
+    }
+
+    static void printBuildInfo()
+    {
+        Serial.printf("{\"benchmark\":\"build\",\"built\":\"%s %s\",\"sdk\":\"%s\",\"cpuMHz\":%u}\n", __DATE__, __TIME__, ESP.getSdkVersion(), ESP.getCpuFreqMHz());
+    }
+
+    // FeedConfigData construction: two JSON passes, then the sort
+    static void runScheduleParseBenchmark(int numOfEntries, bool reversed, int iterations = 5 * FEEDER_BENCHMARK_REPEAT)
+    {
+        String json = buildScheduleJson(numOfEntries, reversed);
+
+        uint32_t freeHeapBefore = ESP.getFreeHeap();
+        unsigned long totalMicros = 0;
+        int parsedEntries = 0;
+        size_t tableBytes = 0;
+
+        for (int i = 0; i < iterations; i++)
+        {
+            unsigned long start = micros();
+            FeedConfigData feedConfigData(json);
+            totalMicros += micros() - start;
+
+            parsedEntries = feedConfigData.numOfEntries;
+            tableBytes = feedConfigData.getMemoryUsage();
+        }
+
+        // The minimum free heap is a low-water mark since boot, so this is an upper bound of the parse peak
+        uint32_t minFreeHeap = ESP.getMinFreeHeap();
+        uint32_t peakHeapBytes = freeHeapBefore > minFreeHeap ? freeHeapBefore - minFreeHeap : 0;
+
+        Serial.printf("{\"benchmark\":\"schedule_parse\",\"entries\":%d,\"order\":\"%s\",\"parsed\":%d,\"jsonBytes\":%u,\"avgMicros\":%lu,\"tableBytes\":%u,\"peakHeapBytes\":%u}\n",
+                      numOfEntries, reversed ? "reversed" : "sorted", parsedEntries, json.length(), totalMicros / iterations, (unsigned)tableBytes, peakHeapBytes);
+    }
+
+    static void runEntryMinutesBenchmark(int iterations = 100 * FEEDER_BENCHMARK_REPEAT)
+    {
+        FeedConfigData feedConfigData(buildScheduleJson(MAX_ENTRIES_NUM));
+        int sum = 0;
+
+        unsigned long start = micros();
+        for (int i = 0; i < iterations; i++)
+        {
+            for (int j = 0; j < feedConfigData.numOfEntries; j++)
+            {
+                sum += feedConfigData.configEntries[j].getTotalMinutesSinceMidnight();
+            }
+        }
+        unsigned long totalMicros = micros() - start;
+        sink = sum;
+
+        Serial.printf("{\"benchmark\":\"entry_minutes\",\"calls\":%d,\"avgNanos\":%u}\n",
+                      iterations * feedConfigData.numOfEntries, nanosPerCall(totalMicros, iterations * feedConfigData.numOfEntries));
+    }
+
+    // FeederController::loop() on a synthetic schedule, before the scheduling task runs it. The time is not
+    // synced yet at boot, so this is the tick between feedings; the day rollover scan is timed on its own
+    static void runSchedulerTickBenchmark(FeederController* feederController, int numOfEntries, int iterations = 1000 * FEEDER_BENCHMARK_REPEAT)
+    {
+        feederController->setFeedConfigData(new FeedConfigData(buildScheduleJson(numOfEntries)));
+
+        unsigned long start = micros();
+        for (int i = 0; i < iterations; i++)
+        {
+            feederController->loop();
+        }
+        unsigned long loopMicros = micros() - start;
+
+        start = micros();
+        for (int i = 0; i < iterations; i++)
+        {
+            feederController->resetFeedConfigDataDispenseStatus();
+        }
+        unsigned long dayResetMicros = micros() - start;
+
+        Serial.printf("{\"benchmark\":\"scheduler_tick\",\"entries\":%d,\"loopNanos\":%u,\"dayResetNanos\":%u}\n",
+                      feederController->getNumOfEntries(), nanosPerCall(loopMicros, iterations), nanosPerCall(dayResetMicros, iterations));
+    }
+
+    // Body of one outbox upload, cycling through the three event types
+    static void runEventBatchPayloadBenchmark(WebConnectionController* webConnection, int numOfRecords, int iterations = 20 * FEEDER_BENCHMARK_REPEAT)
+    {
+        static constexpr int MAX_RECORDS = 16; // UplinkOutbox batch size
+        OutboxRecord records[MAX_RECORDS];
+        numOfRecords = numOfRecords < MAX_RECORDS ? numOfRecords : MAX_RECORDS;
+
+        for (int i = 0; i < numOfRecords; i++)
+        {
+            records[i] = {(uint32_t)(1000 + i), {(UplinkEventType)(i % 3), 1700000000UL + i * 60, 1700000030UL + i * 60, 12.5f + i}};
+        }
+
+        unsigned long totalMicros = 0;
+        size_t payloadBytes = 0;
+
+        for (int i = 0; i < iterations; i++)
+        {
+            unsigned long start = micros();
+            String payload;
+            webConnection->buildEventBatchPayload(0x5EEDCAFE, records, numOfRecords, payload);
+            totalMicros += micros() - start;
+
+            payloadBytes = payload.length();
+        }
+
+        Serial.printf("{\"benchmark\":\"event_batch_payload\",\"events\":%d,\"payloadBytes\":%u,\"avgMicros\":%lu}\n",
+                      numOfRecords, (unsigned)payloadBytes, totalMicros / iterations);
+    }
+
+    // Time sync response parsing: the SNTP transmit timestamp and the HTTP Date header fallback
+    static void runTimeParseBenchmark(int iterations = 1000 * FEEDER_BENCHMARK_REPEAT)
+    {
+        const uint8_t transmitTimestamp[8] = {0xE8, 0x9B, 0x2C, 0x10, 0x40, 0x00, 0x00, 0x00};
+
+        unsigned long start = micros();
+        for (int i = 0; i < iterations; i++)
+        {
+            sink = ClockService::ntpToUnixMicros(transmitTimestamp);
+        }
+        unsigned long sntpMicros = micros() - start;
+
+        start = micros();
+        for (int i = 0; i < iterations; i++)
+        {
+            sink = ClockService::parseHttpDate("Sun, 06 Nov 1994 08:49:37 GMT");
+        }
+        unsigned long httpDateMicros = micros() - start;
+
+        Serial.printf("{\"benchmark\":\"time_parse\",\"sntpNanos\":%u,\"httpDateNanos\":%u}\n",
+                      nanosPerCall(sntpMicros, iterations), nanosPerCall(httpDateMicros, iterations));
+    }
+
+    // Deterministic xorshift32, so every run simulates the same dispenses
+    static float nextRandom(uint32_t& state)
+    {
+        state ^= state << 13;
+        state ^= state >> 17;
+        state ^= state << 5;
+        return (state & 0xFFFFFF) / (float)0x1000000; // [0, 1)
+    }
+
+    // Auger + chute model: food leaves the auger at gramsPerSecond while the motor runs and for
+    // coastTime after it stops, and lands in the bowl fallDelay later
+    struct SimulatedDispenser
+    {
+        float gramsPerSecond;
+        unsigned long fallDelay;
+        unsigned long coastTime;
+
+        float landedGrams(unsigned long time, unsigned long motorOffTime) const
+        {
+            if (time <= fallDelay)
+            {
+                return 0;
+            }
+
+            unsigned long deliveredUntil = time - fallDelay;
+            if (deliveredUntil > motorOffTime + coastTime)
+            {
+                deliveredUntil = motorOffTime + coastTime;
+            }
+
+            return gramsPerSecond * deliveredUntil / 1000.0f;
+        }
+    };
+
+    enum class DispenseSimulationMode
+    {
+        THRESHOLD_1S,  // Stop once the weight reached the target, checked every second (the original controller)
+        THRESHOLD,     // Same, checked on every scale sample
+        PREDICTIVE     // Stop when the predicted in-flight mass reaches the target, learning after every dispense
+    };
+
+    static constexpr unsigned long SIMULATED_SAMPLE_INTERVAL = 100; // HX711 at 10 SPS (ms)
+    static constexpr int MAX_SIMULATED_DISPENSES = 200;
+
+    // Returns the overshoot of one simulated dispense in grams (negative when short)
+    static float simulateDispense(DispenseSimulationMode mode, const SimulatedDispenser& dispenser, int targetWeight, DispenseFlowModel& flowModel, uint32_t& randomState)
+    {
+        WeightReading samples[DispenseFlowModel::FLOW_WINDOW];
+        int sampleCount = 0;
+        unsigned long checkInterval = mode == DispenseSimulationMode::THRESHOLD_1S ? 1000 : SIMULATED_SAMPLE_INTERVAL;
+        unsigned long motorOffTime = 70000;
+        float cutoffWeight = 0;
+        float cutoffFlowRate = 0;
+
+        for (unsigned long time = SIMULATED_SAMPLE_INTERVAL; time < motorOffTime; time += SIMULATED_SAMPLE_INTERVAL)
+        {
+            // +-1 g of scale noise
+            int weight = (int)(dispenser.landedGrams(time, motorOffTime) + nextRandom(randomState) * 2.0f - 1.0f + 0.5f);
+
+            if (sampleCount == DispenseFlowModel::FLOW_WINDOW)
+            {
+                memmove(samples, samples + 1, (sampleCount - 1) * sizeof(WeightReading));
+                sampleCount--;
+            }
+            samples[sampleCount++] = {weight, time, false};
+
+            if (time % checkInterval != 0)
+            {
+                continue;
+            }
+
+            DispenseFlowModel::FlowEstimate flow = flowModel.estimateFlow(samples, sampleCount, 0);
+            bool cutOff = mode == DispenseSimulationMode::PREDICTIVE ? flowModel.shouldCutOff(flow, targetWeight) : weight >= targetWeight;
+            if (cutOff)
+            {
+                motorOffTime = time;
+                cutoffWeight = flow.weight;
+                cutoffFlowRate = flow.gramsPerSecond;
+            }
+        }
+
+        float settledWeight = dispenser.landedGrams(motorOffTime + 10000, motorOffTime);
+
+        if (mode == DispenseSimulationMode::PREDICTIVE)
+        {
+            flowModel.learn(0, cutoffWeight, (int)(settledWeight + 0.5f), cutoffFlowRate, motorOffTime);
+        }
+
+        return settledWeight - targetWeight;
+    }
+
+    // Overshoot distribution of the three cut-off strategies over the same simulated dispenses.
+    // Each dispense draws a target of 10-40 g and a flow within 15% of the feeder's nominal flow
+    static void runDispenseSimulation(DispenseSimulationMode mode, const char* name, int numOfDispenses)
+    {
+        static float overshoots[MAX_SIMULATED_DISPENSES];
+        numOfDispenses = numOfDispenses < MAX_SIMULATED_DISPENSES ? numOfDispenses : MAX_SIMULATED_DISPENSES;
+
+        uint32_t randomState = 0x5EED1234;
+        DispenseFlowModel flowModel; // Starts from the defaults, as on a new feeder
+        float sumOvershoot = 0;
+
+        for (int i = 0; i < numOfDispenses; i++)
+        {
+            SimulatedDispenser dispenser = {3.0f * (0.85f + nextRandom(randomState) * 0.3f), 600, 200};
+            int targetWeight = 10 + (int)(nextRandom(randomState) * 31);
+
+            overshoots[i] = simulateDispense(mode, dispenser, targetWeight, flowModel, randomState);
+            sumOvershoot += overshoots[i];
+        }
+
+        // Percentiles of the absolute error
+        for (int i = 0; i < numOfDispenses; i++)
+        {
+            overshoots[i] = fabsf(overshoots[i]);
+        }
+        std::sort(overshoots, overshoots + numOfDispenses);
+
+        Serial.printf("{\"benchmark\":\"dispense_overshoot\",\"controller\":\"%s\",\"dispenses\":%d,\"meanGrams\":%.2f,\"p50AbsGrams\":%.2f,\"p95AbsGrams\":%.2f,\"maxAbsGrams\":%.2f}\n",
+                      name, numOfDispenses, sumOvershoot / numOfDispenses, overshoots[numOfDispenses / 2], overshoots[numOfDispenses * 95 / 100], overshoots[numOfDispenses - 1]);
+    }
+
+    // Runs in setup(), once the controllers exist but before the scheduling and networking tasks start
+    static void runAll(FeederController* feederController, WebConnectionController* webConnection)
+    {
+        Serial.println("FeederBenchmarks: start");
+        printBuildInfo();
+
+        const int scheduleSizes[] = {1, 10, 100, MAX_ENTRIES_NUM};
+        for (int numOfEntries : scheduleSizes)
+        {
+            runScheduleParseBenchmark(numOfEntries, true);
+            runScheduleParseBenchmark(numOfEntries, false);
+        }
+
+        runEntryMinutesBenchmark();
+
+        for (int numOfEntries : scheduleSizes)
+        {
+            runSchedulerTickBenchmark(feederController, numOfEntries);
+        }
+        feederController->reloadFeedConfigData(); // Back to the stored schedule
+
+        runEventBatchPayloadBenchmark(webConnection, 1);
+        runEventBatchPayloadBenchmark(webConnection, 16);
+
+        runTimeParseBenchmark();
+
+        runDispenseSimulation(DispenseSimulationMode::THRESHOLD_1S, "threshold_1s", MAX_SIMULATED_DISPENSES);
+        runDispenseSimulation(DispenseSimulationMode::THRESHOLD, "threshold", MAX_SIMULATED_DISPENSES);
+        runDispenseSimulation(DispenseSimulationMode::PREDICTIVE, "predictive", MAX_SIMULATED_DISPENSES);
+
+        Serial.println("FeederBenchmarks: done");
+    }
+}
+
+#endif // FEEDER_BENCHMARKS_H
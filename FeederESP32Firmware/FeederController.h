@@ -1,8 +1,19 @@
+#ifndef FEEDER_CONTROLLER_H
+#define FEEDER_CONTROLLER_H
+
 #include <MemoryController.h>
 #include <WeightController.h>
 #include <WebConnectionController.h>
 #include <FeederDataTypes.h>
 #include <GateController.h>
+#include "StationProfile.h"
+#include "TaskQueues.h"
+#include "DispenseFlowModel.h"
+#include "ScheduleSnapshot.h"
+#include "FeederHal.h"
+#include "DeadlineQueue.h"
+#include "FeederLog.h"
+#include <esp_timer.h>
 
 static int getCurrentDayFromUnix(unsigned long unixTime)
 {
@@ -14,22 +25,10 @@ static int getRelativeMinutesSinceMidnight(unsigned long unixTime)
     return (unixTime % 86400L) / 60; // Extracts hours and minutes as total minutes since midnight
 }
 
-static String debugMinutes(unsigned long minutesSinceMidnight) 
-{
-    int hour = minutesSinceMidnight / 60;
-    int minutes = minutesSinceMidnight % 60;
-
-    return String(hour) + ":" + String(minutes);
-}
-
 class FeederController
 {
 private:
-    struct RelayPins 
-    {
-        static constexpr int MOTOR_CONTROL = 21;
-    };
-
+    uint8_t station;
     MemoryController* memoryController = nullptr;
     WeightController* weightController = nullptr;
     WebConnectionController* webConnection = nullptr;
@@ -40,26 +39,228 @@ private:
     int currentDay; // 0-6, 0-monday, ... 6-sunday
     int minutesSinceMidnight; // 0-1440
     bool canFeedByTime = false;
+
+    // Scheduler cursor: index of the next undispensed entry in the sorted schedule.
+    // When it reaches numOfEntries, the next wakeup is the midnight rollover.
+    int nextEntryIndex = 0;
+
+    // One-shot timer armed for the exact second the next entry (or midnight) is due
+    esp_timer_handle_t feedingTimer = nullptr;
+    volatile bool feedingTimerFired = false;
+
+    static constexpr long SECONDS_PER_DAY = 86400L;
+
+    // Dispense state machine, advanced from loop() so the rest of the firmware keeps running
+    // while food is dispensed: IDLE -> MOTOR_ON -> SETTLING -> DONE / PARTIAL / FAILED
+    // The motor is stopped early, when the learned in-flight mass would reach the target.
+    static constexpr unsigned long DISPENSE_SAMPLE_INTERVAL = 50;  // Cut-off check cadence, the scale runs at full rate while dispensing (ms)
+    static constexpr unsigned long DISPENSE_LOG_INTERVAL = 1000;   // Progress log cadence while the motor runs (ms)
+    static constexpr unsigned long SCALE_READY_POLL = 500;          // Recheck of the scale for a dispense queued until the tare (ms)
+    static constexpr unsigned long DISPENSE_SETTLING_TIME = 1500;  // Time for the food in flight to land after the motor stops (ms)
+    static constexpr unsigned long DISPENSE_MAX_MOTOR_TIME = 70000; // Give up if the target is not reached in this time (ms)
+    static constexpr int DISPENSE_MAX_BOWL_WEIGHT = 60;             // Never fill the bowl above this weight (grams)
+    static constexpr int DISPENSE_MIN_PARTIAL_WEIGHT = 5;           // Ignore smaller weight changes as scale noise (grams)
+    static constexpr int DISPENSE_TARGET_TOLERANCE = 2;             // A dispense this close to the target counts as complete (grams)
+
+    FeedConfigEntry activeDispense;
+    unsigned long dispenseStateStartTime = 0;
+    unsigned long lastDispenseSampleTime = 0;
+    int dispenseInitialWeight = 0;
+    int dispenseCurrentWeight = 0;
+    int dispenseExpectedWeight = 0;
+    unsigned long dispenseMotorStartTime = 0;
+    unsigned long dispenseMotorMillis = 0;
+    unsigned long lastDispenseLogTime = 0;
+    float dispenseCutoffWeight = 0;
+    float dispenseCutoffFlowRate = 0;
+    bool dispenseTimedOut = false;
+
+    DispenseFlowModel flowModel;
+
+    // Boot timing of the schedule, see loadFeedConfigData()
+    bool scheduleLoadedFromSnapshot = false;
+    uint32_t scheduleLoadMicros = 0;
+    int64_t schedulerReadyMicros = 0;
+
+    // Dispenses requested while another one is running (e.g. DispenseNow during a scheduled feeding)
+    static constexpr int MAX_PENDING_DISPENSES = 4;
+    FeedConfigEntry pendingDispenses[MAX_PENDING_DISPENSES];
+    int pendingDispensesHead = 0;
+    int pendingDispensesCount = 0;
+
+    static void onFeedingTimer(void* arg)
+    {
+        // Runs in the esp_timer task, so only flag the wakeup and wake the scheduling task; the dispense runs from loop()
+        FeederController* feederController = static_cast<FeederController*>(arg);
+        feederController->feedingTimerFired = true;
+        TaskQueues::postAppCommand(feederController->station, AppCommandType::FEEDING_DUE, 0);
+    }
+
+    void createFeedingTimer()
+    {
+        esp_timer_create_args_t timerArgs = {};
+        timerArgs.callback = &FeederController::onFeedingTimer;
+        timerArgs.arg = this;
+        timerArgs.dispatch_method = ESP_TIMER_TASK;
+        timerArgs.name = "feeding";
+
+        if (esp_timer_create(&timerArgs, &feedingTimer) != ESP_OK)
+        {
+            LOG_ERROR(LOG_FEEDER, "FeederController: unable to create the feeding timer");
+            feedingTimer = nullptr;
+        }
+    }
+
+    // Use the binary snapshot of the schedule when it was built from the latest JSON. Otherwise
+    // parse the JSON and snapshot the result, so only the first boot after a schedule change parses it
+    void loadFeedConfigData()
+    {
+        uint32_t sourceCrc = memoryController->getFoodConfigCrc();
+
+        feedConfigData = ScheduleSnapshot::load(memoryController, sourceCrc);
+        scheduleLoadedFromSnapshot = feedConfigData != nullptr;
+
+        if (!scheduleLoadedFromSnapshot)
+        {
+            // A JSON that did not fit in NVS leaves an older one behind, which is used until the next fetch
+            String feedConfigJson = memoryController->getFoodConfigJson();
+            if (ScheduleSnapshot::getSourceCrc(feedConfigJson) != sourceCrc)
+            {
+                LOG_WARN(LOG_FEEDER, "FeederController: the stored schedule JSON is not the latest one");
+                sourceCrc = ScheduleSnapshot::getSourceCrc(feedConfigJson);
+            }
+
+            feedConfigData = new FeedConfigData(feedConfigJson);
+            ScheduleSnapshot::save(memoryController, feedConfigData, sourceCrc);
+        }
+    }
+
+    // Arm the one-shot timer for the next due entry, or for midnight when the day's schedule is done
+    void armFeedingTimer()
+    {
+        if (feedingTimer == nullptr)
+        {
+            return;
+        }
+
+        esp_timer_stop(feedingTimer); // Ignore the error when the timer is not running
+        feedingTimerFired = false;
+
+        unsigned long currentTime = webConnection->getCurrentTime(true);
+        long secondsSinceMidnight = currentTime % SECONDS_PER_DAY;
+        long targetSecond = SECONDS_PER_DAY;
+
+        if (nextEntryIndex < feedConfigData->numOfEntries)
+        {
+            targetSecond = 60L * feedConfigData->configEntries[nextEntryIndex].getTotalMinutesSinceMidnight();
+        }
+
+        long secondsUntilDue = max(0L, targetSecond - secondsSinceMidnight);
+
+        if (nextEntryIndex < feedConfigData->numOfEntries)
+        {
+            const FeedConfigEntry& nextEntry = feedConfigData->configEntries[nextEntryIndex];
+            LOG_INFO(LOG_FEEDER, "FeederController next wakeup in %lds (%02d:%02d)", secondsUntilDue, nextEntry.getHours(), nextEntry.getMinutes());
+        }
+        else
+        {
+            LOG_INFO(LOG_FEEDER, "FeederController next wakeup in %lds (midnight)", secondsUntilDue);
+        }
+
+        if (secondsUntilDue == 0)
+        {
+            feedingTimerFired = true; // Already due, handle on the next loop pass
+            return;
+        }
+
+        esp_timer_start_once(feedingTimer, FeederClock::toTimerMicros((uint64_t)secondsUntilDue * 1000000ULL));
+    }
+
 public:
+    enum class DispenseState
+    {
+        IDLE,
+        MOTOR_ON,
+        SETTLING,
+        DONE,
+        PARTIAL,
+        FAILED
+    };
+
     bool isFeeding = false;
 
-    FeederController(MemoryController* memController, WeightController* weightCtrl, WebConnectionController* webConn, GateController* gateCtrl)
+    FeederController(const StationProfile& profile, MemoryController* memController, WeightController* weightCtrl, WebConnectionController* webConn, GateController* gateCtrl) : station(profile.index)
     {
         memoryController = memController;
         weightController = weightCtrl;
         webConnection = webConn;
         gateController = gateCtrl;
 
-        feedConfigData = new FeedConfigData(memoryController->getFoodConfigJson());
+        uint32_t freeHeapBeforeLoad = ESP.getFreeHeap();
+        int64_t scheduleLoadStart = FeederClock::micros();
+        loadFeedConfigData();
+        scheduleLoadMicros = FeederClock::micros() - scheduleLoadStart;
+        uint32_t freeHeapAfterLoad = ESP.getFreeHeap();
+
+        LOG_INFO(LOG_FEEDER, "FeedConfigData loaded %d entries from %s in %uus using %u bytes. Free heap before: %u, after: %u", feedConfigData->numOfEntries, scheduleLoadedFromSnapshot ? "the snapshot" : "JSON", scheduleLoadMicros, (uint32_t)feedConfigData->getMemoryUsage(), freeHeapBeforeLoad, freeHeapAfterLoad);
+
+        flowModel.load(memoryController);
 
         canFeedByTime = false; 
 
+        createFeedingTimer();
+        initializeFeederTimeParams();
+
+        // esp_timer counts from the start of the application, right after the bootloader.
+        // Logged by the boot trace (see setup())
+        schedulerReadyMicros = FeederClock::micros();
+    }
+
+    // Apply a schedule synced from the backend after boot. The dispense in progress, if any, keeps running
+    void reloadFeedConfigData()
+    {
+        delete feedConfigData;
+        loadFeedConfigData();
+
+        LOG_INFO(LOG_FEEDER, "FeedConfigData reloaded %d entries", feedConfigData->numOfEntries);
+
+        initializeFeederTimeParams();
+    }
+
+    // Run another schedule (e.g. a synthetic one in the benchmarks) until the next reload. Takes ownership of the table
+    void setFeedConfigData(FeedConfigData* newFeedConfigData)
+    {
+        delete feedConfigData;
+        feedConfigData = newFeedConfigData;
+
         initializeFeederTimeParams();
     }
 
+    int getNumOfEntries() const
+    {
+        return feedConfigData->numOfEntries;
+    }
+
+    uint32_t getScheduleLoadMicros() const
+    {
+        return scheduleLoadMicros;
+    }
+
+    int64_t getSchedulerReadyMicros() const
+    {
+        return schedulerReadyMicros;
+    }
+
+    bool wasScheduleLoadedFromSnapshot() const
+    {
+        return scheduleLoadedFromSnapshot;
+    }
+
     void resetFeedConfigDataDispenseStatus()
     {
-        Serial.println("resetFeedConfigDataDispenseStatus");
+        LOG_DEBUG(LOG_FEEDER, "resetFeedConfigDataDispenseStatus");
+
+        nextEntryIndex = feedConfigData->numOfEntries;
 
         for(int i=0;i<feedConfigData->numOfEntries;i++)
         {
@@ -69,6 +270,7 @@ public:
             {
                 // Consider all config dates after the current minutesSinceMidnight as not dispensed
                 feedConfigData->configEntries[i].wasDispensedToday = false;
+                nextEntryIndex = min(nextEntryIndex, i); // Entries are sorted, so this is the first one still due
             }
             else
             {
@@ -87,138 +289,296 @@ public:
         if(currentTime == 0)
         {
             canFeedByTime = false; // time was not synched yet, so we are unable to dispense the food by the timing logic
-            Serial.println("FeederController canFeedByTime=false because the time was not synched. It will be true when the time will sync correctly");
+            LOG_WARN(LOG_FEEDER, "FeederController canFeedByTime=false because the time was not synched. It will be true when the time will sync correctly");
         }
         else
         {
             canFeedByTime = true;
             resetFeedConfigDataDispenseStatus();
+            armFeedingTimer();
         }
     }
 
-    unsigned long lastTriggerTime = 0;
-    const unsigned long interval = 5000;
     void loop()
     {
-        // Because the loop function is CPU heavy, we're gonna trigger it once 5 seconds
-        if (millis() - lastTriggerTime < interval) 
-        {
-            return;
-        }
+        advanceDispense();
 
-        if(!canFeedByTime)
+        // O(1) while idle: the feeding timer flags the exact second the next entry is due
+        if(!canFeedByTime || !feedingTimerFired)
         {
             return;
         }
 
-        lastTriggerTime = millis();        
+        feedingTimerFired = false;
 
-        if(getCurrentDayFromUnix(webConnection->getCurrentTime(true)) != currentDay)
+        unsigned long currentTime = webConnection->getCurrentTime(true);
+
+        if(getCurrentDayFromUnix(currentTime) != currentDay)
         {
-            Serial.println("One day just passed. Reseting feed config program");
+            LOG_INFO(LOG_FEEDER, "One day just passed. Reseting feed config program");
 
             // The day just changed, so we have to reset the feederConfig array to prepare for a new day
-            currentDay = getCurrentDayFromUnix(webConnection->getCurrentTime(true));
+            currentDay = getCurrentDayFromUnix(currentTime);
             minutesSinceMidnight = 0; // 0 minutes from the midnight
 
             resetFeedConfigDataDispenseStatus();
         }
 
-        int currentMinutesSinceMidnight = getRelativeMinutesSinceMidnight(webConnection->getCurrentTime(true));
+        int currentMinutesSinceMidnight = getRelativeMinutesSinceMidnight(currentTime);
 
-        for(int i=0;i<feedConfigData->numOfEntries;i++)
+        // Dispense every entry that is due; normally only the one under the cursor
+        while(nextEntryIndex < feedConfigData->numOfEntries && currentMinutesSinceMidnight >= feedConfigData->configEntries[nextEntryIndex].getTotalMinutesSinceMidnight())
         {
-            if(feedConfigData->configEntries[i].wasDispensedToday == true)
-            { 
-                continue; // Skip already dispensed configs
-            }
-
-            int configEntryMinutesSinceMidnight = feedConfigData->configEntries[i].getTotalMinutesSinceMidnight();
+            FeedConfigEntry& dueEntry = feedConfigData->configEntries[nextEntryIndex];
+            nextEntryIndex++;
 
-            if(currentMinutesSinceMidnight >= configEntryMinutesSinceMidnight)
+            if(!dueEntry.wasDispensedToday)
             {
-                dispenseFeedConfigQuantity(feedConfigData->configEntries[i]);
+                dispenseFeedConfigQuantity(dueEntry);
             }
         }
+
+        armFeedingTimer();
     }
     
+    // Block time of the scheduling task until loop() has work: the next step of the dispense, or none at all
+    // while idle, since the feeding timer and the app commands wake the task through its queue
+    TickType_t getWaitTicks()
+    {
+        unsigned long elapsed;
+
+        switch (dispenseState)
+        {
+            case DispenseState::MOTOR_ON:
+                elapsed = FeederClock::millis() - lastDispenseSampleTime;
+                return DeadlineQueue::toTicks(elapsed < DISPENSE_SAMPLE_INTERVAL ? DISPENSE_SAMPLE_INTERVAL - elapsed : 0);
+
+            case DispenseState::SETTLING:
+                elapsed = FeederClock::millis() - dispenseStateStartTime;
+                return DeadlineQueue::toTicks(elapsed < DISPENSE_SETTLING_TIME ? DISPENSE_SETTLING_TIME - elapsed : 0);
+
+            default:
+                break;
+        }
+
+        if (canFeedByTime && feedingTimerFired)
+        {
+            return 0;
+        }
+
+        if (pendingDispensesCount > 0)
+        {
+            return isScaleReady() ? 0 : DeadlineQueue::toTicks(SCALE_READY_POLL);
+        }
+
+        return portMAX_DELAY;
+    }
+
+    DispenseState getDispenseState() const
+    {
+        return dispenseState;
+    }
+
+    bool isDispensing() const
+    {
+        return dispenseState == DispenseState::MOTOR_ON || dispenseState == DispenseState::SETTLING;
+    }
+
+    // Request a dispense. It starts right away when the feeder is free, otherwise it is queued
+    // behind the running one. Returns immediately; loop() drives the dispense to completion
     void dispenseFeedConfigQuantity(FeedConfigEntry& feedConfigEntry)
     {
-        Serial.println("DispenseFeedConfigQuantity for entry: " + feedConfigEntry.dispenseTime + " with quantity" + String(feedConfigEntry.quantity) + "gr");
+        LOG_INFO(LOG_FEEDER, "DispenseFeedConfigQuantity for entry: %02d:%02d with quantity %dgr", feedConfigEntry.getHours(), feedConfigEntry.getMinutes(), (int)feedConfigEntry.quantity);
 
-        Serial.println("Closing the gate before starting the dispense");
+        feedConfigEntry.wasDispensedToday = true;
 
-        int initialWeight = weightController->getWeight();
-        int currentWeight = initialWeight;
-        int expectedWeight = initialWeight + (int)feedConfigEntry.quantity;
-        
-        expectedWeight = min(60, expectedWeight);
+        if (!isDispensing() && isScaleReady())
+        {
+            beginDispense(feedConfigEntry);
+            return;
+        }
 
-        int currentTime = millis();
-        int maxExceededTime = 70000;
-        startFeeding();
+        if (pendingDispensesCount >= MAX_PENDING_DISPENSES)
+        {
+            LOG_WARN(LOG_FEEDER, "DispenseFeedConfigQuantity: too many pending dispenses, request dropped");
+            return;
+        }
+
+        pendingDispenses[(pendingDispensesHead + pendingDispensesCount) % MAX_PENDING_DISPENSES] = feedConfigEntry;
+        pendingDispensesCount++;
+        LOG_INFO(LOG_FEEDER, "DispenseFeedConfigQuantity: dispense queued %s", isDispensing() ? "behind the running one" : "until the scale is tared");
+    }
+
+private:
+    DispenseState dispenseState = DispenseState::IDLE;
+
+    // The scale is tared in the background after boot, dispenses wait for its first reading
+    bool isScaleReady()
+    {
+        return weightController->getWeight() >= 0;
+    }
+
+    void beginDispense(const FeedConfigEntry& feedConfigEntry)
+    {
+        LOG_INFO(LOG_FEEDER, "Closing the gate before starting the dispense");
+
+        activeDispense = feedConfigEntry;
+        dispenseInitialWeight = weightController->getWeight();
+        dispenseCurrentWeight = dispenseInitialWeight;
+        dispenseExpectedWeight = dispenseInitialWeight + (int)feedConfigEntry.quantity;
+        if (dispenseExpectedWeight > DISPENSE_MAX_BOWL_WEIGHT)
+        {
+            dispenseExpectedWeight = DISPENSE_MAX_BOWL_WEIGHT;
+        }
+
+        dispenseStateStartTime = FeederClock::millis();
+        dispenseMotorStartTime = dispenseStateStartTime;
+        lastDispenseSampleTime = dispenseStateStartTime;
+        lastDispenseLogTime = dispenseStateStartTime;
+        dispenseTimedOut = false;
+        dispenseState = DispenseState::MOTOR_ON;
 
-        String feedStatus;
+        // Full-rate samples for the flow estimate, kept until the food in flight has landed
+        weightController->setFastSampling(true);
+        startFeeding();
+    }
 
-        int previousWeight = -1;
-        while(currentWeight < expectedWeight)
+    void advanceDispense()
+    {
+        switch (dispenseState)
         {
-            if(millis() - currentTime > maxExceededTime)
+            case DispenseState::MOTOR_ON:
+            {
+                if (FeederClock::millis() - lastDispenseSampleTime < DISPENSE_SAMPLE_INTERVAL)
+                {
+                    return;
+                }
+                lastDispenseSampleTime = FeederClock::millis();
+
+                dispenseCurrentWeight = weightController->getWeight();
+
+                WeightReading samples[DispenseFlowModel::FLOW_WINDOW];
+                int sampleCount = weightController->getRecentSamples(samples, DispenseFlowModel::FLOW_WINDOW);
+                DispenseFlowModel::FlowEstimate flow = flowModel.estimateFlow(samples, sampleCount, dispenseMotorStartTime);
+
+                if (FeederClock::millis() - lastDispenseLogTime >= DISPENSE_LOG_INTERVAL)
+                {
+                    lastDispenseLogTime = FeederClock::millis();
+                    LOG_DEBUG(LOG_FEEDER, "DispenseFeedConfigQuantity. CurrentWeight: %d , expected: %d , flow: %.2f g/s", dispenseCurrentWeight, dispenseExpectedWeight, flow.gramsPerSecond);
+                }
+
+                // Stop when the food in flight will reach the target, or when the motor ran too long (check wirings or foodStorage)
+                dispenseTimedOut = FeederClock::millis() - dispenseStateStartTime > DISPENSE_MAX_MOTOR_TIME;
+                if (flowModel.shouldCutOff(flow, dispenseExpectedWeight) || dispenseTimedOut)
+                {
+                    stopFeeding();
+                    dispenseCutoffWeight = flow.weight;
+                    dispenseCutoffFlowRate = flow.gramsPerSecond;
+                    dispenseMotorMillis = FeederClock::millis() - dispenseMotorStartTime;
+                    LOG_INFO(LOG_FEEDER, "DispenseFeedConfigQuantity: motor stopped at %.1fg, predicted in flight: %.1fg", flow.weight, flowModel.predictInFlightGrams(flow.gramsPerSecond));
+
+                    dispenseState = DispenseState::SETTLING;
+                    dispenseStateStartTime = FeederClock::millis();
+                }
+                break;
+            }
+
+            case DispenseState::SETTLING:
+            {
+                if (FeederClock::millis() - dispenseStateStartTime < DISPENSE_SETTLING_TIME)
+                {
+                    return;
+                }
+
+                dispenseCurrentWeight = weightController->getWeight();
+                learnFlowModel();
+                finishDispense();
+                break;
+            }
+
+            default:
             {
-                // Unable to dispanse the wanted amount in the 45 seconds. Check wirings or foodStorage
+                // IDLE or a finished dispense: start the next queued one, if any
+                if (pendingDispensesCount > 0 && isScaleReady())
+                {
+                    FeedConfigEntry nextDispense = pendingDispenses[pendingDispensesHead];
+                    pendingDispensesHead = (pendingDispensesHead + 1) % MAX_PENDING_DISPENSES;
+                    pendingDispensesCount--;
+
+                    beginDispense(nextDispense);
+                }
                 break;
             }
+        }
+    }
 
-            previousWeight = currentWeight;
-            currentWeight = weightController->getWeight();
-            Serial.println("DispenseFeedConfigQuantity. CurrentWeight: " + String(currentWeight) + " , expected: " + String(expectedWeight));
-            
-            delay(1000);
+    // A timed-out or empty dispense says nothing about the flow, so only learn from food that landed
+    void learnFlowModel()
+    {
+        if (dispenseTimedOut || dispenseCurrentWeight <= dispenseInitialWeight + DISPENSE_MIN_PARTIAL_WEIGHT)
+        {
+            return;
         }
-        
-        stopFeeding();
 
-        if(currentWeight >= expectedWeight)
+        LOG_INFO(LOG_FEEDER, "DispenseFeedConfigQuantity: overshoot %dg", dispenseCurrentWeight - dispenseExpectedWeight);
+
+        flowModel.learn(dispenseInitialWeight, dispenseCutoffWeight, dispenseCurrentWeight, dispenseCutoffFlowRate, dispenseMotorMillis);
+        flowModel.save(memoryController);
+
+        flowModel.log();
+    }
+
+    void finishDispense()
+    {
+        weightController->setFastSampling(false);
+
+        if(dispenseCurrentWeight >= dispenseExpectedWeight - DISPENSE_TARGET_TOLERANCE)
         {
-            Serial.println("Food dispensed complete. Amount dispensed: " + String(feedConfigEntry.quantity));
-            webConnection->addFoodDispenseEvent(webConnection->getCurrentTime(), feedConfigEntry.quantity);
+            dispenseState = DispenseState::DONE;
+            LOG_INFO(LOG_FEEDER, "Food dispensed complete. Amount dispensed: %d", (int)activeDispense.quantity);
+            TaskQueues::postUplinkEvent(station, UplinkEventType::FOOD_DISPENSE_EVENT, webConnection->getCurrentTime(), 0, activeDispense.quantity);
         }
-        else if(currentWeight > initialWeight + 5) // 5 grams added to avoid small errors
+        else if(dispenseCurrentWeight > dispenseInitialWeight + DISPENSE_MIN_PARTIAL_WEIGHT)
         {
-            Serial.println("Food dispensed partially. Amount dispensed: " + String(currentWeight - initialWeight));
-            webConnection->addFoodDispenseEvent(webConnection->getCurrentTime(), currentWeight - initialWeight);
+            dispenseState = DispenseState::PARTIAL;
+            LOG_WARN(LOG_FEEDER, "Food dispensed partially. Amount dispensed: %d", dispenseCurrentWeight - dispenseInitialWeight);
+            TaskQueues::postUplinkEvent(station, UplinkEventType::FOOD_DISPENSE_EVENT, webConnection->getCurrentTime(), 0, dispenseCurrentWeight - dispenseInitialWeight);
         }
         else
         {
-            Serial.println("Unable to dispanse the wanted amount in the 45 seconds. Check wirings or foodStorage");
-            webConnection->addFoodDispenseEvent(webConnection->getCurrentTime(), 0);
+            dispenseState = DispenseState::FAILED;
+            LOG_ERROR(LOG_FEEDER, "Unable to dispanse the wanted amount in time. Check wirings or foodStorage");
+            TaskQueues::postUplinkEvent(station, UplinkEventType::FOOD_DISPENSE_EVENT, webConnection->getCurrentTime(), 0, 0);
         }
 
-        feedConfigEntry.wasDispensedToday = true;
-        webConnection->updateFoodWeight(currentWeight, webConnection->getCurrentTime());
+        // Events are uploaded by the networking task
+        TaskQueues::postUplinkEvent(station, UplinkEventType::FOOD_WEIGHT_UPDATE, webConnection->getCurrentTime(), 0, dispenseCurrentWeight);
     }
 
+public:
     void startFeeding()
     {
-        Serial.println("Start feeding called. isFeeding: " + String((int)isFeeding));
+        LOG_DEBUG(LOG_FEEDER, "Start feeding called. isFeeding: %d", (int)isFeeding);
         if(!isFeeding)
         {
-          Serial.println("Start feeding");
-          // Activate the relay to start feeding
-          digitalWrite(RelayPins::MOTOR_CONTROL, LOW);
+          LOG_INFO(LOG_FEEDER, "Start feeding");
+          // The actuation task activates the relay to start feeding
+          TaskQueues::sendActuatorCommand(station, ActuatorCommand::START_MOTOR);
           isFeeding = true;
         }
     }
 
     void stopFeeding()
     {
-        Serial.println("Stop feeding called. isFeeding: " + String((int)isFeeding));
+        LOG_DEBUG(LOG_FEEDER, "Stop feeding called. isFeeding: %d", (int)isFeeding);
         if(isFeeding)
         {
-            Serial.println("Stop feeding");
-            // Deactivate the relay to stop feeding
-            digitalWrite(RelayPins::MOTOR_CONTROL, HIGH);
+            LOG_INFO(LOG_FEEDER, "Stop feeding");
+            // The actuation task deactivates the relay to stop feeding
+            TaskQueues::sendActuatorCommand(station, ActuatorCommand::STOP_MOTOR);
             isFeeding = false;
         }
     }
-};
\ No newline at end of file
+};
+
+#endif // FEEDER_CONTROLLER_H
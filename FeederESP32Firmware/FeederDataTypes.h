@@ -1,124 +1,319 @@
 #ifndef FEEDER_CONFIG_H
 #define FEEDER_CONFIG_H
 
-#include <ArduinoJson.h>
+#include <Arduino.h>
+#include "FeederLog.h"
 
+// Packed schedule entry (4 bytes). The "HH:MM" string received from the backend
+// is parsed once at load time into minutes since midnight, so no String is kept per entry.
 struct FeedConfigEntry
 {
-    String dispenseTime; // Time in "HH:MM" format
-    float quantity;      // Quantity of food to dispense
-    bool wasDispensedToday = false; // Flag to track if the entry was dispensed today
+    uint16_t minutesSinceMidnight = 0; // Dispense time as minutes since midnight (0-1439)
+    uint16_t quantity : 15;            // Quantity of food to dispense, in grams
+    uint16_t wasDispensedToday : 1;    // Flag to track if the entry was dispensed today
 
-    FeedConfigEntry& operator=(const FeedConfigEntry& other)
+    FeedConfigEntry() : quantity(0), wasDispensedToday(0) {}
+
+    static constexpr uint16_t MAX_QUANTITY = 0x7FFF;
+
+    // Parse a "HH:MM" string into minutes since midnight. Returns -1 for an invalid format
+    static int parseDispenseTime(const char* dispenseTime)
     {
-        // Prevent self-assignment
-        if (this != &other) 
+        int hour = 0;
+        int minute = 0;
+        int hourDigits = 0;
+        int minuteDigits = 0;
+
+        const char* c = dispenseTime;
+        while (*c >= '0' && *c <= '9' && hourDigits < 2)
+        {
+            hour = hour * 10 + (*c - '0');
+            hourDigits++;
+            c++;
+        }
+
+        if (hourDigits == 0 || *c != ':')
+        {
+            return -1; // Invalid format
+        }
+        c++;
+
+        while (*c >= '0' && *c <= '9' && minuteDigits < 2)
         {
-            dispenseTime = other.dispenseTime;
-            quantity = other.quantity;
-            wasDispensedToday = other.wasDispensedToday;
+            minute = minute * 10 + (*c - '0');
+            minuteDigits++;
+            c++;
         }
 
-        // Return reference to allow chained assignment
-        return *this;
+        if (minuteDigits == 0 || *c != '\0' || hour > 23 || minute > 59)
+        {
+            return -1; // Invalid hour or minute
+        }
+
+        return 60 * hour + minute;
     }
 
-    String toString() const
+    void setQuantity(float grams)
     {
-        return "Dispense Time: " + dispenseTime + ", Quantity: " + String(quantity);
+        quantity = grams <= 0 ? 0 : (grams >= MAX_QUANTITY ? MAX_QUANTITY : (uint16_t)grams);
     }
 
     int getHours() const
     {
-        int colonIndex = dispenseTime.indexOf(':');
-        if (colonIndex == -1 || colonIndex == 0 || colonIndex >= dispenseTime.length() - 1)
+        return minutesSinceMidnight / 60;
+    }
+
+    int getMinutes() const
+    {
+        return minutesSinceMidnight % 60;
+    }
+
+    int getTotalMinutesSinceMidnight() const
+    {
+        return minutesSinceMidnight;
+    }
+
+    // Dispense time formatted back as "HH:MM" (for logging only)
+    String getDispenseTime() const
+    {
+        char buffer[6];
+        snprintf(buffer, sizeof(buffer), "%02d:%02d", getHours(), getMinutes());
+        return String(buffer);
+    }
+
+    String toString() const
+    {
+        return "Dispense Time: " + getDispenseTime() + ", Quantity: " + String(quantity);
+    }
+};
+
+static_assert(sizeof(FeedConfigEntry) == 4, "FeedConfigEntry is expected to stay packed in 4 bytes");
+
+#define MAX_ENTRIES_NUM 1440 // Maximum number of entries (one per minute in a day)
+
+// Streaming reader for the {"HH:MM": grams, ...} schedule object. It walks the JSON text one
+// key/value pair at a time without building a document, so its memory use does not grow with
+// the number of entries.
+class FeedConfigJsonReader
+{
+private:
+    const char* cursor;
+    bool expectSeparator = false;
+    bool failed = false;
+    bool finished = false;
+
+    void skipWhitespace()
+    {
+        while (*cursor == ' ' || *cursor == '\t' || *cursor == '\n' || *cursor == '\r')
         {
-            return -1; // Invalid format
+            cursor++;
         }
+    }
 
-        String hourStr = dispenseTime.substring(0, colonIndex);
-        int hour = hourStr.toInt();
+    bool fail()
+    {
+        failed = true;
+        return false;
+    }
 
-        if (hour < 0 || hour > 23)
+    // Read a quoted string into the buffer. Strings that do not fit are returned empty
+    bool readString(char* buffer, size_t bufferSize)
+    {
+        if (*cursor != '"')
         {
-            return -1; // Invalid hour
+            return false;
         }
+        cursor++;
+
+        size_t length = 0;
+        bool truncated = false;
 
-        return hour;
+        while (*cursor != '"')
+        {
+            if (*cursor == '\0')
+            {
+                return false; // Unterminated string
+            }
+
+            if (*cursor == '\\' && *(cursor + 1) != '\0')
+            {
+                cursor++; // Keep the escaped character as-is, schedule keys never need escapes
+            }
+
+            if (length + 1 < bufferSize)
+            {
+                buffer[length++] = *cursor;
+            }
+            else
+            {
+                truncated = true;
+            }
+
+            cursor++;
+        }
+        cursor++; // Closing quote
+
+        buffer[truncated ? 0 : length] = '\0';
+        return true;
     }
 
-    int getMinutes() const
+    bool readValue(float& value)
     {
-        int colonIndex = dispenseTime.indexOf(':');
-        if (colonIndex == -1 || colonIndex == 0 || colonIndex >= dispenseTime.length() - 1)
+        if (*cursor == '"')
         {
-            return -1; // Invalid format
+            // Quantities stored as strings ("30") are accepted as well
+            char number[16];
+            if (!readString(number, sizeof(number)))
+            {
+                return false;
+            }
+            value = atof(number);
+            return true;
         }
 
-        String minuteStr = dispenseTime.substring(colonIndex + 1);
-        int minute = minuteStr.toInt();
+        if (strncmp(cursor, "null", 4) == 0 || strncmp(cursor, "true", 4) == 0)
+        {
+            cursor += 4;
+            value = 0;
+            return true;
+        }
+
+        if (strncmp(cursor, "false", 5) == 0)
+        {
+            cursor += 5;
+            value = 0;
+            return true;
+        }
 
-        if (minute < 0 || minute > 59)
+        char* numberEnd = nullptr;
+        value = strtof(cursor, &numberEnd);
+        if (numberEnd == cursor)
         {
-            return -1; // Invalid minute
+            return false; // Nested objects and arrays are not part of the schedule format
         }
 
-        return minute;
+        cursor = numberEnd;
+        return true;
     }
 
-    int getTotalMinutesSinceMidnight() const
+public:
+    static constexpr size_t MAX_KEY_LENGTH = 8; // "HH:MM" plus some slack
+
+    FeedConfigJsonReader(const char* json) : cursor(json != nullptr ? json : "")
     {
-        int hours = getHours();
-        int minutes = getMinutes();
+        skipWhitespace();
+        if (*cursor != '{')
+        {
+            fail();
+            return;
+        }
+        cursor++;
+    }
+
+    // Read the next pair. Returns false at the end of the object or on a syntax error (see hasError)
+    bool next(char (&key)[MAX_KEY_LENGTH], float& value)
+    {
+        if (failed || finished)
+        {
+            return false;
+        }
+
+        skipWhitespace();
+        if (*cursor == '}')
+        {
+            finished = true;
+            return false;
+        }
+
+        if (expectSeparator)
+        {
+            if (*cursor != ',')
+            {
+                return fail();
+            }
+            cursor++;
+            skipWhitespace();
+        }
+
+        if (!readString(key, MAX_KEY_LENGTH))
+        {
+            return fail();
+        }
 
-        if (hours == -1 || minutes == -1)
+        skipWhitespace();
+        if (*cursor != ':')
         {
-            Serial.println("getTotalMinutesSinceMidnight: Invalid hour or minutes");
-            return -1;
+            return fail();
         }
+        cursor++;
+        skipWhitespace();
 
-        return 60 * hours + minutes;
+        if (!readValue(value))
+        {
+            return fail();
+        }
+
+        expectSeparator = true;
+        return true;
     }
-};
 
-#define MAX_ENTRIES_NUM 1440 // Maximum number of entries (one per minute in a day)
+    bool hasError() const
+    {
+        return failed;
+    }
+};
 
 struct FeedConfigData
 {
-    static FeedConfigEntry configEntries[MAX_ENTRIES_NUM]; // Array to store feed config entries
-    static int numOfEntries; // Number of valid entries in the array
+    FeedConfigEntry* configEntries = nullptr; // Heap array sized to the number of valid entries
+    int numOfEntries = 0; // Number of valid entries in the array
 
-    FeedConfigData(const String& feedFoodConfigurationJSON)
+    FeedConfigData(const String& feedFoodConfigurationJSON) : FeedConfigData(feedFoodConfigurationJSON.c_str())
+    {
+    }
+
+    FeedConfigData(const char* feedFoodConfigurationJSON)
     {
         numOfEntries = 0;
 
-        // Parse the JSON
-        StaticJsonDocument<512> doc;
-        DeserializationError error = deserializeJson(doc, feedFoodConfigurationJSON);
+        // First pass only counts the valid entries, so the table is allocated once with its exact size
+        int validEntries = countValidEntries(feedFoodConfigurationJSON);
+        if (validEntries < 0)
+        {
+            LOG_ERROR(LOG_FEEDER, "Failed to parse JSON: invalid feed configuration");
+            return;
+        }
+
+        if (validEntries > MAX_ENTRIES_NUM)
+        {
+            LOG_WARN(LOG_FEEDER, "Exceeded maximum number of entries!");
+            validEntries = MAX_ENTRIES_NUM;
+        }
 
-        if (error)
+        if (validEntries == 0)
         {
-            Serial.print("Failed to parse JSON: ");
-            Serial.println(error.c_str());
             return;
         }
 
-        // Iterate over the JSON object
-        for (JsonPair kv : doc.as<JsonObject>())
+        configEntries = new FeedConfigEntry[validEntries];
+
+        // Second pass writes each pair straight into the table
+        FeedConfigJsonReader reader(feedFoodConfigurationJSON);
+        char dispenseTime[FeedConfigJsonReader::MAX_KEY_LENGTH];
+        float quantity;
+
+        while (numOfEntries < validEntries && reader.next(dispenseTime, quantity))
         {
-            if (numOfEntries >= MAX_ENTRIES_NUM)
+            int minutesSinceMidnight = FeedConfigEntry::parseDispenseTime(dispenseTime);
+            if (minutesSinceMidnight == -1)
             {
-                Serial.println("Exceeded maximum number of entries!");
-                break;
+                LOG_WARN(LOG_FEEDER, "Skipping feed config entry with invalid time: %s", dispenseTime);
+                continue;
             }
 
-            // Extract time (key) and amount (value)
-            String dispenseTime = kv.key().c_str();
-            int quantity = kv.value().as<int>();
-
             // Populate the FeedConfigEntry
-            configEntries[numOfEntries].dispenseTime = dispenseTime;
-            configEntries[numOfEntries].quantity = quantity;
+            configEntries[numOfEntries].minutesSinceMidnight = minutesSinceMidnight;
+            configEntries[numOfEntries].setQuantity((int)quantity);
             configEntries[numOfEntries].wasDispensedToday = false;
 
             numOfEntries++; // Increment the number of entries
@@ -127,7 +322,28 @@ struct FeedConfigData
         // Database entries may not be sorted, so we sort them to ensure a chronological order
         sortEntriesByTime();
 
-        Serial.println("FeedConfigData deserialization completed.");
+        LOG_DEBUG(LOG_FEEDER, "FeedConfigData deserialization completed.");
+    }
+
+    // Table of the given size, filled by the caller (e.g. from a binary schedule snapshot)
+    explicit FeedConfigData(int numOfEntriesToAllocate)
+    {
+        numOfEntries = numOfEntriesToAllocate;
+        configEntries = numOfEntries > 0 ? new FeedConfigEntry[numOfEntries] : nullptr;
+    }
+
+    ~FeedConfigData()
+    {
+        delete[] configEntries;
+    }
+
+    FeedConfigData(const FeedConfigData&) = delete;
+    FeedConfigData& operator=(const FeedConfigData&) = delete;
+
+    // Bytes used by the schedule table itself
+    size_t getMemoryUsage() const
+    {
+        return sizeof(FeedConfigData) + numOfEntries * sizeof(FeedConfigEntry);
     }
 
     String toString() const
@@ -143,28 +359,79 @@ struct FeedConfigData
     }
 
 private:
+    // Number of pairs with a valid "HH:MM" key, or -1 if the JSON is malformed
+    static int countValidEntries(const char* feedFoodConfigurationJSON)
+    {
+        FeedConfigJsonReader reader(feedFoodConfigurationJSON);
+        char dispenseTime[FeedConfigJsonReader::MAX_KEY_LENGTH];
+        float quantity;
+        int count = 0;
+
+        while (reader.next(dispenseTime, quantity))
+        {
+            if (FeedConfigEntry::parseDispenseTime(dispenseTime) != -1)
+            {
+                count++;
+            }
+        }
+
+        return reader.hasError() ? -1 : count;
+    }
+
     void sortEntriesByTime()
     {
-        // Sort entries by time using bubble sort
-        for (int i = 0; i < numOfEntries - 1; i++)
+        // Insertion sort on the precomputed minutes; schedules are small and mostly sorted already
+        for (int i = 1; i < numOfEntries; i++)
         {
-            for (int j = i + 1; j < numOfEntries; j++)
+            FeedConfigEntry entry = configEntries[i];
+            int j = i - 1;
+
+            while (j >= 0 && configEntries[j].minutesSinceMidnight > entry.minutesSinceMidnight)
             {
-                if (configEntries[i].getTotalMinutesSinceMidnight() > configEntries[j].getTotalMinutesSinceMidnight())
-                {
-                    // Swap entries
-                    FeedConfigEntry temp = configEntries[i];
-                    configEntries[i] = configEntries[j];
-                    configEntries[j] = temp;
-                }
+                configEntries[j + 1] = configEntries[j];
+                j--;
             }
+
+            configEntries[j + 1] = entry;
         }
     }
 };
 
-// Initialize static members
-FeedConfigEntry FeedConfigData::configEntries[MAX_ENTRIES_NUM];
-int FeedConfigData::numOfEntries = 0;
+enum class UplinkEventType : uint8_t
+{
+    GATE_EVENT,
+    FOOD_DISPENSE_EVENT,
+    FOOD_WEIGHT_UPDATE
+};
+
+// Event to upload to the backend. Field usage depends on the type:
+//  GATE_EVENT:          startTime = open time, endTime = close time
+//  FOOD_DISPENSE_EVENT: startTime = dispense time, value = grams dispensed
+//  FOOD_WEIGHT_UPDATE:  startTime = measurement time, value = bowl weight
+struct UplinkEvent
+{
+    UplinkEventType type;
+    unsigned long startTime;
+    unsigned long endTime;
+    float value;
+};
+
+// Uplink event stored in the persistent outbox. The sequence number never repeats within an outbox
+// epoch and is sent with the epoch as the idempotency key, so a batch that is retried after a lost
+// response is not stored twice by the backend
+struct OutboxRecord
+{
+    uint32_t sequence;
+    UplinkEvent event;
+};
+
+// Weight published by the WeightController sampler task
+struct WeightReading
+{
+    int weight;              // Grams, after median + IIR filtering and the restart offset (-1 if the HX711 never answered)
+    unsigned long timestamp; // millis() of the sample the value was computed from
+    bool isStable;           // The last samples agree within a few grams
+};
 
 enum TrapMode
 {
@@ -1,107 +1,438 @@
-#include "FeederController.h"
-#include "GateController.h"
-#include "RFIDController.h"
-#include "WeightController.h"
+#include "FeederStation.h"
+#include "FeederHalEsp32.h"
+#include "StationProfile.h"
 #include "WifiController.h"
-#include "MemoryController.h"
+#include "TaskQueues.h"
+#include "DeadlineQueue.h"
+#include "BootTrace.h"
+#include "FeederMetrics.h"
+#include "MetricsServer.h"
+#include "PowerManager.h"
+#include "FeederLog.h"
 
-// Global instances of controllers
-FeederController* feederController = nullptr;
-GateController* gateController = nullptr;
-RFIDController* rfidController = nullptr;
-WeightController* weightController = nullptr;
+// #define FEEDER_BENCHMARKS // Uncomment to print on-device benchmark results at boot
+// #define FEEDER_POWER_SAVE // Uncomment to scale the CPU clock, use Wi-Fi modem sleep and light sleep between events
+
+#ifdef FEEDER_BENCHMARKS
+#include "FeederBenchmarks.h"
+#endif
+
+// Feeding stations wired to this board, up to StationProfile::MAX_STATIONS. Their pins and backend
+// records are listed in StationProfile::PROFILES
+static const int NUM_OF_STATIONS = 1;
+
+// Global instances of controllers. Wi-Fi, the metrics and the power state belong to the board
+FeederStation stations[StationProfile::MAX_STATIONS];
 WifiController* wifiController = nullptr;
-MemoryController* memoryController = nullptr;
+MetricsServer* metricsServer = nullptr;
+PowerManager* powerManager = nullptr;
+OutputPins* outputPins = nullptr; // Gate coils and motor relays of every station
+
+// Task layout. Networking runs on core 0 next to the Wi-Fi stack, so HTTPS round-trips never
+// delay the control path (sensing -> actuation) that runs on core 1
+static const BaseType_t NETWORK_CORE = 0;
+static const BaseType_t CONTROL_CORE = 1;
+
+static const UBaseType_t SCALE_TASK_PRIORITY = 4;    // WeightController's own sampler, mostly blocked on the HX711
+static const UBaseType_t SENSING_TASK_PRIORITY = 4;
+static const UBaseType_t ACTUATION_TASK_PRIORITY = 3;
+static const UBaseType_t SCHEDULING_TASK_PRIORITY = 2;
+static const UBaseType_t NETWORKING_TASK_PRIORITY = 1;
+static const UBaseType_t COMMAND_READER_TASK_PRIORITY = 2; // Above networking, so it waits on the socket again before networking sleeps
+static const UBaseType_t LOG_TASK_PRIORITY = 1;      // Prints the log ring to Serial, so no other task waits on the UART
+
+// No task runs on a period: each one blocks on its queue (or notification) until the next event or
+// until the earliest deadline of its own work, so an idle feeder leaves the CPU idle
+
+// Deadlines of the networking task, one per stage that has timed work. The board jobs come first,
+// followed by the jobs of each station
+enum BoardJob
+{
+    JOB_WIFI,
+    JOB_TIME_SYNC,
+    JOB_POWER,
+    NUM_OF_BOARD_JOBS
+};
+
+enum StationJob
+{
+    JOB_COMMANDS,
+    JOB_COMMAND_POLL,
+    JOB_WEIGHT_UPDATE,
+    JOB_OUTBOX,
+    JOB_NVS,
+    NUM_OF_STATION_JOBS
+};
+
+static_assert(NUM_OF_BOARD_JOBS + StationProfile::MAX_STATIONS * NUM_OF_STATION_JOBS <= DeadlineQueue::MAX_JOBS, "Networking jobs do not fit in the deadline queue");
+
+DeadlineQueue networkingDeadlines;
 
 // Forward declarations
 void initializeControllers();
-void initializeRelayPin();
-void processCommandsFromApp();
-void updateFoodWeightRecurrently();
-void handleCommand(const String& command);
+void initializeStation(FeederStation& station, const StationProfile& profile);
+void startControlTasks(FeederStation& station);
+void startBackgroundTasks();
+void sensingTask(void* parameter);
+void actuationTask(void* parameter);
+void schedulingTask(void* parameter);
+void networkingTask(void*);
+void synchTime();
+int getStationJob(const FeederStation& station, StationJob job);
+void processCommandsFromApp(FeederStation& station);
+void updateFoodWeightRecurrently(FeederStation& station);
+void handleCommand(FeederStation& station, const String& command);
+void handleAppCommand(FeederStation& station, const AppCommand& command);
 
+// Nothing in setup() waits on the network or the sensors: Wi-Fi, the config fetch and the scale tare
+// finish in the background tasks, so the gate reacts to tags right after the tasks start.
+// Every phase is logged by BootTrace, in ms since power-on
 void setup() 
 {
     Serial.begin(115200);
-    delay(1000);
+    FeederLog::startDrainTask(LOG_TASK_PRIORITY, NETWORK_CORE);
+    BootTrace::mark("runtime init");
+
+    TaskQueues::create(NUM_OF_STATIONS);
 
     initializeControllers();
 
-    int weightToLoadAtRestart = memoryController->getWeightToLoadAtRestart();
-    if (weightToLoadAtRestart > 0)
-    {   
-        Serial.println("CatFeeder.ino set weightToLoadAtRestart: " + String(weightToLoadAtRestart));
-        weightController->setInitialOffset(weightToLoadAtRestart);
+#ifdef FEEDER_POWER_SAVE
+    powerManager->begin(true);
+#else
+    powerManager->begin(false);
+#endif
+    wifiController->setStationOnly(powerManager->getMode() != PowerManager::Mode::FULL_POWER);
+
+    for (int index = 0; index < NUM_OF_STATIONS; index++)
+    {
+        FeederStation& station = stations[index];
+
+        int weightToLoadAtRestart = station.memoryController->getWeightToLoadAtRestart();
+        if (weightToLoadAtRestart > 0)
+        {   
+            LOG_INFO(LOG_SCALE, "CatFeeder.ino set weightToLoadAtRestart: %d (station %d)", weightToLoadAtRestart, index);
+            station.weightController->setInitialOffset(weightToLoadAtRestart);
+        }
+
+        startControlTasks(station);
     }
+    BootTrace::mark("control path live");
+
+    for (int index = 0; index < NUM_OF_STATIONS; index++)
+    {
+        FeederStation& station = stations[index];
+        station.feederController = new FeederController(*station.profile, station.memoryController, station.weightController, station.webConnection, station.gateController);
+    }
+    BootTrace::mark("scheduler ready");
+
+#ifdef FEEDER_BENCHMARKS
+    FeederBenchmarks::runAll(stations[0].feederController, stations[0].webConnection);
+#endif
 
-    feederController = new FeederController(memoryController, weightController, wifiController->getWebConnection(), gateController);
+    startBackgroundTasks();
+    BootTrace::mark("tasks started");
+    BootTrace::print();
 }
 
 void loop() 
 {   
-    synchTime();
+    // All the work runs in the tasks started by setup()
+    vTaskDelete(NULL);
+}
+
+// Constructors only load NVS and configure pins; the Wi-Fi stack is started by the networking task.
+// Station 0 holds the Wi-Fi credentials, so its controllers are created with the board's.
+// The controllers get the ESP32 drivers of FeederHalEsp32.h
+void initializeControllers()
+{
+    for (int index = 0; index < NUM_OF_STATIONS; index++)
+    {
+        stations[index].profile = &StationProfile::PROFILES[index];
+        stations[index].memoryController = new MemoryController(StationProfile::PROFILES[index]);
+    }
+    BootTrace::mark("nvs loaded");
+
+    wifiController = new WifiController(stations[0].memoryController);
+    stations[0].webConnection = wifiController->getWebConnection();
+    for (int index = 1; index < NUM_OF_STATIONS; index++)
+    {
+        stations[index].webConnection = new WebConnectionController(stations[index].memoryController, stations[0].webConnection);
+        wifiController->addStation(stations[index].memoryController, stations[index].webConnection);
+    }
+
+    for (int index = 0; index < NUM_OF_STATIONS; index++)
+    {
+        FeederStation& station = stations[index];
+        station.uplinkOutbox = new UplinkOutbox(station.memoryController, station.webConnection);
+        station.commandChannel = new CommandChannel(station.memoryController->getFeederId(), station.memoryController->getFeederPassword());
+    }
+    BootTrace::mark("network deferred");
 
-    rfidController->loop();
-    gateController->loop();
-    wifiController->loop();
-    feederController->loop();
+    outputPins = new GpioOutputPins();
+    for (int index = 0; index < NUM_OF_STATIONS; index++)
+    {
+        initializeStation(stations[index], StationProfile::PROFILES[index]);
+    }
+    powerManager = new PowerManager(stations, NUM_OF_STATIONS);
+    metricsServer = new MetricsServer(stations, NUM_OF_STATIONS, stations[0].webConnection, powerManager);
+    BootTrace::mark("drivers ready");
+}
 
-    processCommandsFromApp();
-    updateFoodWeightRecurrently();
+void initializeStation(FeederStation& station, const StationProfile& profile)
+{
+    station.gateController = new GateController(profile, station.webConnection, outputPins);
+    station.motorController = new MotorController(profile, outputPins);
+    station.rfidController = new RFIDController(profile, station.memoryController, new UartTagReaderPort(profile.rfidUartNum));
+    station.weightController = new WeightController(new Hx711ScaleDriver(profile.scaleDataPin, profile.scaleClockPin));
+}
 
-    delay(100);
+// RFID, gate and scale: live before the schedule is loaded
+void startControlTasks(FeederStation& station)
+{
+    station.weightController->startSampling(SCALE_TASK_PRIORITY, CONTROL_CORE);
+    xTaskCreatePinnedToCore(sensingTask, "sensing", 4096, &station, SENSING_TASK_PRIORITY, nullptr, CONTROL_CORE);
+    xTaskCreatePinnedToCore(actuationTask, "actuation", 4096, &station, ACTUATION_TASK_PRIORITY, nullptr, CONTROL_CORE);
 }
 
-void initializeControllers()
+void startBackgroundTasks()
+{
+    for (int index = 0; index < NUM_OF_STATIONS; index++)
+    {
+        xTaskCreatePinnedToCore(schedulingTask, "scheduling", 6144, &stations[index], SCHEDULING_TASK_PRIORITY, nullptr, CONTROL_CORE);
+        stations[index].commandChannel->startReader(COMMAND_READER_TASK_PRIORITY, NETWORK_CORE);
+    }
+    xTaskCreatePinnedToCore(networkingTask, "networking", 12288, nullptr, NETWORKING_TASK_PRIORITY, &TaskQueues::networkingTask, NETWORK_CORE);
+}
+
+// The control tasks run once per station, their parameter is the FeederStation they serve
+
+// Decides on the RFID tags decoded by the UART receive callback. Gate requests go to the actuation task
+void sensingTask(void* parameter)
 {
-    memoryController = new MemoryController();
-    wifiController = new WifiController(memoryController);
-    gateController = new GateController(wifiController->getWebConnection());
-    rfidController = new RFIDController(gateController);
-    weightController = new WeightController();
+    FeederStation& station = *static_cast<FeederStation*>(parameter);
+    for (;;)
+    {
+        // Wakes up as soon as a tag frame arrives, or when the registered tag times out
+        station.rfidController->loop();
+    }
 }
 
-void synchTime()
+// Owns the gate stepper and the dispenser motor relay
+void actuationTask(void* parameter)
 {
-    if (wifiController->getWebConnection()->haveInternetConnection())
+    FeederStation& station = *static_cast<FeederStation*>(parameter);
+    GateController* gateController = station.gateController;
+    MotorController* motorController = station.motorController;
+    for (;;)
     {
-        if (!wifiController->getWebConnection()->getCurrentTime())
+        // Nothing to do between commands: the step timer moves the gate and posts GATE_STOPPED at the end
+        ActuatorCommand command;
+        xQueueReceive(TaskQueues::actuatorCommands[station.profile->index], &command, portMAX_DELAY);
+        uint32_t beginMicros = FeederMetrics::begin();
+
+        // open() and close() return right away and ignore the state the gate is already in or
+        // moving to. The step timer moves the gate, reversing a close mid-stroke
+        switch (command)
         {
-            wifiController->getWebConnection()->synchronizeTime();
-            if (wifiController->getWebConnection()->getCurrentTime())
+            case ActuatorCommand::OPEN_GATE:
+                gateController->open();
+                break;
+            case ActuatorCommand::CLOSE_GATE:
+                gateController->close();
+                break;
+            case ActuatorCommand::START_MOTOR:
+                motorController->start();
+                break;
+            case ActuatorCommand::STOP_MOTOR:
+                motorController->stop();
+                break;
+            case ActuatorCommand::GATE_STOPPED:
+                break; // Handled by loop() below
+        }
+
+        gateController->loop();
+        FeederMetrics::end(FeederMetrics::STAGE_GATE, beginMicros);
+    }
+}
+
+// Runs the feeding schedule and the dispense state machine
+void schedulingTask(void* parameter)
+{
+    FeederStation& station = *static_cast<FeederStation*>(parameter);
+    for (;;)
+    {
+        // Sleeps until an app command, the feeding timer (FEEDING_DUE) or the next step of a running dispense
+        AppCommand command;
+        bool hasCommand = xQueueReceive(TaskQueues::appCommands[station.profile->index], &command, station.feederController->getWaitTicks()) == pdTRUE;
+        uint32_t beginMicros = FeederMetrics::begin();
+
+        if (hasCommand)
+        {
+            handleAppCommand(station, command);
+        }
+
+        station.feederController->loop();
+        FeederMetrics::end(FeederMetrics::STAGE_FEEDER, beginMicros);
+    }
+}
+
+// Wi-Fi, time sync, command polling and every HTTP upload, for all the stations. Every stage is a
+// non-blocking check, so a pass runs them all and then sleeps until the earliest deadline they report.
+// Uplink events, Wi-Fi events and the first pending NVS change wake it earlier (TaskQueues::wakeNetworking())
+void networkingTask(void*)
+{
+    for (;;)
+    {
+        uint32_t beginMicros = FeederMetrics::begin();
+        wifiController->loop();
+        networkingDeadlines.scheduleIn(JOB_WIFI, wifiController->getMillisUntilDue());
+        FeederMetrics::end(FeederMetrics::STAGE_WIFI, beginMicros);
+
+        beginMicros = FeederMetrics::begin();
+        synchTime();
+        networkingDeadlines.scheduleIn(JOB_TIME_SYNC, wifiController->getWebConnection()->getClockService().getMillisUntilDue());
+        FeederMetrics::end(FeederMetrics::STAGE_TIME_SYNC, beginMicros);
+
+        // Events are persisted right away by the outbox of their station
+        beginMicros = FeederMetrics::begin();
+        StationUplinkEvent stationEvent;
+        while (xQueueReceive(TaskQueues::uplinkEvents, &stationEvent, 0) == pdTRUE)
+        {
+            stations[stationEvent.station].uplinkOutbox->append(stationEvent.event);
+        }
+        FeederMetrics::end(FeederMetrics::STAGE_OUTBOX, beginMicros);
+
+        for (int index = 0; index < NUM_OF_STATIONS; index++)
+        {
+            FeederStation& station = stations[index];
+
+            // The registry is guarded for lookups from the sensing task
+            if (station.webConnection->consumeRegisteredTagsUpdate())
+            {
+                station.rfidController->reloadRegisteredTags(station.memoryController);
+            }
+
+            // FeederController belongs to the scheduling task, let it swap the schedule
+            if (station.webConnection->consumeScheduleUpdate())
             {
-                feederController->initializeFeederTimeParams();
+                TaskQueues::postAppCommand(index, AppCommandType::SCHEDULE_UPDATED, 0);
             }
+
+            beginMicros = FeederMetrics::begin();
+            processCommandsFromApp(station);
+            FeederMetrics::end(FeederMetrics::STAGE_COMMANDS, beginMicros);
+
+            // Uploaded in batches by the outbox
+            beginMicros = FeederMetrics::begin();
+            updateFoodWeightRecurrently(station);
+            station.uplinkOutbox->loop();
+            networkingDeadlines.scheduleIn(getStationJob(station, JOB_OUTBOX), station.uplinkOutbox->getMillisUntilDue());
+            FeederMetrics::end(FeederMetrics::STAGE_OUTBOX, beginMicros);
+
+            // Batched NVS commit of the feeder settings
+            beginMicros = FeederMetrics::begin();
+            station.memoryController->loop();
+            networkingDeadlines.scheduleIn(getStationJob(station, JOB_NVS), station.memoryController->getMillisUntilDue());
+            FeederMetrics::end(FeederMetrics::STAGE_NVS, beginMicros);
         }
+
+        metricsServer->loop();
+
+        // Wi-Fi events run a pass, so the radio state is accounted for when it changes
+        powerManager->loop();
+        networkingDeadlines.scheduleIn(JOB_POWER, powerManager->getMillisUntilDue());
+
+        // A wake-up sent during the pass is kept, so the next pass starts right away
+        ulTaskNotifyTake(pdTRUE, networkingDeadlines.getWaitTicks());
     }
 }
 
-void processCommandsFromApp()
+void synchTime()
 {
-    static const int COMMAND_PROCESS_INTERVAL = 5000; // 5 seconds
-    static unsigned long lastProcessedCommand = 0;
+    static bool wasTimeSynchronized = false;
+
+    // Non-blocking: SNTP keeps the clock in sync, backend Date headers set it if SNTP is unreachable
+    if (wifiController->getWebConnection()->haveInternetConnection())
+    {
+        wifiController->getWebConnection()->synchronizeTime();
+    }
+
+    bool isTimeSynchronized = wifiController->getWebConnection()->isTimeSynchronized();
+    if (isTimeSynchronized && !wasTimeSynchronized)
+    {
+        BootTrace::mark("time synchronized");
+
+        // FeederController belongs to the scheduling task, let it re-arm the schedule
+        for (int index = 0; index < NUM_OF_STATIONS; index++)
+        {
+            TaskQueues::postAppCommand(index, AppCommandType::TIME_SYNCHRONIZED, 0);
+        }
+    }
+    wasTimeSynchronized = isTimeSynchronized;
+}
+
+// Index of a station job in networkingDeadlines
+int getStationJob(const FeederStation& station, StationJob job)
+{
+    return NUM_OF_BOARD_JOBS + station.profile->index * NUM_OF_STATION_JOBS + job;
+}
+
+void processCommandsFromApp(FeederStation& station)
+{
+    int pollJob = getStationJob(station, JOB_COMMAND_POLL);
+
+    // Commands are pushed by the backend; polling is only a fallback while the channel is down
+    String pushedCommand = station.commandChannel->loop();
+    if (pushedCommand.length() > 0)
+    {
+        LOG_INFO(LOG_NETWORK, "Command from app pushed: %s", pushedCommand);
+        handleCommand(station, pushedCommand);
+    }
+    networkingDeadlines.scheduleIn(getStationJob(station, JOB_COMMANDS), station.commandChannel->getMillisUntilDue());
 
-    if (millis() - lastProcessedCommand < COMMAND_PROCESS_INTERVAL)
+    if (station.commandChannel->isConnected())
+    {
+        networkingDeadlines.cancel(pollJob);
+        return;
+    }
+
+    if (!networkingDeadlines.isArmed(pollJob))
+    {
+        networkingDeadlines.scheduleIn(pollJob, 0); // The channel just went down, poll right away
+    }
+
+    if (!networkingDeadlines.isDue(pollJob))
     {
         return; // Skip processing if interval not reached
     }
 
-    String command = wifiController->getWebConnection()->getCommandFromApplication();
+    String command = station.webConnection->getCommandFromApplication();
     if (command.length() > 0)
     {
-        Serial.println("Command from app received: " + command);
-        handleCommand(command);
+        LOG_INFO(LOG_NETWORK, "Command from app received: %s", command);
+        handleCommand(station, command);
     }
 
-    lastProcessedCommand = millis();
+    networkingDeadlines.scheduleIn(pollJob, station.webConnection->getCommandPollDelay());
 }
 
-void handleCommand(const String& command)
+void handleCommand(FeederStation& station, const String& command)
 {
     if (command.indexOf("UpdateFeeder") != -1)
     {   
-        Serial.println("Command UpdateFeeder, setWeightToLoadAtRestart: " + String(weightController->getWeight()));
-        memoryController->setWeightToLoadAtRestart(weightController->getWeight());
+        // The restart reloads every station, so all of them keep their weight
+        for (int index = 0; index < NUM_OF_STATIONS; index++)
+        {
+            LOG_INFO(LOG_NETWORK, "Command UpdateFeeder, setWeightToLoadAtRestart: %d (station %d)", stations[index].weightController->getWeight(), index);
+            stations[index].memoryController->setWeightToLoadAtRestart(stations[index].weightController->getWeight());
+        }
+
+        // Flush the batched changes of every station, not only the one that received the command
+        for (int index = 0; index < NUM_OF_STATIONS; index++)
+        {
+            stations[index].memoryController->commit();
+        }
         ESP.restart();
     }
     else if (command.indexOf("DispenseNow") != -1)
@@ -110,25 +441,68 @@ void handleCommand(const String& command)
         String quantityStr = command.substring(underscoreIndex + 1);
         float quantity = quantityStr.toFloat();
 
-        FeedConfigEntry feedConfig;
-        feedConfig.dispenseTime = "00:00";
-        feedConfig.quantity = quantity;
-        feedConfig.wasDispensedToday = false;
+        if (!TaskQueues::postAppCommand(station.profile->index, AppCommandType::DISPENSE_NOW, quantity))
+        {
+            LOG_WARN(LOG_NETWORK, "DispenseNow dropped, the scheduling task is busy");
+        }
+    }
+}
+
+// Commands handed from the networking task to the scheduling task
+void handleAppCommand(FeederStation& station, const AppCommand& command)
+{
+    FeederController* feederController = station.feederController;
+
+    switch (command.type)
+    {
+        case AppCommandType::DISPENSE_NOW:
+        {
+            FeedConfigEntry feedConfig;
+            feedConfig.minutesSinceMidnight = 0;
+            feedConfig.setQuantity(command.quantity);
+            feedConfig.wasDispensedToday = false;
+
+            feederController->dispenseFeedConfigQuantity(feedConfig);
+            break;
+        }
 
-        feederController->dispenseFeedConfigQuantity(feedConfig);
+        case AppCommandType::TIME_SYNCHRONIZED:
+        {
+            feederController->initializeFeederTimeParams();
+            break;
+        }
+
+        case AppCommandType::SCHEDULE_UPDATED:
+        {
+            feederController->reloadFeedConfigData();
+            break;
+        }
+
+        case AppCommandType::FEEDING_DUE:
+        {
+            break; // Only wakes the task, feederController->loop() handles the due entries
+        }
     }
 }
 
-void updateFoodWeightRecurrently()
+void updateFoodWeightRecurrently(FeederStation& station)
 {
-    static const int FOOD_WEIGHT_UPDATE_INTERVAL = 300000; // 5 minutes
-    static unsigned long lastProcessedFoodWeightUpdate = 0;
+    static const unsigned long FOOD_WEIGHT_UPDATE_INTERVAL = 300000; // 5 minutes
+
+    int weightUpdateJob = getStationJob(station, JOB_WEIGHT_UPDATE);
+
+    if (!networkingDeadlines.isArmed(weightUpdateJob))
+    {
+        networkingDeadlines.scheduleIn(weightUpdateJob, DeadlineQueue::withJitter(FOOD_WEIGHT_UPDATE_INTERVAL)); // First update ~5 minutes after boot
+        return;
+    }
 
-    if (millis() - lastProcessedFoodWeightUpdate < FOOD_WEIGHT_UPDATE_INTERVAL)
+    if (!networkingDeadlines.isDue(weightUpdateJob))
     {
         return; // Skip processing if interval not reached
     }
 
-    wifiController->getWebConnection()->updateFoodWeight(weightController->getWeight(), wifiController->getWebConnection()->getCurrentTime());
-    lastProcessedFoodWeightUpdate = millis();
+    UplinkEvent event = {UplinkEventType::FOOD_WEIGHT_UPDATE, station.webConnection->getCurrentTime(), 0, (float)station.weightController->getWeight()};
+    station.uplinkOutbox->append(event);
+    networkingDeadlines.scheduleIn(weightUpdateJob, DeadlineQueue::withJitter(FOOD_WEIGHT_UPDATE_INTERVAL));
 }
\ No newline at end of file
@@ -0,0 +1,74 @@
+#ifndef FEEDER_HAL_H
+#define FEEDER_HAL_H
+
+#include <stdint.h>
+#include <functional>
+
+// Hardware seams of the controllers. Each controller takes its drivers as constructor arguments, so the
+// feeding logic builds against either the ESP32 drivers (FeederHalEsp32.h, included by the sketch) or the
+// simulated ones of the host build (host/SimulatedHal.h). This header stays free of ESP-IDF and Arduino includes.
+// Time goes through FeederClock: its source can be swapped for a virtual clock that runs faster than real time
+
+// Monotonic time. Same values as Arduino's millis()/micros() (both derive from esp_timer) unless the
+// source is replaced. ClockService extrapolates the wall clock from it, so a virtual source drives the schedule too.
+// The static members are defined by the driver header of the target
+struct FeederClock
+{
+    typedef int64_t (*MicrosSource)();
+
+    static MicrosSource source;
+    static uint32_t speedup; // Clock microseconds per real microsecond, for a source that runs faster than real time
+
+    static int64_t micros()
+    {
+        return source();
+    }
+
+    static unsigned long millis()
+    {
+        return (unsigned long)(source() / 1000);
+    }
+
+    // esp_timer delay after which the given time has elapsed on this clock
+    static uint64_t toTimerMicros(uint64_t clockMicros)
+    {
+        return clockMicros / speedup;
+    }
+};
+
+// Load cell amplifier, in calibrated kilograms after tare
+class ScaleDriver
+{
+public:
+    virtual ~ScaleDriver() {}
+
+    // Wait up to timeout ms for a conversion
+    virtual bool waitReady(unsigned long timeout) = 0;
+    virtual float getUnits() = 0;
+    virtual void tare() = 0;
+    virtual void setScale(float calibrationFactor) = 0;
+};
+
+// Digital outputs: the stepper coils of the gate and the motor relay.
+// write() is called from the esp_timer task while the gate moves
+class OutputPins
+{
+public:
+    virtual ~OutputPins() {}
+
+    virtual void configure(int pin) = 0;
+    virtual void write(int pin, bool high) = 0;
+};
+
+// Receive-only serial link of the RFID reader. onReceive runs as soon as bytes are available
+class TagReaderPort
+{
+public:
+    virtual ~TagReaderPort() {}
+
+    virtual void begin(unsigned long baudRate, int rxPin, std::function<void()> onReceive) = 0;
+    virtual int available() = 0;
+    virtual int read() = 0;
+};
+
+#endif // FEEDER_HAL_H
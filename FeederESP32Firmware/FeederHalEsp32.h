@@ -0,0 +1,165 @@
+#ifndef FEEDER_HAL_ESP32_H
+#define FEEDER_HAL_ESP32_H
+
+#include <Arduino.h>
+#include <HardwareSerial.h>
+#include <esp_timer.h>
+#include <esp_sleep.h>
+#include <driver/gpio.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include "FeederHal.h"
+#include "AwakeLock.h"
+#include "HX711.h"
+
+// ESP32 drivers of the hardware seams in FeederHal.h. Included by the sketch only, which hands them to
+// the controllers; the host build (host/) uses simulated drivers instead
+
+// Initialize static members. The clock is esp_timer, in real time
+FeederClock::MicrosSource FeederClock::source = esp_timer_get_time;
+uint32_t FeederClock::speedup = 1;
+
+// HX711 on the DOUT and SCK pins of a station
+class Hx711ScaleDriver : public ScaleDriver
+{
+private:
+    HX711 hx711;
+    int dataPin;
+    TaskHandle_t readyWaiter = nullptr;
+    AwakeLock awakeLock{"hx711"};
+
+    // DOUT falls when a conversion is ready
+    static void IRAM_ATTR onDataReady(void* arg)
+    {
+        BaseType_t higherPriorityTaskWoken = pdFALSE;
+        vTaskNotifyGiveFromISR(static_cast<Hx711ScaleDriver*>(arg)->readyWaiter, &higherPriorityTaskWoken);
+        if (higherPriorityTaskWoken)
+        {
+            portYIELD_FROM_ISR();
+        }
+    }
+
+public:
+    Hx711ScaleDriver(int dataPin, int clockPin) : dataPin(dataPin)
+    {
+        hx711.begin(dataPin, clockPin);
+    }
+
+    // Blocks on the data-ready edge instead of polling DOUT every ms. An edge does not wake the chip
+    // from light sleep, so it stays awake for the wait, at most one conversion
+    bool waitReady(unsigned long timeout) override
+    {
+        if (hx711.is_ready())
+        {
+            return true;
+        }
+
+        readyWaiter = xTaskGetCurrentTaskHandle();
+        awakeLock.acquire();
+        attachInterruptArg(dataPin, onDataReady, this, FALLING);
+
+        if (!hx711.is_ready())
+        {
+            ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(timeout));
+        }
+
+        detachInterrupt(dataPin);
+        awakeLock.release();
+        ulTaskNotifyTake(pdTRUE, 0); // Drop an edge that came after the check
+
+        return hx711.is_ready();
+    }
+
+    float getUnits() override
+    {
+        return hx711.get_units();
+    }
+
+    void tare() override
+    {
+        hx711.tare();
+    }
+
+    void setScale(float calibrationFactor) override
+    {
+        hx711.set_scale(calibrationFactor);
+    }
+};
+
+// Arduino digital outputs, shared by the stations of the board
+class GpioOutputPins : public OutputPins
+{
+public:
+    void configure(int pin) override
+    {
+        pinMode(pin, OUTPUT);
+    }
+
+    void write(int pin, bool high) override
+    {
+        digitalWrite(pin, high ? HIGH : LOW);
+    }
+};
+
+// RDM6300 on a hardware UART of a station
+class UartTagReaderPort : public TagReaderPort
+{
+private:
+    // Longer than the ~65 ms between the repeated frames of a tag in range (ms)
+    static constexpr uint64_t LINE_HOLD = 200;
+
+    HardwareSerial uart;
+    AwakeLock awakeLock{"rfid"};
+    esp_timer_handle_t holdTimer = nullptr;
+
+    static void onHoldTimer(void* arg)
+    {
+        static_cast<UartTagReaderPort*>(arg)->awakeLock.release();
+    }
+
+    // The start bit of a frame wakes the chip from light sleep, but the bytes received while it wakes
+    // up are lost. Stay awake while the line is busy, so the next frame of the tag is read in full
+    void holdAwake()
+    {
+        awakeLock.acquire();
+        esp_timer_stop(holdTimer); // Ignore the error when the timer is not running
+        esp_timer_start_once(holdTimer, LINE_HOLD * 1000ULL);
+    }
+
+public:
+    explicit UartTagReaderPort(uint8_t uartNum) : uart(uartNum)
+    {
+    }
+
+    void begin(unsigned long baudRate, int rxPin, std::function<void()> onReceive) override
+    {
+        esp_timer_create_args_t timerArgs = {};
+        timerArgs.callback = &UartTagReaderPort::onHoldTimer;
+        timerArgs.arg = this;
+        timerArgs.dispatch_method = ESP_TIMER_TASK;
+        timerArgs.name = "rfid_hold";
+        esp_timer_create(&timerArgs, &holdTimer);
+
+        uart.begin(baudRate, SERIAL_8N1, rxPin, -1);
+        gpio_wakeup_enable((gpio_num_t)rxPin, GPIO_INTR_LOW_LEVEL); // The idle line is high
+        esp_sleep_enable_gpio_wakeup();
+
+        // Called from the UART driver's event task
+        uart.onReceive([this, onReceive]() {
+            holdAwake();
+            onReceive();
+        });
+    }
+
+    int available() override
+    {
+        return uart.available();
+    }
+
+    int read() override
+    {
+        return uart.read();
+    }
+};
+
+#endif // FEEDER_HAL_ESP32_H
@@ -0,0 +1,416 @@
+#ifndef FEEDER_LOG_H
+#define FEEDER_LOG_H
+
+#include <Arduino.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include "FeederHal.h"
+
+// Levels and categories below the compile-time thresholds are removed by the compiler, arguments included.
+// Override in the sketch or with build flags, e.g. -DFEEDER_LOG_LEVEL=FEEDER_LOG_LEVEL_WARN
+#define FEEDER_LOG_LEVEL_NONE 0
+#define FEEDER_LOG_LEVEL_ERROR 1
+#define FEEDER_LOG_LEVEL_WARN 2
+#define FEEDER_LOG_LEVEL_INFO 3
+#define FEEDER_LOG_LEVEL_DEBUG 4
+
+#ifndef FEEDER_LOG_LEVEL
+#define FEEDER_LOG_LEVEL FEEDER_LOG_LEVEL_INFO
+#endif
+
+#ifndef FEEDER_LOG_CATEGORIES
+#define FEEDER_LOG_CATEGORIES 0xFFu // Bit mask of the LogCategory values to keep
+#endif
+
+enum LogCategory : uint8_t
+{
+    LOG_SYSTEM,
+    LOG_FEEDER,
+    LOG_SCALE,
+    LOG_RFID,
+    LOG_GATE,
+    LOG_NETWORK,
+    LOG_TIME,
+    LOG_STORAGE
+};
+
+#define FEEDER_LOG(level, category, format, ...) \
+    do \
+    { \
+        if ((level) <= FEEDER_LOG_LEVEL && ((FEEDER_LOG_CATEGORIES >> (category)) & 1u)) \
+        { \
+            FeederLog::write((level), (category), format, ##__VA_ARGS__); \
+        } \
+    } while (0)
+
+#define LOG_ERROR(category, format, ...) FEEDER_LOG(FEEDER_LOG_LEVEL_ERROR, category, format, ##__VA_ARGS__)
+#define LOG_WARN(category, format, ...) FEEDER_LOG(FEEDER_LOG_LEVEL_WARN, category, format, ##__VA_ARGS__)
+#define LOG_INFO(category, format, ...) FEEDER_LOG(FEEDER_LOG_LEVEL_INFO, category, format, ##__VA_ARGS__)
+#define LOG_DEBUG(category, format, ...) FEEDER_LOG(FEEDER_LOG_LEVEL_DEBUG, category, format, ##__VA_ARGS__)
+
+// Binary log ring. A log call copies the timestamp, a pointer to its format string (a literal, so it
+// stays in flash) and its raw arguments into a fixed-size record: no String, no heap, no formatting,
+// no UART wait. A low-priority task, woken by the write, formats the records and drains them to Serial. The last
+// RING_SIZE records stay in RAM and can be dumped later ("log" on the serial console, /log on the portal).
+struct FeederLog
+{
+    static constexpr int RING_SIZE = 128;
+    static constexpr int PAYLOAD_SIZE = 40;        // Encoded arguments, longer strings are truncated
+    static constexpr int MAX_LINE_LENGTH = 160;
+
+    struct LogRecord
+    {
+        uint32_t timestamp; // FeederClock::millis()
+        const char* format;
+        uint8_t level;
+        uint8_t category;
+        uint8_t payloadLength;
+        uint8_t payload[PAYLOAD_SIZE]; // Per argument: a type byte, then the value
+    };
+
+    static LogRecord records[RING_SIZE];
+    static uint32_t numOfWritten; // Records written since boot, the next one goes to numOfWritten % RING_SIZE
+    static uint32_t numOfDrained;
+    static uint32_t numOfLost;    // Overwritten before they were drained
+    static portMUX_TYPE lock;
+    static TaskHandle_t drainTaskHandle;
+
+    template <typename... Args>
+    static void write(uint8_t level, uint8_t category, const char* format, const Args&... args)
+    {
+        LogRecord record;
+        record.timestamp = FeederClock::millis();
+        record.format = format;
+        record.level = level;
+        record.category = category;
+        record.payloadLength = 0;
+        encode(record, args...);
+
+        portENTER_CRITICAL(&lock);
+        records[numOfWritten % RING_SIZE] = record;
+        numOfWritten++;
+        if (numOfWritten - numOfDrained > RING_SIZE)
+        {
+            numOfLost += numOfWritten - numOfDrained - RING_SIZE;
+            numOfDrained = numOfWritten - RING_SIZE;
+        }
+        portEXIT_CRITICAL(&lock);
+
+        wakeDrainTask();
+    }
+
+    // Start the task that prints the records and answers the "log" console command. Call after Serial.begin()
+    static void startDrainTask(UBaseType_t priority, BaseType_t core)
+    {
+        xTaskCreatePinnedToCore(drainTask, "log", 3072, nullptr, priority, &drainTaskHandle, core);
+
+        // Called from the UART driver's event task
+        Serial.onReceive([]() {
+            wakeDrainTask();
+        });
+    }
+
+    // Print the records still in the ring, oldest first
+    static void dump(Print& out)
+    {
+        portENTER_CRITICAL(&lock);
+        uint32_t end = numOfWritten;
+        portEXIT_CRITICAL(&lock);
+
+        uint32_t begin = end > RING_SIZE ? end - RING_SIZE : 0;
+        for (uint32_t i = begin; i < end; i++)
+        {
+            LogRecord record;
+            if (!readRecord(i, record))
+            {
+                continue; // Overwritten while dumping
+            }
+            printRecord(out, record);
+        }
+    }
+
+    static uint32_t getNumOfWritten()
+    {
+        return numOfWritten;
+    }
+
+    static uint32_t getNumOfLost()
+    {
+        return numOfLost;
+    }
+
+private:
+    enum ArgType : uint8_t
+    {
+        ARG_INT = 'i',
+        ARG_UINT = 'u',
+        ARG_INT64 = 'q',
+        ARG_FLOAT = 'f',
+        ARG_STRING = 's'
+    };
+
+    static void wakeDrainTask()
+    {
+        if (drainTaskHandle == nullptr)
+        {
+            return; // Not started yet, the records wait in the ring
+        }
+
+        if (xPortInIsrContext())
+        {
+            vTaskNotifyGiveFromISR(drainTaskHandle, nullptr);
+        }
+        else
+        {
+            xTaskNotifyGive(drainTaskHandle);
+        }
+    }
+
+    static void encodeValue(LogRecord& record, ArgType type, const void* value, size_t size)
+    {
+        if (record.payloadLength + 1 + size > PAYLOAD_SIZE)
+        {
+            return; // No room, the formatter prints "?" for missing arguments
+        }
+        record.payload[record.payloadLength++] = type;
+        memcpy(record.payload + record.payloadLength, value, size);
+        record.payloadLength += size;
+    }
+
+    static void encodeArg(LogRecord& record, int value) { encodeValue(record, ARG_INT, &value, sizeof(int32_t)); }
+    static void encodeArg(LogRecord& record, long value) { int32_t v = value; encodeValue(record, ARG_INT, &v, sizeof(v)); }
+    static void encodeArg(LogRecord& record, unsigned int value) { uint32_t v = value; encodeValue(record, ARG_UINT, &v, sizeof(v)); }
+    static void encodeArg(LogRecord& record, unsigned long value) { uint32_t v = value; encodeValue(record, ARG_UINT, &v, sizeof(v)); }
+    static void encodeArg(LogRecord& record, long long value) { int64_t v = value; encodeValue(record, ARG_INT64, &v, sizeof(v)); }
+    static void encodeArg(LogRecord& record, unsigned long long value) { int64_t v = value; encodeValue(record, ARG_INT64, &v, sizeof(v)); }
+    static void encodeArg(LogRecord& record, double value) { float v = value; encodeValue(record, ARG_FLOAT, &v, sizeof(v)); }
+    static void encodeArg(LogRecord& record, const String& value) { encodeArg(record, value.c_str()); }
+
+    // Strings are copied, so they may come from a buffer that is gone by the time the record is printed
+    static void encodeArg(LogRecord& record, const char* value)
+    {
+        if (value == nullptr)
+        {
+            value = "(null)";
+        }
+
+        int room = PAYLOAD_SIZE - record.payloadLength - 2;
+        if (room < 0)
+        {
+            return;
+        }
+
+        size_t length = strlen(value);
+        uint8_t storedLength = length < (size_t)room ? length : room;
+        record.payload[record.payloadLength++] = ARG_STRING;
+        record.payload[record.payloadLength++] = storedLength;
+        memcpy(record.payload + record.payloadLength, value, storedLength);
+        record.payloadLength += storedLength;
+    }
+
+    static void encode(LogRecord&)
+    {
+    }
+
+    template <typename T, typename... Rest>
+    static void encode(LogRecord& record, const T& value, const Rest&... rest)
+    {
+        encodeArg(record, value);
+        encode(record, rest...);
+    }
+
+    static bool readRecord(uint32_t index, LogRecord& record)
+    {
+        portENTER_CRITICAL(&lock);
+        bool isAvailable = numOfWritten - index <= RING_SIZE;
+        if (isAvailable)
+        {
+            record = records[index % RING_SIZE];
+        }
+        portEXIT_CRITICAL(&lock);
+        return isAvailable;
+    }
+
+    // printf-style formatting of the decoded arguments. The conversion follows the stored type,
+    // so a length modifier or a mismatched conversion in the format string cannot misread the payload
+    static void formatRecord(const LogRecord& record, char* line, size_t lineSize)
+    {
+        static const char* const LEVEL_NAMES = "-EWID";
+        static const char* const CATEGORY_NAMES[] = {"SYS", "FEED", "SCALE", "RFID", "GATE", "NET", "TIME", "NVS"};
+
+        int length = snprintf(line, lineSize, "[%lu %c %s] ", (unsigned long)record.timestamp, LEVEL_NAMES[record.level <= FEEDER_LOG_LEVEL_DEBUG ? record.level : 0],
+                              record.category < sizeof(CATEGORY_NAMES) / sizeof(CATEGORY_NAMES[0]) ? CATEGORY_NAMES[record.category] : "?");
+        int offset = 0;
+
+        for (const char* c = record.format; *c != '\0' && length < (int)lineSize - 1; c++)
+        {
+            if (*c != '%')
+            {
+                line[length++] = *c;
+                continue;
+            }
+            if (c[1] == '%')
+            {
+                line[length++] = '%';
+                c++;
+                continue;
+            }
+
+            // Flags, width and precision are kept, length modifiers are replaced
+            char spec[16] = "%";
+            int specLength = 1;
+            c++;
+            while (*c != '\0' && strchr("-+ #0123456789.", *c) != nullptr && specLength < 10)
+            {
+                spec[specLength++] = *c++;
+            }
+            while (*c != '\0' && strchr("hlLqjzt", *c) != nullptr)
+            {
+                c++;
+            }
+            if (*c == '\0')
+            {
+                break;
+            }
+            char conversion = *c;
+
+            int written;
+            if (offset >= record.payloadLength)
+            {
+                written = snprintf(line + length, lineSize - length, "?");
+            }
+            else
+            {
+                uint8_t type = record.payload[offset++];
+                if (type == ARG_STRING)
+                {
+                    uint8_t stringLength = record.payload[offset++];
+                    strcpy(spec + specLength, ".*s");
+                    written = snprintf(line + length, lineSize - length, spec, (int)stringLength, (const char*)(record.payload + offset));
+                    offset += stringLength;
+                }
+                else if (type == ARG_FLOAT)
+                {
+                    float value;
+                    memcpy(&value, record.payload + offset, sizeof(value));
+                    offset += sizeof(value);
+                    spec[specLength++] = strchr("eEgG", conversion) != nullptr ? conversion : 'f';
+                    written = snprintf(line + length, lineSize - length, spec, (double)value);
+                }
+                else if (type == ARG_INT64)
+                {
+                    int64_t value;
+                    memcpy(&value, record.payload + offset, sizeof(value));
+                    offset += sizeof(value);
+                    spec[specLength++] = 'l';
+                    spec[specLength++] = 'l';
+                    spec[specLength++] = strchr("uxX", conversion) != nullptr ? conversion : 'd';
+                    written = snprintf(line + length, lineSize - length, spec, (long long)value);
+                }
+                else
+                {
+                    uint32_t value;
+                    memcpy(&value, record.payload + offset, sizeof(value));
+                    offset += sizeof(value);
+                    if (conversion == 'c')
+                    {
+                        spec[specLength++] = 'c';
+                        written = snprintf(line + length, lineSize - length, spec, (int)value);
+                    }
+                    else if (strchr("uxX", conversion) != nullptr || type == ARG_UINT)
+                    {
+                        spec[specLength++] = strchr("uxX", conversion) != nullptr ? conversion : 'u';
+                        written = snprintf(line + length, lineSize - length, spec, (unsigned int)value);
+                    }
+                    else
+                    {
+                        spec[specLength++] = 'd';
+                        written = snprintf(line + length, lineSize - length, spec, (int)(int32_t)value);
+                    }
+                }
+            }
+
+            length += written > 0 ? written : 0;
+            if (length >= (int)lineSize - 1)
+            {
+                length = lineSize - 1;
+            }
+        }
+
+        line[length] = '\0';
+    }
+
+    static void printRecord(Print& out, const LogRecord& record)
+    {
+        char line[MAX_LINE_LENGTH];
+        formatRecord(record, line, sizeof(line));
+        out.println(line);
+    }
+
+    static void drainTask(void*)
+    {
+        char command[8];
+        int commandLength = 0;
+
+        for (;;)
+        {
+            uint32_t lostBefore = numOfLost;
+
+            LogRecord record;
+            while (numOfDrained != numOfWritten)
+            {
+                portENTER_CRITICAL(&lock);
+                uint32_t index = numOfDrained;
+                bool hasRecord = index != numOfWritten;
+                if (hasRecord)
+                {
+                    record = records[index % RING_SIZE];
+                    numOfDrained++;
+                }
+                portEXIT_CRITICAL(&lock);
+
+                if (hasRecord)
+                {
+                    printRecord(Serial, record);
+                }
+            }
+
+            if (numOfLost != lostBefore)
+            {
+                Serial.printf("[log] %u records lost\n", (unsigned int)(numOfLost - lostBefore));
+            }
+
+            // "log" on the serial console prints the whole ring
+            while (Serial.available() > 0)
+            {
+                char c = Serial.read();
+                if (c == '\n' || c == '\r')
+                {
+                    command[commandLength] = '\0';
+                    if (strcmp(command, "log") == 0)
+                    {
+                        dump(Serial);
+                    }
+                    commandLength = 0;
+                }
+                else if (commandLength < (int)sizeof(command) - 1)
+                {
+                    command[commandLength++] = c;
+                }
+            }
+
+            // Until the next record or console input
+            ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        }
+    }
+};
+
+// Initialize static members
+FeederLog::LogRecord FeederLog::records[FeederLog::RING_SIZE];
+uint32_t FeederLog::numOfWritten = 0;
+uint32_t FeederLog::numOfDrained = 0;
+uint32_t FeederLog::numOfLost = 0;
+portMUX_TYPE FeederLog::lock = portMUX_INITIALIZER_UNLOCKED;
+TaskHandle_t FeederLog::drainTaskHandle = nullptr;
+
+#endif // FEEDER_LOG_H
@@ -0,0 +1,112 @@
+#ifndef FEEDER_METRICS_H
+#define FEEDER_METRICS_H
+
+#include <Arduino.h>
+#include <freertos/FreeRTOS.h>
+#include "FeederHal.h"
+
+// Run time of the task stages, as fixed-bucket histograms. A stage is timed with FeederClock from begin()
+// to end(), excluding the queue waits of its task. Unlike the cycle counter, the clock keeps its rate across
+// frequency switches and light sleep. A pass longer than the stall budget of its stage is counted as a stall:
+// events queued behind it waited longer than the task is sized for. Served by MetricsServer
+struct FeederMetrics
+{
+    enum Stage : uint8_t
+    {
+        STAGE_RFID,      // sensing task: tag decisions
+        STAGE_GATE,      // actuation task: gate and motor commands
+        STAGE_FEEDER,    // scheduling task: app commands and FeederController::loop()
+        STAGE_WIFI,      // networking task: WifiController::loop(), including the config fetch
+        STAGE_TIME_SYNC,
+        STAGE_COMMANDS,
+        STAGE_OUTBOX,
+        STAGE_NVS,
+        NUM_OF_STAGES
+    };
+
+    struct StageInfo
+    {
+        const char* name;
+        uint32_t stallMicros; // Stall budget of one pass
+    };
+
+    static constexpr int NUM_OF_BUCKETS = 12;
+    static const StageInfo STAGES[NUM_OF_STAGES];
+    static const uint32_t BUCKET_LIMITS[NUM_OF_BUCKETS]; // Upper bounds (us), the last bucket is +Inf
+
+    struct Histogram
+    {
+        uint32_t counts[NUM_OF_BUCKETS + 1]; // Not cumulative
+        uint32_t count;
+        uint32_t stalls;
+        uint32_t maxMicros;
+        uint64_t sumMicros;
+    };
+
+    static Histogram histograms[NUM_OF_STAGES];
+    static portMUX_TYPE lock;
+
+    static uint32_t begin()
+    {
+        return (uint32_t)FeederClock::micros();
+    }
+
+    // Wraps after 71 minutes, longer than any stage with the 5 s HTTP timeout
+    static void end(Stage stage, uint32_t beginMicros)
+    {
+        uint32_t micros = (uint32_t)FeederClock::micros() - beginMicros;
+
+        int bucket = 0;
+        while (bucket < NUM_OF_BUCKETS && micros > BUCKET_LIMITS[bucket])
+        {
+            bucket++;
+        }
+
+        portENTER_CRITICAL(&lock);
+        Histogram& histogram = histograms[stage];
+        histogram.counts[bucket]++;
+        histogram.count++;
+        histogram.sumMicros += micros;
+        histogram.stalls += micros > STAGES[stage].stallMicros ? 1 : 0;
+        histogram.maxMicros = micros > histogram.maxMicros ? micros : histogram.maxMicros;
+        portEXIT_CRITICAL(&lock);
+    }
+
+    // Consistent copy of one histogram, for the readers
+    static Histogram getHistogram(Stage stage)
+    {
+        portENTER_CRITICAL(&lock);
+        Histogram histogram = histograms[stage];
+        portEXIT_CRITICAL(&lock);
+        return histogram;
+    }
+
+    // Run time of all the stages since boot
+    static uint64_t getTotalMicros()
+    {
+        uint64_t totalMicros = 0;
+        portENTER_CRITICAL(&lock);
+        for (int stage = 0; stage < NUM_OF_STAGES; stage++)
+        {
+            totalMicros += histograms[stage].sumMicros;
+        }
+        portEXIT_CRITICAL(&lock);
+        return totalMicros;
+    }
+};
+
+// Initialize static members
+const FeederMetrics::StageInfo FeederMetrics::STAGES[FeederMetrics::NUM_OF_STAGES] = {
+    {"rfid", 100000},  // Gate decision latency the tag timeout is tuned for
+    {"gate", 50000},
+    {"feeder", 50000}, // DISPENSE_SAMPLE_INTERVAL is the tightest deadline of the scheduling task
+    {"wifi", 100000},  // Same budget for all the networking stages
+    {"time_sync", 100000},
+    {"commands", 100000},
+    {"outbox", 100000},
+    {"nvs", 100000}};
+const uint32_t FeederMetrics::BUCKET_LIMITS[FeederMetrics::NUM_OF_BUCKETS] = {10, 50, 100, 500, 1000, 5000, 10000, 50000, 100000, 500000, 1000000, 5000000};
+FeederMetrics::Histogram FeederMetrics::histograms[FeederMetrics::NUM_OF_STAGES] = {};
+portMUX_TYPE FeederMetrics::lock = portMUX_INITIALIZER_UNLOCKED;
+
+#endif // FEEDER_METRICS_H
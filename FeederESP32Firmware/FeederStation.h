@@ -0,0 +1,32 @@
+#ifndef FEEDER_STATION_H
+#define FEEDER_STATION_H
+
+#include "StationProfile.h"
+#include "MemoryController.h"
+#include "WebConnectionController.h"
+#include "GateController.h"
+#include "MotorController.h"
+#include "RFIDController.h"
+#include "WeightController.h"
+#include "FeederController.h"
+#include "UplinkOutbox.h"
+#include "CommandChannel.h"
+
+// Controllers of one feeding station: its hopper, gate, RFID reader and scale, and its record on the backend.
+// Each station runs its own sensing, actuation and scheduling tasks; Wi-Fi, the clock and the backend
+// session belong to the board and are shared (see FeederESP32Firmware.ino)
+struct FeederStation
+{
+    const StationProfile* profile = nullptr;
+    MemoryController* memoryController = nullptr;
+    WebConnectionController* webConnection = nullptr;
+    GateController* gateController = nullptr;
+    MotorController* motorController = nullptr;
+    RFIDController* rfidController = nullptr;
+    WeightController* weightController = nullptr;
+    FeederController* feederController = nullptr; // Created once the control tasks run, see setup()
+    UplinkOutbox* uplinkOutbox = nullptr;
+    CommandChannel* commandChannel = nullptr;
+};
+
+#endif // FEEDER_STATION_H
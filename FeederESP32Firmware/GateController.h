@@ -2,129 +2,301 @@
 #define GATE_CONTROLLER_H
 
 #include "WebConnectionController.h"
-#include <Stepper.h>
+#include "StationProfile.h"
+#include "TaskQueues.h"
+#include "FeederHal.h"
+#include "AwakeLock.h"
+#include "FeederLog.h"
+#include <esp_timer.h>
+#include <math.h>
 
 class GateController
 {
-private:
-    
-    enum class GateOperation 
+public:
+
+    enum class GateState
     {
-        NONE,
+        CLOSED,
+        OPENING,
         OPEN,
-        CLOSE
+        CLOSING
     };
 
-    struct StepperPins 
-    {
-        // Pin definitions for the stepper motor
-        static constexpr int IN1 = 19;
-        static constexpr int IN2 = 18;
-        static constexpr int IN3 = 5;
-        static constexpr int IN4 = 17;
-    };
+private:
 
-    static constexpr int STEPS_PER_REVOLUTION = 2048;
+    // Full-step coil sequence on (IN1, IN3, IN2, IN4), as driven by the Arduino Stepper library,
+    // so positive steps still move the gate towards closed
+    static constexpr uint8_t COIL_PHASES[4] = {0b1010, 0b0110, 0b0101, 0b1001};
 
-    // Stepper motor initialization
-    Stepper stepperMotor{STEPS_PER_REVOLUTION, StepperPins::IN1, StepperPins::IN3, StepperPins::IN2, StepperPins::IN4};
+    // Stroke lengths. Opening drives further than closing, so the gate re-seats against its end stop on every open
+    static constexpr long OPEN_STEPS = 625;
+    static constexpr long CLOSE_STEPS = 460;
 
-    unsigned long actionEndTime = 0; // Timestamp to track when the current action ends
-    static constexpr unsigned long WAIT_TIME_AFTER_ACTION = 3000; // Wait time after an action (in milliseconds)
+    // Trapezoidal speed profile (steps per second). The 28BYJ-48 starts reliably at MIN_SPEED without a ramp
+    static constexpr float MIN_SPEED = 100.0f;
+    static constexpr float MAX_SPEED = 340.0f;    // ~10 rpm
+    static constexpr float ACCELERATION = 600.0f; // steps/s^2
 
-    GateOperation lastOperation = GateOperation::NONE; // Tracks the last operation performed
+    // Motion state. The target is set by open()/close() from the actuation task, everything
+    // else is advanced by the step timer, which runs in the esp_timer task
+    esp_timer_handle_t stepTimer = nullptr;
+    portMUX_TYPE motionLock = portMUX_INITIALIZER_UNLOCKED;
+
+    volatile long position = 0;        // Steps from the position at boot (the gate starts closed)
+    volatile long targetPosition = 0;
+    volatile GateState gateState = GateState::CLOSED;
+    volatile bool stepTimerRunning = false;
+    float speed = 0;                   // Current speed, 0 when stopped
+    int direction = 0;                 // Direction of the current motion: -1 (opening), 1 (closing) or 0
+    uint8_t phase = 0;
+
+    long strokeOpenPosition = -OPEN_STEPS; // Position the gate stops at when open
 
     bool gateWasOpened = false; // Tracks if the gate was opened
+    bool updateDatabaseOnClose = true;
     unsigned long openTimestamp = 0; // Timestamp when the gate was opened
     unsigned long closeTimestamp = 0; // Timestamp when the gate was closed
 
+    uint8_t station;
+    StationProfile::GatePins stepperPins; // Stepper motor pins of the station
     WebConnectionController* webConnection = nullptr;
+    OutputPins* pins = nullptr;
+
+    // Light sleep would stretch the step intervals, so the chip stays awake while the gate moves
+    AwakeLock awakeLock{"gate"};
+    unsigned long motionStartTime = 0;
+    uint32_t totalMovingMillis = 0;
+    uint32_t motionGeneration = 0; // Motions started, under motionLock
+    uint32_t awakeMotion = 0;      // Motion that holds awakeLock, so only its own stop releases it
 
     void deactivateStepperPins()
     {
-        digitalWrite(StepperPins::IN1, LOW);
-        digitalWrite(StepperPins::IN2, LOW);
-        digitalWrite(StepperPins::IN3, LOW);
-        digitalWrite(StepperPins::IN4, LOW);
+        pins->write(stepperPins.in1, false);
+        pins->write(stepperPins.in2, false);
+        pins->write(stepperPins.in3, false);
+        pins->write(stepperPins.in4, false);
+    }
+
+    void writeCoils(uint8_t coils)
+    {
+        pins->write(stepperPins.in1, (coils & 0b1000) != 0);
+        pins->write(stepperPins.in3, (coils & 0b0100) != 0);
+        pins->write(stepperPins.in2, (coils & 0b0010) != 0);
+        pins->write(stepperPins.in4, (coils & 0b0001) != 0);
+    }
+
+    static void onStepTimer(void* arg)
+    {
+        static_cast<GateController*>(arg)->step();
+    }
+
+    // Take one step towards the target and schedule the next one. A new target in the opposite
+    // direction decelerates to MIN_SPEED first, then reverses
+    void step()
+    {
+        portENTER_CRITICAL(&motionLock);
+
+        long distance = targetPosition - position;
+        int wantedDirection = distance > 0 ? 1 : (distance < 0 ? -1 : 0);
+
+        if (direction != 0 && wantedDirection != direction)
+        {
+            // Reversal or target reached while moving: slow down before changing direction
+            speed = sqrtf(speed * speed - 2.0f * ACCELERATION);
+            if (!(speed > MIN_SPEED))
+            {
+                speed = 0;
+                direction = 0;
+            }
+        }
+        else if (wantedDirection == 0)
+        {
+            // Target reached. The stop is booked before leaving the lock: once stepTimerRunning is
+            // clear, moveTo() may start the next motion, whose coils and awake lock must stay
+            speed = 0;
+            direction = 0;
+            stepTimerRunning = false;
+            gateState = gateState == GateState::OPENING ? GateState::OPEN : (gateState == GateState::CLOSING ? GateState::CLOSED : gateState);
+            deactivateStepperPins(); // The gate holds without current
+            totalMovingMillis += FeederClock::millis() - motionStartTime;
+            if (awakeMotion == motionGeneration)
+            {
+                awakeLock.release();
+            }
+            portEXIT_CRITICAL(&motionLock);
+
+            TaskQueues::sendActuatorCommand(station, ActuatorCommand::GATE_STOPPED); // Lets the actuation task report the visit
+            return;
+        }
+        else
+        {
+            direction = wantedDirection;
+
+            // Decelerate when the remaining steps are what it takes to slow down to MIN_SPEED
+            float stepsToStop = (speed * speed - MIN_SPEED * MIN_SPEED) / (2.0f * ACCELERATION);
+            if (labs(distance) <= stepsToStop)
+            {
+                float slowerSpeed = sqrtf(speed * speed - 2.0f * ACCELERATION);
+                speed = slowerSpeed > MIN_SPEED ? slowerSpeed : MIN_SPEED;
+            }
+            else
+            {
+                float fasterSpeed = speed > 0 ? sqrtf(speed * speed + 2.0f * ACCELERATION) : MIN_SPEED;
+                speed = fasterSpeed < MAX_SPEED ? fasterSpeed : MAX_SPEED;
+            }
+        }
+
+        bool stepNow = direction != 0;
+        if (stepNow)
+        {
+            position += direction;
+            phase = (phase + direction) & 0x03;
+        }
+        uint64_t nextStepMicros = (uint64_t)(1000000.0f / (speed > 0 ? speed : MIN_SPEED));
+
+        portEXIT_CRITICAL(&motionLock);
+
+        if (stepNow)
+        {
+            writeCoils(COIL_PHASES[phase]);
+        }
+        esp_timer_start_once(stepTimer, nextStepMicros);
+    }
+
+    // Set a new target. open() and close() return right away, the step timer does the moving
+    void moveTo(long newTargetPosition, GateState newState)
+    {
+        bool startTimer = false;
+
+        portENTER_CRITICAL(&motionLock);
+        targetPosition = newTargetPosition;
+        gateState = newState;
+        if (!stepTimerRunning)
+        {
+            stepTimerRunning = true;
+            startTimer = true;
+            motionGeneration++;
+            awakeLock.acquire();
+            awakeMotion = motionGeneration;
+            motionStartTime = FeederClock::millis();
+        }
+        portEXIT_CRITICAL(&motionLock);
+
+        if (startTimer)
+        {
+            writeCoils(COIL_PHASES[phase]); // Energize the current phase before the first step
+            esp_timer_start_once(stepTimer, (uint64_t)(1000000.0f / MIN_SPEED));
+        }
     }
 
 public:
 
-    GateController(WebConnectionController* webConnectionController) : webConnection(webConnectionController)
+    GateController(const StationProfile& profile, WebConnectionController* webConnectionController, OutputPins* outputPins) : station(profile.index), stepperPins(profile.gatePins), webConnection(webConnectionController), pins(outputPins)
     {
-        Serial.println("GateController Constructor");
+        LOG_DEBUG(LOG_GATE, "GateController Constructor");
 
         // Initialize stepper motor pins
-        pinMode(StepperPins::IN1, OUTPUT);
-        pinMode(StepperPins::IN2, OUTPUT);
-        pinMode(StepperPins::IN3, OUTPUT);
-        pinMode(StepperPins::IN4, OUTPUT);
+        pins->configure(stepperPins.in1);
+        pins->configure(stepperPins.in2);
+        pins->configure(stepperPins.in3);
+        pins->configure(stepperPins.in4);
 
         deactivateStepperPins(); // Ensure the stepper motor is deactivated initially
-        stepperMotor.setSpeed(5); // Set the stepper motor speed
+
+        esp_timer_create_args_t timerArgs = {};
+        timerArgs.callback = &GateController::onStepTimer;
+        timerArgs.arg = this;
+        timerArgs.dispatch_method = ESP_TIMER_TASK;
+        timerArgs.name = "gate";
+
+        if (esp_timer_create(&timerArgs, &stepTimer) != ESP_OK)
+        {
+            LOG_ERROR(LOG_GATE, "GateController: unable to create the step timer");
+            stepTimer = nullptr;
+        }
     }
 
+    // Report the end of a gate visit once the gate is fully closed again. Called by the actuation task
+    // after each command, including the GATE_STOPPED posted when a motion ends
     void loop()
     {
-        if (!isBusy())
+        if (gateState != GateState::CLOSED || !gateWasOpened)
+        {
+            return;
+        }
+
+        if (webConnection && updateDatabaseOnClose)
         {
-            deactivateStepperPins();
+            closeTimestamp = webConnection->getCurrentTime(); // Record the close timestamp
+            if (openTimestamp != 0 && closeTimestamp != 0)
+            {
+                // Uploaded by the networking task, so the gate never waits on the network
+                TaskQueues::postUplinkEvent(station, UplinkEventType::GATE_EVENT, openTimestamp, closeTimestamp, 0);
+            }
         }
+
+        // Update state variables
+        openTimestamp = 0;
+        closeTimestamp = 0;
+        gateWasOpened = false;
     }
 
-    // Check if the gate controller is busy (motor moving or within wait time)
-    bool isBusy()
+    // Time the stepper coils were energized since boot
+    uint32_t getTotalMovingMillis() const
     {
-        return millis() < actionEndTime;
+        return totalMovingMillis;
     }
 
-    // Open the gate
+    GateState getState() const
+    {
+        return gateState;
+    }
+
+    // Steps from the position at boot, negative towards open
+    long getPosition() const
+    {
+        return position;
+    }
+
+    // Open the gate. A closing gate reverses mid-stroke
     void open()
     {
-        if (isBusy() || lastOperation == GateOperation::OPEN)
+        if (stepTimer == nullptr || gateState == GateState::OPEN || gateState == GateState::OPENING)
             return;
 
-        Serial.println("Opening gate...");
-
-        stepperMotor.step(-625); // Move the stepper motor to open the gate
-        actionEndTime = millis() + WAIT_TIME_AFTER_ACTION; // Update the action end time
+        if (gateState == GateState::CLOSED)
+        {
+            LOG_INFO(LOG_GATE, "Opening gate...");
+            strokeOpenPosition = position - OPEN_STEPS;
+        }
+        else
+        {
+            LOG_INFO(LOG_GATE, "Reopening gate mid-stroke at %ld", (long)position);
+        }
 
-        if (webConnection)
+        if (!gateWasOpened && webConnection)
         {
             openTimestamp = webConnection->getCurrentTime(); // Record the open timestamp
         }
 
         // Update state variables
         gateWasOpened = true;
-        lastOperation = GateOperation::OPEN;
+        moveTo(strokeOpenPosition, GateState::OPENING);
     }
 
-    // Close the gate
+    // Close the gate. The visit is reported when the gate is fully closed (see loop())
     void close(bool updateDatabase = true)
     {
-        if (isBusy() || lastOperation == GateOperation::CLOSE)
+        if (stepTimer == nullptr || gateState == GateState::CLOSED || gateState == GateState::CLOSING)
             return;
 
-        Serial.println("Closing gate...");
-
-        stepperMotor.step(460); // Move the stepper motor to close the gate
-        actionEndTime = millis() + WAIT_TIME_AFTER_ACTION; // Update the action end time
+        LOG_INFO(LOG_GATE, "Closing gate...");
 
-        if (webConnection && updateDatabase)
-        {
-            closeTimestamp = webConnection->getCurrentTime(); // Record the close timestamp
-            if (openTimestamp != 0 && closeTimestamp != 0)
-            {
-                webConnection->addGateEvent(openTimestamp, closeTimestamp); // Update the database
-            }
-        }
-
-        // Update state variables
-        openTimestamp = 0;
-        closeTimestamp = 0;
-        gateWasOpened = false;
-        lastOperation = GateOperation::CLOSE;
+        updateDatabaseOnClose = updateDatabase;
+        moveTo(strokeOpenPosition + CLOSE_STEPS, GateState::CLOSING);
     }
 };
 
-#endif // GATE_CONTROLLER_H
\ No newline at end of file
+constexpr uint8_t GateController::COIL_PHASES[4];
+
+#endif // GATE_CONTROLLER_H
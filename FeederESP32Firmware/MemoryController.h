@@ -2,31 +2,119 @@
 #define MEMORY_CONTROLLER_H
 
 #include <Preferences.h>
+#include <esp_rom_crc.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
 #include "FeederDataTypes.h"
+#include "FeederHal.h"
+#include "StationProfile.h"
+#include "TaskQueues.h"
+#include "FeederLog.h"
 
 class MemoryController
 {
+public:
+    // Longest feeder ID and password the portal accepts. Both go into the MQTT CONNECT of CommandChannel
+    static constexpr size_t MAX_FEEDER_ID_LENGTH = 64;
+    static constexpr size_t MAX_FEEDER_PASSWORD_LENGTH = 64;
+
+    // Flash write counters. Since-boot values, except the lifetime ones, which are kept in NVS
+    struct WriteStats
+    {
+        uint32_t commits = 0;            // NVS sessions that wrote at least one key
+        uint32_t keysWritten = 0;        // put*() calls that reached flash
+        uint32_t entriesWritten = 0;     // 32-byte NVS entries written, the unit of flash wear
+        uint32_t writesCoalesced = 0;    // Sets that did not change the stored value, so were never written
+        uint32_t failedWrites = 0;       // put*() calls rejected by NVS (no space, value too long)
+        uint32_t lifetimeEntriesWritten = 0;
+        uint32_t lifetimeCommits = 0;
+    };
+
 private:
     // Use Preferences for NVS storage
-    Preferences preferences; 
+    Preferences preferences;
 
-    // Constants for NVS keys
+    // Guards preferences and the mirror, which are used from the networking and scheduling tasks
+    SemaphoreHandle_t lock = nullptr;
+
+    // Constants for NVS keys (at most 15 characters, longer keys are rejected by NVS)
     static constexpr const char* NVS_NAMESPACE = "feeder";
     static constexpr const char* KEY_WIFI_SSID = "wifiSSID";
     static constexpr const char* KEY_WIFI_PASSWORD = "wifiPassword";
-    static constexpr const char* KEY_FOOD_CONFIG = "foodConfig";
+    static constexpr const char* KEY_FOOD_CONFIG = "foodConfig";         // Schedule JSON as a string, read for upgrades only
+    static constexpr const char* KEY_FOOD_SCHEDULE = "foodSchedule";     // Schedule JSON as a blob
+    static constexpr const char* KEY_FOOD_CONFIG_CRC = "foodConfigCrc";
     static constexpr const char* KEY_TRAP_MODE = "trapMode";
     static constexpr const char* KEY_ID = "id";
     static constexpr const char* KEY_NAME = "name";
-    static constexpr const char* KEY_FOOD_STORAGE_QUANTITY = "foodStorageQuantity";
-    static constexpr const char* KEY_FOOD_CURRENT_WEIGHT = "foodCurrentWeight";
-    static constexpr const char* KEY_LAST_FOOD_STORAGE_UPDATE_TIME = "lastFoodStorageUpdateTime";
-    static constexpr const char* KEY_LAST_FOOD_WEIGHT_UPDATE_TIME = "lastFoodCurrentWeightUpdateTime";
-    static constexpr const char* KEY_WEIGHT_TO_LOAD_AT_RESTART = "weightToLoadAtRestart";
+    static constexpr const char* KEY_FOOD_STORAGE_QUANTITY = "storageQty";
+    static constexpr const char* KEY_FOOD_CURRENT_WEIGHT = "currentWeight";
+    static constexpr const char* KEY_LAST_FOOD_STORAGE_UPDATE_TIME = "storageUpdTime";
+    static constexpr const char* KEY_LAST_FOOD_WEIGHT_UPDATE_TIME = "weightUpdTime";
+    static constexpr const char* KEY_WEIGHT_TO_LOAD_AT_RESTART = "restartWeight";
+    static constexpr const char* KEY_WEAR = "wear";
+    static constexpr const char* KEY_FEEDER_ID = "feederId";
+    static constexpr const char* KEY_FEEDER_PASSWORD = "feederPass";
+
+    // Identity the single-station firmware was built with. Station 0 falls back to it until the portal sets one
+    static constexpr const char* LEGACY_FEEDER_ID = "feeder_001";
+    static constexpr const char* LEGACY_FEEDER_PASSWORD = "parola1234";
+
+    static constexpr size_t NVS_ENTRY_SIZE = 32;
+    static constexpr unsigned long COMMIT_DELAY = 5000;             // Batch the sets done within this time into one commit (ms)
+    static constexpr unsigned long STATS_REPORT_INTERVAL = 86400000; // Log the write counters once a day (ms)
+
+    // RAM mirror of the feeder namespace, loaded once at boot
+    enum MirrorKey : uint16_t
+    {
+        DIRTY_WIFI_SSID = 1 << 0,
+        DIRTY_WIFI_PASSWORD = 1 << 1,
+        DIRTY_FOOD_CONFIG = 1 << 2,
+        DIRTY_TRAP_MODE = 1 << 3,
+        DIRTY_ID = 1 << 4,
+        DIRTY_NAME = 1 << 5,
+        DIRTY_FOOD_STORAGE_QUANTITY = 1 << 6,
+        DIRTY_FOOD_CURRENT_WEIGHT = 1 << 7,
+        DIRTY_LAST_FOOD_STORAGE_UPDATE_TIME = 1 << 8,
+        DIRTY_LAST_FOOD_WEIGHT_UPDATE_TIME = 1 << 9,
+        DIRTY_WEIGHT_TO_LOAD_AT_RESTART = 1 << 10,
+        DIRTY_FEEDER_ID = 1 << 11,
+        DIRTY_FEEDER_PASSWORD = 1 << 12
+    };
+
+    String wifiSSID;
+    String wifiPassword;
+    String foodConfig;
+    uint32_t foodConfigCrc = 0;      // Of the latest schedule JSON, kept even when the JSON did not fit in NVS
+    bool hasLegacyFoodConfig = false;
+    String trapMode;
+    String id;
+    String name;
+    float foodStorageQuantity = 0;
+    float foodCurrentWeight = 0;
+    unsigned long lastFoodStorageUpdateTime = 0;
+    unsigned long lastFoodCurrentWeightUpdateTime = 0;
+    int weightToLoadAtRestart = 0;
+    String feederId;
+    String feederPassword;
+
+    uint16_t dirtyKeys = 0;
+    unsigned long firstDirtyTime = 0;
+
+    WriteStats writeStats;
+    unsigned long lastStatsReportTime = 0;
+
+    uint8_t stationIndex;
+
+    // Station 0 keeps the namespaces of single-station firmware, so an upgrade finds its data
+    String getStationNamespace(const char* nvsNamespace) const
+    {
+        return stationIndex == 0 ? String(nvsNamespace) : String(nvsNamespace) + String(stationIndex);
+    }
 
-    void beginPreferences(bool readOnly)
+    void beginPreferences(bool readOnly, const char* nvsNamespace = NVS_NAMESPACE)
     {
-        preferences.begin(NVS_NAMESPACE, readOnly);
+        preferences.begin(getStationNamespace(nvsNamespace).c_str(), readOnly);
     }
 
     void endPreferences()
@@ -34,90 +122,411 @@ private:
         preferences.end();
     }
 
-public:
-    const String feederId = "feeder_001";
-    const String feederPassword = "parola1234";
+    void lockMemory()
+    {
+        xSemaphoreTake(lock, portMAX_DELAY);
+    }
 
-    MemoryController() = default;
+    void unlockMemory()
+    {
+        xSemaphoreGive(lock);
+    }
 
-    void saveWifiData(const String& ssid, const String& password)
+    void countWrite(const char* key, size_t written, size_t size)
     {
-        Serial.println("MemoryController::Wifi saved");
+        if (written == 0)
+        {
+            // Rejected by NVS, nothing reached flash. The RAM copy now differs from flash until the next write
+            writeStats.failedWrites++;
+            LOG_ERROR(LOG_STORAGE, "NVS write of %s failed (%u bytes)", key, (unsigned int)size);
+            return;
+        }
 
-        beginPreferences(false); // Open NVS in write mode
-        preferences.putString(KEY_WIFI_SSID, ssid);
-        preferences.putString(KEY_WIFI_PASSWORD, password);
+        // Variable-length values take a header entry plus their data entries
+        uint32_t entries = size <= 8 ? 1 : 1 + (size + NVS_ENTRY_SIZE - 1) / NVS_ENTRY_SIZE;
+        writeStats.keysWritten++;
+        writeStats.entriesWritten += entries;
+        writeStats.lifetimeEntriesWritten += entries;
+    }
+
+    // putString() returns the length written, so an empty string would read as a failure
+    void writeString(const char* key, const String& value)
+    {
+        size_t written = preferences.putString(key, value);
+        countWrite(key, value.length() == 0 ? 1 : written, value.length() + 1);
+    }
+
+    void markDirty(uint16_t key, bool changed)
+    {
+        if (!changed)
+        {
+            writeStats.writesCoalesced++;
+            return;
+        }
+
+        if (dirtyKeys == 0)
+        {
+            firstDirtyTime = FeederClock::millis();
+            TaskQueues::wakeNetworking(); // Lets it arm the commit deadline
+        }
+        dirtyKeys |= key;
+    }
+
+    void setString(String& field, const String& value, uint16_t key)
+    {
+        bool changed = field != value;
+        field = value;
+        markDirty(key, changed);
+    }
+
+    template <typename T>
+    void setValue(T& field, T value, uint16_t key)
+    {
+        bool changed = field != value;
+        field = value;
+        markDirty(key, changed);
+    }
+
+    // Caller holds a read session
+    void loadFoodConfig()
+    {
+        size_t length = preferences.getBytesLength(KEY_FOOD_SCHEDULE);
+        if (length > 0)
+        {
+            char* json = new char[length + 1];
+            json[preferences.getBytes(KEY_FOOD_SCHEDULE, json, length) == length ? length : 0] = '\0';
+            foodConfig = json;
+            delete[] json;
+        }
+        else
+        {
+            foodConfig = preferences.getString(KEY_FOOD_CONFIG, "");
+            hasLegacyFoodConfig = foodConfig.length() > 0;
+        }
+
+        foodConfigCrc = preferences.isKey(KEY_FOOD_CONFIG_CRC) ? preferences.getUInt(KEY_FOOD_CONFIG_CRC, 0) : getFoodConfigCrc(foodConfig);
+    }
+
+    // NVS strings are limited to about 4000 bytes and a full schedule takes about 16 KB of JSON, so the
+    // JSON is a blob, which NVS spreads over several pages. Even so it may not fit in a small NVS partition.
+    // The CRC is written first: when the JSON fails, the schedule snapshot built from it still matches
+    // (see FeederController::loadFeedConfigData()). Caller holds a write session
+    void writeFoodConfig()
+    {
+        countWrite(KEY_FOOD_CONFIG_CRC, preferences.putUInt(KEY_FOOD_CONFIG_CRC, foodConfigCrc), sizeof(uint32_t));
+
+        if (hasLegacyFoodConfig)
+        {
+            preferences.remove(KEY_FOOD_CONFIG);
+            hasLegacyFoodConfig = false;
+        }
+
+        if (foodConfig.length() == 0)
+        {
+            if (preferences.isKey(KEY_FOOD_SCHEDULE))
+            {
+                preferences.remove(KEY_FOOD_SCHEDULE); // putBytes() rejects empty values
+            }
+            return;
+        }
+
+        countWrite(KEY_FOOD_SCHEDULE, preferences.putBytes(KEY_FOOD_SCHEDULE, foodConfig.c_str(), foodConfig.length()), foodConfig.length());
+    }
+
+    // Caller holds the lock
+    void loadMirror()
+    {
+        beginPreferences(true); // Open NVS in read-only mode
+        wifiSSID = preferences.getString(KEY_WIFI_SSID, "");
+        wifiPassword = preferences.getString(KEY_WIFI_PASSWORD, "");
+        loadFoodConfig();
+        trapMode = preferences.getString(KEY_TRAP_MODE, "");
+        id = preferences.getString(KEY_ID, "");
+        name = preferences.getString(KEY_NAME, "");
+        foodStorageQuantity = preferences.getFloat(KEY_FOOD_STORAGE_QUANTITY, 0);
+        foodCurrentWeight = preferences.getFloat(KEY_FOOD_CURRENT_WEIGHT, 0);
+        lastFoodStorageUpdateTime = preferences.getULong(KEY_LAST_FOOD_STORAGE_UPDATE_TIME, 0);
+        lastFoodCurrentWeightUpdateTime = preferences.getULong(KEY_LAST_FOOD_WEIGHT_UPDATE_TIME, 0);
+        weightToLoadAtRestart = preferences.getInt(KEY_WEIGHT_TO_LOAD_AT_RESTART, 0);
+        feederId = preferences.getString(KEY_FEEDER_ID, stationIndex == 0 ? LEGACY_FEEDER_ID : "");
+        feederPassword = preferences.getString(KEY_FEEDER_PASSWORD, stationIndex == 0 ? LEGACY_FEEDER_PASSWORD : "");
+
+        uint32_t wear[2] = {0, 0};
+        if (preferences.getBytesLength(KEY_WEAR) == sizeof(wear) && preferences.getBytes(KEY_WEAR, wear, sizeof(wear)) == sizeof(wear))
+        {
+            writeStats.lifetimeEntriesWritten = wear[0];
+            writeStats.lifetimeCommits = wear[1];
+        }
         endPreferences();
     }
 
-    void saveFeederConfiguration(const String& foodConfigurationJson, const String& trapMode, const String& id, const String& name, float foodStorageQuantity, float foodCurrentWeight, unsigned long lastFoodStorageQuantityUpdateTime, unsigned long lastFoodCurrentWeightUpdateTime)
+    // Write the dirty keys in a single NVS session. Caller holds the lock
+    void commitDirtyKeys()
     {
-        Serial.println("MemoryController::food config saved");
+        if (dirtyKeys == 0)
+        {
+            return;
+        }
 
         beginPreferences(false); // Open NVS in write mode
 
-        preferences.putString(KEY_FOOD_CONFIG, foodConfigurationJson);
-        preferences.putString(KEY_TRAP_MODE, trapMode);
-        preferences.putString(KEY_ID, id);
-        preferences.putString(KEY_NAME, name);
-        preferences.putFloat(KEY_FOOD_STORAGE_QUANTITY, foodStorageQuantity);
-        preferences.putFloat(KEY_FOOD_CURRENT_WEIGHT, foodCurrentWeight);
-        preferences.putULong(KEY_LAST_FOOD_STORAGE_UPDATE_TIME, lastFoodStorageQuantityUpdateTime);
-        preferences.putULong(KEY_LAST_FOOD_WEIGHT_UPDATE_TIME, lastFoodCurrentWeightUpdateTime);
+        if (dirtyKeys & DIRTY_WIFI_SSID) writeString(KEY_WIFI_SSID, wifiSSID);
+        if (dirtyKeys & DIRTY_WIFI_PASSWORD) writeString(KEY_WIFI_PASSWORD, wifiPassword);
+        if (dirtyKeys & DIRTY_FOOD_CONFIG) writeFoodConfig();
+        if (dirtyKeys & DIRTY_TRAP_MODE) writeString(KEY_TRAP_MODE, trapMode);
+        if (dirtyKeys & DIRTY_ID) writeString(KEY_ID, id);
+        if (dirtyKeys & DIRTY_NAME) writeString(KEY_NAME, name);
+        if (dirtyKeys & DIRTY_FOOD_STORAGE_QUANTITY) countWrite(KEY_FOOD_STORAGE_QUANTITY, preferences.putFloat(KEY_FOOD_STORAGE_QUANTITY, foodStorageQuantity), sizeof(float));
+        if (dirtyKeys & DIRTY_FOOD_CURRENT_WEIGHT) countWrite(KEY_FOOD_CURRENT_WEIGHT, preferences.putFloat(KEY_FOOD_CURRENT_WEIGHT, foodCurrentWeight), sizeof(float));
+        if (dirtyKeys & DIRTY_LAST_FOOD_STORAGE_UPDATE_TIME) countWrite(KEY_LAST_FOOD_STORAGE_UPDATE_TIME, preferences.putULong(KEY_LAST_FOOD_STORAGE_UPDATE_TIME, lastFoodStorageUpdateTime), sizeof(uint32_t));
+        if (dirtyKeys & DIRTY_LAST_FOOD_WEIGHT_UPDATE_TIME) countWrite(KEY_LAST_FOOD_WEIGHT_UPDATE_TIME, preferences.putULong(KEY_LAST_FOOD_WEIGHT_UPDATE_TIME, lastFoodCurrentWeightUpdateTime), sizeof(uint32_t));
+        if (dirtyKeys & DIRTY_FEEDER_ID) writeString(KEY_FEEDER_ID, feederId);
+        if (dirtyKeys & DIRTY_FEEDER_PASSWORD) writeString(KEY_FEEDER_PASSWORD, feederPassword);
+        if (dirtyKeys & DIRTY_WEIGHT_TO_LOAD_AT_RESTART) countWrite(KEY_WEIGHT_TO_LOAD_AT_RESTART, preferences.putInt(KEY_WEIGHT_TO_LOAD_AT_RESTART, weightToLoadAtRestart), sizeof(int32_t));
+
+        // The lifetime counters ride along with writes that happen anyway
+        writeStats.commits++;
+        writeStats.lifetimeCommits++;
+        uint32_t wear[2] = {writeStats.lifetimeEntriesWritten + 1, writeStats.lifetimeCommits};
+        countWrite(KEY_WEAR, preferences.putBytes(KEY_WEAR, wear, sizeof(wear)), sizeof(wear));
 
         endPreferences();
+        dirtyKeys = 0;
+    }
+
+public:
+    explicit MemoryController(const StationProfile& profile) : stationIndex(profile.index)
+    {
+        lock = xSemaphoreCreateMutex();
+
+        lockMemory();
+        loadMirror();
+        unlockMemory();
+    }
+
+    // Commit the batched changes once they are COMMIT_DELAY old. Called from the networking task
+    void loop()
+    {
+        lockMemory();
+        if (dirtyKeys != 0 && FeederClock::millis() - firstDirtyTime >= COMMIT_DELAY)
+        {
+            commitDirtyKeys();
+        }
+
+        if (FeederClock::millis() - lastStatsReportTime >= STATS_REPORT_INTERVAL)
+        {
+            lastStatsReportTime = FeederClock::millis();
+            LOG_INFO(LOG_STORAGE, "MemoryController stats: commits=%u keysWritten=%u entriesWritten=%u writesCoalesced=%u failedWrites=%u lifetimeEntriesWritten=%u lifetimeCommits=%u",
+                          writeStats.commits, writeStats.keysWritten, writeStats.entriesWritten, writeStats.writesCoalesced, writeStats.failedWrites, writeStats.lifetimeEntriesWritten, writeStats.lifetimeCommits);
+        }
+        unlockMemory();
+    }
+
+    // Time until loop() has to commit or report
+    unsigned long getMillisUntilDue()
+    {
+        lockMemory();
+        unsigned long now = FeederClock::millis();
+        unsigned long untilDue = STATS_REPORT_INTERVAL - (now - lastStatsReportTime);
+        if (now - lastStatsReportTime >= STATS_REPORT_INTERVAL)
+        {
+            untilDue = 0;
+        }
+
+        if (dirtyKeys != 0)
+        {
+            unsigned long untilCommit = now - firstDirtyTime < COMMIT_DELAY ? COMMIT_DELAY - (now - firstDirtyTime) : 0;
+            untilDue = untilCommit < untilDue ? untilCommit : untilDue;
+        }
+        unlockMemory();
+
+        return untilDue;
+    }
+
+    // Write the pending changes now, e.g. before a restart
+    void commit()
+    {
+        lockMemory();
+        commitDirtyKeys();
+        unlockMemory();
+    }
+
+    WriteStats getWriteStats()
+    {
+        lockMemory();
+        WriteStats stats = writeStats;
+        unlockMemory();
+        return stats;
+    }
+
+    void saveWifiData(const String& ssid, const String& password)
+    {
+        LOG_INFO(LOG_STORAGE, "MemoryController::Wifi saved");
+
+        lockMemory();
+        setString(wifiSSID, ssid, DIRTY_WIFI_SSID);
+        setString(wifiPassword, password, DIRTY_WIFI_PASSWORD);
+        commitDirtyKeys(); // The caller restarts right after
+        unlockMemory();
+    }
+
+    // Backend identity of the station, set from the configuration portal
+    void saveFeederIdentity(const String& id, const String& password)
+    {
+        LOG_INFO(LOG_STORAGE, "MemoryController::feeder identity saved");
+
+        lockMemory();
+        setString(feederId, id, DIRTY_FEEDER_ID);
+        setString(feederPassword, password, DIRTY_FEEDER_PASSWORD);
+        commitDirtyKeys(); // The caller restarts right after
+        unlockMemory();
+    }
+
+    // Empty until the portal sets one, except on station 0 (see LEGACY_FEEDER_ID). Read once at boot
+    String getFeederId()
+    {
+        lockMemory();
+        String value = feederId;
+        unlockMemory();
+        return value;
+    }
+
+    String getFeederPassword()
+    {
+        lockMemory();
+        String value = feederPassword;
+        unlockMemory();
+        return value;
+    }
+
+    // Called on every connect. Only the values that changed are written, with the next batched commit
+    void saveFeederConfiguration(const String& foodConfigurationJson, const String& trapModeToSave, const String& idToSave, const String& nameToSave, float foodStorageQuantityToSave, float foodCurrentWeightToSave, unsigned long lastFoodStorageQuantityUpdateTime, unsigned long lastFoodCurrentWeightUpdateTimeToSave)
+    {
+        lockMemory();
+        uint16_t dirtyBefore = dirtyKeys;
+
+        setString(foodConfig, foodConfigurationJson, DIRTY_FOOD_CONFIG);
+        foodConfigCrc = getFoodConfigCrc(foodConfig);
+        setString(trapMode, trapModeToSave, DIRTY_TRAP_MODE);
+        setString(id, idToSave, DIRTY_ID);
+        setString(name, nameToSave, DIRTY_NAME);
+        setValue(foodStorageQuantity, foodStorageQuantityToSave, DIRTY_FOOD_STORAGE_QUANTITY);
+        setValue(foodCurrentWeight, foodCurrentWeightToSave, DIRTY_FOOD_CURRENT_WEIGHT);
+        setValue(lastFoodStorageUpdateTime, lastFoodStorageQuantityUpdateTime, DIRTY_LAST_FOOD_STORAGE_UPDATE_TIME);
+        setValue(lastFoodCurrentWeightUpdateTime, lastFoodCurrentWeightUpdateTimeToSave, DIRTY_LAST_FOOD_WEIGHT_UPDATE_TIME);
+
+        uint16_t changedKeys = dirtyKeys & ~dirtyBefore;
+        unlockMemory();
+
+        if (changedKeys == 0)
+        {
+            LOG_DEBUG(LOG_STORAGE, "MemoryController::food config unchanged");
+            return;
+        }
+
+        LOG_INFO(LOG_STORAGE, "MemoryController::food config saved");
 
         // Log the saved values for debugging
-        Serial.println("Configuration saved to memory:");
-        Serial.println("Food Config JSON: " + foodConfigurationJson);
-        Serial.println("Trap Mode: " + trapMode);
-        Serial.println("ID: " + id);
-        Serial.println("Name: " + name);
-        Serial.println("Food Storage Quantity: " + String(foodStorageQuantity));
-        Serial.println("Food Current Weight: " + String(foodCurrentWeight));
-        Serial.println("Last Food Storage Update Time: " + String(lastFoodStorageQuantityUpdateTime));
-        Serial.println("Last Food Current Weight Update Time: " + String(lastFoodCurrentWeightUpdateTime));
+        LOG_DEBUG(LOG_STORAGE, "Configuration saved to memory:");
+        LOG_DEBUG(LOG_STORAGE, "Food Config JSON: %s", foodConfigurationJson);
+        LOG_DEBUG(LOG_STORAGE, "Trap Mode: %s", trapModeToSave);
+        LOG_DEBUG(LOG_STORAGE, "ID: %s", idToSave);
+        LOG_DEBUG(LOG_STORAGE, "Name: %s", nameToSave);
+        LOG_DEBUG(LOG_STORAGE, "Food Storage Quantity: %.2f", foodStorageQuantityToSave);
+        LOG_DEBUG(LOG_STORAGE, "Food Current Weight: %.2f", foodCurrentWeightToSave);
+        LOG_DEBUG(LOG_STORAGE, "Last Food Storage Update Time: %lu", lastFoodStorageQuantityUpdateTime);
+        LOG_DEBUG(LOG_STORAGE, "Last Food Current Weight Update Time: %lu", lastFoodCurrentWeightUpdateTimeToSave);
     }
 
     void setWeightToLoadAtRestart(int weight)
     {
-        beginPreferences(false); // Open in read-write mode
-        preferences.putInt(KEY_WEIGHT_TO_LOAD_AT_RESTART, weight);
-        endPreferences();
+        lockMemory();
+        setValue(weightToLoadAtRestart, weight, DIRTY_WEIGHT_TO_LOAD_AT_RESTART);
+        commitDirtyKeys(); // The caller restarts right after
+        unlockMemory();
     }
 
+    // Returns the saved weight once. It is cleared in the mirror, so flash is only written when it was set
     int getWeightToLoadAtRestart()
     {
-        beginPreferences(false); // Open in read-write mode
-        int weight = preferences.getInt(KEY_WEIGHT_TO_LOAD_AT_RESTART, 0);
-        preferences.putInt(KEY_WEIGHT_TO_LOAD_AT_RESTART, 0);
-        endPreferences();
+        lockMemory();
+        int weight = weightToLoadAtRestart;
+        setValue(weightToLoadAtRestart, 0, DIRTY_WEIGHT_TO_LOAD_AT_RESTART);
+        unlockMemory();
         return weight;
     }
 
     String getFeederWifiSSID()
     {
-        beginPreferences(true); // Open NVS in read-only mode
-        String ssid = preferences.getString(KEY_WIFI_SSID, "");
-        endPreferences();
+        lockMemory();
+        String ssid = wifiSSID;
+        unlockMemory();
         return ssid;
     }
 
     String getFeederWiFiPassword()
     {
-        beginPreferences(true); // Open NVS in read-only mode
-        String password = preferences.getString(KEY_WIFI_PASSWORD, "");
-        endPreferences();
+        lockMemory();
+        String password = wifiPassword;
+        unlockMemory();
         return password;
     }
 
-    String getFoodConfigJson()
+    // Binary records kept outside of the feeder namespace (e.g. the uplink outbox). Written right away,
+    // their owners already decide when a write is needed. Returns false when NVS rejected the write
+    bool saveBlob(const char* nvsNamespace, const char* key, const void* data, size_t size)
     {
-        beginPreferences(true); // Open NVS in read-only mode
-        String feedConfig = preferences.getString(KEY_FOOD_CONFIG, "");
+        lockMemory();
+        beginPreferences(false, nvsNamespace); // Open NVS in write mode
+        size_t written = preferences.putBytes(key, data, size);
+        countWrite(key, written, size);
+        endPreferences();
+        unlockMemory();
+        return written == size;
+    }
+
+    // Erase every key of a blob namespace
+    void clearBlobs(const char* nvsNamespace)
+    {
+        lockMemory();
+        beginPreferences(false, nvsNamespace);
+        preferences.clear();
+        endPreferences();
+        unlockMemory();
+    }
+
+    // Returns false when the key is missing or was saved with a different size
+    bool loadBlob(const char* nvsNamespace, const char* key, void* data, size_t size)
+    {
+        lockMemory();
+        beginPreferences(true, nvsNamespace); // Open NVS in read-only mode
+        bool found = preferences.getBytesLength(key) == size && preferences.getBytes(key, data, size) == size;
         endPreferences();
+        unlockMemory();
+        return found;
+    }
+
+    static uint32_t getFoodConfigCrc(const String& foodConfigJson)
+    {
+        return esp_rom_crc32_le(0, reinterpret_cast<const uint8_t*>(foodConfigJson.c_str()), foodConfigJson.length());
+    }
+
+    // CRC of the latest schedule JSON, which may be newer than the JSON read back from NVS
+    uint32_t getFoodConfigCrc()
+    {
+        lockMemory();
+        uint32_t crc = foodConfigCrc;
+        unlockMemory();
+        return crc;
+    }
+
+    String getFoodConfigJson()
+    {
+        lockMemory();
+        String feedConfig = foodConfig;
+        unlockMemory();
         return feedConfig;
     }
 };
 
-#endif // MEMORY_CONTROLLER_H
\ No newline at end of file
+#endif // MEMORY_CONTROLLER_H
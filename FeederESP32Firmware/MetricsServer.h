@@ -0,0 +1,229 @@
+#ifndef METRICS_SERVER_H
+#define METRICS_SERVER_H
+
+#include <WiFi.h>
+#include <ESPAsyncWebServer.h>
+#include "FeederHal.h"
+#include "FeederMetrics.h"
+#include "FeederStation.h"
+#include "PowerManager.h"
+#include "WebConnectionController.h"
+#include "FeederLog.h"
+
+// Diagnostics on the home network, for scraping the fleet:
+//  /metrics  stage histograms and counters, in the Prometheus text format
+//  /log      the records still in the log ring
+// Served on its own port, so it never clashes with the configuration portal on port 80. Counters of
+// one station carry a station label; the stage histograms cover all the stations
+class MetricsServer
+{
+private:
+    static constexpr uint16_t PORT = 9100;
+
+    AsyncWebServer* server = nullptr;
+    const FeederStation* stations;
+    int numOfStations;
+    WebConnectionController* webConnection;
+    PowerManager* powerManager;
+
+    static void printMetricHeader(Print& out, const char* name, const char* type, const char* help)
+    {
+        out.printf("# HELP %s %s\n# TYPE %s %s\n", name, help, name, type);
+    }
+
+    static void printStageHistograms(Print& out)
+    {
+        printMetricHeader(out, "feeder_stage_duration_seconds", "histogram", "Run time of one pass of a task stage");
+        for (int stage = 0; stage < FeederMetrics::NUM_OF_STAGES; stage++)
+        {
+            FeederMetrics::Histogram histogram = FeederMetrics::getHistogram((FeederMetrics::Stage)stage);
+            const char* name = FeederMetrics::STAGES[stage].name;
+            uint32_t cumulativeCount = 0;
+
+            for (int bucket = 0; bucket < FeederMetrics::NUM_OF_BUCKETS; bucket++)
+            {
+                cumulativeCount += histogram.counts[bucket];
+                out.printf("feeder_stage_duration_seconds_bucket{stage=\"%s\",le=\"%.6f\"} %u\n", name, FeederMetrics::BUCKET_LIMITS[bucket] / 1000000.0, cumulativeCount);
+            }
+            out.printf("feeder_stage_duration_seconds_bucket{stage=\"%s\",le=\"+Inf\"} %u\n", name, histogram.count);
+            out.printf("feeder_stage_duration_seconds_sum{stage=\"%s\"} %.6f\n", name, histogram.sumMicros / 1000000.0);
+            out.printf("feeder_stage_duration_seconds_count{stage=\"%s\"} %u\n", name, histogram.count);
+        }
+
+        printMetricHeader(out, "feeder_stage_max_duration_seconds", "gauge", "Longest pass of a task stage since boot");
+        for (int stage = 0; stage < FeederMetrics::NUM_OF_STAGES; stage++)
+        {
+            out.printf("feeder_stage_max_duration_seconds{stage=\"%s\"} %.6f\n", FeederMetrics::STAGES[stage].name, FeederMetrics::getHistogram((FeederMetrics::Stage)stage).maxMicros / 1000000.0);
+        }
+
+        printMetricHeader(out, "feeder_stage_stalls_total", "counter", "Passes longer than the stall budget of their stage");
+        for (int stage = 0; stage < FeederMetrics::NUM_OF_STAGES; stage++)
+        {
+            out.printf("feeder_stage_stalls_total{stage=\"%s\"} %u\n", FeederMetrics::STAGES[stage].name, FeederMetrics::getHistogram((FeederMetrics::Stage)stage).stalls);
+        }
+    }
+
+    // Per endpoint, for sizing the backend: request rate, latency quantiles and bytes per feeder
+    static void printEndpointMetrics(Print& out, const BackendConnection::Stats& httpStats)
+    {
+        printMetricHeader(out, "feeder_http_endpoint_requests_total", "counter", "Backend requests sent, per endpoint");
+        for (int endpoint = 0; endpoint < BackendConnection::NUM_OF_ENDPOINTS; endpoint++)
+        {
+            out.printf("feeder_http_endpoint_requests_total{endpoint=\"%s\"} %u\n", BackendConnection::ENDPOINT_NAMES[endpoint], httpStats.endpoints[endpoint].requests);
+        }
+
+        printMetricHeader(out, "feeder_http_endpoint_failures_total", "counter", "Backend requests without an HTTP response, per endpoint");
+        for (int endpoint = 0; endpoint < BackendConnection::NUM_OF_ENDPOINTS; endpoint++)
+        {
+            out.printf("feeder_http_endpoint_failures_total{endpoint=\"%s\"} %u\n", BackendConnection::ENDPOINT_NAMES[endpoint], httpStats.endpoints[endpoint].failures);
+        }
+
+        printMetricHeader(out, "feeder_http_endpoint_sent_bytes_total", "counter", "URL and body bytes sent, per endpoint");
+        for (int endpoint = 0; endpoint < BackendConnection::NUM_OF_ENDPOINTS; endpoint++)
+        {
+            out.printf("feeder_http_endpoint_sent_bytes_total{endpoint=\"%s\"} %u\n", BackendConnection::ENDPOINT_NAMES[endpoint], httpStats.endpoints[endpoint].bytesSent);
+        }
+
+        printMetricHeader(out, "feeder_http_endpoint_received_bytes_total", "counter", "Response body bytes received, per endpoint");
+        for (int endpoint = 0; endpoint < BackendConnection::NUM_OF_ENDPOINTS; endpoint++)
+        {
+            out.printf("feeder_http_endpoint_received_bytes_total{endpoint=\"%s\"} %u\n", BackendConnection::ENDPOINT_NAMES[endpoint], httpStats.endpoints[endpoint].bytesReceived);
+        }
+
+        printMetricHeader(out, "feeder_http_request_duration_seconds", "histogram", "Backend request latency, including reconnects");
+        for (int endpoint = 0; endpoint < BackendConnection::NUM_OF_ENDPOINTS; endpoint++)
+        {
+            const BackendConnection::EndpointStats& endpointStats = httpStats.endpoints[endpoint];
+            const char* name = BackendConnection::ENDPOINT_NAMES[endpoint];
+            uint32_t cumulativeCount = 0;
+
+            for (int bucket = 0; bucket < FeederMetrics::NUM_OF_BUCKETS; bucket++)
+            {
+                cumulativeCount += endpointStats.latencyCounts[bucket];
+                out.printf("feeder_http_request_duration_seconds_bucket{endpoint=\"%s\",le=\"%.6f\"} %u\n", name, FeederMetrics::BUCKET_LIMITS[bucket] / 1000000.0, cumulativeCount);
+            }
+            out.printf("feeder_http_request_duration_seconds_bucket{endpoint=\"%s\",le=\"+Inf\"} %u\n", name, endpointStats.requests);
+            out.printf("feeder_http_request_duration_seconds_sum{endpoint=\"%s\"} %.6f\n", name, endpointStats.latencySumMicros / 1000000.0);
+            out.printf("feeder_http_request_duration_seconds_count{endpoint=\"%s\"} %u\n", name, endpointStats.requests);
+        }
+    }
+
+    static void printMetric(Print& out, const char* name, const char* type, const char* help, uint32_t value)
+    {
+        printMetricHeader(out, name, type, help);
+        out.printf("%s %u\n", name, value);
+    }
+
+    void handleMetrics(AsyncWebServerRequest* request)
+    {
+        AsyncResponseStream* response = request->beginResponseStream("text/plain; version=0.0.4");
+        printMetrics(*response);
+        request->send(response);
+    }
+
+    void handleLog(AsyncWebServerRequest* request)
+    {
+        AsyncResponseStream* response = request->beginResponseStream("text/plain");
+        FeederLog::dump(*response);
+        request->send(response);
+    }
+
+public:
+    MetricsServer(const FeederStation* feederStations, int numOfFeederStations, WebConnectionController* webConn, PowerManager* powerMgr) : stations(feederStations), numOfStations(numOfFeederStations), webConnection(webConn), powerManager(powerMgr)
+    {
+    }
+
+    // Start serving once the station is connected. Called by the networking task; the server
+    // stays up across reconnects
+    void loop()
+    {
+        if (server != nullptr || WiFi.status() != WL_CONNECTED)
+        {
+            return;
+        }
+
+        server = new AsyncWebServer(PORT);
+        server->on("/metrics", HTTP_GET, [this](AsyncWebServerRequest* request) {
+            handleMetrics(request);
+        });
+        server->on("/log", HTTP_GET, [this](AsyncWebServerRequest* request) {
+            handleLog(request);
+        });
+        server->begin();
+
+        LOG_INFO(LOG_NETWORK, "MetricsServer: listening on %s:%u", WiFi.localIP().toString(), (unsigned)PORT);
+    }
+
+    void printMetrics(Print& out)
+    {
+        printStageHistograms(out);
+
+        // Counters owned by the controllers. Plain reads of 32-bit values, written by other tasks
+        const BackendConnection::Stats& httpStats = webConnection->getBackendConnectionStats();
+        printMetric(out, "feeder_http_requests_total", "counter", "Backend requests sent", httpStats.requests);
+        printMetric(out, "feeder_http_failures_total", "counter", "Backend requests without an HTTP response", httpStats.failures);
+        printMetric(out, "feeder_http_connects_total", "counter", "TLS handshakes with the backend", httpStats.connects);
+        printEndpointMetrics(out, httpStats);
+
+        printMetricHeader(out, "feeder_nvs_commits_total", "counter", "NVS sessions that wrote at least one key");
+        for (int station = 0; station < numOfStations; station++)
+        {
+            out.printf("feeder_nvs_commits_total{station=\"%d\"} %u\n", station, stations[station].memoryController->getWriteStats().commits);
+        }
+
+        printMetricHeader(out, "feeder_nvs_entries_written_total", "counter", "32-byte NVS entries written");
+        for (int station = 0; station < numOfStations; station++)
+        {
+            out.printf("feeder_nvs_entries_written_total{station=\"%d\"} %u\n", station, stations[station].memoryController->getWriteStats().entriesWritten);
+        }
+
+        printMetricHeader(out, "feeder_nvs_write_failures_total", "counter", "NVS writes rejected, e.g. for lack of space");
+        for (int station = 0; station < numOfStations; station++)
+        {
+            out.printf("feeder_nvs_write_failures_total{station=\"%d\"} %u\n", station, stations[station].memoryController->getWriteStats().failedWrites);
+        }
+
+        printMetricHeader(out, "feeder_rfid_decision_seconds", "gauge", "Time from the tag frame to the gate request, last decision");
+        for (int station = 0; station < numOfStations; station++)
+        {
+            out.printf("feeder_rfid_decision_seconds{station=\"%d\"} %.6f\n", station, stations[station].rfidController->getLastDecisionMicros() / 1000000.0);
+        }
+
+        printMetricHeader(out, "feeder_rfid_decision_max_seconds", "gauge", "Longest time from the tag frame to the gate request since boot");
+        for (int station = 0; station < numOfStations; station++)
+        {
+            out.printf("feeder_rfid_decision_max_seconds{station=\"%d\"} %.6f\n", station, stations[station].rfidController->getMaxDecisionMicros() / 1000000.0);
+        }
+
+        printMetricHeader(out, "feeder_outbox_pending_events", "gauge", "Events stored in the outbox and not yet acknowledged by the backend");
+        for (int station = 0; station < numOfStations; station++)
+        {
+            out.printf("feeder_outbox_pending_events{station=\"%d\"} %d\n", station, stations[station].uplinkOutbox->getPendingCount());
+        }
+
+        printMetricHeader(out, "feeder_motor_on_seconds_total", "counter", "Time the dispenser motor ran");
+        for (int station = 0; station < numOfStations; station++)
+        {
+            out.printf("feeder_motor_on_seconds_total{station=\"%d\"} %.3f\n", station, stations[station].motorController->getTotalOnMillis() / 1000.0);
+        }
+
+        // Estimated from the time spent in each power state, see PowerManager
+        printMetricHeader(out, "feeder_charge_milliamp_hours_total", "counter", "Estimated charge drawn since boot");
+        out.printf("feeder_charge_milliamp_hours_total %.1f\n", powerManager->getTotalMilliampHours());
+        if (powerManager->getLastHourAverageMilliamps() >= 0)
+        {
+            printMetricHeader(out, "feeder_current_milliamps", "gauge", "Estimated average current over the last hour");
+            out.printf("feeder_current_milliamps %.1f\n", powerManager->getLastHourAverageMilliamps());
+        }
+        printMetric(out, "feeder_power_mode", "gauge", "0: full power, 1: frequency scaling, 2: light sleep", (uint32_t)powerManager->getMode());
+
+        printMetric(out, "feeder_log_records_total", "counter", "Log records written to the ring", FeederLog::getNumOfWritten());
+        printMetric(out, "feeder_log_records_lost_total", "counter", "Log records overwritten before they were drained", FeederLog::getNumOfLost());
+
+        printMetric(out, "feeder_free_heap_bytes", "gauge", "Free heap", ESP.getFreeHeap());
+        printMetric(out, "feeder_free_heap_min_bytes", "gauge", "Lowest free heap since boot", ESP.getMinFreeHeap());
+        printMetric(out, "feeder_uptime_seconds", "gauge", "Time since boot", (uint32_t)(FeederClock::micros() / 1000000LL));
+    }
+};
+
+#endif // METRICS_SERVER_H
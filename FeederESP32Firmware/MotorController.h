@@ -0,0 +1,64 @@
+#ifndef MOTOR_CONTROLLER_H
+#define MOTOR_CONTROLLER_H
+
+#include <Arduino.h>
+#include "FeederHal.h"
+#include "StationProfile.h"
+#include "FeederLog.h"
+
+// Drives the relay of the DC motor that dispenses the food. Only the actuation task touches it;
+// FeederController requests start/stop through TaskQueues::actuatorCommands
+class MotorController
+{
+private:
+    int relayPin;
+    OutputPins* pins = nullptr;
+    bool motorRunning = false;
+    unsigned long motorStartTime = 0;
+    uint32_t totalOnMillis = 0; // Completed runs since boot
+
+public:
+    MotorController(const StationProfile& profile, OutputPins* outputPins) : relayPin(profile.motorRelayPin), pins(outputPins)
+    {
+        LOG_DEBUG(LOG_SYSTEM, "MotorController Constructor");
+
+        // The relay is active LOW, so keep it released until a dispense starts
+        pins->configure(relayPin);
+        pins->write(relayPin, true);
+    }
+
+    void start()
+    {
+        // Activate the relay to start feeding
+        pins->write(relayPin, false);
+        if (!motorRunning)
+        {
+            motorStartTime = FeederClock::millis();
+        }
+        motorRunning = true;
+    }
+
+    void stop()
+    {
+        // Deactivate the relay to stop feeding
+        pins->write(relayPin, true);
+        if (motorRunning)
+        {
+            totalOnMillis += FeederClock::millis() - motorStartTime;
+        }
+        motorRunning = false;
+    }
+
+    bool isRunning() const
+    {
+        return motorRunning;
+    }
+
+    // Time the relay was on since boot, including the current run
+    uint32_t getTotalOnMillis() const
+    {
+        return totalOnMillis + (motorRunning ? FeederClock::millis() - motorStartTime : 0);
+    }
+};
+
+#endif // MOTOR_CONTROLLER_H
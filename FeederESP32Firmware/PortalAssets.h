@@ -0,0 +1,130 @@
+#ifndef PORTAL_ASSETS_H
+#define PORTAL_ASSETS_H
+
+#include <Arduino.h>
+
+// Configuration portal page, gzip-compressed and served from flash as is.
+// Generated from portal/index.html (6930 bytes) with:
+//   gzip -9 -n -c portal/index.html | xxd -i
+static const uint8_t PORTAL_INDEX_HTML_GZ[] PROGMEM = {
+    0x1f, 0x8b, 0x08, 0x00, 0x00, 0x00, 0x00, 0x00, 0x02, 0x03, 0xed, 0x59, 0x6d, 0x6f, 0xdb, 0x36,
+    0x10, 0xfe, 0x9e, 0x5f, 0xc1, 0xaa, 0x1b, 0xec, 0x60, 0xb6, 0xec, 0x34, 0x71, 0x5f, 0x1c, 0x3b,
+    0x43, 0x5f, 0x52, 0xac, 0xc0, 0xb6, 0x06, 0x48, 0x80, 0x62, 0x18, 0x06, 0x94, 0x16, 0x69, 0x8b,
+    0x8b, 0x44, 0x6a, 0x24, 0x15, 0xc7, 0x6b, 0xf3, 0xdf, 0x77, 0x24, 0x25, 0x59, 0x96, 0x68, 0x3b,
+    0x59, 0x8b, 0xee, 0xcb, 0xdc, 0x16, 0x96, 0xc8, 0xd3, 0xf1, 0xf8, 0x3c, 0x77, 0x0f, 0x4f, 0xee,
+    0xe4, 0xd1, 0x9b, 0xf7, 0xaf, 0xaf, 0x7e, 0xbb, 0x38, 0x47, 0xb1, 0x4e, 0x93, 0xb3, 0x83, 0x49,
+    0xf9, 0x45, 0x31, 0x39, 0x3b, 0x40, 0xf0, 0x99, 0xa4, 0x54, 0x63, 0x14, 0xc5, 0x58, 0x2a, 0xaa,
+    0xa7, 0x41, 0xae, 0xe7, 0xfd, 0xe7, 0x41, 0x7d, 0x8a, 0xe3, 0x94, 0x4e, 0x83, 0x1b, 0x46, 0x97,
+    0x99, 0x90, 0x3a, 0x40, 0x91, 0xe0, 0x9a, 0x72, 0x30, 0x5d, 0x32, 0xa2, 0xe3, 0x29, 0xa1, 0x37,
+    0x2c, 0xa2, 0x7d, 0x7b, 0xd3, 0x43, 0x8c, 0x33, 0xcd, 0x70, 0xd2, 0x57, 0x11, 0x4e, 0xe8, 0xf4,
+    0xa8, 0x74, 0xa4, 0x99, 0x4e, 0xe8, 0xd9, 0x5b, 0x4a, 0x09, 0x95, 0xe8, 0x03, 0xeb, 0xbf, 0x65,
+    0x93, 0x81, 0x1b, 0x73, 0xf3, 0x4a, 0xaf, 0xca, 0x6b, 0xf3, 0x99, 0x09, 0xb2, 0x42, 0x9f, 0xaa,
+    0x5b, 0xf3, 0x99, 0xc3, 0xaa, 0xfd, 0x39, 0x4e, 0x59, 0xb2, 0x1a, 0xa3, 0x97, 0x12, 0xd6, 0xe8,
+    0x21, 0x85, 0xb9, 0xea, 0x2b, 0x2a, 0xd9, 0xfc, 0x74, 0xc3, 0x36, 0xc5, 0x72, 0xc1, 0xf8, 0x18,
+    0x0d, 0x37, 0x87, 0x33, 0x4c, 0x08, 0xe3, 0x8b, 0xd6, 0x38, 0x61, 0x2a, 0x4b, 0x30, 0xb8, 0x9d,
+    0x27, 0xf4, 0x76, 0x73, 0xca, 0x8c, 0xf4, 0x09, 0x93, 0x34, 0xd2, 0x4c, 0x80, 0xc7, 0x48, 0x24,
+    0x79, 0xca, 0x37, 0x6d, 0x70, 0xc2, 0x16, 0xbc, 0xcf, 0x34, 0x4d, 0x15, 0x18, 0x00, 0x32, 0x54,
+    0x6e, 0x1a, 0xfc, 0x99, 0x2b, 0xcd, 0xe6, 0xab, 0x7e, 0x01, 0x9c, 0xdf, 0x28, 0x65, 0xbc, 0x1f,
+    0x53, 0xb6, 0x88, 0x61, 0xfe, 0x68, 0x38, 0xbc, 0x89, 0x37, 0xa7, 0x67, 0x38, 0xba, 0x5e, 0x48,
+    0x91, 0x73, 0x02, 0x6e, 0x12, 0x21, 0xc7, 0xe8, 0xf1, 0xfc, 0x04, 0xfe, 0xbc, 0xd8, 0x34, 0x2b,
+    0xe7, 0x8e, 0x8f, 0x8f, 0xd7, 0x13, 0x77, 0xd5, 0x55, 0xfc, 0xa4, 0x81, 0xaa, 0x43, 0xaa, 0x3f,
+    0x13, 0x5a, 0x8b, 0x74, 0x8c, 0x9e, 0x0c, 0xb3, 0x5b, 0xbf, 0xc3, 0xd1, 0x68, 0xe4, 0x73, 0x38,
+    0xcb, 0xe1, 0x41, 0x6e, 0x68, 0xcf, 0x72, 0xfd, 0xbb, 0x5e, 0x65, 0x90, 0x29, 0x2a, 0x9f, 0xa5,
+    0x4c, 0x07, 0x7f, 0x34, 0x96, 0xf2, 0xec, 0xe0, 0xe4, 0xf5, 0xcb, 0xb7, 0xa3, 0xa1, 0x77, 0xc1,
+    0x65, 0x0c, 0x80, 0x36, 0x20, 0x10, 0x12, 0xb2, 0x67, 0x8c, 0xb8, 0xe0, 0x74, 0x0b, 0xb1, 0x47,
+    0x10, 0xbf, 0x67, 0x13, 0x9a, 0xde, 0xea, 0xbe, 0xa5, 0xc9, 0x8f, 0xbd, 0x9d, 0x27, 0x34, 0x12,
+    0x12, 0x3b, 0x9a, 0xdb, 0x4b, 0x54, 0x39, 0xc2, 0x78, 0xc2, 0x38, 0xed, 0xcf, 0x12, 0x11, 0x5d,
+    0x9f, 0xb6, 0x33, 0x54, 0xb1, 0xbf, 0x29, 0xc4, 0xf1, 0xb4, 0x19, 0x42, 0x99, 0x92, 0x36, 0xc2,
+    0x51, 0x0b, 0xe5, 0x5c, 0x2a, 0xb3, 0xeb, 0x4c, 0xb0, 0x76, 0x74, 0x6e, 0xdf, 0x7d, 0x89, 0x09,
+    0xcb, 0x21, 0xc3, 0x5a, 0x0f, 0x6b, 0x09, 0x65, 0xc0, 0x5c, 0xe0, 0x4d, 0x90, 0xd1, 0x30, 0x3c,
+    0x56, 0x88, 0x62, 0x45, 0xb7, 0xb3, 0x37, 0x8e, 0xc5, 0x0d, 0x95, 0x7e, 0x0e, 0xdd, 0xdc, 0x3d,
+    0x98, 0x1c, 0xe1, 0xe1, 0xc9, 0x0b, 0xdf, 0x1a, 0x09, 0x9e, 0xd1, 0xa4, 0xe1, 0xa0, 0x02, 0xd3,
+    0x83, 0x62, 0x91, 0x91, 0x5a, 0x64, 0x0e, 0xac, 0xd3, 0x5d, 0xf9, 0xda, 0xc2, 0xc2, 0x72, 0xb0,
+    0x2c, 0xca, 0x68, 0x26, 0x12, 0xe2, 0x0b, 0xc9, 0x6e, 0x14, 0xd4, 0x83, 0x26, 0x50, 0xd6, 0x8d,
+    0xd0, 0xac, 0x8c, 0xd9, 0x0a, 0xfc, 0xbe, 0xb9, 0xf2, 0x6d, 0xbf, 0x98, 0x3c, 0x1e, 0xb6, 0xe2,
+    0xaa, 0x32, 0xf0, 0xf9, 0x9e, 0x88, 0x8f, 0x5a, 0x21, 0x97, 0x69, 0x7d, 0x04, 0x89, 0xa1, 0x44,
+    0xc2, 0x08, 0x7a, 0x1c, 0x45, 0xd1, 0xce, 0x14, 0x38, 0x69, 0xfb, 0xb8, 0x35, 0x99, 0x67, 0x23,
+    0x28, 0x6c, 0x61, 0xc8, 0xb7, 0xf7, 0xc7, 0x4a, 0x63, 0x9d, 0xab, 0x1e, 0xc8, 0x87, 0x15, 0xe3,
+    0x4b, 0x7b, 0xeb, 0x57, 0x85, 0x2d, 0x1c, 0xb8, 0x3c, 0x37, 0x82, 0x0d, 0xd5, 0xa0, 0xa1, 0xac,
+    0x22, 0xbf, 0x64, 0x90, 0x17, 0xa3, 0xe3, 0x93, 0xb9, 0x3f, 0x88, 0x08, 0x73, 0xef, 0xca, 0xf5,
+    0x1a, 0x3a, 0xde, 0xa6, 0x45, 0xcf, 0x9e, 0x3d, 0xf3, 0x79, 0x0d, 0x8d, 0xbe, 0x62, 0x28, 0x4e,
+    0xd9, 0xda, 0x4e, 0x45, 0xdd, 0xc9, 0x0e, 0xea, 0xda, 0xba, 0xb1, 0x4e, 0xf4, 0x9d, 0x82, 0x54,
+    0x63, 0x8e, 0x10, 0xb2, 0x93, 0xb9, 0xe7, 0x5e, 0xe6, 0x62, 0x4c, 0xc4, 0x12, 0x8e, 0x25, 0x43,
+    0xac, 0x31, 0x41, 0x72, 0x31, 0xc3, 0xdd, 0x61, 0x0f, 0x15, 0x7f, 0xc3, 0xa3, 0xc3, 0xfb, 0x0b,
+    0x9a, 0x03, 0x64, 0x32, 0x28, 0x8e, 0xd4, 0xc9, 0xc0, 0x1d, 0xf5, 0x13, 0x73, 0xa6, 0x16, 0xa7,
+    0x2d, 0x61, 0x37, 0x28, 0x4a, 0xb0, 0x52, 0xd3, 0xa0, 0xc2, 0x2c, 0x58, 0x9f, 0xbe, 0x93, 0xf8,
+    0xc9, 0x99, 0x3d, 0xa3, 0xd1, 0x6b, 0xc1, 0xe7, 0x6c, 0x91, 0x3b, 0x59, 0x04, 0x4f, 0x4f, 0x6a,
+    0x46, 0x4e, 0x3c, 0x90, 0xe0, 0x11, 0x64, 0xc0, 0x35, 0x48, 0x06, 0x70, 0xda, 0x3d, 0x0c, 0xce,
+    0x2e, 0xe1, 0x1b, 0xfd, 0x4a, 0xf5, 0x52, 0xc8, 0x6b, 0x35, 0x19, 0x38, 0xb3, 0xda, 0x73, 0x19,
+    0x62, 0xc4, 0x59, 0xbb, 0x0c, 0x08, 0xce, 0x26, 0x83, 0xac, 0x36, 0x5f, 0x94, 0xa5, 0x35, 0x52,
+    0x8c, 0x04, 0x48, 0xd2, 0xbf, 0x72, 0x38, 0x81, 0x09, 0xd8, 0xb9, 0xb9, 0x9a, 0xb1, 0x53, 0x97,
+    0xb9, 0x90, 0xd3, 0x20, 0x83, 0xfd, 0xc0, 0x9a, 0x24, 0x38, 0xbb, 0x28, 0xae, 0xc6, 0x93, 0x81,
+    0x9d, 0xaf, 0xd9, 0xdb, 0xd2, 0xb7, 0xbe, 0x2b, 0x73, 0xe4, 0x14, 0x6f, 0x7d, 0x0f, 0xd2, 0x14,
+    0xd1, 0x18, 0xb4, 0x83, 0x82, 0xd7, 0x73, 0x03, 0x2e, 0x5a, 0x89, 0xbc, 0x68, 0x5b, 0xd0, 0xda,
+    0xae, 0x8a, 0xab, 0xe9, 0x7e, 0x43, 0x42, 0xd1, 0x0d, 0x4e, 0x72, 0xb8, 0xbd, 0xc4, 0x37, 0xb4,
+    0x70, 0xf1, 0x92, 0x10, 0x49, 0x95, 0x0a, 0x6a, 0xd8, 0xc1, 0xe4, 0x07, 0x36, 0x67, 0x06, 0xbf,
+    0x16, 0x52, 0x4d, 0x94, 0x26, 0x03, 0xe0, 0xef, 0xfe, 0x4c, 0x16, 0x4d, 0xd7, 0x3b, 0x02, 0x79,
+    0xc2, 0xf4, 0xaa, 0xc1, 0x62, 0x0d, 0x40, 0xb3, 0x10, 0xd0, 0x0c, 0x0c, 0xba, 0x8b, 0x9d, 0xf0,
+    0x95, 0xc6, 0xc5, 0x66, 0x79, 0x9e, 0xce, 0x60, 0x65, 0xd3, 0xc5, 0x4c, 0x83, 0x61, 0xb5, 0xe9,
+    0xa1, 0x17, 0xa5, 0xda, 0x9a, 0x4e, 0x84, 0xde, 0x01, 0x69, 0x65, 0x98, 0x6f, 0x76, 0x2e, 0x5b,
+    0xd9, 0x17, 0xeb, 0x9a, 0x42, 0x08, 0x4c, 0x81, 0x27, 0x94, 0x2f, 0xa0, 0x19, 0x0d, 0x9e, 0x9e,
+    0x78, 0x09, 0xd4, 0x31, 0x45, 0xf3, 0x72, 0x85, 0xfb, 0x05, 0x75, 0xf1, 0xb0, 0x7c, 0x6a, 0x3c,
+    0xd4, 0xca, 0xaa, 0x07, 0xc5, 0xf8, 0x45, 0x49, 0xd6, 0x20, 0xbc, 0x91, 0x66, 0x6e, 0xd6, 0x97,
+    0x68, 0xf5, 0x03, 0x61, 0x4b, 0xba, 0xa9, 0x48, 0xb2, 0xac, 0x56, 0x7f, 0x83, 0x01, 0xba, 0x5a,
+    0x47, 0x6d, 0x6a, 0x5a, 0xc1, 0x6a, 0xd4, 0xbc, 0x4d, 0x70, 0x0e, 0x70, 0x62, 0x8d, 0x30, 0xd2,
+    0x2c, 0xa5, 0x08, 0x73, 0x02, 0xff, 0xd4, 0x92, 0x4a, 0x85, 0xa4, 0x39, 0x9e, 0x11, 0x5e, 0xe2,
+    0x15, 0x1c, 0xb7, 0x3a, 0x06, 0x69, 0x05, 0x3b, 0xa6, 0x51, 0x8c, 0x15, 0x1c, 0xca, 0x94, 0x83,
+    0x98, 0xa2, 0x39, 0x96, 0xbd, 0xfa, 0x32, 0x30, 0x74, 0x4d, 0x69, 0x86, 0xb0, 0xba, 0x06, 0xb1,
+    0x36, 0x6a, 0x9c, 0x50, 0x8b, 0x98, 0x59, 0x14, 0xc9, 0x9c, 0xab, 0xca, 0x7a, 0x9e, 0x73, 0xdb,
+    0xad, 0x23, 0xa7, 0x48, 0xcd, 0x13, 0x86, 0xea, 0x28, 0xee, 0x76, 0x06, 0x66, 0xb2, 0x73, 0xb8,
+    0x31, 0x15, 0x82, 0x3f, 0xde, 0x85, 0xd2, 0xcc, 0x04, 0x57, 0x14, 0x4d, 0xcf, 0x50, 0x79, 0x1d,
+    0xfe, 0xa9, 0x04, 0xb8, 0xf2, 0x99, 0x13, 0x0c, 0xaf, 0x48, 0x60, 0xba, 0xb9, 0x8a, 0xed, 0x7c,
+    0xa8, 0x46, 0x44, 0x8a, 0x0c, 0xb4, 0x9d, 0xa3, 0x29, 0x22, 0x22, 0xca, 0x53, 0xa0, 0x24, 0x5c,
+    0x50, 0x7d, 0x9e, 0x50, 0x73, 0xf9, 0x6a, 0xf5, 0x8e, 0x74, 0x3b, 0x46, 0xe5, 0x3a, 0x0d, 0x81,
+    0x2f, 0x9f, 0x77, 0x82, 0x47, 0x89, 0x79, 0xbe, 0x70, 0x15, 0x5a, 0xae, 0xdb, 0xe6, 0xd5, 0x3c,
+    0x03, 0xe8, 0xe5, 0x4f, 0x57, 0xbf, 0xfc, 0x0c, 0x0f, 0x75, 0x3a, 0x1e, 0x43, 0x88, 0x38, 0xe4,
+    0x85, 0x40, 0x87, 0xd0, 0x77, 0xea, 0x6e, 0x17, 0xf7, 0xd0, 0xec, 0xd0, 0x6c, 0x63, 0x16, 0x4a,
+    0x88, 0x07, 0xf5, 0x11, 0xb6, 0x17, 0x87, 0xfb, 0x1e, 0x87, 0x82, 0x39, 0xc7, 0x00, 0x28, 0x0c,
+    0xf8, 0x51, 0x28, 0x77, 0x22, 0x32, 0xcb, 0x49, 0x0d, 0x87, 0x48, 0x52, 0xac, 0x69, 0x01, 0x45,
+    0xb7, 0xe3, 0x0c, 0x7c, 0x40, 0x98, 0x8f, 0x9b, 0x75, 0x7b, 0x07, 0x27, 0xb0, 0x5c, 0x68, 0x70,
+    0xdb, 0x69, 0x6c, 0xc4, 0xa1, 0x66, 0x8b, 0x7e, 0x40, 0x1d, 0xd4, 0xed, 0xc0, 0x97, 0x19, 0xb1,
+    0xdb, 0x34, 0x23, 0xe4, 0x55, 0x6a, 0xc6, 0xba, 0xd6, 0x8c, 0x42, 0x27, 0x4e, 0xd1, 0x8f, 0x80,
+    0x1b, 0x1a, 0xa3, 0x4e, 0x0f, 0x3c, 0x51, 0x08, 0xc9, 0xd8, 0xf5, 0x50, 0xf9, 0x24, 0x5e, 0x50,
+    0x33, 0xa0, 0x10, 0x5e, 0x88, 0xc3, 0xce, 0xce, 0x08, 0x6a, 0xf4, 0x55, 0x51, 0x4c, 0xa7, 0xd3,
+    0x8a, 0x56, 0xff, 0xc3, 0x15, 0x93, 0xd0, 0x99, 0x74, 0x9d, 0x27, 0x0f, 0x2a, 0x77, 0x30, 0xd6,
+    0x26, 0x67, 0x6b, 0x92, 0x55, 0xe7, 0x6d, 0xe7, 0xd0, 0x65, 0xc8, 0x95, 0x43, 0xc7, 0xd2, 0x69,
+    0x66, 0xb9, 0xa9, 0x2b, 0xd8, 0xf9, 0x65, 0x71, 0x1d, 0x86, 0xa1, 0x01, 0x61, 0x93, 0x6e, 0x27,
+    0x61, 0x16, 0xb7, 0x72, 0xcc, 0x83, 0x00, 0x9b, 0xa3, 0xee, 0x86, 0xdf, 0xc3, 0x2d, 0x89, 0xa1,
+    0xa8, 0xbe, 0x02, 0x75, 0x10, 0xb9, 0xee, 0x1a, 0xd3, 0x9e, 0xe9, 0xbb, 0x87, 0xbe, 0xbd, 0x1e,
+    0x34, 0x77, 0xbe, 0x9e, 0xa9, 0xab, 0x04, 0xf4, 0x2b, 0xdc, 0x34, 0x0f, 0x5a, 0xac, 0x2b, 0xa7,
+    0x88, 0xd3, 0x23, 0x0f, 0xd5, 0xa1, 0xdb, 0x88, 0xce, 0x16, 0x9e, 0xa5, 0x6a, 0x5f, 0xd1, 0xba,
+    0x7c, 0x0c, 0xb5, 0x64, 0x69, 0xb7, 0x11, 0xb6, 0x71, 0x52, 0xca, 0xf8, 0x2e, 0x47, 0xa5, 0x4d,
+    0xcb, 0xd9, 0x41, 0x13, 0xd1, 0x47, 0x36, 0xa6, 0xcf, 0x9f, 0xd1, 0xa3, 0xf2, 0x19, 0x1f, 0xac,
+    0xdb, 0x23, 0xf6, 0xb1, 0x1f, 0x5c, 0x24, 0xe6, 0xe5, 0x10, 0x65, 0x52, 0xdc, 0x30, 0x42, 0xa1,
+    0x1d, 0x05, 0x76, 0x2f, 0x2f, 0xdf, 0xbd, 0xb1, 0x82, 0x5d, 0xae, 0x13, 0x06, 0x6d, 0x4a, 0x24,
+    0xd5, 0xb9, 0x6c, 0xfc, 0x12, 0x72, 0x77, 0xd0, 0x82, 0x00, 0xf4, 0x21, 0x7d, 0x63, 0x25, 0x12,
+    0x88, 0x58, 0xa2, 0xb7, 0xc5, 0x6d, 0x13, 0xad, 0xd2, 0x2c, 0xc4, 0x19, 0x54, 0x5c, 0x89, 0x6f,
+    0xcf, 0xd2, 0xb0, 0xcf, 0xb4, 0x42, 0xb0, 0x57, 0x05, 0xdc, 0x84, 0xaf, 0x12, 0x7d, 0xa0, 0xfc,
+    0xa5, 0x6d, 0xbe, 0xc0, 0xb8, 0x8d, 0x5d, 0x4a, 0x75, 0x2c, 0xa0, 0xd7, 0xef, 0x5c, 0xbc, 0xbf,
+    0xbc, 0xea, 0xf4, 0x5a, 0xf3, 0xa6, 0x85, 0x1e, 0x57, 0x01, 0x34, 0x72, 0x72, 0xcf, 0x51, 0xf2,
+    0xc9, 0x5b, 0x25, 0x8f, 0xaa, 0x13, 0x46, 0x5c, 0x6f, 0x2b, 0x12, 0x1d, 0x4b, 0xb1, 0xb4, 0xe8,
+    0x9d, 0x4b, 0x29, 0x64, 0xf7, 0xa3, 0xfd, 0x1a, 0xa3, 0xef, 0x3e, 0x55, 0x0f, 0x3b, 0x6e, 0xef,
+    0x3e, 0xee, 0x2d, 0x9d, 0x35, 0x73, 0xeb, 0xb3, 0xcd, 0xc8, 0x64, 0x93, 0x8f, 0xbb, 0x87, 0x1d,
+    0x75, 0x0f, 0x4b, 0x3a, 0xe3, 0xe7, 0xf4, 0x5f, 0xf8, 0xb0, 0x6f, 0x34, 0xa1, 0xfb, 0x5d, 0x03,
+    0x8e, 0xb6, 0xc7, 0xa3, 0x68, 0xf6, 0x7c, 0x14, 0x75, 0x76, 0x47, 0x1e, 0x61, 0x43, 0x3d, 0x35,
+    0x90, 0x7d, 0x8d, 0xd8, 0xad, 0xa3, 0x30, 0x85, 0x0c, 0x82, 0x63, 0xe0, 0xf4, 0x9e, 0xb2, 0x74,
+    0x09, 0x85, 0x60, 0x7a, 0x95, 0x46, 0x59, 0x41, 0x6f, 0x54, 0xb4, 0xd1, 0x28, 0x11, 0x0b, 0x85,
+    0x18, 0x37, 0xc2, 0x65, 0x0c, 0xcd, 0x8b, 0x27, 0xe4, 0xb6, 0x6d, 0x8f, 0xfc, 0xc2, 0x55, 0xb6,
+    0x71, 0x3e, 0xe9, 0x2a, 0x7c, 0x4e, 0x77, 0x6f, 0xcd, 0x1e, 0xb6, 0x7b, 0x04, 0x6c, 0xb7, 0x06,
+    0x96, 0xcd, 0xf8, 0x57, 0xd1, 0xc1, 0xcd, 0xfe, 0xf9, 0x3e, 0x6a, 0x58, 0x6c, 0xd3, 0x08, 0xe2,
+    0x97, 0xe8, 0x62, 0xbd, 0xed, 0xdd, 0xa3, 0x8e, 0xb6, 0xdf, 0x74, 0xcb, 0xf6, 0xaa, 0x36, 0xfb,
+    0xbf, 0x97, 0xca, 0x82, 0xcc, 0x5e, 0x19, 0xdb, 0xbe, 0x07, 0xac, 0xb2, 0x7e, 0x75, 0x5d, 0x75,
+    0x78, 0xfc, 0xaf, 0xab, 0xdf, 0x44, 0x57, 0x77, 0x24, 0xed, 0x03, 0xd5, 0xb5, 0xe1, 0xe9, 0x1b,
+    0x6b, 0xec, 0x8e, 0x7d, 0x3c, 0x5c, 0x69, 0xdd, 0xfb, 0xde, 0x69, 0xf9, 0xfb, 0x57, 0xf1, 0xae,
+    0x3a, 0x19, 0xb8, 0x5f, 0xbe, 0x26, 0x03, 0xf7, 0x5f, 0x5f, 0xff, 0x00, 0x2d, 0x6e, 0x79, 0x67,
+    0x12, 0x1b, 0x00, 0x00,
+};
+
+static const size_t PORTAL_INDEX_HTML_GZ_LENGTH = sizeof(PORTAL_INDEX_HTML_GZ);
+
+#endif // PORTAL_ASSETS_H
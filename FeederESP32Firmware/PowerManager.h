@@ -0,0 +1,247 @@
+#ifndef POWER_MANAGER_H
+#define POWER_MANAGER_H
+
+#include <Arduino.h>
+#include <WiFi.h>
+#include <esp_pm.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include "FeederHal.h"
+#include "FeederMetrics.h"
+#include "FeederStation.h"
+#include "FeederLog.h"
+
+// Frequency scaling, Wi-Fi modem sleep and automatic light sleep between events. The chip sleeps
+// whenever every task is blocked (see the Tasks section of the README), and wakes on:
+//  - the RDM6300 line: GPIO wake on the RX pin, see UartTagReaderPort
+//  - the HX711 data-ready: the sampler wakes on its timeout, then waits awake for DOUT, see Hx711ScaleDriver
+//  - the next scheduled feeding: an esp_timer armed from FeedConfigData, which ends a light sleep like every timer
+//  - the network: DTIM beacons carry the command channel traffic, and the task timeouts its keep-alive
+// There is no current sensor, so the draw is estimated from the time spent in each state and nominal currents
+class PowerManager
+{
+public:
+    enum class Mode : uint8_t
+    {
+        FULL_POWER,        // 240 MHz, radio always listening
+        FREQUENCY_SCALING, // The core was built without tickless idle: no light sleep
+        LIGHT_SLEEP
+    };
+
+private:
+    static constexpr int MAX_CPU_FREQ_MHZ = 240;
+    static constexpr int MIN_CPU_FREQ_MHZ = 80; // Keeps the APB at 80 MHz, so the UART baud rates never shift
+    static constexpr unsigned long REPORT_INTERVAL = 3600000; // ms
+    static constexpr unsigned long ACCOUNT_INTERVAL = 1800000; // Shorter than the wrap of the task run time counters (ms)
+
+    // Nominal currents at the 5 V input (mA), from the datasheets. Calibrate them against a meter
+    // before sizing a battery
+    static constexpr float PERIPHERALS_MA = 52.0f;    // RDM6300 (always reading) and HX711 of one station
+    static constexpr float CPU_ACTIVE_MA = 40.0f;     // Added while a core runs a task other than idle
+    static constexpr float RADIO_OFF_MA = 45.0f;      // Before the Wi-Fi stack starts, at full clock
+    static constexpr float RADIO_LISTEN_MA = 100.0f;  // Connecting, or connected without modem sleep
+    static constexpr float RADIO_AP_MA = 120.0f;      // Configuration portal
+    static constexpr float MODEM_SLEEP_MA = 25.0f;    // Connected, DTIM modem sleep at the minimum clock
+    static constexpr float LIGHT_SLEEP_MA = 4.0f;     // Connected, light sleep between beacons
+    static constexpr float STEPPER_MA = 240.0f;       // 28BYJ-48 with two coils energized
+    static constexpr float MOTOR_RELAY_MA = 70.0f;    // Relay coil, the dispenser motor has its own supply
+
+    const FeederStation* stations;
+    int numOfStations;
+    Mode mode = Mode::FULL_POWER;
+
+    unsigned long lastAccountTime = 0;
+    uint64_t lastActiveMicros = 0;
+
+#if configGENERATE_RUN_TIME_STATS && configUSE_TRACE_FACILITY
+    static constexpr int MAX_TASKS = 40;
+    TaskStatus_t taskStatus[MAX_TASKS];
+    uint32_t lastTotalRunTime = 0;
+    uint32_t lastIdleRunTime = 0;
+    bool hasRunTime = false;
+    uint64_t cpuActiveMicros = 0;
+#endif
+    uint32_t lastGateMillis = 0;
+    uint32_t lastMotorMillis = 0;
+
+    unsigned long reportStartTime = 0;
+    float reportCharge = 0;         // mAh since reportStartTime
+    float totalCharge = 0;          // mAh since boot
+    float lastHourAverage = -1.0f;  // mA, -1 until the first hour passed
+
+    // Draw of the chip and its radio while no task runs
+    float getIdleMilliamps()
+    {
+        wifi_mode_t wifiMode = WiFi.getMode();
+
+        if ((wifiMode & WIFI_AP) != 0)
+        {
+            return RADIO_AP_MA; // No modem sleep with the soft-AP up
+        }
+        if (wifiMode == WIFI_OFF)
+        {
+            return RADIO_OFF_MA;
+        }
+        if (WiFi.status() != WL_CONNECTED || mode == Mode::FULL_POWER)
+        {
+            return RADIO_LISTEN_MA;
+        }
+
+        return mode == Mode::LIGHT_SLEEP ? LIGHT_SLEEP_MA : MODEM_SLEEP_MA;
+    }
+
+    // CPU time of both cores, in us: the time their idle tasks did not run. The idle task keeps running through
+    // light sleep, and the run time counters follow esp_timer, so neither the sleeps nor the frequency switches
+    // skew it. They are 32-bit and wrap after 71 minutes, so the sum of the two cores is read every 30 minutes.
+    // A core built without run time stats falls back to the run time of the task stages
+    uint64_t getCpuActiveMicros()
+    {
+#if configGENERATE_RUN_TIME_STATS && configUSE_TRACE_FACILITY
+        configRUN_TIME_COUNTER_TYPE totalRunTime = 0;
+        UBaseType_t numOfTasks = uxTaskGetSystemState(taskStatus, MAX_TASKS, &totalRunTime);
+        if (numOfTasks == 0)
+        {
+            return cpuActiveMicros; // More tasks than MAX_TASKS
+        }
+
+        uint32_t idleRunTime = 0;
+        for (UBaseType_t i = 0; i < numOfTasks; i++)
+        {
+            if (strncmp(taskStatus[i].pcTaskName, "IDLE", 4) == 0)
+            {
+                idleRunTime += (uint32_t)taskStatus[i].ulRunTimeCounter;
+            }
+        }
+
+        if (hasRunTime)
+        {
+            uint64_t coreMicros = (uint64_t)((uint32_t)totalRunTime - lastTotalRunTime) * portNUM_PROCESSORS;
+            uint32_t idleMicros = idleRunTime - lastIdleRunTime;
+            cpuActiveMicros += coreMicros > idleMicros ? coreMicros - idleMicros : 0;
+        }
+
+        hasRunTime = true;
+        lastTotalRunTime = (uint32_t)totalRunTime;
+        lastIdleRunTime = idleRunTime;
+        return cpuActiveMicros;
+#else
+        return FeederMetrics::getTotalMicros();
+#endif
+    }
+
+    // Add the charge drawn since the last call. The radio state is sampled, which is exact as long as
+    // a Wi-Fi event runs the caller; the actuators and the CPU report their own on-time
+    void account()
+    {
+        unsigned long now = FeederClock::millis();
+        unsigned long elapsed = now - lastAccountTime;
+
+        uint64_t activeMicros = getCpuActiveMicros();
+        uint32_t gateMillis = 0;
+        uint32_t motorMillis = 0;
+        for (int station = 0; station < numOfStations; station++)
+        {
+            gateMillis += stations[station].gateController->getTotalMovingMillis();
+            motorMillis += stations[station].motorController->getTotalOnMillis();
+        }
+
+        float chargeMilliampMillis = (PERIPHERALS_MA * numOfStations + getIdleMilliamps()) * elapsed
+            + CPU_ACTIVE_MA * ((activeMicros - lastActiveMicros) / 1000.0f)
+            + STEPPER_MA * (gateMillis - lastGateMillis)
+            + MOTOR_RELAY_MA * (motorMillis - lastMotorMillis);
+
+        reportCharge += chargeMilliampMillis / 3600000.0f;
+        totalCharge += chargeMilliampMillis / 3600000.0f;
+
+        lastAccountTime = now;
+        lastActiveMicros = activeMicros;
+        lastGateMillis = gateMillis;
+        lastMotorMillis = motorMillis;
+    }
+
+public:
+    PowerManager(const FeederStation* feederStations, int numOfFeederStations) : stations(feederStations), numOfStations(numOfFeederStations)
+    {
+        lastAccountTime = FeederClock::millis();
+        reportStartTime = lastAccountTime;
+        lastActiveMicros = getCpuActiveMicros();
+    }
+
+    // Call before the Wi-Fi stack starts. Without power save the radio listens all the time, as before.
+    // Light sleep needs a core built with tickless idle; otherwise only the clock and the modem are scaled
+    void begin(bool powerSave)
+    {
+        if (!powerSave)
+        {
+            WiFi.setSleep(false);
+            return;
+        }
+
+        esp_pm_config_esp32_t config = {};
+        config.max_freq_mhz = MAX_CPU_FREQ_MHZ;
+        config.min_freq_mhz = MIN_CPU_FREQ_MHZ;
+        config.light_sleep_enable = true;
+
+        esp_err_t result = esp_pm_configure(&config);
+        if (result != ESP_OK)
+        {
+            config.light_sleep_enable = false;
+            result = esp_pm_configure(&config);
+        }
+
+        if (result != ESP_OK)
+        {
+            LOG_WARN(LOG_SYSTEM, "PowerManager: power management not supported by this core (%d), running at full power", result);
+            WiFi.setSleep(false);
+            return;
+        }
+
+        mode = config.light_sleep_enable ? Mode::LIGHT_SLEEP : Mode::FREQUENCY_SCALING;
+        WiFi.setSleep(WIFI_PS_MIN_MODEM); // Applied when the station starts
+        LOG_INFO(LOG_SYSTEM, "PowerManager: %d-%d MHz, modem sleep, light sleep %s", (int)MIN_CPU_FREQ_MHZ, (int)MAX_CPU_FREQ_MHZ, mode == Mode::LIGHT_SLEEP ? "on" : "unavailable");
+    }
+
+    // Account the charge and log the average of every hour. Called from the networking task
+    void loop()
+    {
+        account();
+
+        unsigned long elapsed = lastAccountTime - reportStartTime;
+        if (elapsed < REPORT_INTERVAL)
+        {
+            return;
+        }
+
+        lastHourAverage = reportCharge * 3600000.0f / elapsed;
+        LOG_INFO(LOG_SYSTEM, "PowerManager: %.1f mA average over the last hour (estimate), %.0f mAh since boot", lastHourAverage, totalCharge);
+
+        reportCharge = 0;
+        reportStartTime = lastAccountTime;
+    }
+
+    // Time until the next hourly report, or the next reading of the run time counters
+    unsigned long getMillisUntilDue() const
+    {
+        unsigned long now = FeederClock::millis();
+        unsigned long untilReport = now - reportStartTime < REPORT_INTERVAL ? REPORT_INTERVAL - (now - reportStartTime) : 0;
+        unsigned long untilAccount = now - lastAccountTime < ACCOUNT_INTERVAL ? ACCOUNT_INTERVAL - (now - lastAccountTime) : 0;
+        return untilReport < untilAccount ? untilReport : untilAccount;
+    }
+
+    Mode getMode() const
+    {
+        return mode;
+    }
+
+    float getLastHourAverageMilliamps() const
+    {
+        return lastHourAverage;
+    }
+
+    float getTotalMilliampHours() const
+    {
+        return totalCharge;
+    }
+};
+
+#endif // POWER_MANAGER_H
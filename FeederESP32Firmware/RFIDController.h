@@ -2,24 +2,44 @@
 #define RFID_CONTROLLER_H
 
 #include <Arduino.h>
-#include <rdm6300.h>
-#include "GateController.h"
+#include "FeederHal.h"
+#include "MemoryController.h"
+#include "StationProfile.h"
+#include "TagRegistry.h"
+#include "TaskQueues.h"
+#include "DeadlineQueue.h"
+#include "FeederMetrics.h"
+#include "FeederLog.h"
 
 class RFIDController
 {
 private:
 
-    struct RFIDPins
-    {
-        // Pin definitions for the RFID reader
-        static constexpr byte RX_PIN = 4; // RX pin for receiving data from the RDM6300
-    };
+    // RDM6300 frame: 0x02, 10 hex chars of data (version + 32-bit tag ID), 2 hex chars of checksum, 0x03.
+    // The reader repeats it every ~65 ms while a tag is in range. Its RX pin and UART come from the station profile
+    static constexpr unsigned long RDM6300_BAUDRATE = 9600;
+    static constexpr int FRAME_SIZE = 14;
+    static constexpr uint8_t FRAME_BEGIN = 0x02;
+    static constexpr uint8_t FRAME_END = 0x03;
+
+    // An unregistered tag closes the gate only when seen on consecutive frames, so a single
+    // misread never shuts the gate on a registered pet that is eating
+    static constexpr int UNREGISTERED_TAG_CONFIRM_FRAMES = 2;
+    static constexpr unsigned long UNREGISTERED_TAG_CONFIRM_WINDOW = 300; // ms
+
+    // The gate stays open this long after the last frame of a registered tag
+    static constexpr unsigned long REGISTERED_TAG_TIMEOUT = 10000; // ms
+    // Retry delay of a gate request that did not fit in the actuator queue
+    static constexpr unsigned long GATE_REQUEST_RETRY = 100; // ms
 
-    // Registered RFID tags (For each feeder we have the posibility to register two tags)
-    String registeredTag1;
-    String registeredTag2;
+    uint8_t station;
+    TagReaderPort* rfidSerial = nullptr;
 
-    GateController* gateController = nullptr;
+    // Frame decoder state, only touched by the UART receive callback
+    uint8_t frame[FRAME_SIZE];
+    int frameLength = 0;
+
+    TagRegistry registry;
 
     // Timestamp to track the last time a registered tag was read
     unsigned long lastTagReadTime = 0;
@@ -27,77 +47,215 @@ private:
     // Flag to track if a registered tag was read
     bool registeredTagWasRead = false;
 
-    Rdm6300 rdm6300;
+    // Unregistered tag waiting for confirmation
+    uint32_t unconfirmedTagId = 0;
+    int unconfirmedTagFrames = 0;
+    unsigned long unconfirmedTagTime = 0;
 
-public:
+    // Last tag logged, so a tag kept in range is logged once
+    uint32_t lastLoggedTagId = 0;
 
-    RFIDController(GateController* gate_controller) : gateController(gate_controller)
-    {
-        Serial.println("RFIDController Constructor...");
+    // Last gate request sent to the actuation task, so a request is only posted when it changes
+    bool gateOpenRequested = false;
+    bool gateRequestSent = false;
 
-        // Initialize the RDM6300 reader
-        rdm6300.begin(RFIDPins::RX_PIN);
+    // Time from the last byte of a frame to the gate request it caused (us)
+    uint32_t lastDecisionMicros = 0;
+    uint32_t maxDecisionMicros = 0;
 
-        // Set default registered tags
-        setRegisteredTag1("7E3FE9");
-        setRegisteredTag2("1ECADE");
+    static int hexValue(uint8_t c)
+    {
+        if (c >= '0' && c <= '9') return c - '0';
+        if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+        if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+        return -1;
     }
 
-    // Read an RFID tag (if any exists within its detection range)
-    String readTag()
+    // Validate the checksum and extract the tag ID. The checksum is the XOR of the 5 data bytes
+    static bool decodeFrame(const uint8_t* frameBytes, uint32_t& tagId)
     {
-        if (rdm6300.get_tag_id())
+        if (frameBytes[FRAME_SIZE - 1] != FRAME_END)
+        {
+            return false;
+        }
+
+        uint8_t bytes[6];
+        for (int i = 0; i < 6; i++)
         {
-            String tagHex = String(rdm6300.get_tag_id(), HEX);
-            tagHex.toUpperCase();
-            return tagHex;
+            int high = hexValue(frameBytes[1 + i * 2]);
+            int low = hexValue(frameBytes[2 + i * 2]);
+            if (high < 0 || low < 0)
+            {
+                return false;
+            }
+            bytes[i] = (high << 4) | low;
+        }
+
+        if ((bytes[0] ^ bytes[1] ^ bytes[2] ^ bytes[3] ^ bytes[4]) != bytes[5])
+        {
+            return false;
         }
-        return "";
+
+        tagId = ((uint32_t)bytes[1] << 24) | ((uint32_t)bytes[2] << 16) | ((uint32_t)bytes[3] << 8) | bytes[4];
+        return tagId != 0;
     }
 
-    void loop()
+    // Runs in the UART driver's event task as soon as the receive interrupt reports data
+    void onUartReceive()
     {
-        const String& tagHex = readTag();
-
-        if (!tagHex.isEmpty())
+        while (rfidSerial->available() > 0)
         {
-            if (tagHex.equals(registeredTag1) || tagHex.equals(registeredTag2))
+            uint8_t byteRead = rfidSerial->read();
+
+            // A begin byte always restarts the frame, so the decoder resyncs after a lost byte
+            if (byteRead == FRAME_BEGIN)
             {
-                lastTagReadTime = millis(); // Update the last read time for the registered tag
-                registeredTagWasRead = true;
+                frameLength = 0;
             }
-            else
+            else if (frameLength == 0)
             {
-                lastTagReadTime = 0; // Invalidate the timer for unregistered tags
-                registeredTagWasRead = false;
+                continue;
+            }
+
+            frame[frameLength++] = byteRead;
+            if (frameLength < FRAME_SIZE)
+            {
+                continue;
+            }
+            frameLength = 0;
+
+            uint32_t tagId;
+            if (decodeFrame(frame, tagId))
+            {
+                TaskQueues::postTagRead(station, tagId, (uint32_t)FeederClock::micros());
             }
         }
+    }
+
+    void handleTagRead(const TagRead& read)
+    {
+        bool isRegistered = registry.contains(read.tagId);
 
-        // Control the gate based on whether a registered tag is present
-        if (isRegisteredTagPresent())
+        if (read.tagId != lastLoggedTagId)
         {
-            gateController->open();
+            lastLoggedTagId = read.tagId;
+            LOG_INFO(LOG_RFID, "RFIDController: tag %X %s", read.tagId, isRegistered ? "registered" : "not registered");
+        }
+
+        if (isRegistered)
+        {
+            lastTagReadTime = FeederClock::millis(); // Update the last read time for the registered tag
+            registeredTagWasRead = true;
+            unconfirmedTagFrames = 0;
+            return;
+        }
+
+        if (read.tagId == unconfirmedTagId && FeederClock::millis() - unconfirmedTagTime <= UNREGISTERED_TAG_CONFIRM_WINDOW)
+        {
+            unconfirmedTagFrames++;
         }
         else
         {
-            gateController->close();
+            unconfirmedTagId = read.tagId;
+            unconfirmedTagFrames = 1;
+        }
+        unconfirmedTagTime = FeederClock::millis();
+
+        if (unconfirmedTagFrames >= UNREGISTERED_TAG_CONFIRM_FRAMES)
+        {
+            invalidateRegisteredTag(); // Invalidate the timer for unregistered tags
+        }
+    }
+
+public:
+
+    RFIDController(const StationProfile& profile, MemoryController* memoryController, TagReaderPort* tagReaderPort) : station(profile.index), rfidSerial(tagReaderPort)
+    {
+        LOG_DEBUG(LOG_RFID, "RFIDController Constructor...");
+
+        reloadRegisteredTags(memoryController);
+
+        // Initialize the RDM6300 UART (receive only). Frames are decoded from the receive callback
+        // instead of being polled, so a tag is seen as soon as its frame ends
+        rfidSerial->begin(RDM6300_BAUDRATE, profile.rfidRxPin, [this]() { onUartReceive(); });
+    }
+
+    // Load the tags synced from the backend, or the two default tags on a feeder that was never synced
+    void reloadRegisteredTags(MemoryController* memoryController)
+    {
+        if (!registry.load(memoryController) && registry.size() == 0)
+        {
+            const uint32_t defaultTags[] = {TagRegistry::parseTagId("7E3FE9"), TagRegistry::parseTagId("1ECADE")};
+            registry.setTags(defaultTags, 2);
         }
+
+        LOG_INFO(LOG_RFID, "RFIDController: %d registered tags", registry.size());
     }
 
-    void setRegisteredTag1(const String& tag)
+    // Wait for tag reads, then update the gate request. The wait returns as soon as a frame is decoded,
+    // and otherwise only when the registered tag times out, so an idle feeder never wakes this task
+    void loop()
     {
-        registeredTag1 = tag;
+        TagRead read;
+        bool hasRead = xQueueReceive(TaskQueues::tagReads[station], &read, getWaitTicks()) == pdTRUE;
+        uint32_t oldestReadMicros = hasRead ? read.receivedMicros : 0;
+
+        uint32_t beginMicros = FeederMetrics::begin();
+
+        if (hasRead)
+        {
+            do
+            {
+                handleTagRead(read);
+            } while (xQueueReceive(TaskQueues::tagReads[station], &read, 0) == pdTRUE);
+        }
+
+        // Control the gate based on whether a registered tag is present. The actuation task keeps
+        // applying the last request, so it only has to be sent when it changes
+        bool shouldOpen = isRegisteredTagPresent();
+        if (!gateRequestSent || shouldOpen != gateOpenRequested)
+        {
+            gateRequestSent = TaskQueues::sendActuatorCommand(station, shouldOpen ? ActuatorCommand::OPEN_GATE : ActuatorCommand::CLOSE_GATE);
+            gateOpenRequested = shouldOpen;
+
+            if (hasRead)
+            {
+                lastDecisionMicros = (uint32_t)FeederClock::micros() - oldestReadMicros;
+                maxDecisionMicros = lastDecisionMicros > maxDecisionMicros ? lastDecisionMicros : maxDecisionMicros;
+                LOG_INFO(LOG_RFID, "RFIDController: gate %s requested %uus after the tag frame (max %uus)", shouldOpen ? "open" : "close", lastDecisionMicros, maxDecisionMicros);
+            }
+        }
+
+        FeederMetrics::end(FeederMetrics::STAGE_RFID, beginMicros);
     }
 
-    void setRegisteredTag2(const String& tag)
+    // Block time of the next tag wait: until the registered tag expires and the gate has to close
+    TickType_t getWaitTicks()
     {
-        registeredTag2 = tag;
+        if (!gateRequestSent)
+        {
+            return DeadlineQueue::toTicks(GATE_REQUEST_RETRY);
+        }
+
+        if (!gateOpenRequested)
+        {
+            return portMAX_DELAY;
+        }
+
+        // One clock read: the tag may expire while this runs, and the remaining time must not wrap
+        unsigned long elapsed = registeredTagWasRead ? FeederClock::millis() - lastTagReadTime : REGISTERED_TAG_TIMEOUT + 1;
+        if (elapsed > REGISTERED_TAG_TIMEOUT)
+        {
+            return 0; // Expired since the last decision, close the gate right away
+        }
+
+        return DeadlineQueue::toTicks(REGISTERED_TAG_TIMEOUT - elapsed + 1);
     }
 
     // Check if a registered tag was read within the last `tagTimeout` milliseconds
-    bool isRegisteredTagPresent(int tagTimeout = 10000) // Default timeout: 10 seconds
+    bool isRegisteredTagPresent(unsigned long tagTimeout = REGISTERED_TAG_TIMEOUT)
     {
-        return registeredTagWasRead && (millis() - lastTagReadTime) <= tagTimeout;
+        return registeredTagWasRead && (FeederClock::millis() - lastTagReadTime) <= tagTimeout;
     }
 
     // Invalidate the registered tag (reset the timer and flag)
@@ -106,6 +264,16 @@ public:
         registeredTagWasRead = false;
         lastTagReadTime = 0;
     }
+
+    uint32_t getLastDecisionMicros() const
+    {
+        return lastDecisionMicros;
+    }
+
+    uint32_t getMaxDecisionMicros() const
+    {
+        return maxDecisionMicros;
+    }
 };
 
-#endif // RFID_CONTROLLER_H
\ No newline at end of file
+#endif // RFID_CONTROLLER_H
@@ -0,0 +1,120 @@
+#ifndef SCHEDULE_SNAPSHOT_H
+#define SCHEDULE_SNAPSHOT_H
+
+#include <Arduino.h>
+#include <esp_rom_crc.h>
+#include "MemoryController.h"
+#include "FeederDataTypes.h"
+#include "FeederLog.h"
+
+// Binary copy of the parsed, validated and sorted feeding schedule. Boot reads the entries
+// straight into a FeedConfigData table instead of parsing and sorting the schedule JSON.
+// The snapshot records the CRC of the JSON it was built from, so a schedule synced from the
+// backend makes it stale and it is rebuilt once from the JSON on the next boot.
+class ScheduleSnapshot
+{
+private:
+    static constexpr const char* NVS_NAMESPACE = "schedule";
+    static constexpr const char* KEY_HEADER = "header";
+    static constexpr const char* KEY_ENTRIES = "entries";
+
+    // Bump when the snapshot layout changes. The entry size is part of the version, so a
+    // change to FeedConfigEntry also invalidates older snapshots
+    static constexpr uint32_t SNAPSHOT_VERSION = (1u << 16) | sizeof(FeedConfigEntry);
+
+    struct Header
+    {
+        uint32_t version;
+        uint32_t numOfEntries;
+        uint32_t sourceCrc;  // CRC32 of the schedule JSON the entries were built from
+        uint32_t entriesCrc; // CRC32 of the entries blob
+    };
+
+    static uint32_t crc32(const void* data, size_t size)
+    {
+        return esp_rom_crc32_le(0, static_cast<const uint8_t*>(data), size);
+    }
+
+    // Entries must be in range and sorted, the scheduler cursor relies on the order
+    static bool isValidSchedule(const FeedConfigData* feedConfigData)
+    {
+        for (int i = 0; i < feedConfigData->numOfEntries; i++)
+        {
+            const FeedConfigEntry& entry = feedConfigData->configEntries[i];
+            if (entry.minutesSinceMidnight >= 1440 || entry.wasDispensedToday)
+            {
+                return false;
+            }
+            if (i > 0 && entry.minutesSinceMidnight < feedConfigData->configEntries[i - 1].minutesSinceMidnight)
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+
+public:
+    static uint32_t getSourceCrc(const String& feedConfigJson)
+    {
+        return MemoryController::getFoodConfigCrc(feedConfigJson);
+    }
+
+    // Load the snapshot built from the given JSON. Returns nullptr when it is missing, corrupted,
+    // from another firmware layout or built from a different schedule
+    static FeedConfigData* load(MemoryController* memoryController, uint32_t sourceCrc)
+    {
+        Header header;
+        if (!memoryController->loadBlob(NVS_NAMESPACE, KEY_HEADER, &header, sizeof(header)))
+        {
+            return nullptr;
+        }
+
+        if (header.version != SNAPSHOT_VERSION || header.sourceCrc != sourceCrc || header.numOfEntries > MAX_ENTRIES_NUM)
+        {
+            LOG_INFO(LOG_STORAGE, "ScheduleSnapshot: stale snapshot (version %X, %u entries)", header.version, header.numOfEntries);
+            return nullptr;
+        }
+
+        FeedConfigData* feedConfigData = new FeedConfigData((int)header.numOfEntries);
+        size_t entriesSize = header.numOfEntries * sizeof(FeedConfigEntry);
+
+        bool loaded = entriesSize == 0 || memoryController->loadBlob(NVS_NAMESPACE, KEY_ENTRIES, feedConfigData->configEntries, entriesSize);
+        if (!loaded || (entriesSize > 0 && crc32(feedConfigData->configEntries, entriesSize) != header.entriesCrc) || !isValidSchedule(feedConfigData))
+        {
+            LOG_WARN(LOG_STORAGE, "ScheduleSnapshot: corrupted snapshot");
+            delete feedConfigData;
+            return nullptr;
+        }
+
+        return feedConfigData;
+    }
+
+    // Store the schedule parsed from the JSON with the given CRC. Call before any entry is marked as dispensed
+    static void save(MemoryController* memoryController, const FeedConfigData* feedConfigData, uint32_t sourceCrc)
+    {
+        if (!isValidSchedule(feedConfigData))
+        {
+            return;
+        }
+
+        size_t entriesSize = feedConfigData->numOfEntries * sizeof(FeedConfigEntry);
+
+        Header header;
+        header.version = SNAPSHOT_VERSION;
+        header.numOfEntries = feedConfigData->numOfEntries;
+        header.sourceCrc = sourceCrc;
+        header.entriesCrc = entriesSize > 0 ? crc32(feedConfigData->configEntries, entriesSize) : 0;
+
+        // Entries first, so a reset between the two writes leaves a header that does not match them.
+        // Without its entries the old header is kept, which no longer matches the schedule JSON
+        if (entriesSize > 0 && !memoryController->saveBlob(NVS_NAMESPACE, KEY_ENTRIES, feedConfigData->configEntries, entriesSize))
+        {
+            return;
+        }
+        memoryController->saveBlob(NVS_NAMESPACE, KEY_HEADER, &header, sizeof(header));
+
+        LOG_INFO(LOG_STORAGE, "ScheduleSnapshot: saved %d entries (%u bytes)", feedConfigData->numOfEntries, (uint32_t)entriesSize);
+    }
+};
+
+#endif // SCHEDULE_SNAPSHOT_H
@@ -0,0 +1,40 @@
+#ifndef STATION_PROFILE_H
+#define STATION_PROFILE_H
+
+#include <Arduino.h>
+
+// Pins of one feeding station: its hopper motor, gate, scale and RFID reader. One board runs up to
+// MAX_STATIONS of them side by side. Each station has its own backend identity, schedule, tag
+// registry, scale and outbox, stored under its own NVS namespaces (see MemoryController)
+struct StationProfile
+{
+    // One RDM6300 per free hardware UART: UART1 and UART2. UART0 is the serial console
+    static constexpr int MAX_STATIONS = 2;
+
+    // ULN2003 inputs of the gate stepper
+    struct GatePins
+    {
+        int in1;
+        int in2;
+        int in3;
+        int in4;
+    };
+
+    uint8_t index;
+
+    GatePins gatePins;
+    int motorRelayPin;   // Active LOW
+    int scaleDataPin;    // HX711 DOUT, may be an input-only pin (34-39)
+    int scaleClockPin;   // HX711 SCK
+    int rfidRxPin;       // RDM6300 TX, may be an input-only pin (34-39)
+    uint8_t rfidUartNum;
+
+    static const StationProfile PROFILES[MAX_STATIONS];
+};
+
+// Initialize static members. Station 0 is the wiring of the single-station feeder (see the wiring diagrams)
+const StationProfile StationProfile::PROFILES[StationProfile::MAX_STATIONS] = {
+    {0, {19, 18, 5, 17}, 21, 27, 14, 4, 1},
+    {1, {25, 26, 32, 33}, 23, 34, 13, 35, 2}};
+
+#endif // STATION_PROFILE_H
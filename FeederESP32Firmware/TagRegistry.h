@@ -0,0 +1,136 @@
+#ifndef TAG_REGISTRY_H
+#define TAG_REGISTRY_H
+
+#include <Arduino.h>
+#include <algorithm>
+#include <freertos/FreeRTOS.h>
+#include "MemoryController.h"
+
+// Sorted set of the RFID tags allowed to open the gate. Tags are the 32-bit IDs sent by the
+// RDM6300, so a lookup is a binary search over integers (at most 8 steps for 256 tags).
+// The list is synced from the backend (see WebConnectionController::fetchFeederData), stored
+// in NVS and reloaded by the sensing task, which looks tags up while the networking task writes.
+class TagRegistry
+{
+private:
+    static constexpr const char* NVS_NAMESPACE = "tags";
+    static constexpr const char* KEY_COUNT = "count";
+    static constexpr const char* KEY_IDS = "ids";
+
+public:
+    static constexpr int MAX_TAGS = 256;
+
+private:
+    uint32_t tags[MAX_TAGS];
+    int numOfTags = 0;
+
+    // Held only for the lookup or the copy, both a few microseconds
+    portMUX_TYPE lock = portMUX_INITIALIZER_UNLOCKED;
+
+public:
+    // Parse a tag written as hex, as printed on the tag or shown by the app ("7E3FE9").
+    // Returns 0, which is never a valid tag, on invalid input
+    static uint32_t parseTagId(const char* hex)
+    {
+        if (hex == nullptr || hex[0] == '\0')
+        {
+            return 0;
+        }
+
+        uint32_t tagId = 0;
+        int digits = 0;
+
+        for (const char* c = hex; *c != '\0'; c++)
+        {
+            int nibble;
+            if (*c >= '0' && *c <= '9') nibble = *c - '0';
+            else if (*c >= 'A' && *c <= 'F') nibble = *c - 'A' + 10;
+            else if (*c >= 'a' && *c <= 'f') nibble = *c - 'a' + 10;
+            else return 0;
+
+            if (++digits > 8)
+            {
+                return 0; // Does not fit the 32-bit ID sent by the reader
+            }
+            tagId = (tagId << 4) | nibble;
+        }
+
+        return tagId;
+    }
+
+    // Sort the IDs and drop duplicates and zeros in place. Returns the new count
+    static int normalize(uint32_t* ids, int count)
+    {
+        std::sort(ids, ids + count);
+        uint32_t* end = std::unique(ids, ids + count);
+        uint32_t* first = std::upper_bound(ids, end, 0u);
+
+        int normalizedCount = end - first;
+        memmove(ids, first, normalizedCount * sizeof(uint32_t));
+        return normalizedCount;
+    }
+
+    // Store a tag list received from the backend. It is applied by the next load()
+    static void save(MemoryController* memoryController, uint32_t* ids, int count)
+    {
+        count = normalize(ids, count < MAX_TAGS ? count : MAX_TAGS);
+
+        uint16_t storedCount = count;
+        if (count > 0)
+        {
+            memoryController->saveBlob(NVS_NAMESPACE, KEY_IDS, ids, count * sizeof(uint32_t));
+        }
+        memoryController->saveBlob(NVS_NAMESPACE, KEY_COUNT, &storedCount, sizeof(storedCount));
+    }
+
+    // Load the stored list. Returns false (and keeps the current tags) when nothing was stored yet
+    bool load(MemoryController* memoryController)
+    {
+        uint16_t storedCount = 0;
+        if (!memoryController->loadBlob(NVS_NAMESPACE, KEY_COUNT, &storedCount, sizeof(storedCount)) || storedCount > MAX_TAGS)
+        {
+            return false;
+        }
+
+        uint32_t* ids = new uint32_t[storedCount > 0 ? storedCount : 1];
+        bool loaded = storedCount == 0 || memoryController->loadBlob(NVS_NAMESPACE, KEY_IDS, ids, storedCount * sizeof(uint32_t));
+        if (loaded)
+        {
+            setTags(ids, storedCount);
+        }
+        delete[] ids;
+
+        return loaded;
+    }
+
+    void setTags(const uint32_t* ids, int count)
+    {
+        count = count < MAX_TAGS ? count : MAX_TAGS;
+
+        uint32_t* sortedIds = new uint32_t[count > 0 ? count : 1];
+        memcpy(sortedIds, ids, count * sizeof(uint32_t));
+        count = normalize(sortedIds, count);
+
+        portENTER_CRITICAL(&lock);
+        memcpy(tags, sortedIds, count * sizeof(uint32_t));
+        numOfTags = count;
+        portEXIT_CRITICAL(&lock);
+
+        delete[] sortedIds;
+    }
+
+    bool contains(uint32_t tagId)
+    {
+        portENTER_CRITICAL(&lock);
+        bool found = std::binary_search(tags, tags + numOfTags, tagId);
+        portEXIT_CRITICAL(&lock);
+        return found;
+    }
+
+    int size() const
+    {
+        return numOfTags;
+    }
+};
+
+#endif // TAG_REGISTRY_H
@@ -0,0 +1,130 @@
+#ifndef TASK_QUEUES_H
+#define TASK_QUEUES_H
+
+#include <Arduino.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/queue.h>
+#include <freertos/task.h>
+#include "FeederDataTypes.h"
+#include "StationProfile.h"
+#include "FeederLog.h"
+
+// Messages exchanged between the firmware tasks (see FeederESP32Firmware.ino):
+//  - UART receive callback: decodes RDM6300 frames, posts tag reads to sensing
+//  - sensing (core 1):    RFID decisions, posts gate requests to actuation
+//  - actuation (core 1):  gate stepper + dispenser motor relay
+//  - scheduling (core 1): FeederController, receives app commands from networking
+//  - networking (core 0): Wi-Fi, time sync, command polling and all HTTP uploads. Sleeps until its next
+//                         deadline, so anything it has to act on sooner wakes it with wakeNetworking()
+// Each station runs its own sensing, actuation and scheduling tasks, so their queues are per station.
+// The networking task serves every station and gets their events through one queue
+
+enum class ActuatorCommand : uint8_t
+{
+    OPEN_GATE,
+    CLOSE_GATE,
+    START_MOTOR,
+    STOP_MOTOR,
+    GATE_STOPPED // Posted by the gate step timer when a motion ends
+};
+
+enum class AppCommandType : uint8_t
+{
+    DISPENSE_NOW,
+    TIME_SYNCHRONIZED,
+    SCHEDULE_UPDATED,
+    FEEDING_DUE // Posted by the feeding timer, so the scheduling task wakes only when an entry is due
+};
+
+struct AppCommand
+{
+    AppCommandType type;
+    float quantity;
+};
+
+// Checksum-validated tag frame, stamped when its last byte was decoded
+struct TagRead
+{
+    uint32_t tagId;
+    uint32_t receivedMicros;
+};
+
+// Uplink event with the station it belongs to. Only the event is stored in the outbox of the station
+struct StationUplinkEvent
+{
+    uint8_t station;
+    UplinkEvent event;
+};
+
+struct TaskQueues
+{
+    static QueueHandle_t actuatorCommands[StationProfile::MAX_STATIONS];
+    static QueueHandle_t uplinkEvents;
+    static QueueHandle_t appCommands[StationProfile::MAX_STATIONS];
+    static QueueHandle_t tagReads[StationProfile::MAX_STATIONS];
+    static TaskHandle_t networkingTask;
+
+    static constexpr UBaseType_t ACTUATOR_QUEUE_LENGTH = 8;
+    static constexpr UBaseType_t UPLINK_QUEUE_LENGTH = 16;
+    static constexpr UBaseType_t APP_COMMAND_QUEUE_LENGTH = 4;
+    static constexpr UBaseType_t TAG_READ_QUEUE_LENGTH = 8;
+
+    static void create(int numOfStations)
+    {
+        uplinkEvents = xQueueCreate(UPLINK_QUEUE_LENGTH, sizeof(StationUplinkEvent));
+
+        for (int station = 0; station < numOfStations; station++)
+        {
+            actuatorCommands[station] = xQueueCreate(ACTUATOR_QUEUE_LENGTH, sizeof(ActuatorCommand));
+            appCommands[station] = xQueueCreate(APP_COMMAND_QUEUE_LENGTH, sizeof(AppCommand));
+            tagReads[station] = xQueueCreate(TAG_READ_QUEUE_LENGTH, sizeof(TagRead));
+        }
+    }
+
+    static bool sendActuatorCommand(uint8_t station, ActuatorCommand command)
+    {
+        return actuatorCommands[station] != nullptr && xQueueSend(actuatorCommands[station], &command, 0) == pdTRUE;
+    }
+
+    static bool postUplinkEvent(uint8_t station, UplinkEventType type, unsigned long startTime, unsigned long endTime, float value)
+    {
+        StationUplinkEvent stationEvent = {station, {type, startTime, endTime, value}};
+        if (uplinkEvents == nullptr || xQueueSend(uplinkEvents, &stationEvent, 0) != pdTRUE)
+        {
+            LOG_WARN(LOG_SYSTEM, "TaskQueues: uplink queue full, event dropped");
+            return false;
+        }
+        wakeNetworking();
+        return true;
+    }
+
+    // Run the networking task now instead of at its next deadline
+    static void wakeNetworking()
+    {
+        if (networkingTask != nullptr)
+        {
+            xTaskNotifyGive(networkingTask);
+        }
+    }
+
+    static bool postAppCommand(uint8_t station, AppCommandType type, float quantity)
+    {
+        AppCommand command = {type, quantity};
+        return appCommands[station] != nullptr && xQueueSend(appCommands[station], &command, 0) == pdTRUE;
+    }
+
+    static bool postTagRead(uint8_t station, uint32_t tagId, uint32_t receivedMicros)
+    {
+        TagRead read = {tagId, receivedMicros};
+        return tagReads[station] != nullptr && xQueueSend(tagReads[station], &read, 0) == pdTRUE;
+    }
+};
+
+// Initialize static members
+QueueHandle_t TaskQueues::actuatorCommands[StationProfile::MAX_STATIONS] = {};
+QueueHandle_t TaskQueues::uplinkEvents = nullptr;
+QueueHandle_t TaskQueues::appCommands[StationProfile::MAX_STATIONS] = {};
+QueueHandle_t TaskQueues::tagReads[StationProfile::MAX_STATIONS] = {};
+TaskHandle_t TaskQueues::networkingTask = nullptr;
+
+#endif // TASK_QUEUES_H
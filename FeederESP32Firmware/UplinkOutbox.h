@@ -0,0 +1,247 @@
+#ifndef UPLINK_OUTBOX_H
+#define UPLINK_OUTBOX_H
+
+#include <Arduino.h>
+#include <esp_random.h>
+#include "FeederDataTypes.h"
+#include "MemoryController.h"
+#include "WebConnectionController.h"
+#include "DeadlineQueue.h"
+#include "FeederLog.h"
+
+// Flash-backed ring of uplink events. Gate, dispense and weight events are appended as they
+// happen and uploaded in batches (see WebConnectionController::sendEventBatch), so events
+// survive Wi-Fi outages and reboots and each upload pays for a single TLS request.
+// Owned by the networking task.
+class UplinkOutbox
+{
+private:
+    static constexpr const char* NVS_NAMESPACE = "outbox";
+    static constexpr const char* KEY_STATE = "ring";
+
+    static constexpr int CAPACITY = 64;                            // Oldest events are dropped beyond this
+    static constexpr int MAX_BATCH_SIZE = 16;                      // Events per request
+    static constexpr unsigned long FLUSH_INTERVAL = 60000;         // Max time an event waits for a batch (ms)
+    static constexpr unsigned long MIN_RETRY_INTERVAL = 30000;     // First retry after a failed upload (ms)
+    static constexpr unsigned long MAX_RETRY_INTERVAL = 600000;    // Retry backoff cap (ms)
+
+    // Written only when the backend acknowledges a batch or a new epoch starts. The records
+    // themselves are found by their sequence: sequence s is always stored in slot s % CAPACITY
+    struct State
+    {
+        uint32_t epoch;         // Random, drawn when the outbox starts empty. Sent with every batch
+        uint32_t ackedThrough;  // Highest sequence acknowledged by the backend in this epoch
+    };
+
+    MemoryController* memoryController = nullptr;
+    WebConnectionController* webConnection = nullptr;
+
+    OutboxRecord records[CAPACITY]; // RAM mirror of the flash slots
+    State state = {0, 0};
+    uint32_t firstPending = 1;      // Sequence of the oldest pending record
+    uint32_t nextSequence = 1;      // Sequence of the next appended record
+
+    bool flushDue = false;
+    unsigned long oldestPendingTime = 0;
+    unsigned long nextRetryTime = 0;
+    unsigned long retryInterval = MIN_RETRY_INTERVAL;
+
+    static void slotKey(int slot, char (&key)[8])
+    {
+        snprintf(key, sizeof(key), "e%d", slot);
+    }
+
+    void saveState()
+    {
+        memoryController->saveBlob(NVS_NAMESPACE, KEY_STATE, &state, sizeof(state));
+    }
+
+    void saveSlot(int slot)
+    {
+        char key[8];
+        slotKey(slot, key);
+        memoryController->saveBlob(NVS_NAMESPACE, key, &records[slot], sizeof(OutboxRecord));
+    }
+
+    // Sequences restart at 1 in a new epoch, so the backend tells them apart from those it
+    // already stored by the (ID, epoch, seq) key
+    void startEpoch()
+    {
+        memoryController->clearBlobs(NVS_NAMESPACE);
+        state.epoch = esp_random();
+        state.ackedThrough = 0;
+        if (state.epoch == 0)
+        {
+            state.epoch = 1;
+        }
+        firstPending = nextSequence = 1;
+        saveState();
+        LOG_INFO(LOG_NETWORK, "UplinkOutbox: new epoch %08x", (unsigned int)state.epoch);
+    }
+
+    void load()
+    {
+        for (int slot = 0; slot < CAPACITY; slot++)
+        {
+            records[slot].sequence = 0;
+        }
+
+        if (!memoryController->loadBlob(NVS_NAMESPACE, KEY_STATE, &state, sizeof(state)) || state.epoch == 0)
+        {
+            startEpoch();
+            return;
+        }
+
+        uint32_t lastSequence = state.ackedThrough;
+        for (int slot = 0; slot < CAPACITY; slot++)
+        {
+            char key[8];
+            slotKey(slot, key);
+
+            OutboxRecord record;
+            if (memoryController->loadBlob(NVS_NAMESPACE, key, &record, sizeof(OutboxRecord)) && record.sequence > state.ackedThrough && record.sequence % CAPACITY == (uint32_t)slot)
+            {
+                records[slot] = record;
+                lastSequence = record.sequence > lastSequence ? record.sequence : lastSequence;
+            }
+        }
+
+        // Pending records are the unacknowledged ones among the last CAPACITY sequences.
+        // A slot lost to a failed write only leaves a gap
+        nextSequence = lastSequence + 1;
+        firstPending = nextSequence - 1 - state.ackedThrough > CAPACITY ? nextSequence - CAPACITY : state.ackedThrough + 1;
+
+        // Events saved before the reboot are uploaded as soon as there is a connection
+        flushDue = getPendingCount() > 0;
+    }
+
+    bool isStored(uint32_t sequence) const
+    {
+        return records[sequence % CAPACITY].sequence == sequence;
+    }
+
+public:
+    UplinkOutbox(MemoryController* memController, WebConnectionController* webConn) : memoryController(memController), webConnection(webConn)
+    {
+        LOG_DEBUG(LOG_NETWORK, "UplinkOutbox Constructor");
+        load();
+        LOG_INFO(LOG_NETWORK, "UplinkOutbox: %u pending events restored", (unsigned int)getPendingCount());
+    }
+
+    // One NVS write per event: the slot. The state is only written when a batch is acknowledged
+    void append(const UplinkEvent& event)
+    {
+        if (event.startTime == 0)
+        {
+            LOG_WARN(LOG_NETWORK, "UplinkOutbox: event dropped, time was not synched yet");
+            return;
+        }
+
+        if (nextSequence - firstPending == CAPACITY)
+        {
+            LOG_WARN(LOG_NETWORK, "UplinkOutbox: full, dropping the oldest event");
+            firstPending++;
+        }
+
+        if (nextSequence == firstPending)
+        {
+            oldestPendingTime = FeederClock::millis();
+        }
+
+        int slot = nextSequence % CAPACITY;
+        records[slot].sequence = nextSequence++;
+        records[slot].event = event;
+
+        saveSlot(slot);
+    }
+
+    int getPendingCount() const
+    {
+        return nextSequence - firstPending;
+    }
+
+    void loop()
+    {
+        if (getPendingCount() == 0 || !webConnection->haveInternetConnection() || !webConnection->hasFeederIdentity())
+        {
+            return;
+        }
+
+        bool batchIsFull = getPendingCount() >= MAX_BATCH_SIZE;
+        bool batchIsOld = FeederClock::millis() - oldestPendingTime >= FLUSH_INTERVAL;
+        if (!flushDue && !batchIsFull && !batchIsOld)
+        {
+            return;
+        }
+
+        if ((long)(FeederClock::millis() - nextRetryTime) < 0)
+        {
+            return; // Backing off after a failed upload
+        }
+
+        flush();
+    }
+
+    // Time until loop() has to upload, DeadlineQueue::NEVER while there is nothing it can send.
+    // New events and the Wi-Fi reconnect wake the networking task
+    unsigned long getMillisUntilDue()
+    {
+        if (getPendingCount() == 0 || !webConnection->haveInternetConnection() || !webConnection->hasFeederIdentity())
+        {
+            return DeadlineQueue::NEVER;
+        }
+
+        unsigned long now = FeederClock::millis();
+        unsigned long untilFlush = 0;
+        if (!flushDue && getPendingCount() < MAX_BATCH_SIZE && now - oldestPendingTime < FLUSH_INTERVAL)
+        {
+            untilFlush = FLUSH_INTERVAL - (now - oldestPendingTime);
+        }
+
+        long untilRetry = (long)(nextRetryTime - now);
+        return untilRetry > 0 && (unsigned long)untilRetry > untilFlush ? (unsigned long)untilRetry : untilFlush;
+    }
+
+    // Upload one batch from the oldest pending record. Returns true if records were acknowledged
+    bool flush()
+    {
+        // The ring may wrap, so copy the batch into a contiguous buffer
+        OutboxRecord batch[MAX_BATCH_SIZE];
+        int batchSize = 0;
+        for (uint32_t sequence = firstPending; sequence != nextSequence && batchSize < MAX_BATCH_SIZE; sequence++)
+        {
+            if (isStored(sequence))
+            {
+                batch[batchSize++] = records[sequence % CAPACITY];
+            }
+        }
+
+        uint32_t ackedThrough = batchSize > 0 ? webConnection->sendEventBatch(state.epoch, batch, batchSize) : nextSequence - 1;
+
+        if (ackedThrough < firstPending || ackedThrough >= nextSequence)
+        {
+            unsigned long retryDelay = DeadlineQueue::withJitter(retryInterval);
+            LOG_WARN(LOG_NETWORK, "UplinkOutbox: upload failed, retrying in %lus", retryDelay / 1000);
+            nextRetryTime = FeederClock::millis() + retryDelay;
+            retryInterval = retryInterval * 2 < MAX_RETRY_INTERVAL ? retryInterval * 2 : MAX_RETRY_INTERVAL;
+            return false;
+        }
+
+        int numOfAcked = ackedThrough + 1 - firstPending;
+        firstPending = ackedThrough + 1;
+        state.ackedThrough = ackedThrough;
+        saveState();
+
+        retryInterval = MIN_RETRY_INTERVAL;
+        nextRetryTime = FeederClock::millis();
+        oldestPendingTime = FeederClock::millis();
+
+        // The radio is up already, so drain what is left on the next passes
+        flushDue = getPendingCount() > 0;
+
+        LOG_INFO(LOG_NETWORK, "UplinkOutbox: %u events uploaded, %u pending", (unsigned int)numOfAcked, (unsigned int)getPendingCount());
+        return true;
+    }
+};
+
+#endif // UPLINK_OUTBOX_H
@@ -5,6 +5,21 @@
 #include <WiFi.h>
 #include <ArduinoJson.h>
 #include <MemoryController.h>
+#include "BackendConnection.h"
+#include "TagRegistry.h"
+#include "ClockService.h"
+#include "DeadlineQueue.h"
+#include "FeederLog.h"
+
+// Fallback polling of get_esp32_command.php while the command channel is down (ms). Failed polls
+// double the interval up to the maximum; each poll is spread by FEEDER_POLL_JITTER_PERCENT
+#ifndef FEEDER_COMMAND_POLL_INTERVAL
+#define FEEDER_COMMAND_POLL_INTERVAL 5000
+#endif
+
+#ifndef FEEDER_COMMAND_POLL_MAX_INTERVAL
+#define FEEDER_COMMAND_POLL_MAX_INTERVAL 120000
+#endif
 
 class WebConnectionController
 {
@@ -15,334 +30,384 @@ private:
     String FeederId;
     String FeederPassword;
 
-    unsigned long syncedTimestamp = 0; // The Unix time when the last sync occurred
-    unsigned long syncMillis = 0;      // The millis value at the time of the last sync
+    // SNTP clock with drift correction; backend Date headers are its fallback source
+    ClockService* clockService = nullptr;
 
     MemoryController* memoryController = nullptr;
 
-public:
-    // Constructor to initialize Wi-Fi credentials
-    WebConnectionController(MemoryController* memController)
-    {
-        Serial.println("WebConnectionController Constructor");
-
-        memoryController = memController;
-
-        wifiSSID = memoryController->getFeederWifiSSID();
-        wifiPassword = memoryController->getFeederWiFiPassword();
-        FeederId = memoryController->feederId;
-        FeederPassword = memoryController->feederPassword;
+    // Persistent keep-alive session to the backend, shared by every request below. The clock and
+    // the session belong to the board: the controllers of the other stations use those of station 0
+    BackendConnection* backendConnection = nullptr;
 
-        Serial.println("WebConnectionController Initialized");
-    }
-
-    static int getRelativeMinutesSinceMidnight(unsigned long unixTime) 
-    {
-      return (unixTime % 86400L) / 60; // Extracts hours and minutes as total minutes since midnight
-    }
+    // No response, or a server error, on the last request. Polls back off on it
+    bool lastRequestFailed = false;
+    int lastResponseCode = 0;
 
-    static String debugMinutes(unsigned long minutesSinceMidnight) 
-    {
-        int hour = minutesSinceMidnight / 60;
-        int minutes = minutesSinceMidnight % 60;
+    // Backends without add_events_batch.php get the legacy per-event requests. The batch
+    // endpoint is tried again after a day, so a backend upgrade is picked up
+    static constexpr unsigned long BATCH_ENDPOINT_PROBE_INTERVAL = 86400000; // ms
+    bool batchEndpointMissing = false;
+    unsigned long batchEndpointProbeTime = 0;
+    unsigned long commandPollInterval = FEEDER_COMMAND_POLL_INTERVAL;
 
-        return String(hour) + ":" + String(minutes);
-    }
+    // Set when fetchFeederData() stored a new RFID tag list
+    volatile bool registeredTagsUpdated = false;
+    volatile bool scheduleUpdated = false;
 
-    // Connect to Wi-Fi
-    bool connectToWifi()
+    // RFIDTags: ["7E3FE9", ...]. A feeder record without the field keeps the stored tags
+    void saveRegisteredTags(JsonArrayConst tagList)
     {
-        WiFi.begin(wifiSSID.c_str(), wifiPassword.c_str());
+        uint32_t* tagIds = new uint32_t[TagRegistry::MAX_TAGS];
+        int numOfTags = 0;
 
-        Serial.println("Connect to wifi begin: ");
-        Serial.println("Ssid: " + wifiSSID);
-        Serial.println("Password: " + wifiPassword);
-
-        int maxRetries = 10; // Maximum number of retries to connect
-        int retryCount = 0;
-
-        // Wait for connection
-        while (WiFi.status() != WL_CONNECTED && retryCount < maxRetries)
+        for (JsonVariantConst tag : tagList)
         {
-            delay(750);
-            Serial.print(".");
-            retryCount++;
-        }
-
-        if (WiFi.status() == WL_CONNECTED)
-        {
-            Serial.println("\nWi-Fi connected!");
-            Serial.print("IP address: ");
-            Serial.println(WiFi.localIP());
-
-            delay(1000);
-            //synchronizeTime();
-
-            fetchFeederData();
+            uint32_t tagId = TagRegistry::parseTagId(tag.as<const char*>());
+            if (tagId == 0)
+            {
+                LOG_WARN(LOG_RFID, "Ignoring invalid RFID tag: %s", tag.as<const char*>());
+                continue;
+            }
 
-            //addFoodDispenseEvent(getCurrentTime(), 0.35f);
-            //addGateEvent(getCurrentTime(), getCurrentTime() + 100);
-            return true;
-        }
-        else
-        {
-            Serial.println("\nFailed to connect to Wi-Fi");
-            disconnect(); // to reset wifi module
-            return false;
+            if (numOfTags < TagRegistry::MAX_TAGS)
+            {
+                tagIds[numOfTags++] = tagId;
+            }
         }
-    }
 
-    bool haveInternetConnection()
-    {
-        return WiFi.status() == WL_CONNECTED;
+        TagRegistry::save(memoryController, tagIds, numOfTags);
+        delete[] tagIds;
+
+        LOG_INFO(LOG_RFID, "RFID tags: %d received", numOfTags);
+        registeredTagsUpdated = true;
     }
 
-    // Perform an HTTP GET request
-    String httpGetRequest(const String &url)
+    // Send a request and return the response body ("" on error)
+    String sendHttpRequest(const char* method, const String &url, const String &payload, const String &contentType)
     {
         if (WiFi.status() != WL_CONNECTED)
         {
-            Serial.println("Wi-Fi not connected!");
+            LOG_WARN(LOG_NETWORK, "Wi-Fi not connected!");
+            lastRequestFailed = true;
+            lastResponseCode = 0;
             return "";
         }
 
-        HTTPClient http;
-        http.begin(url);
-
-        int httpResponseCode = http.GET();
+        String response = "";
+        int httpResponseCode;
 
-        String payload = "";
-        if (httpResponseCode > 0)
+        if (BackendConnection::isBackendUrl(url))
         {
-            payload = http.getString();
+            httpResponseCode = backendConnection->request(method, url, payload, contentType, response);
+            if (httpResponseCode > 0)
+            {
+                clockService->onHttpDate(backendConnection->getLastDateHeader(), backendConnection->getLastRequestSentMicros(), backendConnection->getLastResponseMicros());
+            }
         }
         else
         {
-            Serial.print("Error on HTTP request: ");
-            Serial.println(httpResponseCode);
+            // Other hosts are rare, use a one-off connection
+            HTTPClient http;
+            http.begin(url);
+            if (payload.length() > 0)
+            {
+                http.addHeader("Content-Type", contentType);
+            }
+
+            httpResponseCode = http.sendRequest(method, payload);
+            if (httpResponseCode > 0)
+            {
+                response = http.getString();
+            }
+            http.end();
         }
 
-        http.end();
-        return payload;
-    }
+        lastRequestFailed = httpResponseCode <= 0 || httpResponseCode >= 500;
+        lastResponseCode = httpResponseCode;
 
-    // Perform an HTTP POST request
-    String httpPostRequest(const String &url, const String &payload, const String &contentType = "application/json")
-    {
-        if (WiFi.status() != WL_CONNECTED)
+        if (httpResponseCode <= 0)
         {
-            Serial.println("Wi-Fi not connected!");
+            LOG_WARN(LOG_NETWORK, "Error on HTTP %s request: %d", method, httpResponseCode);
             return "";
         }
 
-        HTTPClient http;
-        http.begin(url);
-        http.addHeader("Content-Type", contentType);
+        return response;
+    }
 
-        int httpResponseCode = http.POST(payload);
+    // Legacy upload of one record: add_gate_event.php, add_food_dispense_event.php or update_food_weight.php.
+    // These endpoints cannot deduplicate, so a record whose response was lost is stored twice
+    bool sendEvent(const UplinkEvent& event)
+    {
+        JsonDocument jsonDoc;
+        jsonDoc["ID"] = FeederId;
+        jsonDoc["Password"] = FeederPassword;
 
-        String response = "";
-        if (httpResponseCode > 0)
+        String response;
+        String jsonPayload;
+        switch (event.type)
         {
-            response = http.getString();
+            case UplinkEventType::GATE_EVENT:
+                jsonDoc["startTime"] = event.startTime;
+                jsonDoc["endTime"] = event.endTime;
+                serializeJson(jsonDoc, jsonPayload);
+                response = httpPostRequest("https://dev.bull-software.com/add_gate_event.php", jsonPayload);
+                break;
+            case UplinkEventType::FOOD_DISPENSE_EVENT:
+                jsonDoc["dispensedAt"] = event.startTime;
+                jsonDoc["quantityDispensed"] = event.value;
+                serializeJson(jsonDoc, jsonPayload);
+                response = httpPostRequest("https://dev.bull-software.com/add_food_dispense_event.php", jsonPayload);
+                break;
+            case UplinkEventType::FOOD_WEIGHT_UPDATE:
+                jsonDoc["FoodCurrentWeight"] = event.value;
+                jsonDoc["LastFoodCurrentWeightUpdateTime"] = event.startTime;
+                serializeJson(jsonDoc, jsonPayload);
+                response = httpPutRequest("https://dev.bull-software.com/update_food_weight.php", jsonPayload);
+                break;
         }
-        else
+
+        if (lastResponseCode < 200 || lastResponseCode >= 300)
         {
-            Serial.print("Error on HTTP POST request: ");
-            Serial.println(httpResponseCode);
+            LOG_WARN(LOG_NETWORK, "Event upload failed: %d", lastResponseCode);
+            return false;
         }
 
-        http.end();
-        return response;
+        LOG_DEBUG(LOG_NETWORK, "Server response: %s", response);
+        return true;
     }
 
-    String httpPutRequest(const String &url, const String &payload, const String &contentType = "application/json")
+    // Returns the sequence of the last record sent before the first failure, 0 if none was sent
+    uint32_t sendEventsOneByOne(const OutboxRecord* records, int numOfRecords)
     {
-        if (WiFi.status() != WL_CONNECTED)
+        uint32_t ackedThrough = 0;
+        for (int i = 0; i < numOfRecords && sendEvent(records[i].event); i++)
         {
-            Serial.println("Wi-Fi not connected!");
-            return "";
+            ackedThrough = records[i].sequence;
         }
+        return ackedThrough;
+    }
 
-        HTTPClient http;
-        http.begin(url);
-        http.addHeader("Content-Type", contentType);
+public:
+    // Constructor to initialize Wi-Fi credentials. Pass the controller of station 0 as boardConnection
+    // to share its clock and backend session
+    WebConnectionController(MemoryController* memController, WebConnectionController* boardConnection = nullptr)
+    {
+        LOG_DEBUG(LOG_NETWORK, "WebConnectionController Constructor");
 
-        int httpResponseCode = http.PUT(payload);
+        memoryController = memController;
 
-        String response = "";
-        if (httpResponseCode > 0)
+        if (boardConnection == nullptr)
         {
-            response = http.getString();
+            clockService = new ClockService();
+            backendConnection = new BackendConnection();
         }
         else
         {
-            Serial.print("Error on HTTP PUT request: ");
-            Serial.println(httpResponseCode);
+            clockService = boardConnection->clockService;
+            backendConnection = boardConnection->backendConnection;
         }
 
-        http.end();
-        return response;
+        wifiSSID = memoryController->getFeederWifiSSID();
+        wifiPassword = memoryController->getFeederWiFiPassword();
+        FeederId = memoryController->getFeederId();
+        FeederPassword = memoryController->getFeederPassword();
+        if (!hasFeederIdentity())
+        {
+            LOG_WARN(LOG_NETWORK, "No feeder ID set for this station, set it in the configuration portal");
+        }
+
+        LOG_DEBUG(LOG_NETWORK, "WebConnectionController Initialized");
     }
 
-    bool addGateEvent(int startTime, int endTime)
+    static int getRelativeMinutesSinceMidnight(unsigned long unixTime) 
     {
-        Serial.println("AddGateEvent");
-        if (!haveInternetConnection())
-        {
-            Serial.println("No internet connection. Cannot add gate event.");
-            return false;
-        }
+      return (unixTime % 86400L) / 60; // Extracts hours and minutes as total minutes since midnight
+    }
 
-        if(startTime == 0 || endTime == 0)
-        {
-            Serial.println("Cannot addGateEvent. Invalid Time");
-            return false;
-        }
+    // Connect to Wi-Fi
+    // Start connecting and return right away. WifiController polls haveInternetConnection()
+    // and fetches the feeder data once connected
+    void connectToWifi()
+    {
+        WiFi.begin(wifiSSID.c_str(), wifiPassword.c_str());
 
-        // Define the API endpoint
-        const String apiUrl = "https://dev.bull-software.com/add_gate_event.php";
+        LOG_INFO(LOG_NETWORK, "Connect to wifi begin: %s", wifiSSID.c_str());
+    }
 
-        StaticJsonDocument<256> jsonDoc;
-        jsonDoc["ID"] = FeederId;
-        jsonDoc["Password"] = FeederPassword;
-        jsonDoc["startTime"] = startTime;
-        jsonDoc["endTime"] = endTime;
+    bool haveInternetConnection()
+    {
+        return WiFi.status() == WL_CONNECTED;
+    }
 
-        String jsonPayload;
-        serializeJson(jsonDoc, jsonPayload);
+    // A station without an identity makes no backend requests
+    bool hasFeederIdentity() const
+    {
+        return FeederId.length() > 0;
+    }
 
-        // Perform HTTP POST request
-        Serial.println("Sending HTTP POST request to add gate event...");
-        String response = httpPostRequest(apiUrl, jsonPayload, "application/json");
+    // Perform an HTTP GET request
+    String httpGetRequest(const String &url)
+    {
+        return sendHttpRequest("GET", url, "", "");
+    }
 
-        // Handle the response
-        if (response.isEmpty())
-        {
-            Serial.println("Failed to get a response from the server.");
-            return false;
-        }
+    // Perform an HTTP POST request
+    String httpPostRequest(const String &url, const String &payload, const String &contentType = "application/json")
+    {
+        return sendHttpRequest("POST", url, payload, contentType);
+    }
 
-        Serial.print("Server response: ");
-        Serial.println(response);
-        return true;
+    String httpPutRequest(const String &url, const String &payload, const String &contentType = "application/json")
+    {
+        return sendHttpRequest("PUT", url, payload, contentType);
     }
 
-    bool addFoodDispenseEvent(unsigned long dispensedAt, float quantityDispensed)
+    // True once after fetchFeederData() stored a new RFID tag list
+    bool consumeRegisteredTagsUpdate()
     {
-        Serial.println("AddFoodDispanseEvent");
-        if (!haveInternetConnection())
+        bool updated = registeredTagsUpdated;
+        registeredTagsUpdated = false;
+        return updated;
+    }
+
+    // True once after fetchFeederData() stored a schedule different from the one in use
+    bool consumeScheduleUpdate()
+    {
+        bool updated = scheduleUpdated;
+        scheduleUpdated = false;
+        return updated;
+    }
+
+    const BackendConnection::Stats& getBackendConnectionStats() const
+    {
+        return backendConnection->getStats();
+    }
+
+    // Upload several outbox records with one request. Batch contract (add_events_batch.php):
+    //  request:  {"ID": ..., "Password": ..., "epoch": 2864434397, "events": [
+    //               {"seq": 41, "type": "gate", "startTime": ..., "endTime": ...},
+    //               {"seq": 42, "type": "dispense", "dispensedAt": ..., "quantityDispensed": ...},
+    //               {"seq": 43, "type": "weight", "FoodCurrentWeight": ..., "LastFoodCurrentWeightUpdateTime": ...}]}
+    //  response: {"ackedThrough": 43}
+    // (ID, epoch, seq) is the idempotency key: the backend stores each one once and acknowledges
+    // duplicates as if they were new. A backend without the endpoint (404) gets one legacy request
+    // per record instead. Returns the highest acknowledged sequence, or 0 on failure.
+    uint32_t sendEventBatch(uint32_t epoch, const OutboxRecord* records, int numOfRecords)
+    {
+        if (!haveInternetConnection() || !hasFeederIdentity() || numOfRecords == 0)
         {
-            Serial.println("No internet connection. Cannot add food dispense event.");
-            return false;
+            return 0;
         }
 
-        if(dispensedAt == 0)
+        if (batchEndpointMissing && (long)(FeederClock::millis() - batchEndpointProbeTime) < 0)
         {
-            Serial.println("Cannot AddFoodDispanseEvent. Invalid Time");
-            return false;
+            return sendEventsOneByOne(records, numOfRecords);
         }
 
-        // Define the API endpoint
-        const String apiUrl = "https://dev.bull-software.com/add_food_dispense_event.php";
-
-        StaticJsonDocument<256> jsonDoc;
-        jsonDoc["ID"] = FeederId;
-        jsonDoc["Password"] = FeederPassword;
-        jsonDoc["dispensedAt"] = dispensedAt;
-        jsonDoc["quantityDispensed"] = quantityDispensed;
+        const String apiUrl = "https://dev.bull-software.com/add_events_batch.php";
 
         String jsonPayload;
-        serializeJson(jsonDoc, jsonPayload);
+        buildEventBatchPayload(epoch, records, numOfRecords, jsonPayload);
 
-        // Perform HTTP POST request
-        Serial.println("Sending HTTP POST request to add food dispense event...");
+        LOG_DEBUG(LOG_NETWORK, "Sending HTTP POST request with %d events...", numOfRecords);
         String response = httpPostRequest(apiUrl, jsonPayload, "application/json");
 
-        // Handle the response
-        if (response.isEmpty())
+        if (lastResponseCode == 404)
         {
-            Serial.println("Failed to get a response from the server.");
-            return false;
+            LOG_WARN(LOG_NETWORK, "No batch endpoint on the backend, sending events one by one");
+            batchEndpointMissing = true;
+            batchEndpointProbeTime = FeederClock::millis() + BATCH_ENDPOINT_PROBE_INTERVAL;
+            return sendEventsOneByOne(records, numOfRecords);
         }
+        batchEndpointMissing = false;
 
-        Serial.print("Server response: ");
-        Serial.println(response);
-        return true;
-    }
-
-    void updateFoodWeight(float newWeight, int currentTime)
-    {
-        Serial.println("Updating food weight...");
-        
-        if (!haveInternetConnection())
+        if (response.isEmpty())
         {
-            Serial.println("No internet connection. Cannot update food weight.");
-            return;
+            LOG_WARN(LOG_NETWORK, "Failed to get a response from the server.");
+            return 0;
         }
 
-        if(currentTime == 0)
+        JsonDocument responseDoc;
+        if (deserializeJson(responseDoc, response) || !responseDoc["ackedThrough"].is<uint32_t>())
         {
-             Serial.println("updateFoodWeight Cannot be updated because time was not synched yet");
+            LOG_WARN(LOG_NETWORK, "Unexpected batch response: %s", response);
+            return 0;
         }
-        
-        // Define the API endpoint
-        const String apiUrl = "https://dev.bull-software.com/update_food_weight.php";
-        
-        // Create JSON payload
-        StaticJsonDocument<256> jsonDoc;
+
+        return responseDoc["ackedThrough"].as<uint32_t>();
+    }
+
+    // Request body of sendEventBatch()
+    void buildEventBatchPayload(uint32_t epoch, const OutboxRecord* records, int numOfRecords, String& jsonPayload)
+    {
+        JsonDocument jsonDoc;
         jsonDoc["ID"] = FeederId;
         jsonDoc["Password"] = FeederPassword;
-        jsonDoc["FoodCurrentWeight"] = newWeight;
-        jsonDoc["LastFoodCurrentWeightUpdateTime"] = currentTime;
-        
-        String jsonPayload;
-        serializeJson(jsonDoc, jsonPayload);
-        
-        // Perform HTTP PUT request
-        Serial.println("Sending HTTP PUT request to update food weight...");
-        String response = httpPutRequest(apiUrl, jsonPayload, "application/json");
-        
-        // Handle the response
-        if (response.isEmpty())
+        jsonDoc["epoch"] = epoch;
+        JsonArray events = jsonDoc["events"].to<JsonArray>();
+
+        for (int i = 0; i < numOfRecords; i++)
         {
-            Serial.println("Failed to get a response from the server.");
-            return;
+            const UplinkEvent& event = records[i].event;
+            JsonObject jsonEvent = events.add<JsonObject>();
+            jsonEvent["seq"] = records[i].sequence;
+
+            switch (event.type)
+            {
+                case UplinkEventType::GATE_EVENT:
+                    jsonEvent["type"] = "gate";
+                    jsonEvent["startTime"] = event.startTime;
+                    jsonEvent["endTime"] = event.endTime;
+                    break;
+                case UplinkEventType::FOOD_DISPENSE_EVENT:
+                    jsonEvent["type"] = "dispense";
+                    jsonEvent["dispensedAt"] = event.startTime;
+                    jsonEvent["quantityDispensed"] = event.value;
+                    break;
+                case UplinkEventType::FOOD_WEIGHT_UPDATE:
+                    jsonEvent["type"] = "weight";
+                    jsonEvent["FoodCurrentWeight"] = event.value;
+                    jsonEvent["LastFoodCurrentWeightUpdateTime"] = event.startTime;
+                    break;
+            }
         }
-        
-        Serial.print("Server response: ");
-        Serial.println(response);
+
+        serializeJson(jsonDoc, jsonPayload);
     }
 
     void fetchFeederData()
     {
+        if (!hasFeederIdentity())
+        {
+            return;
+        }
+
         // Construct the full API URL with query parameters
         String url = "https://dev.bull-software.com/get_feeder.php?ID=" + FeederId + "&Password=" + FeederPassword;
 
-        Serial.println("Sending GET request to: " + url);
+        LOG_DEBUG(LOG_NETWORK, "Sending GET request to: %s", url);
         String response = httpGetRequest(url);
 
         if (response.length() > 0)
         {
-            Serial.println("Response received:");
-            Serial.println(response);
+            LOG_DEBUG(LOG_NETWORK, "Response received: %s", response);
 
             // Parse the JSON response
-            StaticJsonDocument<1024> doc; // Adjust size if necessary
+            // Elastic document: FeedFoodConfiguration can hold up to MAX_ENTRIES_NUM entries,
+            // which does not fit in a fixed-size pool
+            JsonDocument doc;
             DeserializationError error = deserializeJson(doc, response);
 
             if (error)
             {
-                Serial.print("JSON parsing failed: ");
-                Serial.println(error.c_str());
+                LOG_WARN(LOG_NETWORK, "JSON parsing failed: %s", error.c_str());
                 return;
             }
 
             // Extract fields from JSON response
-            if (doc.containsKey("error"))
+            if (!doc["error"].isNull())
             {
-                Serial.print("API Error: ");
-                Serial.println(doc["error"].as<String>());
+                LOG_WARN(LOG_NETWORK, "API Error: %s", doc["error"].as<const char*>());
                 return;
             }
 
@@ -355,213 +420,113 @@ public:
             unsigned long lastFoodStorageQuantityUpdateTime = doc["LastFoodStorageQuantityUpdateTime"].as<unsigned long>();
             unsigned long lastFoodCurrentWeightUpdateTime = doc["LastFoodCurrentWeightUpdateTime"].as<unsigned long>();
 
-            Serial.println("Feeder Data:");
-            Serial.println("ID: " + id);
-            Serial.println("Name: " + name);
-            Serial.println("Trap Mode: " + trapMode);
-            Serial.println("Food Storage Quantity: " + String(foodStorageQuantity));
-            Serial.println("Food Current Weight: " + String(foodCurrentWeight));
-            Serial.println("Last Update lastFoodStorageQuantityUpdateTime: " + String(lastFoodStorageQuantityUpdateTime));
-            Serial.println("Last Update lastFoodCurrentWeightUpdateTime: " + String(lastFoodCurrentWeightUpdateTime));
+            LOG_DEBUG(LOG_NETWORK, "Feeder Data:");
+            LOG_DEBUG(LOG_NETWORK, "ID: %s", id);
+            LOG_DEBUG(LOG_NETWORK, "Name: %s", name);
+            LOG_DEBUG(LOG_NETWORK, "Trap Mode: %s", trapMode);
+            LOG_DEBUG(LOG_NETWORK, "Food Storage Quantity: %.2f", foodStorageQuantity);
+            LOG_DEBUG(LOG_NETWORK, "Food Current Weight: %.2f", foodCurrentWeight);
+            LOG_DEBUG(LOG_NETWORK, "Last Update lastFoodStorageQuantityUpdateTime: %lu", lastFoodStorageQuantityUpdateTime);
+            LOG_DEBUG(LOG_NETWORK, "Last Update lastFoodCurrentWeightUpdateTime: %lu", lastFoodCurrentWeightUpdateTime);
+
+            if (feedFoodConfigJson != memoryController->getFoodConfigJson())
+            {
+                scheduleUpdated = true;
+            }
 
             memoryController->saveFeederConfiguration(feedFoodConfigJson, trapMode, id, name, foodStorageQuantity, foodCurrentWeight, lastFoodStorageQuantityUpdateTime, lastFoodCurrentWeightUpdateTime);
+
+            if (doc["RFIDTags"].is<JsonArrayConst>())
+            {
+                saveRegisteredTags(doc["RFIDTags"].as<JsonArrayConst>());
+            }
         }
         else
         {
-            Serial.println("Failed to get a response from the API.");
+            LOG_WARN(LOG_NETWORK, "Failed to get a response from the API.");
         }
     }
 
+    // Delay until the next fallback poll, backed off after failed polls and jittered
+    unsigned long getCommandPollDelay() const
+    {
+        return DeadlineQueue::withJitter(commandPollInterval);
+    }
+
     String getCommandFromApplication()
     {
         if (!haveInternetConnection())
         {
-            Serial.println("No internet connection. Cannot fetch command.");
+            LOG_WARN(LOG_NETWORK, "No internet connection. Cannot fetch command.");
+            return "";
+        }
+
+        if (!hasFeederIdentity())
+        {
             return "";
         }
 
         const String apiUrl = "https://dev.bull-software.com/get_esp32_command.php?ID=" + FeederId + "&Password=" + FeederPassword;
 
-        HTTPClient http;
-        http.begin(apiUrl);
-        int httpResponseCode = http.GET();
+        String response = httpGetRequest(apiUrl);
+        //Serial.println("Command Response: " + response);
 
-        String response = "";
-        if (httpResponseCode > 0)
+        if (lastRequestFailed)
         {
-            response = http.getString();
-            //Serial.println("Command Response: " + response);
-
-            if(response.length() > 0)
-            {
-                StaticJsonDocument<1024> doc;
-                DeserializationError error = deserializeJson(doc, response);
-
-                if (error)
-                {
-                    Serial.print("JSON parsing failed: ");
-                    Serial.println(error.c_str());
-                    http.end();
-                    return "";
-                }
-
-                if (doc.containsKey("error") || doc.containsKey("message"))
-                {
-                    Serial.print("API Error: ");
-                    Serial.println(doc["error"].as<String>());
-                    http.end();
-                    return "";
-                }
-
-                String command = doc["Command"].as<String>();
-                response = command;
-            }
-            else
-            {
-                response = "";
-            }
+            commandPollInterval = commandPollInterval * 2 < FEEDER_COMMAND_POLL_MAX_INTERVAL ? commandPollInterval * 2 : FEEDER_COMMAND_POLL_MAX_INTERVAL;
         }
         else
         {
-            Serial.print("Error on HTTP GET request: ");
-            Serial.println(httpResponseCode);
-            response = "";
+            commandPollInterval = FEEDER_COMMAND_POLL_INTERVAL;
         }
 
-        http.end();
-        return response;
-    }
-
-    bool synchronizeTime() 
-    {
-        if (WiFi.status() != WL_CONNECTED) 
+        if (response.length() == 0)
         {
-            Serial.println("Wi-Fi not connected! Cannot sync time.");
-            return false;
+            return "";
         }
 
-        int numOfTries = 5;
+        JsonDocument doc;
+        DeserializationError error = deserializeJson(doc, response);
 
-        for(int tryNumber = 1; tryNumber <= numOfTries; tryNumber++)
+        if (error)
         {
-            Serial.println("Trying to sync time. Try number:" + tryNumber);
-            const char* apis[] = 
-            {
-                "http://worldtimeapi.org/api/timezone/Etc/UTC",
-                "http://worldclockapi.com/api/json/utc/now",
-                "https://timeapi.io/api/Time/current/zone?timeZone=UTC"
-            };
+            LOG_WARN(LOG_NETWORK, "JSON parsing failed: %s", error.c_str());
+            return "";
+        }
 
-            for (int i = 0; i < 3; i++) 
-            {
-                HTTPClient http;
-                http.begin(apis[i]);
-                Serial.print("Trying getting time with API: ");
-                Serial.println(apis[i]);
-
-                int httpResponseCode = http.GET();
-
-                if (httpResponseCode > 0) 
-                {
-                    String response = http.getString();
-                    Serial.println("Time sync response: " + response);
-
-                    // Extract the UNIX timestamp from the JSON response
-                    int timeIndex;
-                    if (apis[i] == apis[0]) 
-                    {
-                        timeIndex = response.indexOf("\"unixtime\":");
-                        if (timeIndex != -1) 
-                        {
-                            syncedTimestamp = response.substring(timeIndex + 11).toInt();
-                        }
-                    } 
-                    else if (apis[i] == apis[1]) 
-                    {
-                        timeIndex = response.indexOf("\"currentFileTime\":");
-                        if (timeIndex != -1) 
-                        {
-                            // Extract the "currentFileTime" value
-                            String fileTimeStr = response.substring(timeIndex + 18, response.indexOf(",", timeIndex));
-                            
-                            // Convert the extracted string to a 64-bit integer
-                            uint64_t fileTime = strtoull(fileTimeStr.c_str(), NULL, 10);
-                            // (133815211641693715 / 10000000) - 11644473600;
-                            // Convert from 100-nanoseconds since 1601 to UNIX time
-                            syncedTimestamp = (fileTime / 10000000) - 11644473600; //GMT+0000
-                        }
-                    }
-                    else if (apis[i] == apis[2]) 
-                    {
-                        // Parse the JSON response
-                        int yearIndex = response.indexOf("\"year\":");
-                        int monthIndex = response.indexOf("\"month\":");
-                        int dayIndex = response.indexOf("\"day\":");
-                        int hourIndex = response.indexOf("\"hour\":");
-                        int minuteIndex = response.indexOf("\"minute\":");
-                        int secondsIndex = response.indexOf("\"seconds\":");
-
-                        if (yearIndex != -1 && monthIndex != -1 && dayIndex != -1 &&
-                            hourIndex != -1 && minuteIndex != -1 && secondsIndex != -1) 
-                        {
-                            int year = response.substring(yearIndex + 7, response.indexOf(",", yearIndex)).toInt();
-                            int month = response.substring(monthIndex + 8, response.indexOf(",", monthIndex)).toInt();
-                            int day = response.substring(dayIndex + 6, response.indexOf(",", dayIndex)).toInt();
-                            int hour = response.substring(hourIndex + 7, response.indexOf(",", hourIndex)).toInt();
-                            int minute = response.substring(minuteIndex + 9, response.indexOf(",", minuteIndex)).toInt();
-                            int seconds = response.substring(secondsIndex + 10, response.indexOf(",", secondsIndex)).toInt();
-
-                            // Convert to UNIX time
-                            struct tm timeinfo;
-                            timeinfo.tm_year = year - 1900;  // tm_year is years since 1900
-                            timeinfo.tm_mon = month - 1;    // tm_mon is 0-based
-                            timeinfo.tm_mday = day;
-                            timeinfo.tm_hour = hour;
-                            timeinfo.tm_min = minute;
-                            timeinfo.tm_sec = seconds;
-
-                            // Use mktime to compute the UNIX timestamp
-                            time_t rawTime = mktime(&timeinfo); // GMT+0000 timezone
-                            if (rawTime != -1) 
-                            {
-                                syncedTimestamp = (uint32_t)rawTime;
-                                syncMillis = millis();
-                                Serial.print("Synced Timestamp from timeapi.io: ");
-                                Serial.println(syncedTimestamp);
-                                return true;
-                            }
-                        }
-                    }
-
-                    if (syncedTimestamp > 0) 
-                    {
-                        syncMillis = millis(); // Record when the sync happened
-                        Serial.print("Time Synced Succesfull: Timestamp: "); // + syncMillis
-                        Serial.println(String(syncedTimestamp));
-                        http.end();
-                        return true;
-                    }
-                } 
-                else 
-                {
-                    Serial.print("HTTP GET failed with code: ");
-                    Serial.println(httpResponseCode);
-                }
-
-                http.end();
-            }
+        if (!doc["error"].isNull() || !doc["message"].isNull())
+        {
+            LOG_WARN(LOG_NETWORK, "API Error: %s", doc["error"].as<const char*>());
+            return "";
         }
 
-        Serial.println("Failed to sync time with all APIs.");
-        return false;
+        return doc["Command"].as<String>();
+    }
+
+    // Advance the SNTP exchange (non-blocking). Returns true once the clock was set
+    bool synchronizeTime()
+    {
+        clockService->loop();
+        return clockService->isSynchronized();
+    }
+
+    bool isTimeSynchronized()
+    {
+        return clockService->isSynchronized();
+    }
+
+    ClockService& getClockService()
+    {
+        return *clockService;
     }
 
     // Function to get the current real-time (non-blocking)
     unsigned long getCurrentTime(bool ro_time = false) 
     {
-        if (syncedTimestamp == 0) 
+        unsigned long unixTime = clockService->getUnixTime();
+        if (unixTime == 0) 
         {
-            Serial.println("Time not synced yet!");
+            LOG_DEBUG(LOG_TIME, "Time not synced yet!");
             return 0; // Return 0 if time is not synced
         }
 
@@ -572,12 +537,12 @@ public:
             gmtPlusTwoOffset = 7200;
         }
 
-        // Calculate the current time based on syncedTimestamp and elapsed time
-        return syncedTimestamp + ((millis() - syncMillis) / 1000) + gmtPlusTwoOffset;
+        return unixTime + gmtPlusTwoOffset;
     }
 
     void disconnect()
     {
+        backendConnection->disconnect();
         WiFi.disconnect();
     }
 };
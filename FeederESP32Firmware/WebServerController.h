@@ -1,7 +1,11 @@
 #include <WiFi.h>
 #include <ESPAsyncWebServer.h>
 #include <ArduinoJson.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
 #include "MemoryController.h"
+#include "PortalAssets.h"
+#include "FeederLog.h"
 
 // Create an Access Point Server that saves the wifi password into memory
 class WebServerController
@@ -11,16 +15,113 @@ private:
     const char *apPassword = "12345678"; // AP Password (min 8 characters)
     AsyncWebServer* server = NULL; // Web server instance
     MemoryController* memoryController;
+    MemoryController* stationMemories[StationProfile::MAX_STATIONS]; // Indexed by station, [0] is memoryController
+    int numOfStations = 1;
+
+    // Networks are scanned one channel at a time, so the AP keeps serving its clients between
+    // channels and /scan answers right away with the networks seen so far
+    static constexpr uint8_t LAST_SCAN_CHANNEL = 13;
+    static constexpr uint32_t SCAN_TIME_PER_CHANNEL = 120;       // Active scan dwell time (ms)
+    static constexpr unsigned long SCAN_RESULTS_MAX_AGE = 15000; // A /scan after this starts a new sweep (ms)
+    static constexpr unsigned long NETWORK_EXPIRY = 120000;      // Networks not seen for this long are dropped (ms)
+    static constexpr int MAX_NETWORKS = 24;
+    static constexpr unsigned long RESTART_DELAY = 1000;         // Time to send the response before restarting (ms)
+
+    struct ScannedNetwork
+    {
+        char ssid[33];
+        int8_t rssi;
+        bool isSecure;
+        unsigned long lastSeenTime;
+    };
+
+    // Written by loop() (networking task), read by the /scan handler (async TCP task)
+    ScannedNetwork networks[MAX_NETWORKS];
+    int numOfNetworks = 0;
+    SemaphoreHandle_t networksLock = nullptr;
+
+    uint8_t scanChannel = 0; // Channel being scanned, 0 when no sweep is running
+    volatile bool scanRequested = false;
+    volatile bool isSweepDone = false;
+    volatile unsigned long lastSweepTime = 0;
+
+    volatile bool restartRequested = false;
+    unsigned long restartRequestTime = 0;
+
+    void startChannelScan()
+    {
+        if (WiFi.scanNetworks(true, false, false, SCAN_TIME_PER_CHANNEL, scanChannel) == WIFI_SCAN_FAILED)
+        {
+            LOG_WARN(LOG_NETWORK, "Wi-Fi scan failed on channel %d", scanChannel);
+            scanChannel = 0;
+        }
+    }
+
+    // Merge the results of one channel into the cached list
+    void mergeScanResults(int numOfResults)
+    {
+        unsigned long now = FeederClock::millis();
 
-    String scannedWiFiAdressesJson;
+        xSemaphoreTake(networksLock, portMAX_DELAY);
+        for (int i = 0; i < numOfResults; i++)
+        {
+            String ssid = WiFi.SSID(i);
+            if (ssid.isEmpty())
+            {
+                continue; // Hidden network
+            }
+
+            int index = 0;
+            while (index < numOfNetworks && strcmp(networks[index].ssid, ssid.c_str()) != 0)
+            {
+                index++;
+            }
+
+            if (index == numOfNetworks)
+            {
+                if (numOfNetworks == MAX_NETWORKS)
+                {
+                    continue; // Full, the list is trimmed of expired networks after each sweep
+                }
+                numOfNetworks++;
+                strlcpy(networks[index].ssid, ssid.c_str(), sizeof(networks[index].ssid));
+            }
+            else if (now - networks[index].lastSeenTime < SCAN_RESULTS_MAX_AGE && networks[index].rssi > WiFi.RSSI(i))
+            {
+                continue; // Seen stronger in this sweep, on another access point of the same network
+            }
+
+            networks[index].rssi = WiFi.RSSI(i);
+            networks[index].isSecure = WiFi.encryptionType(i) != WIFI_AUTH_OPEN;
+            networks[index].lastSeenTime = now;
+        }
+        xSemaphoreGive(networksLock);
+    }
+
+    void dropExpiredNetworks()
+    {
+        unsigned long now = FeederClock::millis();
+
+        xSemaphoreTake(networksLock, portMAX_DELAY);
+        int kept = 0;
+        for (int i = 0; i < numOfNetworks; i++)
+        {
+            if (now - networks[i].lastSeenTime <= NETWORK_EXPIRY)
+            {
+                networks[kept++] = networks[i];
+            }
+        }
+        numOfNetworks = kept;
+        xSemaphoreGive(networksLock);
+    }
 
 public:
     WebServerController(MemoryController* memController)
     {
-        Serial.println("WebServerController Constructor");
+        LOG_DEBUG(LOG_NETWORK, "WebServerController Constructor");
         memoryController = memController;
-
-        updateScannedWiFiAdressesJson();
+        stationMemories[0] = memController;
+        networksLock = xSemaphoreCreateMutex();
     }
 
     ~WebServerController()
@@ -32,16 +133,24 @@ public:
         }
     }
 
+    // Stations after the first, so the portal can set their feeder identity
+    void addStation(MemoryController* stationMemory)
+    {
+        if (numOfStations < StationProfile::MAX_STATIONS)
+        {
+            stationMemories[numOfStations++] = stationMemory;
+        }
+    }
+
     // Start AP mode and web server
     void startAP()
     {
         // start server on port 80
         server = new AsyncWebServer(80);
 
-        // Configure Access Point
+        // Configure Access Point. WifiController keeps the station interface up (WIFI_AP_STA) for scanning
         WiFi.softAP(apSSID, apPassword);
-        Serial.print("Access Point Started: ");
-        Serial.println(apSSID);
+        LOG_INFO(LOG_NETWORK, "Access Point Started: %s", apSSID);
 
         // Setup web server routes
         server->on("/", HTTP_GET, [&](AsyncWebServerRequest *request) {
@@ -53,8 +162,17 @@ public:
         server->on("/saveAdress", HTTP_POST, [&](AsyncWebServerRequest *request) {
             handleSaveWifiAddress(request);
         });
+        server->on("/saveFeeder", HTTP_POST, [&](AsyncWebServerRequest *request) {
+            handleSaveFeeder(request);
+        });
+        server->on("/log", HTTP_GET, [&](AsyncWebServerRequest *request) {
+            handleLog(request);
+        });
 
         server->begin();
+
+        // Have the first results ready by the time a phone opens the page
+        scanRequested = true;
     }
 
     void stopAP()
@@ -66,219 +184,107 @@ public:
         server->end();
 
         // Print confirmation to Serial Monitor
-        Serial.println("Access Point Stopped.");
+        LOG_INFO(LOG_NETWORK, "Access Point Stopped.");
 
         delete server;
         server = NULL;
     }
 
-    // Handle root webpage
-    void handleRoot(AsyncWebServerRequest *request)
-    {
-        String html = R"rawliteral(
-          <!DOCTYPE html>
-          <html>
-          <head>
-              <style>
-                  body {
-                      font-family: Arial, sans-serif;
-                      margin: 0;
-                      padding: 0;
-                      display: flex;
-                      flex-direction: column;
-                      align-items: center;
-                      justify-content: center;
-                      min-height: 100vh;
-                      background-color: #f4f4f9;
-                      color: #333;
-                  }
-                  h2 {
-                      margin-bottom: 20px;
-                      color: #555;
-                  }
-                  button, input[type="submit"] {
-                      background-color: #4CAF50;
-                      color: white;
-                      border: none;
-                      padding: 10px 20px;
-                      text-align: center;
-                      text-decoration: none;
-                      display: inline-block;
-                      font-size: 16px;
-                      margin: 10px 5px;
-                      cursor: pointer;
-                      border-radius: 5px;
-                      transition: background-color 0.3s ease;
-                  }
-                  button:hover, input[type="submit"]:hover {
-                      background-color: #45a049;
-                  }
-                  label {
-                      display: block;
-                      margin-top: 10px;
-                      margin-bottom: 5px;
-                      font-weight: bold;
-                  }
-                  input, select {
-                      width: 100%;
-                      max-width: 300px;
-                      padding: 8px;
-                      margin-bottom: 15px;
-                      border: 1px solid #ccc;
-                      border-radius: 4px;
-                      box-sizing: border-box;
-                  }
-                  #status {
-                      margin-top: 10px;
-                      font-style: italic;
-                      color: #d9534f;
-                  }
-                  .container {
-                      max-width: 400px;
-                      padding: 20px;
-                      background: white;
-                      border: 1px solid #ddd;
-                      border-radius: 8px;
-                      box-shadow: 0 4px 8px rgba(0, 0, 0, 0.1);
-                      text-align: center;
-                  }
-              </style>
-          </head>
-          <body>
-              <div class="container">
-                  <h2>Wi-Fi Configuration</h2>
-                  <button onclick="scan()">Scan Networks</button>
-                  <select id="ssid" required></select>
-                  <label for="password">Password:</label>
-                  <input id="password" type="password" placeholder="Enter your Wi-Fi password" required>
-                  <input type="submit" value="Save Wi-Fi Address" onclick="saveWifi()">
-                  <p id="status"></p>
-              </div>
-              <script>
-                  // Scan for networks
-                  function scan() {
-                      fetch('/scan')
-                      .then(response => response.json())
-                      .then(data => {
-                          let dropdown = document.getElementById('ssid');
-                          dropdown.innerHTML = '';
-                          data.forEach(net => {
-                              dropdown.innerHTML += `<option value="${net}">${net}</option>`;
-                          });
-                      });
-                  }
-
-                  // Connect to selected network
-                  function saveWifi() {
-                      let ssid = document.getElementById('ssid').value.trim();
-                      let password = document.getElementById('password').value.trim();
-
-                      if (!ssid || !password) {
-                          document.getElementById('status').innerText = "Please provide both SSID and password.";
-                          return;
-                      }
-
-                      let formData = new FormData();
-                      formData.append('ssid', ssid);
-                      formData.append('password', password);
-
-                      fetch('/saveAdress', {
-                          method: 'POST',
-                          body: formData
-                      })
-                      .then(response => {
-                          if (!response.ok) {
-                              throw new Error(`Error: ${response.status}`);
-                          }
-                          return response.text();
-                      })
-                      .then(data => {
-                          document.getElementById('status').innerText = data;
-                          document.getElementById('status').style.color = '#5cb85c';
-                      })
-                      .catch(error => {
-                          document.getElementById('status').innerText = error.message;
-                      });
-                  }
-              </script>
-          </body>
-          </html>
-          )rawliteral";
-
-        request->send(200, "text/html", html);
-    }
-
-    // Handle Wi-Fi scanning
-    void handleScan(AsyncWebServerRequest *request)
+    // Advance the channel scan and the pending restart. Non-blocking, called by WifiController while the AP runs
+    void loop()
     {
-        request->send(200, "application/json", scannedWiFiAdressesJson);
-    }
-
-    void updateScannedWiFiAdressesJson()
-    {   
-        scannedWiFiAdressesJson = "";
+        if (restartRequested && FeederClock::millis() - restartRequestTime >= RESTART_DELAY)
+        {
+            for (int index = 0; index < numOfStations; index++)
+            {
+                stationMemories[index]->commit();
+            }
+            ESP.restart();
+        }
 
-        Serial.println("Scan Wi-Fi networks:");
+        if (scanChannel == 0)
+        {
+            if (scanRequested)
+            {
+                scanRequested = false;
+                scanChannel = 1;
+                startChannelScan();
+            }
+            return;
+        }
 
-        WiFi.mode(WIFI_STA);
-        WiFi.disconnect(true);
-        delay(100);
+        int numOfResults = WiFi.scanComplete();
+        if (numOfResults == WIFI_SCAN_RUNNING)
+        {
+            return;
+        }
 
-        Serial.println("Starting asynchronous Wi-Fi scan...");
-        int scanStart = WiFi.scanNetworks(true); // Start asynchronous scan
-        if (scanStart == WIFI_SCAN_RUNNING) 
+        if (numOfResults > 0)
         {
-            Serial.println("Scan started successfully!");
+            mergeScanResults(numOfResults);
         }
-        else
+        WiFi.scanDelete(); // Clear scan results
+
+        if (scanChannel < LAST_SCAN_CHANNEL)
         {
-            Serial.printf("Failed to start scan. Error code: %d\n", scanStart);
-            scannedWiFiAdressesJson = "[]";
+            scanChannel++;
+            startChannelScan();
             return;
         }
 
-        // Wait for scan to complete (polling)
-        int timeout = 10; // 10 seconds timeout
-        while (WiFi.scanComplete() == WIFI_SCAN_RUNNING && timeout > 0) 
+        scanChannel = 0;
+        dropExpiredNetworks();
+        lastSweepTime = FeederClock::millis();
+        isSweepDone = true;
+        LOG_INFO(LOG_NETWORK, "Wi-Fi scan complete, %d networks", numOfNetworks);
+    }
+
+    // Handle root webpage: the compressed page is sent straight from flash
+    void handleRoot(AsyncWebServerRequest *request)
+    {
+        AsyncWebServerResponse* response = request->beginResponse(200, "text/html", PORTAL_INDEX_HTML_GZ, PORTAL_INDEX_HTML_GZ_LENGTH);
+        response->addHeader("Content-Encoding", "gzip");
+        response->addHeader("Cache-Control", "max-age=3600");
+        request->send(response);
+    }
+
+    // Handle Wi-Fi scanning: {"scanning": true, "networks": [{"ssid": "...", "rssi": -60, "secure": true, "age": 4}]}.
+    // Answers from the cache and starts a new sweep when the cache is old
+    void handleScan(AsyncWebServerRequest *request)
+    {
+        if (!isSweepDone || FeederClock::millis() - lastSweepTime > SCAN_RESULTS_MAX_AGE)
         {
-            delay(1000); // Wait 1 second
-            timeout--;
-            Serial.print(".");
+            scanRequested = true;
         }
 
-        int n = WiFi.scanComplete(); // Get the scan result
-        scannedWiFiAdressesJson = "[";
+        unsigned long now = FeederClock::millis();
+        JsonDocument doc;
+        doc["scanning"] = scanRequested || scanChannel != 0;
+        JsonArray networkList = doc["networks"].to<JsonArray>();
 
-        if (n <= 0) 
+        xSemaphoreTake(networksLock, portMAX_DELAY);
+        for (int i = 0; i < numOfNetworks; i++)
         {
-            if (n == WIFI_SCAN_FAILED) 
-            {
-                Serial.println("Wi-Fi scan failed.");
-            }
-            else
-            {
-                Serial.println("No networks found.");
-            }    
-        } 
-        else
-        {
-            Serial.printf("\nFound %d networks:\n", n);
-            for (int i = 0; i < n; ++i) 
-            {
-                if (i > 0)
-                    scannedWiFiAdressesJson += ",";
-                scannedWiFiAdressesJson += "\"" + WiFi.SSID(i) + "\"";
-
-                Serial.printf("%d: %s (%d dBm) %s\n", i + 1, WiFi.SSID(i).c_str(), WiFi.RSSI(i), (WiFi.encryptionType(i) == WIFI_AUTH_OPEN) ? "open" : "encrypted");
-            }
-            WiFi.scanDelete(); // Clear scan results
+            JsonObject network = networkList.add<JsonObject>();
+            network["ssid"] = networks[i].ssid;
+            network["rssi"] = networks[i].rssi;
+            network["secure"] = networks[i].isSecure;
+            network["age"] = (now - networks[i].lastSeenTime) / 1000;
         }
+        xSemaphoreGive(networksLock);
 
-        scannedWiFiAdressesJson += "]";
-
-        Serial.println("Scan complete, JSON returned.");
+        AsyncResponseStream* response = request->beginResponseStream("application/json");
+        serializeJson(doc, *response);
+        request->send(response);
     }
 
+    // Handle log retrieval: the records still in the log ring, oldest first
+    void handleLog(AsyncWebServerRequest *request)
+    {
+        AsyncResponseStream* response = request->beginResponseStream("text/plain");
+        FeederLog::dump(*response);
+        request->send(response);
+    }
 
     // Handle Wi-Fi save address
     void handleSaveWifiAddress(AsyncWebServerRequest *request) 
@@ -299,7 +305,7 @@ public:
                 password = p->value();
             }
 
-            Serial.printf("POST[%s]: %s\n", p->name().c_str(), p->value().c_str());
+            LOG_DEBUG(LOG_NETWORK, "POST[%s]", p->name());
         }
 
         // Check if both SSID and password were provided
@@ -315,8 +321,60 @@ public:
         // Respond with success
         request->send(200, "text/plain", "Wi-Fi network saved successfully!");
 
-        delay(3000);
+        // Restart from loop() to start reconnecting to the new set wifi password, the response is still being sent
+        restartRequestTime = FeederClock::millis();
+        restartRequested = true;
+    }
+
+    // Handle the backend identity of a station: the feeder ID and password it logs in with
+    void handleSaveFeeder(AsyncWebServerRequest *request)
+    {
+        int station = -1;
+        String id;
+        String password;
+
+        for (int i = 0; i < request->params(); i++)
+        {
+            const AsyncWebParameter* p = request->getParam(i);
+            if (p->name() == "station")
+            {
+                station = p->value().toInt();
+            }
+            else if (p->name() == "id")
+            {
+                id = p->value();
+            }
+            else if (p->name() == "password")
+            {
+                password = p->value();
+            }
+        }
+
+        if (station < 0 || station >= numOfStations)
+        {
+            request->send(400, "text/plain", "Unknown station.");
+            return;
+        }
+
+        if (id.isEmpty() || password.isEmpty())
+        {
+            request->send(400, "text/plain", "Missing Feeder ID or Password.");
+            return;
+        }
+
+        if (id.length() > MemoryController::MAX_FEEDER_ID_LENGTH || password.length() > MemoryController::MAX_FEEDER_PASSWORD_LENGTH)
+        {
+            request->send(400, "text/plain", "Feeder ID or Password too long.");
+            return;
+        }
+
+        stationMemories[station]->saveFeederIdentity(id, password);
+        LOG_INFO(LOG_NETWORK, "Feeder ID of station %d set to %s", station, id.c_str());
+
+        request->send(200, "text/plain", "Feeder identity saved successfully!");
 
-        ESP.restart(); // restart to start reconnecting to the new set wifi password
+        // Restart so the backend connection and command channel log in with the new identity
+        restartRequestTime = FeederClock::millis();
+        restartRequested = true;
     }
-};
\ No newline at end of file
+};
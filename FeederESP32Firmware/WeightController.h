@@ -1,46 +1,168 @@
 #ifndef WEIGHT_CONTROLLER_H
 #define WEIGHT_CONTROLLER_H
 
-#include "HX711.h"
+#include <atomic>
+#include "FeederHal.h"
 #include "MemoryController.h"
+#include "FeederDataTypes.h"
+#include "BootTrace.h"
+#include "DeadlineQueue.h"
+#include "FeederLog.h"
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
 
 class WeightController
 {
 private:
 
-    struct ScalePins
-    {
-        // Pin definitions for the HX711
-        static constexpr int DATA_PIN = 27;  // Data pin for the HX711
-        static constexpr int CLOCK_PIN = 14; // Clock pin for the HX711
-    };
-
-    HX711 scale; // HX711 load cell amplifier instance
+    ScaleDriver* scale = nullptr; // HX711 load cell amplifier
 
     // Calibration factor for the scale
     float calibrationFactor = 466170.09;
 
-    // Cached weight value to return if the scale is not ready
-    int cachedWeight = -1;
-
     // Offset to adjust the weight readings
     int offset = 0;
 
+    // Sampling: every conversion while the dispenser motor runs (10/80 SPS depending on the
+    // HX711 RATE pin), one sample every IDLE_SAMPLE_INTERVAL otherwise
+    static constexpr unsigned long IDLE_SAMPLE_INTERVAL = 500; // ms
+    static constexpr unsigned long READY_TIMEOUT = 200;        // Longer than one conversion at 10 SPS (ms)
+    static constexpr int MEDIAN_WINDOW = 5;                    // Samples used by the median filter (odd)
+    static constexpr float FAST_IIR_ALPHA = 0.6f;              // Follows the weight closely while dispensing
+    static constexpr float IDLE_IIR_ALPHA = 0.2f;              // Smooths out vibrations while idle
+    static constexpr int STABLE_BAND = 2;                      // grams
+
+    // Lock-free single-producer ring of raw samples, written by the sampler task only
+    static constexpr int RING_SIZE = 16;
+    WeightReading ring[RING_SIZE];
+    std::atomic<uint32_t> ringHead{0}; // Number of samples written so far
+
+    // Latest filtered reading, published with a sequence lock so readers never block the sampler
+    WeightReading published = {-1, 0, false};
+    std::atomic<uint32_t> publishedSequence{0};
+
+    std::atomic<bool> fastSampling{false};
+    float filteredWeight = 0;
+    bool hasFilteredWeight = false;
+
+    TaskHandle_t samplerTask = nullptr;
+
+    static void samplerTaskEntry(void* parameter)
+    {
+        static_cast<WeightController*>(parameter)->runSampler();
+    }
+
+    void runSampler()
+    {
+        // Tare here rather than in the constructor: it averages ~1 s of conversions at 10 SPS,
+        // and waits for the HX711 to answer, while the rest of the firmware is already running
+        while (!scale->waitReady(READY_TIMEOUT))
+        {
+            vTaskDelay(DeadlineQueue::toTicks(IDLE_SAMPLE_INTERVAL));
+        }
+        scale->tare(); // Reset the scale to zero
+        BootTrace::mark("scale tared");
+
+        for (;;)
+        {
+            if (!fastSampling.load())
+            {
+                vTaskDelay(DeadlineQueue::toTicks(IDLE_SAMPLE_INTERVAL));
+            }
+
+            // Blocks on the DOUT falling edge, so no conversion is missed at 80 SPS
+            if (!scale->waitReady(READY_TIMEOUT))
+            {
+                continue; // HX711 not answering, readers keep the last value
+            }
+
+            sample();
+        }
+    }
+
+    void sample()
+    {
+        // Read the weight and ensure it's non-negative
+        float rawWeight = scale->getUnits() * 1000.0f; // Convert to grams
+        int grams = max(0, static_cast<int>(rawWeight));
+        unsigned long now = FeederClock::millis();
+
+        uint32_t head = ringHead.load();
+        ring[head % RING_SIZE] = {grams + offset, now, false};
+        ringHead.store(head + 1);
+
+        // Median of the last samples drops single spikes (e.g. the motor kicking in)
+        int window[MEDIAN_WINDOW];
+        int windowSize = head + 1 < MEDIAN_WINDOW ? (int)(head + 1) : MEDIAN_WINDOW;
+        for (int i = 0; i < windowSize; i++)
+        {
+            window[i] = ring[(head - i) % RING_SIZE].weight;
+        }
+        int median = medianOf(window, windowSize);
+        int spread = window[windowSize - 1] - window[0]; // medianOf() sorts the window
+
+        // IIR low-pass on top of the median
+        float alpha = fastSampling.load() ? FAST_IIR_ALPHA : IDLE_IIR_ALPHA;
+        filteredWeight = hasFilteredWeight ? filteredWeight + alpha * (median - filteredWeight) : median;
+        hasFilteredWeight = true;
+
+        publish({(int)(filteredWeight + 0.5f), now, windowSize == MEDIAN_WINDOW && spread <= STABLE_BAND});
+    }
+
+    static int medianOf(int* values, int count)
+    {
+        // Insertion sort, the window is tiny
+        for (int i = 1; i < count; i++)
+        {
+            int value = values[i];
+            int j = i - 1;
+            while (j >= 0 && values[j] > value)
+            {
+                values[j + 1] = values[j];
+                j--;
+            }
+            values[j + 1] = value;
+        }
+
+        return values[count / 2];
+    }
+
+    void publish(const WeightReading& reading)
+    {
+        publishedSequence.fetch_add(1); // Odd: write in progress
+        published = reading;
+        publishedSequence.fetch_add(1); // Even: consistent
+    }
+
 public:
     static constexpr float INVALID_WEIGHT_VALUE = -1.0f;
 
-    WeightController()
+    explicit WeightController(ScaleDriver* scaleDriver) : scale(scaleDriver)
+    {
+        scale->setScale(calibrationFactor); // Set calibration factor
+    }
+
+    // Start the background sampler. From then on only the sampler task talks to the HX711.
+    // Readings are invalid (-1) until the sampler has tared the scale
+    void startSampling(UBaseType_t priority, BaseType_t core)
+    {
+        if (samplerTask == nullptr)
+        {
+            xTaskCreatePinnedToCore(samplerTaskEntry, "scale", 3072, this, priority, &samplerTask, core);
+        }
+    }
+
+    // Sample every conversion while food is being dispensed, slowly otherwise
+    void setFastSampling(bool enabled)
     {
-        scale.begin(ScalePins::DATA_PIN, ScalePins::CLOCK_PIN);
-        scale.set_scale(calibrationFactor); // Set calibration factor
-        scale.tare(); // Reset the scale to zero
+        fastSampling.store(enabled);
     }
 
     void setCalibrationFactor(float calibFact)
     {
-        Serial.println("WeightController: Calibration factor set");
+        LOG_INFO(LOG_SCALE, "WeightController: Calibration factor set");
         calibrationFactor = calibFact;
-        scale.set_scale(calibrationFactor);
+        scale->setScale(calibrationFactor);
     }
 
     float getCalibrationFactor() const
@@ -54,22 +176,44 @@ public:
         offset = offsetToSet;
     }
 
-    // Get the current weight in grams
-    int getWeight()
+    // Latest filtered reading. Non-blocking and O(1): retries only if the sampler published
+    // a new value while it was being copied
+    WeightReading getReading()
     {
-        if (scale.is_ready())
+        WeightReading reading;
+        uint32_t sequence;
+
+        do
         {
-            // Read the weight, apply the offset, and ensure it's non-negative
-            float rawWeight = scale.get_units() * 1000.0f; // Convert to grams
-            cachedWeight = max(0, static_cast<int>(rawWeight)) + offset;
-            return cachedWeight;
-        }
-        else
+            sequence = publishedSequence.load();
+            reading = published;
+        } while ((sequence & 1) != 0 || sequence != publishedSequence.load());
+
+        return reading;
+    }
+
+    // Get the current weight in grams (-1 if the HX711 never answered)
+    int getWeight()
+    {
+        return getReading().weight;
+    }
+
+    // Copy up to maxSamples of the most recent unfiltered samples (offset included), oldest first.
+    // Returns the number copied
+    int getRecentSamples(WeightReading* samples, int maxSamples)
+    {
+        uint32_t head = ringHead.load();
+        int available = head < RING_SIZE - 1 ? (int)head : RING_SIZE - 1;
+        int count = maxSamples < available ? maxSamples : available;
+
+        for (int i = 0; i < count; i++)
         {
-            Serial.println("WeightController: HX711 not found. Returning cached weight");
-            return cachedWeight; // Return the last valid weight if the scale is not ready
+            samples[i] = ring[(head - count + i) % RING_SIZE];
         }
+
+        // The slot after head is the only one the sampler may be rewriting, and it is never copied
+        return count;
     }
 };
 
-#endif // WEIGHT_CONTROLLER_H
\ No newline at end of file
+#endif // WEIGHT_CONTROLLER_H
@@ -1,6 +1,11 @@
 #include <WebServerController.h>
 #include <WebConnectionController.h>
 #include "MemoryController.h"
+#include "BootTrace.h"
+#include "StationProfile.h"
+#include "TaskQueues.h"
+#include "DeadlineQueue.h"
+#include "FeederLog.h"
 #include <Arduino.h>
 #include <freertos/FreeRTOS.h>
 #include <freertos/task.h>
@@ -12,11 +17,25 @@ private:
     WebServerController* webServer = nullptr;
     WebConnectionController* webConnection = nullptr;
 
+    // Controllers of the other stations on the board, refreshed with station 0 on every connection
+    WebConnectionController* stationConnections[StationProfile::MAX_STATIONS - 1] = {};
+    int numOfStationConnections = 0;
+
     int retryCount = 0;
     const int maxRetries = 3;
 
-    int serverStartTime = 0;
-    const int serverTimeout = 180000; // 5-minute
+    // Connection attempts run in the background: loop() checks on them instead of waiting
+    static constexpr unsigned long CONNECT_TIMEOUT = 7500; // Time given to each attempt (ms)
+    static constexpr unsigned long PORTAL_POLL_INTERVAL = 100; // Channel scan and restart checks of the portal (ms)
+    bool isWifiStarted = false;
+    bool isStationOnly = false; // Power save: the soft-AP is only added while the portal is up
+    bool isConnecting = false;
+    bool wasConnected = false;
+    bool isFirstConnection = true;
+    unsigned long connectStartTime = 0;
+
+    unsigned long serverStartTime = 0;
+    const unsigned long serverTimeout = 180000; // 5-minute
     bool isServerActive = false;
 
     void startWebServer()
@@ -32,6 +51,32 @@ private:
     void startWifiClient()
     { 
         webConnection->connectToWifi();
+        isConnecting = true;
+        connectStartTime = FeederClock::millis();
+    }
+
+    // Runs once per connection: the feeder record may have changed while the feeder was offline
+    void onConnected()
+    {
+        LOG_INFO(LOG_NETWORK, "Wi-Fi connected! IP address: %s", WiFi.localIP().toString());
+
+        if (isFirstConnection)
+        {
+            BootTrace::mark("wifi connected");
+        }
+
+        webConnection->fetchFeederData();
+        for (int station = 0; station < numOfStationConnections; station++)
+        {
+            stationConnections[station]->fetchFeederData();
+        }
+
+        if (isFirstConnection)
+        {
+            BootTrace::mark("config fetched");
+            BootTrace::print();
+            isFirstConnection = false;
+        }
     }
 
     void stopWifiClient()
@@ -42,12 +87,10 @@ private:
 public:
     WifiController(MemoryController* memController)
     {
-        Serial.println("WifiController Constructor...");
+        LOG_DEBUG(LOG_NETWORK, "WifiController Constructor...");
         memoryController = memController;
         webServer = new WebServerController(memoryController);
         webConnection = new WebConnectionController(memoryController);
-        WiFi.mode(WIFI_AP_STA);
-        startWifiClient();
     }
 
     WebConnectionController* getWebConnection()
@@ -55,36 +98,114 @@ public:
         return webConnection;
     }
 
+    // Start the station without the soft-AP, which softAP() adds when the portal starts. Modem sleep
+    // is unavailable in AP+STA mode. Call before the networking task starts
+    void setStationOnly(bool stationOnly)
+    {
+        isStationOnly = stationOnly;
+    }
+
+    // Stations after the first: their config is fetched on connect, and the portal sets their identity
+    void addStation(MemoryController* stationMemory, WebConnectionController* stationConnection)
+    {
+        if (numOfStationConnections < StationProfile::MAX_STATIONS - 1)
+        {
+            stationConnections[numOfStationConnections++] = stationConnection;
+            webServer->addStation(stationMemory);
+        }
+    }
+
+    // Non-blocking, called from the networking task
     void loop()
     {   
-        if (!isServerActive && !webConnection->haveInternetConnection())
+        // The Wi-Fi stack is started by the networking task, so it never delays the boot of the control path
+        if (!isWifiStarted)
+        {
+            // Connection changes wake the networking task, which otherwise sleeps while connected
+            WiFi.onEvent([](arduino_event_id_t, arduino_event_info_t) { TaskQueues::wakeNetworking(); }, ARDUINO_EVENT_WIFI_STA_GOT_IP);
+            WiFi.onEvent([](arduino_event_id_t, arduino_event_info_t) { TaskQueues::wakeNetworking(); }, ARDUINO_EVENT_WIFI_STA_DISCONNECTED);
+            WiFi.mode(isStationOnly ? WIFI_STA : WIFI_AP_STA);
+            startWifiClient();
+            isWifiStarted = true;
+            return;
+        }
+
+        bool isConnected = webConnection->haveInternetConnection();
+        if (isConnected && !wasConnected)
+        {
+            isConnecting = false;
+            retryCount = 0;
+            onConnected();
+        }
+        wasConnected = isConnected;
+
+        if (isConnecting && !isConnected)
+        {
+            if (FeederClock::millis() - connectStartTime < CONNECT_TIMEOUT)
+            {
+                return;
+            }
+
+            LOG_WARN(LOG_NETWORK, "Failed to connect to Wi-Fi");
+            stopWifiClient(); // to reset wifi module
+            isConnecting = false;
+        }
+
+        if (!isServerActive && !isConnected)
         {
             if (retryCount < maxRetries)
             {
-                Serial.println("WiFi connection try" +  String(retryCount) + "failed, retrying...");
+                LOG_INFO(LOG_NETWORK, "WiFi connection try %d failed, retrying...", retryCount);
                 retryCount++;
                 startWifiClient();
-                delay(1000);
             }
             else
             {
-                Serial.println("Max retries reached, starting WebServer AP for 2 minutes...");
+                LOG_WARN(LOG_NETWORK, "Max retries reached, starting WebServer AP for 2 minutes...");
                 stopWifiClient();
                 startWebServer();
                 isServerActive = true;
-                serverStartTime = millis();
+                serverStartTime = FeederClock::millis();
                 retryCount = 0; // Reset retry count
             }
         }
 
-        if (isServerActive && millis() - serverStartTime > serverTimeout)
+        if (isServerActive)
+        {
+            webServer->loop(); // Channel scan for the portal
+        }
+
+        if (isServerActive && FeederClock::millis() - serverStartTime > serverTimeout)
         {   
-            Serial.println("WebServer AP timeout, stopping AP and retrying WiFi connection...");
+            LOG_INFO(LOG_NETWORK, "WebServer AP timeout, stopping AP and retrying WiFi connection...");
             stopWebServer();
             isServerActive = false;
             startWifiClient();
             retryCount = 0;
         }
     }
+
+    // Time until loop() has to run again. While connecting it waits for the attempt timeout,
+    // the Wi-Fi events wake the networking task as soon as the attempt ends
+    unsigned long getMillisUntilDue()
+    {
+        if (!isWifiStarted)
+        {
+            return 0;
+        }
+
+        if (isServerActive)
+        {
+            return PORTAL_POLL_INTERVAL;
+        }
+
+        if (isConnecting)
+        {
+            unsigned long elapsed = FeederClock::millis() - connectStartTime;
+            return elapsed < CONNECT_TIMEOUT ? CONNECT_TIMEOUT - elapsed : 0;
+        }
+
+        return webConnection->haveInternetConnection() ? DeadlineQueue::NEVER : 0;
+    }
 };
 
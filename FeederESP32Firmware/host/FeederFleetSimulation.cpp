@@ -0,0 +1,478 @@
+// A fleet of feeders against the stand-in backend, in virtual time, to size the backend before a rollout.
+// Each feeder is a board with its own NVS partition running the networking side of FeederESP32Firmware.ino:
+// the real WebConnectionController, UplinkOutbox, CommandChannel and ClockService, with the app commands,
+// cat visits, dispenses and weight updates of a day turned into events. Backend traffic is what those
+// classes send: get_feeder at boot, the MQTT session the app commands are pushed through (polling
+// get_esp32_command only while it is down), add_events_batch or the per-event endpoints, and SNTP. A
+// backend outage in the middle of the run shows the retry behaviour.
+//
+// Usage: feeder_fleet_sim [--feeders N] [--hours H] [--seed S] [--legacy] [--no-push] [--workers W]
+//                         [--jitter PERCENT] [--poll-interval MS] [--poll-max-interval MS]
+//                         [--outage-minutes M] [--boot-spread S]
+//   --legacy            the backend has no add_events_batch.php (404), uploads fall back to the per-event endpoints
+//   --no-push           no broker, the app commands are polled for as before the push channel
+//   --jitter, --poll-*  FEEDER_POLL_JITTER_PERCENT, FEEDER_COMMAND_POLL_INTERVAL and FEEDER_COMMAND_POLL_MAX_INTERVAL
+// Exit status 0 when no event or command was lost, and no command poll ran while a push session was up
+
+#include <Arduino.h>
+
+// The polling knobs of the firmware, settable from the command line
+static unsigned long fleetPollJitterPercent = 20;
+static unsigned long fleetCommandPollInterval = 5000;
+static unsigned long fleetCommandPollMaxInterval = 120000;
+#define FEEDER_POLL_JITTER_PERCENT fleetPollJitterPercent
+#define FEEDER_COMMAND_POLL_INTERVAL fleetCommandPollInterval
+#define FEEDER_COMMAND_POLL_MAX_INTERVAL fleetCommandPollMaxInterval
+
+#include <algorithm>
+#include <chrono>
+#include <string>
+#include <vector>
+#include "SimulatedHal.h"
+#include "StandInBackend.h"
+#include "StationProfile.h"
+#include "MemoryController.h"
+#include "WebConnectionController.h"
+#include "UplinkOutbox.h"
+#include "CommandChannel.h"
+#include "DeadlineQueue.h"
+#include "FeederLog.h"
+
+static const int64_t START_UNIX = 1772424000LL; // 2026-03-02 04:00:00 UTC
+static const int64_t SECOND = 1000000LL;
+static const int64_t MINUTE = 60 * SECOND;
+static const int64_t HOUR = 60 * MINUTE;
+
+static const size_t FEEDER_STACK_SIZE = 64 * 1024;
+static const UBaseType_t NETWORKING_TASK_PRIORITY = 1;
+static const UBaseType_t COMMAND_READER_TASK_PRIORITY = 2;
+static const UBaseType_t SCENARIO_PRIORITY = 10;
+
+// Feeder behaviour, per feeder and day
+static const int DISPENSES_PER_DAY = 3;
+static const double VISIT_INTERVAL_MINUTES = 100.0;               // Mean time between cat visits
+static const unsigned long FOOD_WEIGHT_UPDATE_INTERVAL = 300000;  // As FeederESP32Firmware.ino (ms)
+static const unsigned long TIME_WAIT_INTERVAL = 10000;            // Events wait for the clock after boot (ms)
+
+enum FeederJob
+{
+    JOB_TIME_SYNC,
+    JOB_COMMANDS,
+    JOB_COMMAND_POLL,
+    JOB_WEIGHT_UPDATE,
+    JOB_OUTBOX,
+    JOB_NVS,
+    JOB_VISIT,
+    JOB_DISPENSE,
+    NUM_OF_JOBS
+};
+
+struct SimulatedFeeder
+{
+    std::string id;
+    std::string password;
+    int64_t bootTime = 0;
+    MemoryController* memoryController = nullptr;
+    WebConnectionController* webConnection = nullptr;
+    UplinkOutbox* uplinkOutbox = nullptr;
+    CommandChannel* commandChannel = nullptr;
+    DeadlineQueue deadlines;
+    std::mt19937 random;
+    uint32_t generatedEvents = 0;
+    uint32_t receivedCommands = 0;
+    bool isStarted = false;
+};
+
+static std::vector<SimulatedFeeder> feeders;
+static int64_t runEndTime = 0;
+
+static int64_t getWorldMicros()
+{
+    return START_UNIX * SECOND + HostRtos::now();
+}
+
+static void appendEvent(SimulatedFeeder& feeder, UplinkEventType type, unsigned long startTime, unsigned long endTime, float value)
+{
+    feeder.uplinkOutbox->append({type, startTime, endTime, value});
+    feeder.generatedEvents++;
+}
+
+// Delay to the next occurrence of a Poisson process with the given mean (ms)
+static unsigned long nextArrival(SimulatedFeeder& feeder, double meanMillis)
+{
+    std::exponential_distribution<double> gap(1.0 / meanMillis);
+    return (unsigned long)gap(feeder.random) + 1;
+}
+
+// The events of the feeding station, as the control tasks would queue them. They need the clock
+static void runStation(SimulatedFeeder& feeder)
+{
+    if (!feeder.webConnection->isTimeSynchronized())
+    {
+        feeder.deadlines.scheduleIn(JOB_VISIT, TIME_WAIT_INTERVAL);
+        feeder.deadlines.scheduleIn(JOB_DISPENSE, TIME_WAIT_INTERVAL);
+        return;
+    }
+
+    if (feeder.deadlines.isDue(JOB_VISIT))
+    {
+        std::uniform_int_distribution<unsigned long> duration(120, 360);
+        unsigned long closeTime = feeder.webConnection->getCurrentTime();
+        appendEvent(feeder, UplinkEventType::GATE_EVENT, closeTime - duration(feeder.random), closeTime, 0);
+        feeder.deadlines.scheduleIn(JOB_VISIT, nextArrival(feeder, VISIT_INTERVAL_MINUTES * 60000.0));
+    }
+
+    if (feeder.deadlines.isDue(JOB_DISPENSE))
+    {
+        unsigned long now = feeder.webConnection->getCurrentTime();
+        appendEvent(feeder, UplinkEventType::FOOD_DISPENSE_EVENT, now, 0, 20);
+        appendEvent(feeder, UplinkEventType::FOOD_WEIGHT_UPDATE, now, 0, 35);
+        feeder.deadlines.scheduleIn(JOB_DISPENSE, 24UL * 3600000UL / DISPENSES_PER_DAY);
+    }
+
+    if (feeder.deadlines.isDue(JOB_WEIGHT_UPDATE))
+    {
+        appendEvent(feeder, UplinkEventType::FOOD_WEIGHT_UPDATE, feeder.webConnection->getCurrentTime(), 0, 15);
+        feeder.deadlines.scheduleIn(JOB_WEIGHT_UPDATE, DeadlineQueue::withJitter(FOOD_WEIGHT_UPDATE_INTERVAL));
+    }
+}
+
+static void handleCommand(SimulatedFeeder& feeder, const String& command)
+{
+    if (command.indexOf("DispenseNow") == -1)
+    {
+        return;
+    }
+
+    feeder.receivedCommands++;
+    float quantity = command.substring(command.indexOf('_') + 1).toFloat();
+    appendEvent(feeder, UplinkEventType::FOOD_DISPENSE_EVENT, feeder.webConnection->getCurrentTime(), 0, quantity);
+}
+
+// processCommandsFromApp() of FeederESP32Firmware.ino
+static void processCommandsFromApp(SimulatedFeeder& feeder)
+{
+    String pushedCommand = feeder.commandChannel->loop();
+    if (pushedCommand.length() > 0)
+    {
+        handleCommand(feeder, pushedCommand);
+    }
+    feeder.deadlines.scheduleIn(JOB_COMMANDS, feeder.commandChannel->getMillisUntilDue());
+
+    if (feeder.commandChannel->isConnected())
+    {
+        feeder.deadlines.cancel(JOB_COMMAND_POLL);
+        return;
+    }
+
+    if (!feeder.deadlines.isArmed(JOB_COMMAND_POLL))
+    {
+        feeder.deadlines.scheduleIn(JOB_COMMAND_POLL, 0);
+    }
+
+    if (!feeder.deadlines.isDue(JOB_COMMAND_POLL))
+    {
+        return;
+    }
+
+    handleCommand(feeder, feeder.webConnection->getCommandFromApplication());
+    feeder.deadlines.scheduleIn(JOB_COMMAND_POLL, feeder.webConnection->getCommandPollDelay());
+}
+
+// Boot of one board, then the networking task of FeederESP32Firmware.ino for its single station
+static void feederTask(void* parameter)
+{
+    SimulatedFeeder& feeder = *static_cast<SimulatedFeeder*>(parameter);
+    HostRtos::sleepUntil(feeder.bootTime);
+
+    const StationProfile& profile = StationProfile::PROFILES[0];
+    feeder.memoryController = new MemoryController(profile);
+    feeder.webConnection = new WebConnectionController(feeder.memoryController);
+    feeder.uplinkOutbox = new UplinkOutbox(feeder.memoryController, feeder.webConnection);
+    feeder.commandChannel = new CommandChannel(feeder.memoryController->getFeederId(), feeder.memoryController->getFeederPassword());
+    feeder.commandChannel->startReader(COMMAND_READER_TASK_PRIORITY, 0);
+    feeder.isStarted = true;
+
+    feeder.webConnection->connectToWifi();
+    while (!feeder.webConnection->haveInternetConnection())
+    {
+        vTaskDelay(pdMS_TO_TICKS(1000));
+    }
+    feeder.webConnection->fetchFeederData();
+    feeder.deadlines.scheduleIn(JOB_WEIGHT_UPDATE, DeadlineQueue::withJitter(FOOD_WEIGHT_UPDATE_INTERVAL));
+    feeder.deadlines.scheduleIn(JOB_VISIT, nextArrival(feeder, VISIT_INTERVAL_MINUTES * 60000.0));
+    feeder.deadlines.scheduleIn(JOB_DISPENSE, feeder.random() % (24UL * 3600000UL / DISPENSES_PER_DAY));
+
+    for (;;)
+    {
+        // The station stops at the end of the run, so its last events can still be uploaded
+        if (HostRtos::now() < runEndTime)
+        {
+            runStation(feeder);
+        }
+        else
+        {
+            feeder.deadlines.cancel(JOB_VISIT);
+            feeder.deadlines.cancel(JOB_DISPENSE);
+            feeder.deadlines.cancel(JOB_WEIGHT_UPDATE);
+        }
+
+        feeder.webConnection->synchronizeTime();
+        feeder.deadlines.scheduleIn(JOB_TIME_SYNC, feeder.webConnection->getClockService().getMillisUntilDue());
+
+        processCommandsFromApp(feeder);
+
+        feeder.webConnection->consumeRegisteredTagsUpdate();
+        feeder.webConnection->consumeScheduleUpdate();
+
+        feeder.uplinkOutbox->loop();
+        feeder.deadlines.scheduleIn(JOB_OUTBOX, feeder.uplinkOutbox->getMillisUntilDue());
+
+        feeder.memoryController->loop();
+        feeder.deadlines.scheduleIn(JOB_NVS, feeder.memoryController->getMillisUntilDue());
+
+        ulTaskNotifyTake(pdTRUE, feeder.deadlines.getWaitTicks());
+    }
+}
+
+struct ScenarioEvent
+{
+    int64_t time;
+    int feeder; // -1: the backend goes down, -2: it comes back
+};
+
+int main(int argc, char** argv)
+{
+    int numOfFeeders = 1000;
+    double hours = 24;
+    uint32_t seed = 1;
+    bool legacy = false;
+    bool push = true;
+    int workers = StandInBackend::LatencyModel().workers;
+    double outageMinutes = 15;
+    double bootSpreadSeconds = 60;
+
+    for (int i = 1; i < argc; i++)
+    {
+        std::string argument = argv[i];
+        bool hasValue = i + 1 < argc;
+        if (argument == "--legacy")
+        {
+            legacy = true;
+        }
+        else if (argument == "--no-push")
+        {
+            push = false;
+        }
+        else if (argument == "--feeders" && hasValue)
+        {
+            numOfFeeders = std::max(1, atoi(argv[++i]));
+        }
+        else if (argument == "--hours" && hasValue)
+        {
+            hours = std::max(0.1, atof(argv[++i]));
+        }
+        else if (argument == "--seed" && hasValue)
+        {
+            seed = (uint32_t)strtoul(argv[++i], nullptr, 10);
+        }
+        else if (argument == "--workers" && hasValue)
+        {
+            workers = std::max(1, atoi(argv[++i]));
+        }
+        else if (argument == "--jitter" && hasValue)
+        {
+            fleetPollJitterPercent = std::min(99UL, strtoul(argv[++i], nullptr, 10));
+        }
+        else if (argument == "--poll-interval" && hasValue)
+        {
+            fleetCommandPollInterval = std::max(100UL, strtoul(argv[++i], nullptr, 10));
+        }
+        else if (argument == "--poll-max-interval" && hasValue)
+        {
+            fleetCommandPollMaxInterval = strtoul(argv[++i], nullptr, 10);
+        }
+        else if (argument == "--outage-minutes" && hasValue)
+        {
+            outageMinutes = std::max(0.0, atof(argv[++i]));
+        }
+        else if (argument == "--boot-spread" && hasValue)
+        {
+            bootSpreadSeconds = std::max(0.0, atof(argv[++i]));
+        }
+        else
+        {
+            fprintf(stderr, "Usage: %s [--feeders N] [--hours H] [--seed S] [--legacy] [--no-push] [--workers W] [--jitter PERCENT] [--poll-interval MS] [--poll-max-interval MS] "
+                            "[--outage-minutes M] [--boot-spread S]\n", argv[0]);
+            return 2;
+        }
+    }
+    fleetCommandPollMaxInterval = std::max(fleetCommandPollMaxInterval, fleetCommandPollInterval);
+
+    HostRtos::setMainPriority(SCENARIO_PRIORITY);
+    HostRtos::setStackSize(FEEDER_STACK_SIZE);
+    randomSeed(seed);
+    Serial.begin(115200);
+
+    StandInBackend::LatencyModel latencyModel;
+    latencyModel.workers = workers;
+    StandInBackend backend(latencyModel, getWorldMicros);
+    backend.setBatchEndpoint(!legacy);
+    backend.install();
+    if (!push)
+    {
+        HostNet::state().connect = nullptr;
+    }
+
+    // Requests per second of virtual time, for the peak load
+    runEndTime = (int64_t)(hours * HOUR);
+    std::vector<uint32_t> requestsPerSecond(runEndTime / SECOND + 3600, 0);
+    HostNet::HttpHandler backendHandler = HostNet::state().http;
+    HostNet::state().http = [&](const String& method, const String& url, const String& body) {
+        size_t second = std::min<size_t>(HostRtos::now() / SECOND, requestsPerSecond.size() - 1);
+        requestsPerSecond[second]++;
+        return backendHandler(method, url, body);
+    };
+    HostNet::setWifiUp(true);
+
+    // Provision every board, as the configuration portal does, then boot it
+    std::mt19937 random(seed);
+    std::uniform_real_distribution<double> bootOffset(0.0, bootSpreadSeconds * SECOND);
+    feeders.resize(numOfFeeders);
+    for (int index = 0; index < numOfFeeders; index++)
+    {
+        SimulatedFeeder& feeder = feeders[index];
+        char id[24];
+        snprintf(id, sizeof(id), "FLEET-%05d", index);
+        feeder.id = id;
+        feeder.password = "secret-" + std::to_string(index);
+        feeder.bootTime = (int64_t)bootOffset(random);
+        feeder.random.seed(seed * 7919 + index);
+
+        StandInBackend::Feeder& record = backend.addFeeder(feeder.id, feeder.password);
+        record.keepEvents = false;
+        record.schedule = "{\"07:00\":20,\"13:00\":15,\"19:30\":20}";
+        record.tags = {"7E3FE9", "1ECADE"};
+
+        HostNvs::setPartition(index);
+        MemoryController memoryController(StationProfile::PROFILES[0]);
+        memoryController.saveWifiData("fleet-ssid", "fleet-password");
+        memoryController.saveFeederIdentity(feeder.id.c_str(), feeder.password.c_str());
+        xTaskCreate(feederTask, "networking", 12288, &feeder, NETWORKING_TASK_PRIORITY, nullptr);
+    }
+    HostNvs::setPartition(0);
+
+    // One app command per feeder and started day, and the backend outage halfway
+    std::vector<ScenarioEvent> scenario;
+    std::uniform_int_distribution<int64_t> commandTime(10 * MINUTE, std::max(10 * MINUTE, runEndTime - 10 * MINUTE));
+    int days = std::max(1, (int)ceil(hours / 24));
+    for (int day = 0; day < days; day++)
+    {
+        for (int index = 0; index < numOfFeeders; index++)
+        {
+            scenario.push_back({commandTime(random), index});
+        }
+    }
+    int64_t outageStart = runEndTime / 2;
+    int64_t outageEnd = outageStart + (int64_t)(outageMinutes * MINUTE);
+    if (outageMinutes > 0)
+    {
+        scenario.push_back({outageStart, -1});
+        scenario.push_back({outageEnd, -2});
+    }
+    std::sort(scenario.begin(), scenario.end(), [](const ScenarioEvent& a, const ScenarioEvent& b) { return a.time < b.time; });
+
+    std::chrono::steady_clock::time_point wallStart = std::chrono::steady_clock::now();
+    int queuedCommands = 0;
+    for (const ScenarioEvent& event : scenario)
+    {
+        HostRtos::sleepUntil(event.time);
+        if (event.feeder >= 0)
+        {
+            backend.sendCommand(feeders[event.feeder].id, "DispenseNow_10");
+            queuedCommands++;
+        }
+        else
+        {
+            backend.setAvailable(event.feeder == -2);
+        }
+    }
+
+    // The load is measured over the run; then the outboxes flush what the stations queued last
+    HostRtos::sleepUntil(runEndTime);
+    std::map<std::string, StandInBackend::EndpointStats> endpointStats = backend.getEndpointStats();
+    HostRtos::sleepUntil(runEndTime + 10 * MINUTE);
+    double wallSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - wallStart).count();
+
+    uint64_t generatedEvents = 0;
+    uint64_t pendingEvents = 0;
+    uint64_t receivedCommands = 0;
+    uint64_t storedEvents = 0;
+    uint64_t duplicates = 0;
+    uint64_t pollsWhileSubscribed = 0;
+    for (SimulatedFeeder& feeder : feeders)
+    {
+        generatedEvents += feeder.generatedEvents;
+        receivedCommands += feeder.receivedCommands;
+        pendingEvents += feeder.isStarted ? feeder.uplinkOutbox->getPendingCount() : 0;
+        const StandInBackend::Feeder& record = backend.getFeeder(feeder.id);
+        storedEvents += record.numOfEvents;
+        duplicates += record.duplicates;
+        pollsWhileSubscribed += record.pollsWhileSubscribed;
+    }
+
+    size_t seconds = (size_t)(runEndTime / SECOND);
+    uint64_t totalRequests = 0;
+    uint32_t peakRequests = 0;
+    uint32_t peakAfterOutage = 0;
+    for (size_t second = 0; second < seconds; second++)
+    {
+        totalRequests += requestsPerSecond[second];
+        peakRequests = std::max(peakRequests, requestsPerSecond[second]);
+        if (outageMinutes > 0 && (int64_t)second * SECOND >= outageEnd && (int64_t)second * SECOND < outageEnd + 10 * MINUTE)
+        {
+            peakAfterOutage = std::max(peakAfterOutage, requestsPerSecond[second]);
+        }
+    }
+
+    double simulatedDays = hours / 24.0;
+    printf("Simulated %d feeders for %.1f h in %.2f s (%llu context switches)\n", numOfFeeders, hours, wallSeconds, (unsigned long long)HostRtos::getContextSwitches());
+    printf("Polling: jitter %lu%%, command poll %lu ms backing off to %lu ms; backend %s, %d workers, %.0f min outage at %.1f h\n", fleetPollJitterPercent, fleetCommandPollInterval,
+           fleetCommandPollMaxInterval, legacy ? "without add_events_batch" : "with add_events_batch", workers, outageMinutes, outageStart / (double)HOUR);
+    printf("Backend: %.1f requests/s on average, peak %u/s, peak %u/s in the 10 min after the outage\n", (double)totalRequests / seconds, peakRequests, peakAfterOutage);
+    printf("  %-24s %10s %8s %9s %9s %12s\n", "endpoint", "requests/s", "errors", "p50 ms", "p99 ms", "KB/day/feeder");
+    uint64_t totalBytes = 0;
+    for (const auto& endpoint : endpointStats)
+    {
+        const StandInBackend::EndpointStats& stats = endpoint.second;
+        totalBytes += stats.bytesReceived + stats.bytesSent;
+        printf("  %-24s %10.2f %8llu %9.0f %9.0f %12.2f\n", endpoint.first.c_str(), (double)stats.requests / seconds, (unsigned long long)stats.errors, stats.latency.getPercentile(0.5) / 1000.0,
+               stats.latency.getPercentile(0.99) / 1000.0, (stats.bytesReceived + stats.bytesSent) / 1024.0 / numOfFeeders / simulatedDays);
+    }
+    printf("Per feeder: %.1f KB/day (URL and bodies, without HTTP headers and TLS)\n", totalBytes / 1024.0 / numOfFeeders / simulatedDays);
+    printf("Events: %llu generated, %llu stored, %llu pending, %llu duplicates acknowledged; commands: %d queued, %llu received\n", (unsigned long long)generatedEvents,
+           (unsigned long long)storedEvents, (unsigned long long)pendingEvents, (unsigned long long)duplicates, queuedCommands, (unsigned long long)receivedCommands);
+
+    StandInBroker::Stats brokerStats = backend.getBroker().getTotals();
+    printf("Broker: %u connects, %u publishes (%u resent with DUP), %u pings; %llu command polls while subscribed\n", brokerStats.connects, brokerStats.publishes, brokerStats.redeliveries, brokerStats.pings,
+           (unsigned long long)pollsWhileSubscribed);
+
+    bool passed = true;
+    if (storedEvents + pendingEvents != generatedEvents)
+    {
+        printf("[FAIL] events were lost or stored twice\n");
+        passed = false;
+    }
+    if ((int)receivedCommands != queuedCommands)
+    {
+        printf("[FAIL] app commands were lost\n");
+        passed = false;
+    }
+    if (pollsWhileSubscribed > 0)
+    {
+        printf("[FAIL] commands were polled for while pushed\n");
+        passed = false;
+    }
+    printf("%s\n", passed ? "PASS" : "FAIL");
+    return passed ? 0 : 1;
+}
@@ -0,0 +1,91 @@
+// The FeederBenchmarks.h suite on the host, so its results can be reproduced without a board. The
+// controllers run on the simulated drivers; the timed sections read the host's monotonic clock
+// (micros()), while the firmware's own time (FeederClock) stays virtual. One JSON object per line.
+//
+// Usage: feeder_benchmarks [--sntp-iterations N]
+// On top of the device suite, sntp_exchange times WebConnectionController::synchronizeTime() against
+// the stand-in SNTP server: the call that sends the request and the call that parses the reply
+
+#include <Arduino.h>
+#include <string>
+#include "SimulatedHal.h"
+#include "SimulatedStation.h"
+#include "StandInBackend.h"
+#include "FeederStation.h"
+#include "StationProfile.h"
+#include "FeederBenchmarks.h"
+
+static const int64_t START_UNIX = 1772424000LL; // 2026-03-02 04:00:00 UTC
+static const int64_t SECOND = 1000000LL;
+static const int64_t SNTP_SYNC_INTERVAL = 3600 * SECOND; // ClockService resyncs hourly
+
+static int64_t getWorldMicros()
+{
+    return START_UNIX * SECOND + HostRtos::now();
+}
+
+// One synchronizeTime() round per iteration. Virtual time moves past the resync interval before the
+// request and past the reply latency before the parse, so each call does the full work
+static void runSntpExchangeBenchmark(WebConnectionController* webConnection, int iterations)
+{
+    unsigned long sendMicros = 0;
+    unsigned long parseMicros = 0;
+    int synchronized = 0;
+
+    for (int i = 0; i < iterations; i++)
+    {
+        HostRtos::sleepFor(SNTP_SYNC_INTERVAL);
+        unsigned long start = micros();
+        webConnection->synchronizeTime();
+        sendMicros += micros() - start;
+
+        HostRtos::sleepFor(StandInBackend::LatencyModel().sntpRoundTrip + StandInBackend::LatencyModel().roundTripJitter);
+        start = micros();
+        synchronized += webConnection->synchronizeTime() ? 1 : 0;
+        parseMicros += micros() - start;
+    }
+
+    Serial.printf("{\"benchmark\":\"sntp_exchange\",\"iterations\":%d,\"synchronized\":%d,\"sendNanos\":%u,\"parseNanos\":%u}\n", iterations, synchronized,
+                  FeederBenchmarks::nanosPerCall(sendMicros, iterations), FeederBenchmarks::nanosPerCall(parseMicros, iterations));
+}
+
+int main(int argc, char** argv)
+{
+    int sntpIterations = 1000;
+    for (int i = 1; i < argc; i++)
+    {
+        std::string argument = argv[i];
+        if (argument == "--sntp-iterations" && i + 1 < argc)
+        {
+            sntpIterations = std::max(1, atoi(argv[++i]));
+        }
+        else
+        {
+            fprintf(stderr, "Usage: %s [--sntp-iterations N]\n", argv[0]);
+            return 2;
+        }
+    }
+
+    Serial.begin(115200);
+
+    StandInBackend backend(StandInBackend::LatencyModel(), getWorldMicros);
+    backend.install();
+    HostNet::setWifiUp(true);
+
+    // Station 0 as setup() of FeederESP32Firmware.ino creates it, without starting its tasks
+    const StationProfile& profile = StationProfile::PROFILES[0];
+    FeederStation station;
+    station.profile = &profile;
+    station.memoryController = new MemoryController(profile);
+    station.webConnection = new WebConnectionController(station.memoryController);
+
+    SimulatedPins outputPins;
+    SimulatedStation simulatedStation(profile, &outputPins, 1);
+    station.gateController = new GateController(profile, station.webConnection, &outputPins);
+    station.weightController = new WeightController(simulatedStation.getScale());
+    station.feederController = new FeederController(profile, station.memoryController, station.weightController, station.webConnection, station.gateController);
+
+    FeederBenchmarks::runAll(station.feederController, station.webConnection);
+    runSntpExchangeBenchmark(station.webConnection, sntpIterations);
+    return 0;
+}
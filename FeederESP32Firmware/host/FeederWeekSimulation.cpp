@@ -0,0 +1,796 @@
+// A week of feeding on the host, in virtual time. The controllers of FeederStation.h run unchanged on
+// the simulated drivers (SimulatedStation.h) against the stand-in backend (StandInBackend.h), with the
+// task layout of FeederESP32Firmware.ino. A scenario of cat visits, app commands, a Wi-Fi outage and
+// backend incidents plays out, then the outcome is checked against what the backend stored.
+//
+// Usage: feeder_week_sim [-v] [--days N] [--seed S]
+//   -v  print the firmware log as it is written (otherwise only on a failed check)
+// Exit status 0 when every check passes
+
+#include <Arduino.h>
+#include <algorithm>
+#include <chrono>
+#include <string>
+#include <vector>
+#include "SimulatedHal.h"
+#include "SimulatedStation.h"
+#include "StandInBackend.h"
+#include "FeederStation.h"
+#include "StationProfile.h"
+#include "TaskQueues.h"
+#include "DeadlineQueue.h"
+#include "BootTrace.h"
+#include "FeederMetrics.h"
+#include "FeederLog.h"
+
+static const int NUM_OF_STATIONS = 1;
+
+// Scenario. The feeder boots at 06:00 RO time (UTC+2, the firmware's schedule time)
+static const int64_t START_UNIX = 1772424000LL; // 2026-03-02 04:00:00 UTC
+static const double OSCILLATOR_DRIFT_PPM = 40.0; // The board's clock runs slow by this much
+static const double SNTP_LATE_SHARE = 0.2;
+static const char* const FEEDER_ID = "HOST-1";
+static const char* const FEEDER_PASSWORD = "host-secret";
+static const char* const SCHEDULE_JSON = "{\"07:00\":20,\"13:00\":15,\"19:30\":20}";
+static const char* const REGISTERED_TAGS[] = {"7E3FE9", "1ECADE"};
+static const char* const STRAY_TAG = "A1B2C3";
+static const int64_t SECOND = 1000000LL;
+static const int64_t MINUTE = 60 * SECOND;
+static const int64_t HOUR = 60 * MINUTE;
+static const int64_t DAY = 24 * HOUR;
+
+// Task layout of FeederESP32Firmware.ino. The host scheduler has one core, the core arguments are ignored
+static const BaseType_t NETWORK_CORE = 0;
+static const BaseType_t CONTROL_CORE = 1;
+
+static const UBaseType_t SCALE_TASK_PRIORITY = 4;
+static const UBaseType_t SENSING_TASK_PRIORITY = 4;
+static const UBaseType_t ACTUATION_TASK_PRIORITY = 3;
+static const UBaseType_t SCHEDULING_TASK_PRIORITY = 2;
+static const UBaseType_t NETWORKING_TASK_PRIORITY = 1;
+static const UBaseType_t COMMAND_READER_TASK_PRIORITY = 2; // Above networking, so it waits on the socket again before networking sleeps
+static const UBaseType_t LOG_TASK_PRIORITY = 1;
+static const UBaseType_t SCENARIO_PRIORITY = 10; // Plays the scenario events on time, above every firmware task
+
+enum BoardJob
+{
+    JOB_WIFI,
+    JOB_TIME_SYNC,
+    NUM_OF_BOARD_JOBS
+};
+
+enum StationJob
+{
+    JOB_COMMANDS,
+    JOB_COMMAND_POLL,
+    JOB_WEIGHT_UPDATE,
+    JOB_OUTBOX,
+    JOB_NVS,
+    NUM_OF_STATION_JOBS
+};
+
+FeederStation stations[StationProfile::MAX_STATIONS];
+SimulatedPins* outputPins = nullptr;
+SimulatedStation* simulatedStations[StationProfile::MAX_STATIONS] = {};
+StandInBackend* backend = nullptr;
+DeadlineQueue networkingDeadlines;
+
+// True unix time at the current virtual time. The board's own clock is FeederClock, which runs slow
+static int64_t getWorldMicros()
+{
+    return START_UNIX * SECOND + (int64_t)(HostRtos::now() * (1.0 + OSCILLATOR_DRIFT_PPM / 1e6));
+}
+
+// Feeder provisioning, as done by the configuration portal before the first boot
+static void provisionStations()
+{
+    for (int index = 0; index < NUM_OF_STATIONS; index++)
+    {
+        MemoryController memoryController(StationProfile::PROFILES[index]);
+        memoryController.saveWifiData("host-ssid", "host-password");
+        memoryController.saveFeederIdentity(FEEDER_ID, FEEDER_PASSWORD);
+    }
+}
+
+// The tasks of FeederESP32Firmware.ino, except for the networking task, which is below
+
+void sensingTask(void* parameter)
+{
+    FeederStation& station = *static_cast<FeederStation*>(parameter);
+    for (;;)
+    {
+        station.rfidController->loop();
+    }
+}
+
+void actuationTask(void* parameter)
+{
+    FeederStation& station = *static_cast<FeederStation*>(parameter);
+    for (;;)
+    {
+        ActuatorCommand command;
+        xQueueReceive(TaskQueues::actuatorCommands[station.profile->index], &command, portMAX_DELAY);
+        uint32_t beginMicros = FeederMetrics::begin();
+
+        switch (command)
+        {
+            case ActuatorCommand::OPEN_GATE:
+                station.gateController->open();
+                break;
+            case ActuatorCommand::CLOSE_GATE:
+                station.gateController->close();
+                break;
+            case ActuatorCommand::START_MOTOR:
+                station.motorController->start();
+                break;
+            case ActuatorCommand::STOP_MOTOR:
+                station.motorController->stop();
+                break;
+            case ActuatorCommand::GATE_STOPPED:
+                break;
+        }
+
+        station.gateController->loop();
+        FeederMetrics::end(FeederMetrics::STAGE_GATE, beginMicros);
+    }
+}
+
+void handleAppCommand(FeederStation& station, const AppCommand& command)
+{
+    switch (command.type)
+    {
+        case AppCommandType::DISPENSE_NOW:
+        {
+            FeedConfigEntry feedConfig;
+            feedConfig.minutesSinceMidnight = 0;
+            feedConfig.setQuantity(command.quantity);
+            feedConfig.wasDispensedToday = false;
+            station.feederController->dispenseFeedConfigQuantity(feedConfig);
+            break;
+        }
+        case AppCommandType::TIME_SYNCHRONIZED:
+            station.feederController->initializeFeederTimeParams();
+            break;
+        case AppCommandType::SCHEDULE_UPDATED:
+            station.feederController->reloadFeedConfigData();
+            break;
+        case AppCommandType::FEEDING_DUE:
+            break;
+    }
+}
+
+void schedulingTask(void* parameter)
+{
+    FeederStation& station = *static_cast<FeederStation*>(parameter);
+    for (;;)
+    {
+        AppCommand command;
+        bool hasCommand = xQueueReceive(TaskQueues::appCommands[station.profile->index], &command, station.feederController->getWaitTicks()) == pdTRUE;
+        uint32_t beginMicros = FeederMetrics::begin();
+
+        if (hasCommand)
+        {
+            handleAppCommand(station, command);
+        }
+
+        station.feederController->loop();
+        FeederMetrics::end(FeederMetrics::STAGE_FEEDER, beginMicros);
+    }
+}
+
+int getStationJob(const FeederStation& station, StationJob job)
+{
+    return NUM_OF_BOARD_JOBS + station.profile->index * NUM_OF_STATION_JOBS + job;
+}
+
+// Stand-in of WifiController, whose portal needs the ESP32 web server: start the link and fetch the
+// feeder records on each new connection. The host link raises no events, so it is polled while down
+void runWifi()
+{
+    static const unsigned long LINK_POLL_INTERVAL = 1000; // ms
+    static bool isWifiStarted = false;
+    static bool wasConnected = false;
+
+    WebConnectionController* webConnection = stations[0].webConnection;
+    if (!isWifiStarted)
+    {
+        webConnection->connectToWifi();
+        isWifiStarted = true;
+    }
+
+    bool isConnected = webConnection->haveInternetConnection();
+    if (isConnected && !wasConnected)
+    {
+        for (int index = 0; index < NUM_OF_STATIONS; index++)
+        {
+            stations[index].webConnection->fetchFeederData();
+        }
+    }
+    wasConnected = isConnected;
+
+    networkingDeadlines.scheduleIn(JOB_WIFI, isConnected ? DeadlineQueue::NEVER : LINK_POLL_INTERVAL);
+}
+
+void synchTime()
+{
+    static bool wasTimeSynchronized = false;
+
+    WebConnectionController* webConnection = stations[0].webConnection;
+    if (webConnection->haveInternetConnection())
+    {
+        webConnection->synchronizeTime();
+    }
+
+    bool isTimeSynchronized = webConnection->isTimeSynchronized();
+    if (isTimeSynchronized && !wasTimeSynchronized)
+    {
+        for (int index = 0; index < NUM_OF_STATIONS; index++)
+        {
+            TaskQueues::postAppCommand(index, AppCommandType::TIME_SYNCHRONIZED, 0);
+        }
+    }
+    wasTimeSynchronized = isTimeSynchronized;
+}
+
+void handleCommand(FeederStation& station, const String& command)
+{
+    if (command.indexOf("DispenseNow") != -1)
+    {
+        float quantity = command.substring(command.indexOf('_') + 1).toFloat();
+        if (!TaskQueues::postAppCommand(station.profile->index, AppCommandType::DISPENSE_NOW, quantity))
+        {
+            LOG_WARN(LOG_NETWORK, "DispenseNow dropped, the scheduling task is busy");
+        }
+    }
+}
+
+void processCommandsFromApp(FeederStation& station)
+{
+    int pollJob = getStationJob(station, JOB_COMMAND_POLL);
+
+    // Commands are pushed by the backend; polling is only a fallback while the channel is down
+    String pushedCommand = station.commandChannel->loop();
+    if (pushedCommand.length() > 0)
+    {
+        LOG_INFO(LOG_NETWORK, "Command from app pushed: %s", pushedCommand);
+        handleCommand(station, pushedCommand);
+    }
+    networkingDeadlines.scheduleIn(getStationJob(station, JOB_COMMANDS), station.commandChannel->getMillisUntilDue());
+
+    if (station.commandChannel->isConnected())
+    {
+        networkingDeadlines.cancel(pollJob);
+        return;
+    }
+
+    if (!networkingDeadlines.isArmed(pollJob))
+    {
+        networkingDeadlines.scheduleIn(pollJob, 0);
+    }
+
+    if (!networkingDeadlines.isDue(pollJob))
+    {
+        return;
+    }
+
+    String command = station.webConnection->getCommandFromApplication();
+    if (command.length() > 0)
+    {
+        LOG_INFO(LOG_NETWORK, "Command from app received: %s", command);
+        handleCommand(station, command);
+    }
+
+    networkingDeadlines.scheduleIn(pollJob, station.webConnection->getCommandPollDelay());
+}
+
+void updateFoodWeightRecurrently(FeederStation& station)
+{
+    static const unsigned long FOOD_WEIGHT_UPDATE_INTERVAL = 300000;
+
+    int weightUpdateJob = getStationJob(station, JOB_WEIGHT_UPDATE);
+    if (!networkingDeadlines.isArmed(weightUpdateJob))
+    {
+        networkingDeadlines.scheduleIn(weightUpdateJob, DeadlineQueue::withJitter(FOOD_WEIGHT_UPDATE_INTERVAL));
+        return;
+    }
+
+    if (!networkingDeadlines.isDue(weightUpdateJob))
+    {
+        return;
+    }
+
+    UplinkEvent event = {UplinkEventType::FOOD_WEIGHT_UPDATE, station.webConnection->getCurrentTime(), 0, (float)station.weightController->getWeight()};
+    station.uplinkOutbox->append(event);
+    networkingDeadlines.scheduleIn(weightUpdateJob, DeadlineQueue::withJitter(FOOD_WEIGHT_UPDATE_INTERVAL));
+}
+
+// The networking task of FeederESP32Firmware.ino without the metrics server and the power manager
+static uint64_t networkingPasses = 0;
+
+void networkingTask(void*)
+{
+    for (;;)
+    {
+        networkingPasses++;
+        runWifi();
+
+        synchTime();
+        networkingDeadlines.scheduleIn(JOB_TIME_SYNC, stations[0].webConnection->getClockService().getMillisUntilDue());
+
+        StationUplinkEvent stationEvent;
+        while (xQueueReceive(TaskQueues::uplinkEvents, &stationEvent, 0) == pdTRUE)
+        {
+            stations[stationEvent.station].uplinkOutbox->append(stationEvent.event);
+        }
+
+        for (int index = 0; index < NUM_OF_STATIONS; index++)
+        {
+            FeederStation& station = stations[index];
+
+            if (station.webConnection->consumeRegisteredTagsUpdate())
+            {
+                station.rfidController->reloadRegisteredTags(station.memoryController);
+            }
+
+            if (station.webConnection->consumeScheduleUpdate())
+            {
+                TaskQueues::postAppCommand(index, AppCommandType::SCHEDULE_UPDATED, 0);
+            }
+
+            processCommandsFromApp(station);
+
+            updateFoodWeightRecurrently(station);
+            station.uplinkOutbox->loop();
+            networkingDeadlines.scheduleIn(getStationJob(station, JOB_OUTBOX), station.uplinkOutbox->getMillisUntilDue());
+
+            station.memoryController->loop();
+            networkingDeadlines.scheduleIn(getStationJob(station, JOB_NVS), station.memoryController->getMillisUntilDue());
+        }
+
+        ulTaskNotifyTake(pdTRUE, networkingDeadlines.getWaitTicks());
+    }
+}
+
+// setup() of FeederESP32Firmware.ino, with the simulated drivers
+void setup(uint32_t seed)
+{
+    TaskQueues::create(NUM_OF_STATIONS);
+
+    for (int index = 0; index < NUM_OF_STATIONS; index++)
+    {
+        stations[index].profile = &StationProfile::PROFILES[index];
+        stations[index].memoryController = new MemoryController(StationProfile::PROFILES[index]);
+    }
+
+    stations[0].webConnection = new WebConnectionController(stations[0].memoryController);
+    for (int index = 1; index < NUM_OF_STATIONS; index++)
+    {
+        stations[index].webConnection = new WebConnectionController(stations[index].memoryController, stations[0].webConnection);
+    }
+
+    outputPins = new SimulatedPins();
+    for (int index = 0; index < NUM_OF_STATIONS; index++)
+    {
+        FeederStation& station = stations[index];
+        const StationProfile& profile = StationProfile::PROFILES[index];
+        SimulatedStation* simulatedStation = new SimulatedStation(profile, outputPins, seed + 100 * index);
+        simulatedStations[index] = simulatedStation;
+
+        station.uplinkOutbox = new UplinkOutbox(station.memoryController, station.webConnection);
+        station.commandChannel = new CommandChannel(station.memoryController->getFeederId(), station.memoryController->getFeederPassword());
+        station.gateController = new GateController(profile, station.webConnection, outputPins);
+        station.motorController = new MotorController(profile, outputPins);
+        station.rfidController = new RFIDController(profile, station.memoryController, simulatedStation->getTagReader());
+        station.weightController = new WeightController(simulatedStation->getScale());
+    }
+
+    for (int index = 0; index < NUM_OF_STATIONS; index++)
+    {
+        FeederStation& station = stations[index];
+        station.weightController->startSampling(SCALE_TASK_PRIORITY, CONTROL_CORE);
+        xTaskCreatePinnedToCore(sensingTask, "sensing", 4096, &station, SENSING_TASK_PRIORITY, nullptr, CONTROL_CORE);
+        xTaskCreatePinnedToCore(actuationTask, "actuation", 4096, &station, ACTUATION_TASK_PRIORITY, nullptr, CONTROL_CORE);
+    }
+
+    for (int index = 0; index < NUM_OF_STATIONS; index++)
+    {
+        FeederStation& station = stations[index];
+        station.feederController = new FeederController(*station.profile, station.memoryController, station.weightController, station.webConnection, station.gateController);
+        xTaskCreatePinnedToCore(schedulingTask, "scheduling", 6144, &station, SCHEDULING_TASK_PRIORITY, nullptr, CONTROL_CORE);
+        station.commandChannel->startReader(COMMAND_READER_TASK_PRIORITY, NETWORK_CORE);
+    }
+
+    xTaskCreatePinnedToCore(networkingTask, "networking", 12288, nullptr, NETWORKING_TASK_PRIORITY, &TaskQueues::networkingTask, NETWORK_CORE);
+}
+
+// Scenario
+
+struct ScenarioEvent
+{
+    enum class Type
+    {
+        CAT_ARRIVES,
+        CAT_LEAVES,
+        APP_COMMAND,
+        PUBACK_LOST,
+        BROKER_BLACK_HOLE,
+        WIFI_DOWN,
+        WIFI_UP,
+        BACKEND_DOWN,
+        BACKEND_UP,
+        BATCH_ENDPOINT_REMOVED
+    };
+
+    int64_t time; // Virtual time (us)
+    Type type;
+    uint32_t tagId;
+    bool isRegistered;
+    double appetite;
+    std::string command;
+};
+
+// A feeding the firmware was asked for, and the motor run that served it
+struct ExpectedDispense
+{
+    int64_t time;
+    float quantity;
+    bool isPushedLive = false; // An app command pushed while the feeder was connected: runs within a second
+};
+
+// Virtual time of a time of day (RO time, UTC+2) on the given day after boot
+static int64_t atLocalTime(int day, int hour, int minute)
+{
+    int64_t bootLocalSeconds = (START_UNIX + 7200) % 86400;
+    int64_t worldOffset = (int64_t)day * DAY + (int64_t)(hour * 3600 + minute * 60 - bootLocalSeconds) * SECOND;
+    return (int64_t)(worldOffset / (1.0 + OSCILLATOR_DRIFT_PPM / 1e6)); // The world runs ahead of the board's clock
+}
+
+static std::vector<ScenarioEvent> buildScenario(int days, uint32_t seed, std::vector<ExpectedDispense>& expectedDispenses, int& registeredVisits, int& strayVisits)
+{
+    std::vector<ScenarioEvent> events;
+    std::mt19937 random(seed);
+
+    // Scheduled feedings, in RO time; the feeder boots at 06:00
+    const int entries[][3] = {{7, 0, 20}, {13, 0, 15}, {19, 30, 20}};
+    for (int day = 0; day < days; day++)
+    {
+        for (const int* entry : entries)
+        {
+            expectedDispenses.push_back({atLocalTime(day, entry[0], entry[1]), (float)entry[2]});
+        }
+    }
+
+    // App commands, pushed through the broker: one plain; one whose PUBACK is lost, so the broker resends
+    // it with DUP on the next connection; one held by the session over the Wi-Fi outage; one sent into a
+    // connection that silently died, which only the keep-alive finds
+    if (days > 1)
+    {
+        events.push_back({atLocalTime(1, 16, 45), ScenarioEvent::Type::APP_COMMAND, 0, false, 0, "DispenseNow_10"});
+        expectedDispenses.push_back({atLocalTime(1, 16, 45), 10, true});
+    }
+    if (days > 2)
+    {
+        events.push_back({atLocalTime(2, 16, 44), ScenarioEvent::Type::PUBACK_LOST, 0, false, 0, ""});
+        events.push_back({atLocalTime(2, 16, 45), ScenarioEvent::Type::APP_COMMAND, 0, false, 0, "DispenseNow_10"});
+        expectedDispenses.push_back({atLocalTime(2, 16, 45), 10, true});
+    }
+    if (days > 3)
+    {
+        events.push_back({atLocalTime(3, 7, 30), ScenarioEvent::Type::APP_COMMAND, 0, false, 0, "DispenseNow_10"});
+        expectedDispenses.push_back({atLocalTime(3, 7, 30), 10});
+    }
+    if (days > 5)
+    {
+        events.push_back({atLocalTime(5, 16, 45) - 10 * SECOND, ScenarioEvent::Type::BROKER_BLACK_HOLE, 0, false, 0, ""});
+        events.push_back({atLocalTime(5, 16, 45), ScenarioEvent::Type::APP_COMMAND, 0, false, 0, "DispenseNow_10"});
+        expectedDispenses.push_back({atLocalTime(5, 16, 45), 10});
+    }
+
+    // Incidents: the access point reboots over a feeding, the backend is redeployed, and later loses
+    // the batch endpoint, so the outbox falls back to the legacy per-event uploads
+    if (days > 3)
+    {
+        events.push_back({atLocalTime(3, 6, 30), ScenarioEvent::Type::WIFI_DOWN, 0, false, 0, ""});
+        events.push_back({atLocalTime(3, 8, 30), ScenarioEvent::Type::WIFI_UP, 0, false, 0, ""});
+    }
+    if (days > 4)
+    {
+        events.push_back({atLocalTime(4, 14, 0), ScenarioEvent::Type::BACKEND_DOWN, 0, false, 0, ""});
+        events.push_back({atLocalTime(4, 14, 25), ScenarioEvent::Type::BACKEND_UP, 0, false, 0, ""});
+    }
+    if (days > 5)
+    {
+        events.push_back({atLocalTime(5, 0, 0), ScenarioEvent::Type::BATCH_ENDPOINT_REMOVED, 0, false, 0, ""});
+    }
+
+    // Cat visits, one at a time, with the gate closed again in between. Mostly the registered cats,
+    // sometimes a stray that must find the gate shut
+    std::exponential_distribution<double> gap(1.0 / (100.0 * MINUTE));
+    std::uniform_int_distribution<int64_t> duration(2 * MINUTE, 6 * MINUTE);
+    std::uniform_real_distribution<double> appetite(5.0, 12.0);
+    std::uniform_real_distribution<double> chance(0.0, 1.0);
+
+    int64_t end = (int64_t)days * DAY;
+    int64_t time = 30 * MINUTE;
+    int cat = 0;
+    for (;;)
+    {
+        time += 5 * MINUTE + (int64_t)gap(random);
+        int64_t leaveTime = time + duration(random);
+        if (leaveTime > end - 30 * MINUTE)
+        {
+            break;
+        }
+
+        bool isStray = chance(random) < 0.15;
+        uint32_t tagId = TagRegistry::parseTagId(isStray ? STRAY_TAG : REGISTERED_TAGS[cat++ % 2]);
+        events.push_back({time, ScenarioEvent::Type::CAT_ARRIVES, tagId, !isStray, appetite(random), ""});
+        events.push_back({leaveTime, ScenarioEvent::Type::CAT_LEAVES, tagId, !isStray, 0, ""});
+        (isStray ? strayVisits : registeredVisits)++;
+        time = leaveTime;
+    }
+
+    std::stable_sort(events.begin(), events.end(), [](const ScenarioEvent& a, const ScenarioEvent& b) { return a.time < b.time; });
+    return events;
+}
+
+static void playEvent(const ScenarioEvent& event)
+{
+    SimulatedStation* station = simulatedStations[0];
+
+    switch (event.type)
+    {
+        case ScenarioEvent::Type::CAT_ARRIVES:
+            station->catArrives(event.tagId, event.isRegistered, event.appetite);
+            break;
+        case ScenarioEvent::Type::CAT_LEAVES:
+            station->catLeaves();
+            break;
+        case ScenarioEvent::Type::APP_COMMAND:
+            backend->sendCommand(FEEDER_ID, event.command);
+            break;
+        case ScenarioEvent::Type::PUBACK_LOST:
+            backend->getBroker().loseNextPuback(FEEDER_ID);
+            break;
+        case ScenarioEvent::Type::BROKER_BLACK_HOLE:
+            backend->getBroker().blackHole(FEEDER_ID);
+            break;
+        case ScenarioEvent::Type::WIFI_DOWN:
+            HostNet::setWifiUp(false);
+            TaskQueues::wakeNetworking(); // As the disconnect event does
+            break;
+        case ScenarioEvent::Type::WIFI_UP:
+            HostNet::setWifiUp(true);
+            break;
+        case ScenarioEvent::Type::BACKEND_DOWN:
+            backend->setAvailable(false);
+            break;
+        case ScenarioEvent::Type::BACKEND_UP:
+            backend->setAvailable(true);
+            break;
+        case ScenarioEvent::Type::BATCH_ENDPOINT_REMOVED:
+            backend->setBatchEndpoint(false);
+            break;
+    }
+}
+
+// Report
+
+static int failures = 0;
+
+static void check(bool passed, const char* format, ...)
+{
+    char line[256];
+    va_list args;
+    va_start(args, format);
+    vsnprintf(line, sizeof(line), format, args);
+    va_end(args);
+
+    printf("%s %s\n", passed ? "[ok]  " : "[FAIL]", line);
+    failures += passed ? 0 : 1;
+}
+
+static double percentile(std::vector<double> values, double fraction)
+{
+    if (values.empty())
+    {
+        return 0.0;
+    }
+    std::sort(values.begin(), values.end());
+    return values[std::min(values.size() - 1, (size_t)(fraction * values.size()))];
+}
+
+int main(int argc, char** argv)
+{
+    bool verbose = false;
+    int days = 7;
+    uint32_t seed = 1;
+    for (int i = 1; i < argc; i++)
+    {
+        std::string argument = argv[i];
+        if (argument == "-v")
+        {
+            verbose = true;
+        }
+        else if (argument == "--days" && i + 1 < argc)
+        {
+            days = std::max(1, atoi(argv[++i]));
+        }
+        else if (argument == "--seed" && i + 1 < argc)
+        {
+            seed = (uint32_t)strtoul(argv[++i], nullptr, 10);
+        }
+        else
+        {
+            fprintf(stderr, "Usage: %s [-v] [--days N] [--seed S]\n", argv[0]);
+            return 2;
+        }
+    }
+
+    HostRtos::setMainPriority(SCENARIO_PRIORITY);
+    randomSeed(seed);
+    Serial.begin(115200);
+    if (verbose)
+    {
+        FeederLog::startDrainTask(LOG_TASK_PRIORITY, NETWORK_CORE);
+    }
+
+    // Some SNTP replies come after ClockService gave up on them, and are still queued at its next request
+    StandInBackend::LatencyModel latencyModel;
+    latencyModel.sntpLateShare = SNTP_LATE_SHARE;
+    StandInBackend standInBackend(latencyModel, getWorldMicros);
+    backend = &standInBackend;
+    StandInBackend::Feeder& feeder = backend->addFeeder(FEEDER_ID, FEEDER_PASSWORD);
+    feeder.schedule = SCHEDULE_JSON;
+    feeder.tags.assign(std::begin(REGISTERED_TAGS), std::end(REGISTERED_TAGS));
+    backend->install();
+
+    std::vector<ExpectedDispense> expectedDispenses;
+    int registeredVisits = 0;
+    int strayVisits = 0;
+    std::vector<ScenarioEvent> scenario = buildScenario(days, seed, expectedDispenses, registeredVisits, strayVisits);
+
+    provisionStations();
+    uint64_t provisioningWrites = HostNvs::writes();
+    setup(seed);
+
+    std::chrono::steady_clock::time_point wallStart = std::chrono::steady_clock::now();
+    for (const ScenarioEvent& event : scenario)
+    {
+        HostRtos::sleepUntil(event.time);
+        playEvent(event);
+    }
+    HostRtos::sleepUntil((int64_t)days * DAY);
+
+    // A weight update may have been queued just before the end: give it the time of one upload
+    while (stations[0].uplinkOutbox->getPendingCount() > 0 && HostRtos::now() < (int64_t)days * DAY + MINUTE)
+    {
+        HostRtos::sleepFor(SECOND);
+    }
+    double wallSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - wallStart).count();
+
+    // What the backend stored
+    int gateEvents = 0;
+    int dispenseEvents = 0;
+    int emptyDispenseEvents = 0;
+    int weightUpdates = 0;
+    for (const StandInBackend::StoredEvent& event : feeder.events)
+    {
+        gateEvents += event.type == StandInBackend::StoredEvent::Type::GATE ? 1 : 0;
+        dispenseEvents += event.type == StandInBackend::StoredEvent::Type::DISPENSE ? 1 : 0;
+        emptyDispenseEvents += event.type == StandInBackend::StoredEvent::Type::DISPENSE && event.value <= 0 ? 1 : 0;
+        weightUpdates += event.type == StandInBackend::StoredEvent::Type::WEIGHT ? 1 : 0;
+    }
+
+    // Dispense accuracy: each motor run against the feeding it served, capped at the bowl limit
+    const SimulatedStation::Stats& stationStats = simulatedStations[0]->getStats();
+    const std::vector<SimulatedStation::Pour>& pours = simulatedStations[0]->getPours();
+    std::vector<double> errors;
+    std::vector<double> absoluteErrors;
+    for (const SimulatedStation::Pour& pour : pours)
+    {
+        const ExpectedDispense* served = nullptr;
+        for (const ExpectedDispense& expected : expectedDispenses)
+        {
+            if (expected.time <= pour.relayOnTime + SECOND && (served == nullptr || expected.time > served->time))
+            {
+                served = &expected;
+            }
+        }
+        if (served == nullptr)
+        {
+            continue;
+        }
+
+        double target = std::min((double)served->quantity, std::max(0.0, 60.0 - pour.bowlGramsBefore));
+        errors.push_back(pour.getGrams() - target);
+        absoluteErrors.push_back(fabs(pour.getGrams() - target));
+    }
+    double meanError = 0;
+    for (double error : errors)
+    {
+        meanError += error / errors.size();
+    }
+    // The flow model starts from its defaults and learns from the first dispenses
+    std::vector<double> learnedErrors(absoluteErrors.begin() + std::min<size_t>(3, absoluteErrors.size()), absoluteErrors.end());
+
+    // Pushed commands: the motor run each one started, right after the push
+    int pushedLive = 0;
+    int pushedLiveOnTime = 0;
+    for (const ExpectedDispense& expected : expectedDispenses)
+    {
+        if (!expected.isPushedLive || expected.time >= (int64_t)days * DAY)
+        {
+            continue;
+        }
+        pushedLive++;
+        for (const SimulatedStation::Pour& pour : pours)
+        {
+            pushedLiveOnTime += pour.relayOnTime >= expected.time && pour.relayOnTime <= expected.time + SECOND ? 1 : 0;
+        }
+    }
+    StandInBroker::Stats brokerStats = backend->getBroker().getStats(FEEDER_ID);
+    int appCommands = 0;
+    for (const ScenarioEvent& event : scenario)
+    {
+        appCommands += event.type == ScenarioEvent::Type::APP_COMMAND ? 1 : 0;
+    }
+
+    double networkingPassesPerMinute = networkingPasses / (HostRtos::now() / (double)MINUTE);
+
+    int64_t clockError = (int64_t)stations[0].webConnection->getCurrentTime() * SECOND - getWorldMicros();
+
+    printf("Simulated %d days in %.2f s (%llu context switches, %u RFID frames)\n", days, wallSeconds, (unsigned long long)HostRtos::getContextSwitches(), simulatedStations[0]->getTagReader()->getFramesSent());
+    printf("Cat visits: %d registered, %d stray; eaten %.0f g, appetite left %.0f g\n", registeredVisits, strayVisits, stationStats.eatenGrams, stationStats.hungryGrams);
+    printf("Gate: opened %u times, open latency mean %.2f s max %.2f s, %u missed steps\n", stationStats.gateOpenings,
+           stationStats.openLatencyCount > 0 ? stationStats.totalOpenLatency / 1e6 / stationStats.openLatencyCount : 0.0, stationStats.maxOpenLatency / 1e6, stationStats.missedSteps);
+    printf("Dispenses: %zu motor runs, error mean %+.2f g, p95 |error| %.2f g (%.2f g after the first 3), max |error| %.2f g\n", pours.size(), meanError, percentile(absoluteErrors, 0.95),
+           percentile(learnedErrors, 0.95), percentile(absoluteErrors, 1.0));
+    printf("Backend: %d gate, %d dispense, %d weight events stored, %u duplicates\n", gateEvents, dispenseEvents, weightUpdates, feeder.duplicates);
+    for (const auto& endpoint : backend->getEndpointStats())
+    {
+        const StandInBackend::EndpointStats& stats = endpoint.second;
+        printf("  %-24s %7llu requests %5llu errors, p50 %.0f ms p99 %.0f ms, %.1f KB/day\n", endpoint.first.c_str(), (unsigned long long)stats.requests, (unsigned long long)stats.errors,
+               stats.latency.getPercentile(0.5) / 1000, stats.latency.getPercentile(0.99) / 1000, (stats.bytesReceived + stats.bytesSent) / 1024.0 / days);
+    }
+    printf("Broker: %u connects, %u publishes (%u resent with DUP), %u PUBACKs, %u pings; %u command polls while subscribed\n", brokerStats.connects, brokerStats.publishes, brokerStats.redeliveries,
+           brokerStats.pubacks, brokerStats.pings, feeder.pollsWhileSubscribed);
+    printf("Networking: %.1f passes/min\n", networkingPassesPerMinute);
+    printf("NVS: %.1f writes/day after provisioning\n", (double)(HostNvs::writes() - provisioningWrites) / days);
+    printf("Clock: %+.3f s off the world time, drift estimate %.1f ppm (actual %.1f ppm)\n", clockError / 1e6, stations[0].webConnection->getClockService().getDriftPpm(), OSCILLATOR_DRIFT_PPM);
+
+    int expectedDispenseCount = 0;
+    for (const ExpectedDispense& expected : expectedDispenses)
+    {
+        expectedDispenseCount += expected.time < (int64_t)days * DAY ? 1 : 0;
+    }
+
+    check((int)pours.size() == expectedDispenseCount, "every scheduled feeding and app command ran the motor once (%zu of %d)", pours.size(), expectedDispenseCount);
+    check(dispenseEvents == expectedDispenseCount && emptyDispenseEvents == 0, "every dispense was reported with food (%d reported, %d empty)", dispenseEvents, emptyDispenseEvents);
+    check((int)stationStats.gateOpenings == registeredVisits && stationStats.openLatencyCount == (uint32_t)registeredVisits, "the gate opened once per registered visit (%u openings)", stationStats.gateOpenings);
+    check(stationStats.strayOpenings == 0, "the gate stayed shut for the stray");
+    check(gateEvents == (int)stationStats.gateOpenings, "every gate visit was reported (%d)", gateEvents);
+    check(stations[0].uplinkOutbox->getPendingCount() == 0, "the outbox drained (%d pending)", stations[0].uplinkOutbox->getPendingCount());
+    check(pushedLiveOnTime == pushedLive, "pushed app commands ran the motor within 1 s (%d of %d)", pushedLiveOnTime, pushedLive);
+    check((int)brokerStats.pubacks == appCommands && backend->getBroker().getInflightCount(FEEDER_ID) == 0 && feeder.commands.empty(), "every app command was pushed and acknowledged (%u PUBACKs for %d)",
+          brokerStats.pubacks, appCommands);
+    check(days <= 5 || brokerStats.redeliveries >= 2, "the commands of the lost PUBACK and the dead connection were resent with DUP (%u)", brokerStats.redeliveries);
+    check(feeder.pollsWhileSubscribed == 0, "no command polls while the push session was up");
+    // Pings, weight updates and uploads; the command channel socket is waited on, not polled
+    check(networkingPassesPerMinute <= 10.0, "the networking task woke a handful of times per minute (%.1f)", networkingPassesPerMinute);
+    check(llabs(clockError) <= SECOND, "the clock is within 1 s of the world time");
+    check(fabs(stations[0].webConnection->getClockService().getDriftPpm() - OSCILLATOR_DRIFT_PPM) <= 5.0, "the drift estimate is within 5 ppm, late SNTP replies included");
+    // The motor vibration lets the fitted weight cross the cut-off early, and the learned in-flight time
+    // cannot go below zero to make up for it: the dispenses land about 2 g short
+    check(learnedErrors.empty() || percentile(learnedErrors, 0.95) <= 5.0, "the learned cut-off dispenses within 5 g (p95)");
+
+    if (failures > 0 && !verbose)
+    {
+        printf("Firmware log (last records):\n");
+        FeederLog::dump(Serial);
+    }
+
+    printf("%s\n", failures == 0 ? "PASS" : "FAIL");
+    fflush(stdout);
+    return failures == 0 ? 0 : 1;
+}
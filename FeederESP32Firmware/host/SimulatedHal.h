@@ -0,0 +1,242 @@
+#ifndef SIMULATED_HAL_H
+#define SIMULATED_HAL_H
+
+#include <Arduino.h>
+#include <esp_timer.h>
+#include <deque>
+#include <map>
+#include <random>
+#include "FeederHal.h"
+
+// Simulated drivers of the hardware seams in FeederHal.h, for the host build. They only model what
+// the firmware can observe: scale conversions, RDM6300 frames and output pin levels. The physics
+// behind them (bowl, gate, cats) is up to the simulation that owns them (see SimulatedStation.h)
+
+// Initialize static members. The clock is the virtual one of HostRtos, which jumps from event to
+// event, so the firmware's timers and timeouts run as fast as the host can process them
+FeederClock::MicrosSource FeederClock::source = esp_timer_get_time;
+uint32_t FeederClock::speedup = 1;
+
+// Output levels, reported to a listener as they are written (e.g. a stepper model)
+class SimulatedPins : public OutputPins
+{
+public:
+    typedef std::function<void(int pin, bool high)> Listener;
+
+private:
+    std::map<int, bool> levels;
+    std::vector<Listener> listeners;
+
+public:
+    void addListener(Listener listener)
+    {
+        listeners.push_back(listener);
+    }
+
+    bool isHigh(int pin) const
+    {
+        auto level = levels.find(pin);
+        return level != levels.end() && level->second;
+    }
+
+    void configure(int pin) override
+    {
+        levels[pin] = false;
+    }
+
+    void write(int pin, bool high) override
+    {
+        levels[pin] = high;
+        for (Listener& listener : listeners)
+        {
+            listener(pin, high);
+        }
+    }
+};
+
+// HX711 on a load cell. A conversion is ready every CONVERSION_TIME (80 SPS) and reads the load
+// given by the simulation, in grams, plus gaussian noise
+class SimulatedScale : public ScaleDriver
+{
+public:
+    typedef std::function<double()> LoadSource;
+
+    static constexpr int64_t CONVERSION_TIME = 12500;  // us
+    static constexpr double COUNTS_PER_GRAM = 466.17009; // The calibration factor of WeightController, per gram
+    static constexpr int TARE_SAMPLES = 10;            // As HX711::tare()
+
+private:
+    LoadSource load;
+    double noiseGrams;
+    std::mt19937 random;
+    int64_t lastReadTime = 0;
+    double offsetCounts = 0;
+    float calibrationFactor = 1.0f;
+
+    // Conversion ready: one has completed since the last read
+    bool isReady() const
+    {
+        return HostRtos::now() - lastReadTime >= CONVERSION_TIME;
+    }
+
+    double readCounts()
+    {
+        std::normal_distribution<double> noise(0.0, noiseGrams);
+        lastReadTime = HostRtos::now();
+        return (load() + noise(random)) * COUNTS_PER_GRAM;
+    }
+
+public:
+    SimulatedScale(LoadSource loadSource, double noise, uint32_t seed) : load(loadSource), noiseGrams(noise), random(seed)
+    {
+    }
+
+    bool waitReady(unsigned long timeout) override
+    {
+        int64_t readyTime = lastReadTime + CONVERSION_TIME;
+        if (readyTime - HostRtos::now() > (int64_t)timeout * 1000)
+        {
+            HostRtos::sleepFor((int64_t)timeout * 1000);
+            return false;
+        }
+
+        HostRtos::sleepUntil(readyTime);
+        return isReady();
+    }
+
+    float getUnits() override
+    {
+        return (float)((readCounts() - offsetCounts) / calibrationFactor);
+    }
+
+    void tare() override
+    {
+        double sum = 0;
+        for (int i = 0; i < TARE_SAMPLES; i++)
+        {
+            waitReady(1000);
+            sum += readCounts();
+        }
+        offsetCounts = sum / TARE_SAMPLES;
+    }
+
+    void setScale(float factor) override
+    {
+        calibrationFactor = factor;
+    }
+};
+
+// RDM6300 in front of the tags the simulation puts in range. A tag in range is sent every
+// FRAME_INTERVAL; the receive callback runs from the timer, like the UART event task on the chip.
+// One frame in corruptOneIn gets a flipped byte, which the firmware has to reject
+class SimulatedTagReader : public TagReaderPort
+{
+public:
+    static constexpr int64_t FRAME_INTERVAL = 65000; // us
+
+private:
+    std::function<void()> onReceive;
+    std::deque<uint8_t> received;
+    esp_timer_handle_t frameTimer = nullptr;
+    uint32_t tagInRange = 0;
+    uint32_t framesSent = 0;
+    uint32_t corruptOneIn;
+    std::mt19937 random;
+
+    static void onFrameTimer(void* arg)
+    {
+        static_cast<SimulatedTagReader*>(arg)->sendFrame();
+    }
+
+    static char hexDigit(uint8_t value)
+    {
+        return "0123456789ABCDEF"[value & 0x0F];
+    }
+
+    void sendFrame()
+    {
+        // Version byte, then the 32-bit tag ID; the checksum is the XOR of the 5 bytes
+        uint8_t bytes[6] = {0x00, (uint8_t)(tagInRange >> 24), (uint8_t)(tagInRange >> 16), (uint8_t)(tagInRange >> 8), (uint8_t)tagInRange, 0};
+        bytes[5] = bytes[0] ^ bytes[1] ^ bytes[2] ^ bytes[3] ^ bytes[4];
+
+        uint8_t frame[14];
+        frame[0] = 0x02;
+        for (int i = 0; i < 6; i++)
+        {
+            frame[1 + i * 2] = hexDigit(bytes[i] >> 4);
+            frame[2 + i * 2] = hexDigit(bytes[i]);
+        }
+        frame[13] = 0x03;
+
+        framesSent++;
+        if (corruptOneIn > 0 && random() % corruptOneIn == 0)
+        {
+            frame[1 + random() % 12] ^= 0x01;
+        }
+
+        received.insert(received.end(), frame, frame + sizeof(frame));
+        if (onReceive)
+        {
+            onReceive();
+        }
+    }
+
+public:
+    SimulatedTagReader(uint32_t corruptFramesOneIn, uint32_t seed) : corruptOneIn(corruptFramesOneIn), random(seed)
+    {
+    }
+
+    // Bring a tag in range (0 takes it away). The first frame comes within one frame interval
+    void setTagInRange(uint32_t tagId)
+    {
+        if (tagId == tagInRange || frameTimer == nullptr)
+        {
+            tagInRange = tagId;
+            return;
+        }
+
+        tagInRange = tagId;
+        esp_timer_stop(frameTimer); // Ignore the error when the timer is not running
+        if (tagId != 0)
+        {
+            esp_timer_start_periodic(frameTimer, FRAME_INTERVAL);
+            frameTimer->dueTime = HostRtos::now() + 1000 + random() % FRAME_INTERVAL;
+        }
+    }
+
+    uint32_t getFramesSent() const
+    {
+        return framesSent;
+    }
+
+    void begin(unsigned long baudRate, int rxPin, std::function<void()> receiveCallback) override
+    {
+        (void)baudRate;
+        (void)rxPin;
+        onReceive = receiveCallback;
+
+        esp_timer_create_args_t timerArgs = {};
+        timerArgs.callback = &SimulatedTagReader::onFrameTimer;
+        timerArgs.arg = this;
+        timerArgs.name = "rdm6300";
+        esp_timer_create(&timerArgs, &frameTimer);
+    }
+
+    int available() override
+    {
+        return (int)received.size();
+    }
+
+    int read() override
+    {
+        if (received.empty())
+        {
+            return -1;
+        }
+        uint8_t value = received.front();
+        received.pop_front();
+        return value;
+    }
+};
+
+#endif // SIMULATED_HAL_H
@@ -0,0 +1,308 @@
+#ifndef SIMULATED_STATION_H
+#define SIMULATED_STATION_H
+
+#include <math.h>
+#include <random>
+#include <vector>
+#include "SimulatedHal.h"
+#include "StationProfile.h"
+
+// Physics of one feeding station behind the simulated drivers: the dispenser (auger and chute), the
+// bowl on the load cell, the gate stepper and the cat at the gate. The state is advanced lazily, up to
+// the virtual time of each driver call or scenario event, so nothing runs while the feeder is idle
+class SimulatedStation
+{
+public:
+    // Dispenser: flow starts after the auger spins up, coasts briefly after the relay opens, and lands
+    // in the bowl FALL_TIME after leaving the auger. Each run gets its own flow (kibble jams)
+    static constexpr double FLOW_GRAMS_PER_SECOND = 2.5;
+    static constexpr double FLOW_VARIATION = 0.15;
+    static constexpr int64_t SPIN_UP_TIME = 150000; // us
+    static constexpr int64_t COAST_TIME = 120000;   // us
+    static constexpr int64_t FALL_TIME = 350000;    // us
+
+    static constexpr double PLATE_GRAMS = 140.0;     // Tared away at boot
+    static constexpr double SCALE_NOISE_GRAMS = 0.4;
+    static constexpr double MOTOR_VIBRATION_GRAMS = 2.0;
+
+    // Gate: the closing stroke of GateController between its end stops. The opening wide enough to eat
+    // from is the last part of the stroke
+    static constexpr long GATE_TRAVEL = 460;
+    static constexpr long GATE_EATING_POSITION = -400;
+
+    static constexpr double EATING_GRAMS_PER_SECOND = 0.2;
+    static constexpr int64_t EATING_STEP = 100000; // Integration step while a cat eats (us)
+
+    // A motor run and what it did to the bowl
+    struct Pour
+    {
+        int64_t relayOnTime;
+        int64_t startTime;   // Food leaves the auger
+        int64_t endTime;     // Last food leaves the auger, 0 while the relay is on
+        double gramsPerSecond;
+        double bowlGramsBefore;
+
+        double getGrams() const
+        {
+            return endTime > startTime ? gramsPerSecond * (endTime - startTime) / 1e6 : 0.0;
+        }
+
+        // Food of this run in the bowl at the given time
+        double getLandedGrams(int64_t time) const
+        {
+            int64_t end = endTime > 0 ? endTime : time - FALL_TIME;
+            int64_t flowing = std::min(time - FALL_TIME, end) - startTime;
+            return flowing > 0 ? gramsPerSecond * flowing / 1e6 : 0.0;
+        }
+    };
+
+    struct Stats
+    {
+        uint32_t gateOpenings = 0;        // The gate reached the eating position
+        uint32_t strayOpenings = 0;       // ... while an unregistered tag was at the gate
+        uint32_t missedSteps = 0;         // Coil patterns two phases apart
+        int64_t maxOpenLatency = 0;       // From a registered tag in range to the gate open (us)
+        int64_t totalOpenLatency = 0;
+        uint32_t openLatencyCount = 0;
+        double eatenGrams = 0;
+        double hungryGrams = 0;           // Appetite left when the cats left
+    };
+
+private:
+    const StationProfile& profile;
+    SimulatedPins* pins;
+    SimulatedScale scale;
+    SimulatedTagReader tagReader;
+    std::mt19937 random;
+
+    int64_t lastUpdateTime = 0;
+    double eatenGrams = 0;
+    double landedGramsOfPastPours = 0;
+    std::vector<Pour> pours;
+    size_t firstLandingPour = 0; // Pours before it have fully landed
+    bool isMotorOn = false;
+
+    int coilPhase = 0; // GateController energizes phase 0 first
+    long gatePosition = 0;
+    bool isGateOpen = false;
+
+    uint32_t catTag = 0;
+    bool isCatRegistered = false;
+    double appetiteGrams = 0;
+    int64_t catArrivalTime = 0;
+    bool hasOpenedForCat = false;
+
+    Stats stats;
+
+    double getLandedGrams(int64_t time)
+    {
+        // Pours that have fully landed no longer need to be evaluated
+        while (firstLandingPour < pours.size() && pours[firstLandingPour].endTime > 0 && pours[firstLandingPour].endTime + FALL_TIME <= time)
+        {
+            landedGramsOfPastPours += pours[firstLandingPour].getGrams();
+            firstLandingPour++;
+        }
+
+        double grams = landedGramsOfPastPours;
+        for (size_t i = firstLandingPour; i < pours.size(); i++)
+        {
+            grams += pours[i].getLandedGrams(time);
+        }
+        return grams;
+    }
+
+    // Let the cat eat up to now. The gate and the cat do not change between two updates
+    void update()
+    {
+        int64_t now = HostRtos::now();
+        bool isEating = catTag != 0 && isCatRegistered && isGateOpen;
+
+        while (isEating && lastUpdateTime < now && appetiteGrams > 0)
+        {
+            int64_t step = std::min(EATING_STEP, now - lastUpdateTime);
+            lastUpdateTime += step;
+
+            double available = getLandedGrams(lastUpdateTime) - eatenGrams;
+            double bite = std::min(std::min(EATING_GRAMS_PER_SECOND * step / 1e6, appetiteGrams), std::max(0.0, available));
+            eatenGrams += bite;
+            appetiteGrams -= bite;
+            stats.eatenGrams += bite;
+        }
+        lastUpdateTime = now;
+    }
+
+    double getLoadGrams()
+    {
+        update();
+
+        double load = PLATE_GRAMS + getLandedGrams(HostRtos::now()) - eatenGrams;
+        if (isMotorOn)
+        {
+            std::normal_distribution<double> vibration(0.0, MOTOR_VIBRATION_GRAMS);
+            load += vibration(random);
+        }
+        return load;
+    }
+
+    void onRelay(bool high)
+    {
+        bool motorOn = !high; // Active LOW
+        if (motorOn == isMotorOn)
+        {
+            return;
+        }
+
+        update();
+        isMotorOn = motorOn;
+        int64_t now = HostRtos::now();
+
+        if (motorOn)
+        {
+            std::uniform_real_distribution<double> variation(1.0 - FLOW_VARIATION, 1.0 + FLOW_VARIATION);
+            pours.push_back({now, now + SPIN_UP_TIME, 0, FLOW_GRAMS_PER_SECOND * variation(random), getBowlGrams()});
+        }
+        else
+        {
+            Pour& pour = pours.back();
+            pour.endTime = std::max(pour.startTime, now + COAST_TIME);
+        }
+    }
+
+    // Decode the coil pattern of the ULN2003 inputs. Adjacent phases are one step, positive towards closed
+    void onGateCoil()
+    {
+        bool in1 = pins->isHigh(profile.gatePins.in1);
+        bool in2 = pins->isHigh(profile.gatePins.in2);
+        bool in3 = pins->isHigh(profile.gatePins.in3);
+        bool in4 = pins->isHigh(profile.gatePins.in4);
+
+        int phase = -1;
+        if (in1 && in2 && !in3 && !in4) phase = 0;
+        if (!in1 && in2 && in3 && !in4) phase = 1;
+        if (!in1 && !in2 && in3 && in4) phase = 2;
+        if (in1 && !in2 && !in3 && in4) phase = 3;
+
+        if (phase < 0 || phase == coilPhase)
+        {
+            return; // Coils off, or a pattern on the way from one phase to the next
+        }
+
+        int delta = (phase - coilPhase) & 0x03;
+        coilPhase = phase;
+        if (delta == 2)
+        {
+            stats.missedSteps++;
+            return;
+        }
+
+        // The end stops hold the gate, the stepper skips against them
+        long position = gatePosition + (delta == 1 ? 1 : -1);
+        gatePosition = std::max(-GATE_TRAVEL, std::min(0L, position));
+
+        bool gateOpen = gatePosition <= GATE_EATING_POSITION;
+        if (gateOpen == isGateOpen)
+        {
+            return;
+        }
+
+        update();
+        isGateOpen = gateOpen;
+        if (!gateOpen)
+        {
+            return;
+        }
+
+        stats.gateOpenings++;
+        if (catTag != 0 && !isCatRegistered)
+        {
+            stats.strayOpenings++;
+        }
+        if (catTag != 0 && isCatRegistered && !hasOpenedForCat)
+        {
+            hasOpenedForCat = true;
+            int64_t latency = HostRtos::now() - catArrivalTime;
+            stats.maxOpenLatency = std::max(stats.maxOpenLatency, latency);
+            stats.totalOpenLatency += latency;
+            stats.openLatencyCount++;
+        }
+    }
+
+public:
+    SimulatedStation(const StationProfile& stationProfile, SimulatedPins* outputPins, uint32_t seed)
+        : profile(stationProfile), pins(outputPins), scale([this]() { return getLoadGrams(); }, SCALE_NOISE_GRAMS, seed), tagReader(200, seed + 1), random(seed + 2)
+    {
+        pins->addListener([this](int pin, bool high) {
+            if (pin == profile.motorRelayPin)
+            {
+                onRelay(high);
+            }
+            else if (pin == profile.gatePins.in1 || pin == profile.gatePins.in2 || pin == profile.gatePins.in3 || pin == profile.gatePins.in4)
+            {
+                onGateCoil();
+            }
+        });
+    }
+
+    SimulatedScale* getScale()
+    {
+        return &scale;
+    }
+
+    SimulatedTagReader* getTagReader()
+    {
+        return &tagReader;
+    }
+
+    // A cat with the given tag comes to the gate, hungry for up to appetite grams
+    void catArrives(uint32_t tagId, bool isRegistered, double appetite)
+    {
+        update();
+        catTag = tagId;
+        isCatRegistered = isRegistered;
+        appetiteGrams = appetite;
+        catArrivalTime = HostRtos::now();
+        hasOpenedForCat = false;
+        tagReader.setTagInRange(tagId);
+    }
+
+    void catLeaves()
+    {
+        update();
+        if (isCatRegistered)
+        {
+            stats.hungryGrams += appetiteGrams;
+        }
+        catTag = 0;
+        appetiteGrams = 0;
+        tagReader.setTagInRange(0);
+    }
+
+    // Food in the bowl, without the scale noise
+    double getBowlGrams()
+    {
+        update();
+        return getLandedGrams(HostRtos::now()) - eatenGrams;
+    }
+
+    bool isGateOpenForEating() const
+    {
+        return isGateOpen;
+    }
+
+    long getGatePosition() const
+    {
+        return gatePosition;
+    }
+
+    const std::vector<Pour>& getPours() const
+    {
+        return pours;
+    }
+
+    const Stats& getStats() const
+    {
+        return stats;
+    }
+};
+
+#endif // SIMULATED_STATION_H
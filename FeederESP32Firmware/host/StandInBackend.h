@@ -0,0 +1,453 @@
+#ifndef STAND_IN_BACKEND_H
+#define STAND_IN_BACKEND_H
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+#include <math.h>
+#include <time.h>
+#include <deque>
+#include <map>
+#include <random>
+#include <set>
+#include <string>
+#include <vector>
+#include <HTTPClient.h>
+#include "HostNet.h"
+#include "StandInBroker.h"
+
+// Latencies on a log scale (2% buckets), so percentiles of millions of requests take a few KB
+class LatencyHistogram
+{
+private:
+    static constexpr double BUCKET_GROWTH = 1.02;
+    static constexpr int NUM_OF_BUCKETS = 1024; // Up to ~640 s
+
+    std::vector<uint64_t> counts = std::vector<uint64_t>(NUM_OF_BUCKETS, 0);
+    uint64_t total = 0;
+    double sum = 0;
+
+public:
+    void add(int64_t micros)
+    {
+        int bucket = micros <= 1 ? 0 : (int)(log((double)micros) / log(BUCKET_GROWTH));
+        counts[std::min(bucket, NUM_OF_BUCKETS - 1)]++;
+        total++;
+        sum += (double)micros;
+    }
+
+    uint64_t getCount() const
+    {
+        return total;
+    }
+
+    double getMean() const
+    {
+        return total > 0 ? sum / total : 0.0;
+    }
+
+    // Upper bound of the bucket holding the given fraction of the samples (us)
+    double getPercentile(double fraction) const
+    {
+        uint64_t rank = (uint64_t)ceil(fraction * total);
+        uint64_t seen = 0;
+        for (int bucket = 0; bucket < NUM_OF_BUCKETS; bucket++)
+        {
+            seen += counts[bucket];
+            if (seen >= rank && seen > 0)
+            {
+                return pow(BUCKET_GROWTH, bucket + 1);
+            }
+        }
+        return 0.0;
+    }
+};
+
+// Stand-in of the PHP backend on dev.bull-software.com, its MQTT broker (StandInBroker.h) and the SNTP
+// pool, answering the requests of the host build through HostNet. It implements the contracts the
+// firmware relies on:
+//  get_feeder.php            feeder record, schedule and RFID tags
+//  get_esp32_command.php     queued app command, {"Command": ""} when none
+//  add_events_batch.php      outbox batches, deduplicated on (ID, epoch, seq)
+//  add_gate_event.php, add_food_dispense_event.php, update_food_weight.php  legacy per-event uploads
+// Requests queue for a pool of workers (M/G/c), so the latency grows with the load of a fleet
+class StandInBackend
+{
+public:
+    struct LatencyModel
+    {
+        int64_t roundTrip = 60000;        // Network and TLS record overhead of a keep-alive request (us)
+        int64_t roundTripJitter = 20000;  // Uniform, added to the round trip (us)
+        int64_t serviceTime = 4000;       // Script run time per request (us)
+        double serviceMicrosPerByte = 2;  // Extra run time per byte of request body
+        int workers = 8;                  // PHP-FPM workers
+        int64_t sntpRoundTrip = 30000;    // us
+        double sntpLateShare = 0;         // Share of SNTP replies that arrive after the client gave up
+        int64_t sntpLateDelay = 3000000;  // Extra delay of those replies (us)
+    };
+
+    struct StoredEvent
+    {
+        enum class Type
+        {
+            GATE,
+            DISPENSE,
+            WEIGHT
+        };
+
+        Type type;
+        unsigned long startTime;
+        unsigned long endTime;
+        float value;
+        int64_t receivedAt; // Virtual time the backend stored it (us)
+    };
+
+    struct Feeder
+    {
+        std::string password;
+        std::string name = "Host feeder";
+        std::string trapMode = "0";
+        std::string schedule = "{}";       // FeedFoodConfiguration, in RO time
+        float foodStorageQuantity = 1500;
+        std::vector<std::string> tags;
+        std::deque<std::string> commands;  // Served one per command poll
+        uint32_t pollsWhileSubscribed = 0; // Command polls while the push session was up
+
+        std::set<std::pair<uint32_t, uint32_t>> storedSequences; // (epoch, seq) of the batch events
+        std::vector<StoredEvent> events;
+        uint32_t duplicates = 0;           // Batch events acknowledged again without being stored
+        bool keepEvents = true;            // Counters only for large fleets
+        uint32_t numOfEvents = 0;
+    };
+
+    struct EndpointStats
+    {
+        uint64_t requests = 0;
+        uint64_t errors = 0;               // 4xx and 5xx responses
+        uint64_t bytesReceived = 0;        // URL and body
+        uint64_t bytesSent = 0;            // Body
+        LatencyHistogram latency;          // As seen by the feeder, queueing included
+    };
+
+    typedef std::function<int64_t()> WorldClock;
+
+private:
+    static constexpr const char* BASE_URL = "https://dev.bull-software.com/";
+    static constexpr uint32_t NTP_UNIX_EPOCH_OFFSET = 2208988800UL;
+    static constexpr int64_t SUBSCRIBE_GRACE = 1000000; // A poll already on the way when the SUBACK left (us)
+
+    std::map<std::string, Feeder> feeders;
+    std::map<std::string, EndpointStats> endpoints;
+    LatencyModel model;
+    WorldClock worldMicros;
+    std::vector<int64_t> workerFreeTimes;
+    std::mt19937 random{2024};
+
+    bool isAvailable = true;
+    bool hasBatchEndpoint = true;
+
+    StandInBroker broker{[this](const std::string& username, const std::string& password) { return authenticate(username, password) != nullptr; }};
+
+    static std::map<std::string, std::string> parseQuery(const std::string& url)
+    {
+        std::map<std::string, std::string> parameters;
+        size_t position = url.find('?');
+        while (position != std::string::npos)
+        {
+            size_t end = url.find('&', position + 1);
+            std::string pair = url.substr(position + 1, end == std::string::npos ? std::string::npos : end - position - 1);
+            size_t equals = pair.find('=');
+            if (equals != std::string::npos)
+            {
+                parameters[pair.substr(0, equals)] = pair.substr(equals + 1);
+            }
+            position = end;
+        }
+        return parameters;
+    }
+
+    Feeder* authenticate(const std::string& id, const std::string& password)
+    {
+        auto feeder = feeders.find(id);
+        return feeder != feeders.end() && feeder->second.password == password ? &feeder->second : nullptr;
+    }
+
+    static std::string toJson(const JsonDocument& doc)
+    {
+        std::string json;
+        serializeJson(doc, json);
+        return json;
+    }
+
+    static void store(Feeder& feeder, StoredEvent event)
+    {
+        feeder.numOfEvents++;
+        if (feeder.keepEvents)
+        {
+            feeder.events.push_back(event);
+        }
+    }
+
+    // Status and body of a request, at the given virtual time
+    int handle(const std::string& method, const std::string& script, const std::string& url, const std::string& body, int64_t time, std::string& response)
+    {
+        if (!isAvailable)
+        {
+            response = "<html><body>503 Service Unavailable</body></html>";
+            return 503;
+        }
+
+        if (script == "get_feeder" || script == "get_esp32_command")
+        {
+            std::map<std::string, std::string> query = parseQuery(url);
+            Feeder* feeder = authenticate(query["ID"], query["Password"]);
+            JsonDocument doc;
+            if (feeder == nullptr)
+            {
+                doc["error"] = "Invalid ID or password";
+                response = toJson(doc);
+                return 200;
+            }
+
+            if (script == "get_esp32_command")
+            {
+                feeder->pollsWhileSubscribed += broker.isSubscribed(query["ID"], SUBSCRIBE_GRACE) ? 1 : 0;
+                doc["Command"] = feeder->commands.empty() ? "" : feeder->commands.front();
+                if (!feeder->commands.empty())
+                {
+                    feeder->commands.pop_front();
+                }
+                response = toJson(doc);
+                return 200;
+            }
+
+            doc["ID"] = query["ID"];
+            doc["Name"] = feeder->name;
+            doc["TrapMode"] = feeder->trapMode;
+            doc["FeedFoodConfiguration"] = feeder->schedule;
+            doc["FoodStorageQuantity"] = feeder->foodStorageQuantity;
+            doc["FoodCurrentWeight"] = 0;
+            doc["LastFoodStorageQuantityUpdateTime"] = 0;
+            doc["LastFoodCurrentWeightUpdateTime"] = 0;
+            JsonArray tags = doc["RFIDTags"].to<JsonArray>();
+            for (const std::string& tag : feeder->tags)
+            {
+                tags.add(tag);
+            }
+            response = toJson(doc);
+            return 200;
+        }
+
+        bool isUpload = script == "add_events_batch" || script == "add_gate_event" || script == "add_food_dispense_event" || script == "update_food_weight";
+        if (!isUpload || (script == "add_events_batch" && !hasBatchEndpoint))
+        {
+            response = "<html><body>404 Not Found</body></html>";
+            return 404;
+        }
+
+        JsonDocument request;
+        if (method == "GET" || deserializeJson(request, body))
+        {
+            response = "{\"error\":\"Invalid request\"}";
+            return 400;
+        }
+
+        Feeder* feeder = authenticate(request["ID"].as<std::string>(), request["Password"].as<std::string>());
+        if (feeder == nullptr)
+        {
+            response = "{\"error\":\"Invalid ID or password\"}";
+            return 401;
+        }
+
+        if (script == "add_gate_event")
+        {
+            store(*feeder, {StoredEvent::Type::GATE, request["startTime"], request["endTime"], 0, time});
+        }
+        else if (script == "add_food_dispense_event")
+        {
+            store(*feeder, {StoredEvent::Type::DISPENSE, request["dispensedAt"], 0, request["quantityDispensed"], time});
+        }
+        else if (script == "update_food_weight")
+        {
+            store(*feeder, {StoredEvent::Type::WEIGHT, request["LastFoodCurrentWeightUpdateTime"], 0, request["FoodCurrentWeight"], time});
+        }
+        else
+        {
+            uint32_t epoch = request["epoch"];
+            uint32_t ackedThrough = 0;
+            for (JsonObjectConst event : request["events"].as<JsonArrayConst>())
+            {
+                uint32_t sequence = event["seq"];
+                ackedThrough = std::max(ackedThrough, sequence);
+                if (!feeder->storedSequences.insert({epoch, sequence}).second)
+                {
+                    feeder->duplicates++;
+                    continue;
+                }
+
+                std::string type = event["type"].as<std::string>();
+                if (type == "gate")
+                {
+                    store(*feeder, {StoredEvent::Type::GATE, event["startTime"], event["endTime"], 0, time});
+                }
+                else if (type == "dispense")
+                {
+                    store(*feeder, {StoredEvent::Type::DISPENSE, event["dispensedAt"], 0, event["quantityDispensed"], time});
+                }
+                else
+                {
+                    store(*feeder, {StoredEvent::Type::WEIGHT, event["LastFoodCurrentWeightUpdateTime"], 0, event["FoodCurrentWeight"], time});
+                }
+            }
+
+            JsonDocument doc;
+            doc["ackedThrough"] = ackedThrough;
+            response = toJson(doc);
+            return 200;
+        }
+
+        response = "{\"success\":true}";
+        return 200;
+    }
+
+    // Date header value (RFC 1123) of a unix time
+    static String formatHttpDate(int64_t unixMicros)
+    {
+        time_t seconds = (time_t)(unixMicros / 1000000);
+        struct tm utc;
+        gmtime_r(&seconds, &utc);
+        char date[40];
+        strftime(date, sizeof(date), "%a, %d %b %Y %H:%M:%S GMT", &utc);
+        return String(date);
+    }
+
+    static void writeNtpTimestamp(uint8_t* timestamp, int64_t unixMicros)
+    {
+        uint32_t seconds = (uint32_t)(unixMicros / 1000000 + NTP_UNIX_EPOCH_OFFSET);
+        uint32_t fraction = (uint32_t)(((uint64_t)(unixMicros % 1000000) << 32) / 1000000);
+        for (int i = 0; i < 4; i++)
+        {
+            timestamp[i] = (uint8_t)(seconds >> (24 - i * 8));
+            timestamp[4 + i] = (uint8_t)(fraction >> (24 - i * 8));
+        }
+    }
+
+public:
+    // worldClock gives the true unix time (us) at the current virtual time
+    StandInBackend(const LatencyModel& latencyModel, WorldClock worldClock) : model(latencyModel), worldMicros(worldClock), workerFreeTimes(latencyModel.workers, 0)
+    {
+    }
+
+    // Answer the HTTP requests, MQTT connections and SNTP datagrams of the host build
+    void install()
+    {
+        HostNet::state().connect = [this](const String& host, uint16_t port) { return broker.accept(host, port); };
+        HostNet::state().http = [this](const String& method, const String& url, const String& body) { return request(method, url, body); };
+        HostNet::state().udp = [this](const String&, uint16_t, const std::vector<uint8_t>& datagram, int64_t& latency) { return answerSntp(datagram, latency); };
+    }
+
+    Feeder& addFeeder(const std::string& id, const std::string& password)
+    {
+        Feeder& feeder = feeders[id];
+        feeder.password = password;
+        return feeder;
+    }
+
+    Feeder& getFeeder(const std::string& id)
+    {
+        return feeders.at(id);
+    }
+
+    // An app command: pushed when the feeder holds a subscribed session with the broker (delivered on
+    // its reconnect if it is offline), otherwise queued for the command poll
+    void sendCommand(const std::string& id, const std::string& command)
+    {
+        if (!broker.publish("feeders/" + id + "/command", command))
+        {
+            feeders.at(id).commands.push_back(command);
+        }
+    }
+
+    StandInBroker& getBroker()
+    {
+        return broker;
+    }
+
+    // 503 on every request while unavailable (e.g. a deploy)
+    void setAvailable(bool available)
+    {
+        isAvailable = available;
+    }
+
+    // A backend without add_events_batch.php (404), as before the outbox
+    void setBatchEndpoint(bool available)
+    {
+        hasBatchEndpoint = available;
+    }
+
+    const std::map<std::string, EndpointStats>& getEndpointStats() const
+    {
+        return endpoints;
+    }
+
+    HostNet::HttpResponse request(const String& method, const String& url, const String& body)
+    {
+        std::string path = url.c_str();
+        if (path.compare(0, strlen(BASE_URL), BASE_URL) != 0)
+        {
+            return {HTTPC_ERROR_CONNECTION_REFUSED, String(), String(), model.roundTrip};
+        }
+
+        size_t scriptEnd = path.find(".php", strlen(BASE_URL));
+        std::string script = path.substr(strlen(BASE_URL), scriptEnd == std::string::npos ? std::string::npos : scriptEnd - strlen(BASE_URL));
+
+        // The request waits for the first free worker
+        std::uniform_int_distribution<int64_t> jitter(0, model.roundTripJitter);
+        int64_t now = HostRtos::now();
+        int64_t roundTrip = model.roundTrip + jitter(random);
+        int64_t arrival = now + roundTrip / 2;
+        auto worker = std::min_element(workerFreeTimes.begin(), workerFreeTimes.end());
+        int64_t start = std::max(arrival, *worker);
+        int64_t finish = start + model.serviceTime + (int64_t)(model.serviceMicrosPerByte * body.length());
+        *worker = finish;
+
+        std::string response;
+        int code = handle(method.c_str(), script, path, body.c_str(), finish, response);
+        int64_t latency = finish + roundTrip / 2 - now;
+
+        EndpointStats& stats = endpoints[script];
+        stats.requests++;
+        stats.errors += code >= 400 ? 1 : 0;
+        stats.bytesReceived += url.length() + body.length();
+        stats.bytesSent += response.size();
+        stats.latency.add(latency);
+
+        return {code, String(response.c_str()), formatHttpDate(worldMicros() + (finish - now)), latency};
+    }
+
+    // Mode 4 reply of a stratum 2 server, with receive and transmit timestamps of the world clock
+    std::vector<uint8_t> answerSntp(const std::vector<uint8_t>& datagram, int64_t& latency)
+    {
+        if (datagram.size() < 48)
+        {
+            return {};
+        }
+
+        std::vector<uint8_t> reply(48, 0);
+        reply[0] = 0x24; // LI 0, version 4, mode 4 (server)
+        reply[1] = 2;
+        std::copy(datagram.begin() + 40, datagram.begin() + 48, reply.begin() + 24); // Originate = client transmit
+
+        std::uniform_int_distribution<int64_t> jitter(0, model.roundTripJitter);
+        latency = model.sntpRoundTrip + jitter(random);
+        int64_t serverTime = worldMicros() + latency / 2;
+        if (std::bernoulli_distribution(model.sntpLateShare)(random))
+        {
+            latency += model.sntpLateDelay; // Queued on the way back
+        }
+        writeNtpTimestamp(reply.data() + 32, serverTime);
+        writeNtpTimestamp(reply.data() + 40, serverTime + 50);
+        return reply;
+    }
+};
+
+#endif // STAND_IN_BACKEND_H
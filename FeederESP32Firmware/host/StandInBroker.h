@@ -0,0 +1,449 @@
+#ifndef STAND_IN_BROKER_H
+#define STAND_IN_BROKER_H
+
+#include <Arduino.h>
+#include <deque>
+#include <functional>
+#include <map>
+#include <memory>
+#include <set>
+#include <string>
+#include <vector>
+#include "HostNet.h"
+
+// Stand-in of the MQTT broker the app commands are pushed through, over HostNet's TCP connections.
+// MQTT 3.1.1 as far as CommandChannel uses it: persistent sessions, QoS 1 delivery to exact topics, the
+// unacknowledged messages resent with DUP after a reconnect, keep-alive pings. A client logs in with
+// a username and password the authenticator accepts, and may subscribe to its own command topic only.
+// Faults to inject: a PUBACK lost just before the connection breaks, and a connection that silently
+// stops carrying anything (a dead NAT mapping), which only the client's keep-alive can detect
+class StandInBroker
+{
+public:
+    static constexpr const char* HOST = "dev.bull-software.com";
+    static constexpr uint16_t PORT = 8883;
+
+    typedef std::function<bool(const std::string& username, const std::string& password)> Authenticator;
+
+    struct Stats
+    {
+        uint32_t connects = 0;     // Accepted CONNECTs
+        uint32_t refusals = 0;     // Refused CONNECTs
+        uint32_t publishes = 0;    // PUBLISH packets sent, resent ones included
+        uint32_t redeliveries = 0; // ... resent with DUP after a reconnect
+        uint32_t pubacks = 0;      // PUBACKs received
+        uint32_t pings = 0;
+    };
+
+private:
+    // MQTT control packet types (upper nibble of the fixed header)
+    static constexpr uint8_t CONNECT = 0x10;
+    static constexpr uint8_t CONNACK = 0x20;
+    static constexpr uint8_t PUBLISH = 0x30;
+    static constexpr uint8_t PUBACK = 0x40;
+    static constexpr uint8_t SUBSCRIBE = 0x80;
+    static constexpr uint8_t SUBACK = 0x90;
+    static constexpr uint8_t PINGREQ = 0xC0;
+    static constexpr uint8_t PINGRESP = 0xD0;
+    static constexpr uint8_t DISCONNECT = 0xE0;
+
+    struct Message
+    {
+        uint16_t packetId;
+        std::string topic;
+        std::string payload;
+        bool wasSent;
+    };
+
+    struct Connection;
+
+    // Kept across connections, as the clients connect with the clean session flag off
+    struct Session
+    {
+        std::string username;
+        std::set<std::string> subscriptions;
+        std::deque<Message> inflight; // Unacknowledged, in publish order
+        uint16_t lastPacketId = 0;
+        Connection* connection = nullptr;
+        int64_t subscribedSince = -1; // SUBACK of the current connection, -1 while it has none
+        bool losesNextPuback = false;
+        Stats stats;
+    };
+
+    struct Connection
+    {
+        std::shared_ptr<HostNet::TcpConnection> tcp;
+        std::vector<uint8_t> received; // Bytes of the packet being received
+        Session* session = nullptr;
+        bool isBlackHole = false;
+    };
+
+    Authenticator authenticator;
+    std::map<std::string, Session> sessions; // By client ID
+    std::set<std::shared_ptr<Connection>> connections;
+
+    static void appendString(std::vector<uint8_t>& bytes, const std::string& value)
+    {
+        bytes.push_back((uint8_t)(value.size() >> 8));
+        bytes.push_back((uint8_t)(value.size() & 0xFF));
+        bytes.insert(bytes.end(), value.begin(), value.end());
+    }
+
+    // Read a length-prefixed string at position, false if the body ends before it does
+    static bool readString(const std::vector<uint8_t>& body, size_t& position, std::string& value)
+    {
+        if (position + 2 > body.size())
+        {
+            return false;
+        }
+        size_t length = (body[position] << 8) | body[position + 1];
+        if (position + 2 + length > body.size())
+        {
+            return false;
+        }
+        value.assign(body.begin() + position + 2, body.begin() + position + 2 + length);
+        position += 2 + length;
+        return true;
+    }
+
+    static void send(Connection& connection, uint8_t header, const std::vector<uint8_t>& body, int64_t time)
+    {
+        if (connection.isBlackHole)
+        {
+            return;
+        }
+
+        std::vector<uint8_t> packet{header};
+        size_t length = body.size();
+        do
+        {
+            uint8_t encodedByte = length % 128;
+            length /= 128;
+            packet.push_back(length > 0 ? (encodedByte | 0x80) : encodedByte);
+        } while (length > 0);
+        packet.insert(packet.end(), body.begin(), body.end());
+        connection.tcp->sendToClient(packet.data(), packet.size(), time);
+    }
+
+    static void sendPublish(Session& session, Message& message, int64_t time)
+    {
+        bool isDuplicate = message.wasSent;
+        std::vector<uint8_t> body;
+        appendString(body, message.topic);
+        body.push_back((uint8_t)(message.packetId >> 8));
+        body.push_back((uint8_t)(message.packetId & 0xFF));
+        body.insert(body.end(), message.payload.begin(), message.payload.end());
+        send(*session.connection, PUBLISH | (isDuplicate ? 0x08 : 0) | 0x02, body, time); // QoS 1
+
+        message.wasSent = true;
+        session.stats.publishes++;
+        session.stats.redeliveries += isDuplicate ? 1 : 0;
+    }
+
+    void close(Connection& connection)
+    {
+        if (connection.session != nullptr)
+        {
+            connection.session->connection = nullptr;
+            connection.session->subscribedSince = -1;
+            connection.session = nullptr;
+        }
+        connection.tcp->closeFromServer();
+    }
+
+    void release(Connection* connection)
+    {
+        for (auto it = connections.begin(); it != connections.end(); ++it)
+        {
+            if (it->get() == connection)
+            {
+                connections.erase(it);
+                return;
+            }
+        }
+    }
+
+    void handleConnect(Connection& connection, const std::vector<uint8_t>& body, int64_t time)
+    {
+        size_t position = 0;
+        std::string protocol;
+        std::string clientId;
+        std::string username;
+        std::string password;
+        bool isValid = readString(body, position, protocol) && protocol == "MQTT" && position + 4 <= body.size() && body[position] == 4;
+        uint8_t flags = isValid ? body[position + 1] : 0;
+        position += 4;
+        isValid = isValid && readString(body, position, clientId);
+        isValid = isValid && (!(flags & 0x80) || readString(body, position, username));
+        isValid = isValid && (!(flags & 0x40) || readString(body, position, password));
+
+        if (!isValid || !authenticator(username, password))
+        {
+            send(connection, CONNACK, {0, (uint8_t)(isValid ? 5 : 1)}, time); // Not authorized, or unacceptable protocol
+            sessions[clientId].stats.refusals++;
+            close(connection);
+            return;
+        }
+
+        bool isCleanSession = (flags & 0x02) != 0;
+        if (isCleanSession)
+        {
+            sessions.erase(clientId);
+        }
+        bool isSessionPresent = sessions.count(clientId) > 0 && !sessions[clientId].subscriptions.empty();
+        Session& session = sessions[clientId];
+
+        // A client ID connects once: the new connection takes the session over
+        if (session.connection != nullptr)
+        {
+            close(*session.connection);
+        }
+
+        session.username = username;
+        session.connection = &connection;
+        session.stats.connects++;
+        connection.session = &session;
+        send(connection, CONNACK, {(uint8_t)(isSessionPresent ? 1 : 0), 0}, time);
+
+        for (Message& message : session.inflight)
+        {
+            sendPublish(session, message, time);
+        }
+    }
+
+    void handleSubscribe(Connection& connection, const std::vector<uint8_t>& body, int64_t time)
+    {
+        Session& session = *connection.session;
+        std::vector<uint8_t> ack{body[0], body[1]};
+        size_t position = 2;
+        std::string topic;
+        bool isGranted = false;
+        while (position < body.size() && readString(body, position, topic) && position < body.size())
+        {
+            position++; // Requested QoS, 1 is granted at most
+            bool isOwnTopic = topic == "feeders/" + session.username + "/command";
+            ack.push_back(isOwnTopic ? 1 : 0x80);
+            if (isOwnTopic)
+            {
+                session.subscriptions.insert(topic);
+                isGranted = true;
+            }
+        }
+
+        send(connection, SUBACK, ack, time);
+        if (isGranted)
+        {
+            session.subscribedSince = time;
+        }
+    }
+
+    void handlePuback(Connection& connection, const std::vector<uint8_t>& body)
+    {
+        Session& session = *connection.session;
+        if (session.losesNextPuback)
+        {
+            // Lost on the way, then the connection breaks: the message is resent with DUP on the next one
+            session.losesNextPuback = false;
+            close(connection);
+            return;
+        }
+
+        uint16_t packetId = (body[0] << 8) | body[1];
+        for (auto it = session.inflight.begin(); it != session.inflight.end(); ++it)
+        {
+            if (it->packetId == packetId)
+            {
+                session.inflight.erase(it);
+                break;
+            }
+        }
+        session.stats.pubacks++;
+    }
+
+    void handlePacket(Connection& connection, uint8_t header, const std::vector<uint8_t>& body, int64_t time)
+    {
+        uint8_t type = header & 0xF0;
+        if (connection.session == nullptr && type != CONNECT)
+        {
+            close(connection); // Anything before CONNECT is a protocol violation
+            return;
+        }
+
+        switch (type)
+        {
+            case CONNECT:
+                if (connection.session != nullptr)
+                {
+                    close(connection); // A second CONNECT is a protocol violation
+                    return;
+                }
+                handleConnect(connection, body, time);
+                break;
+            case SUBSCRIBE:
+                if (header != (SUBSCRIBE | 0x02) || body.size() < 2)
+                {
+                    close(connection);
+                    return;
+                }
+                handleSubscribe(connection, body, time);
+                break;
+            case PUBACK:
+                if (body.size() != 2)
+                {
+                    close(connection);
+                    return;
+                }
+                handlePuback(connection, body);
+                break;
+            case PINGREQ:
+                connection.session->stats.pings++;
+                send(connection, PINGRESP, {}, time);
+                break;
+            default: // DISCONNECT, and the publishing the clients have no use for
+                close(connection);
+                break;
+        }
+    }
+
+    // Bytes from a client, reaching the broker at the given time
+    void receive(Connection& connection, const uint8_t* data, size_t size, int64_t time)
+    {
+        if (connection.isBlackHole)
+        {
+            return;
+        }
+
+        std::vector<uint8_t>& received = connection.received;
+        received.insert(received.end(), data, data + size);
+
+        while (received.size() >= 2 && connection.tcp->isOpen)
+        {
+            size_t length = 0;
+            size_t multiplier = 1;
+            size_t position = 1;
+            bool isLengthComplete = false;
+            while (position < received.size() && position <= 4 && !isLengthComplete)
+            {
+                length += (received[position] & 0x7F) * multiplier;
+                multiplier *= 128;
+                isLengthComplete = (received[position++] & 0x80) == 0;
+            }
+            if (!isLengthComplete || received.size() < position + length)
+            {
+                return; // The rest is still on the way
+            }
+
+            uint8_t header = received[0];
+            std::vector<uint8_t> body(received.begin() + position, received.begin() + position + length);
+            received.erase(received.begin(), received.begin() + position + length);
+            handlePacket(connection, header, body, time);
+        }
+    }
+
+public:
+    explicit StandInBroker(Authenticator accepts) : authenticator(accepts)
+    {
+    }
+
+    // Server end of a client connect, nullptr when refused
+    std::shared_ptr<HostNet::TcpConnection> accept(const String& host, uint16_t port)
+    {
+        if (host != HOST || port != PORT)
+        {
+            return nullptr;
+        }
+
+        std::shared_ptr<Connection> connection = std::make_shared<Connection>();
+        connection->tcp = std::make_shared<HostNet::TcpConnection>();
+        Connection* server = connection.get();
+        connection->tcp->onServerReceive = [this, server](const uint8_t* data, size_t size, int64_t time) { receive(*server, data, size, time); };
+        connection->tcp->onClientClose = [this, server]() {
+            close(*server);
+            release(server);
+        };
+        connections.insert(connection);
+        return connection->tcp;
+    }
+
+    // Deliver with QoS 1 to the sessions subscribed to the topic, now or when their client reconnects.
+    // False when no session holds it
+    bool publish(const std::string& topic, const std::string& payload)
+    {
+        bool isHeld = false;
+        for (auto& entry : sessions)
+        {
+            Session& session = entry.second;
+            if (session.subscriptions.count(topic) == 0)
+            {
+                continue;
+            }
+
+            session.lastPacketId = session.lastPacketId == 0xFFFF ? 1 : session.lastPacketId + 1;
+            session.inflight.push_back({session.lastPacketId, topic, payload, false});
+            if (session.connection != nullptr)
+            {
+                sendPublish(session, session.inflight.back(), HostRtos::now());
+            }
+            isHeld = true;
+        }
+        return isHeld;
+    }
+
+    // The next PUBACK of the client is lost, and its connection breaks right after
+    void loseNextPuback(const std::string& clientId)
+    {
+        sessions[clientId].losesNextPuback = true;
+    }
+
+    // The current connection of the client stops carrying anything, in both directions, without closing.
+    // Messages sent meanwhile count as sent: the broker only learns of it when the client reconnects
+    void blackHole(const std::string& clientId)
+    {
+        Session& session = sessions[clientId];
+        if (session.connection != nullptr)
+        {
+            session.connection->isBlackHole = true;
+        }
+    }
+
+    // The client has had its subscription for at least the given time (us)
+    bool isSubscribed(const std::string& clientId, int64_t minDuration) const
+    {
+        auto it = sessions.find(clientId);
+        if (it == sessions.end() || it->second.connection == nullptr || it->second.connection->isBlackHole)
+        {
+            return false;
+        }
+        return it->second.subscribedSince >= 0 && HostRtos::now() - it->second.subscribedSince >= minDuration;
+    }
+
+    size_t getInflightCount(const std::string& clientId) const
+    {
+        auto it = sessions.find(clientId);
+        return it != sessions.end() ? it->second.inflight.size() : 0;
+    }
+
+    Stats getStats(const std::string& clientId) const
+    {
+        auto it = sessions.find(clientId);
+        return it != sessions.end() ? it->second.stats : Stats();
+    }
+
+    Stats getTotals() const
+    {
+        Stats totals;
+        for (const auto& entry : sessions)
+        {
+            const Stats& stats = entry.second.stats;
+            totals.connects += stats.connects;
+            totals.refusals += stats.refusals;
+            totals.publishes += stats.publishes;
+            totals.redeliveries += stats.redeliveries;
+            totals.pubacks += stats.pubacks;
+            totals.pings += stats.pings;
+        }
+        return totals;
+    }
+};
+
+#endif // STAND_IN_BROKER_H
@@ -0,0 +1,332 @@
+#ifndef HOST_ARDUINO_H
+#define HOST_ARDUINO_H
+
+#include <stdint.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <algorithm>
+#include <chrono>
+#include <functional>
+#include <random>
+#include <string>
+#include "freertos/FreeRTOS.h"
+
+// The subset of the Arduino-ESP32 core used by the firmware, for the host build. millis() and micros()
+// are the host's monotonic clock, as they are real time on the chip; the firmware itself reads time from
+// FeederClock, which the host build points at the virtual clock of HostRtos
+
+#define HIGH 1
+#define LOW 0
+#define INPUT 0x01
+#define OUTPUT 0x03
+#define FALLING 0x02
+#define RISING 0x01
+#define DEC 10
+#define HEX 16
+#define IRAM_ATTR
+#define PROGMEM
+#define F(string) (string)
+
+typedef uint8_t byte;
+
+using std::max;
+using std::min;
+
+#define constrain(amount, low, high) ((amount) < (low) ? (low) : ((amount) > (high) ? (high) : (amount)))
+
+class String
+{
+private:
+    std::string value;
+
+    static std::string format(const char* format, ...)
+    {
+        char buffer[64];
+        va_list args;
+        va_start(args, format);
+        vsnprintf(buffer, sizeof(buffer), format, args);
+        va_end(args);
+        return buffer;
+    }
+
+public:
+    String() {}
+    String(const char* text) : value(text != nullptr ? text : "") {}
+    String(const std::string& text) : value(text) {}
+    explicit String(char c) : value(1, c) {}
+    String(int number, unsigned char base = DEC) : value(format(base == HEX ? "%x" : "%d", number)) {}
+    String(unsigned int number, unsigned char base = DEC) : value(format(base == HEX ? "%x" : "%u", number)) {}
+    String(long number, unsigned char base = DEC) : value(format(base == HEX ? "%lx" : "%ld", number)) {}
+    String(unsigned long number, unsigned char base = DEC) : value(format(base == HEX ? "%lx" : "%lu", number)) {}
+    String(long long number) : value(std::to_string(number)) {}
+    String(unsigned long long number) : value(std::to_string(number)) {}
+    String(float number, unsigned int decimalPlaces = 2) : value(format("%.*f", decimalPlaces, (double)number)) {}
+    String(double number, unsigned int decimalPlaces = 2) : value(format("%.*f", decimalPlaces, number)) {}
+
+    const char* c_str() const { return value.c_str(); }
+    unsigned int length() const { return (unsigned int)value.size(); }
+    bool isEmpty() const { return value.empty(); }
+    bool reserve(unsigned int size) { value.reserve(size); return true; }
+
+    bool concat(const String& other) { value += other.value; return true; }
+    bool concat(const char* text) { value += text != nullptr ? text : ""; return true; }
+    bool concat(const char* text, unsigned int size) { value.append(text, size); return true; }
+    bool concat(char c) { value += c; return true; }
+
+    String& operator+=(const String& other) { value += other.value; return *this; }
+    String& operator+=(const char* text) { return concat(text), *this; }
+    String& operator+=(char c) { value += c; return *this; }
+
+    friend String operator+(const String& a, const String& b) { return String(a.value + b.value); }
+    friend String operator+(const String& a, const char* b) { return String(a.value + (b != nullptr ? b : "")); }
+    friend String operator+(const char* a, const String& b) { return String((a != nullptr ? a : "") + b.value); }
+
+    bool operator==(const String& other) const { return value == other.value; }
+    bool operator==(const char* text) const { return value == (text != nullptr ? text : ""); }
+    bool operator!=(const String& other) const { return value != other.value; }
+    bool operator!=(const char* text) const { return !(*this == text); }
+    bool operator<(const String& other) const { return value < other.value; }
+    bool equals(const String& other) const { return value == other.value; }
+
+    char operator[](unsigned int index) const { return index < value.size() ? value[index] : '\0'; }
+    char charAt(unsigned int index) const { return (*this)[index]; }
+
+    int indexOf(char c, unsigned int from = 0) const { size_t found = value.find(c, from); return found == std::string::npos ? -1 : (int)found; }
+    int indexOf(const char* text, unsigned int from = 0) const { size_t found = value.find(text, from); return found == std::string::npos ? -1 : (int)found; }
+    int indexOf(const String& text, unsigned int from = 0) const { return indexOf(text.c_str(), from); }
+    int lastIndexOf(char c) const { size_t found = value.rfind(c); return found == std::string::npos ? -1 : (int)found; }
+
+    String substring(unsigned int begin) const { return begin >= value.size() ? String() : String(value.substr(begin)); }
+    String substring(unsigned int begin, unsigned int end) const
+    {
+        if (begin > end)
+        {
+            std::swap(begin, end);
+        }
+        return begin >= value.size() ? String() : String(value.substr(begin, end - begin));
+    }
+
+    bool startsWith(const String& prefix) const { return value.compare(0, prefix.value.size(), prefix.value) == 0; }
+    bool endsWith(const String& suffix) const { return value.size() >= suffix.value.size() && value.compare(value.size() - suffix.value.size(), suffix.value.size(), suffix.value) == 0; }
+
+    long toInt() const { return atol(value.c_str()); }
+    float toFloat() const { return (float)atof(value.c_str()); }
+    void toUpperCase() { for (char& c : value) c = (char)toupper((unsigned char)c); }
+    void toLowerCase() { for (char& c : value) c = (char)tolower((unsigned char)c); }
+    void trim()
+    {
+        size_t begin = value.find_first_not_of(" \t\r\n");
+        size_t end = value.find_last_not_of(" \t\r\n");
+        value = begin == std::string::npos ? std::string() : value.substr(begin, end - begin + 1);
+    }
+    void remove(unsigned int index) { if (index < value.size()) value.erase(index); }
+    void remove(unsigned int index, unsigned int count) { if (index < value.size()) value.erase(index, count); }
+    void replace(const String& find, const String& replacement)
+    {
+        if (find.value.empty())
+        {
+            return;
+        }
+        for (size_t at = value.find(find.value); at != std::string::npos; at = value.find(find.value, at + replacement.value.size()))
+        {
+            value.replace(at, find.value.size(), replacement.value);
+        }
+    }
+};
+
+class Print
+{
+public:
+    virtual ~Print() {}
+    virtual size_t write(uint8_t c) = 0;
+    virtual size_t write(const uint8_t* buffer, size_t size)
+    {
+        for (size_t i = 0; i < size; i++)
+        {
+            write(buffer[i]);
+        }
+        return size;
+    }
+
+    size_t write(const char* text) { return write((const uint8_t*)text, strlen(text)); }
+
+    size_t printf(const char* format, ...)
+    {
+        char buffer[512];
+        va_list args;
+        va_start(args, format);
+        int length = vsnprintf(buffer, sizeof(buffer), format, args);
+        va_end(args);
+        return write((const uint8_t*)buffer, length < (int)sizeof(buffer) ? length : sizeof(buffer) - 1);
+    }
+
+    size_t print(const char* text) { return write(text); }
+    size_t print(const String& text) { return write(text.c_str()); }
+    size_t print(char c) { return write((uint8_t)c); }
+    size_t print(int number, int base = DEC) { return print(String(number, (unsigned char)base)); }
+    size_t print(unsigned int number, int base = DEC) { return print(String(number, (unsigned char)base)); }
+    size_t print(long number, int base = DEC) { return print(String(number, (unsigned char)base)); }
+    size_t print(unsigned long number, int base = DEC) { return print(String(number, (unsigned char)base)); }
+    size_t print(double number, int digits = 2) { return print(String(number, (unsigned int)digits)); }
+
+    size_t println() { return write("\n"); }
+    template <typename T>
+    size_t println(const T& value) { return print(value) + println(); }
+    template <typename T>
+    size_t println(const T& value, int format) { return print(value, format) + println(); }
+
+    virtual void flush() {}
+};
+
+class Stream : public Print
+{
+public:
+    virtual int available() = 0;
+    virtual int read() = 0;
+};
+
+// The console. Output goes to stdout unless disabled, input is never available
+class HardwareSerial : public Stream
+{
+private:
+    bool isEnabled = true;
+
+public:
+    explicit HardwareSerial(int uartNum = 0) { (void)uartNum; }
+
+    void begin(unsigned long baudRate, uint32_t config = 0, int rxPin = -1, int txPin = -1)
+    {
+        (void)baudRate;
+        (void)config;
+        (void)rxPin;
+        (void)txPin;
+    }
+
+    void onReceive(std::function<void()> callback, bool onlyOnTimeout = false)
+    {
+        (void)callback;
+        (void)onlyOnTimeout;
+    }
+
+    // Host build only: drop the output, e.g. the log of a long simulation
+    void setEnabled(bool enabled)
+    {
+        isEnabled = enabled;
+    }
+
+    using Print::write;
+    size_t write(uint8_t c) override
+    {
+        if (isEnabled)
+        {
+            fputc(c, stdout);
+        }
+        return 1;
+    }
+
+    size_t write(const uint8_t* buffer, size_t size) override
+    {
+        if (isEnabled)
+        {
+            fwrite(buffer, 1, size, stdout);
+        }
+        return size;
+    }
+
+    int available() override { return 0; }
+    int read() override { return -1; }
+    void flush() override { fflush(stdout); }
+    operator bool() const { return true; }
+};
+
+#define SERIAL_8N1 0x800001c
+
+inline HardwareSerial Serial;
+
+class IPAddress
+{
+private:
+    uint8_t octets[4] = {0, 0, 0, 0};
+
+public:
+    IPAddress() {}
+    IPAddress(uint8_t a, uint8_t b, uint8_t c, uint8_t d) : octets{a, b, c, d} {}
+
+    uint8_t operator[](int index) const { return octets[index]; }
+
+    String toString() const
+    {
+        char text[16];
+        snprintf(text, sizeof(text), "%u.%u.%u.%u", octets[0], octets[1], octets[2], octets[3]);
+        return text;
+    }
+};
+
+// Fixed seed, so a simulation replays the same run
+struct HostRandom
+{
+    static std::mt19937& generator()
+    {
+        static std::mt19937 instance(12345);
+        return instance;
+    }
+};
+
+inline void randomSeed(unsigned long seed)
+{
+    HostRandom::generator().seed((uint32_t)seed);
+}
+
+inline long random(long howBig)
+{
+    return howBig <= 0 ? 0 : (long)(HostRandom::generator()() % (uint32_t)howBig);
+}
+
+inline long random(long howSmall, long howBig)
+{
+    return howSmall >= howBig ? howSmall : howSmall + random(howBig - howSmall);
+}
+
+inline unsigned long micros()
+{
+    static const auto start = std::chrono::steady_clock::now();
+    return (unsigned long)std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
+}
+
+inline unsigned long millis()
+{
+    return micros() / 1000;
+}
+
+inline void delay(unsigned long ms)
+{
+    vTaskDelay(pdMS_TO_TICKS(ms));
+}
+
+inline void yield()
+{
+    HostRtos::yield();
+}
+
+class EspClass
+{
+public:
+    uint32_t getFreeHeap() { return 200000; }
+    uint32_t getMinFreeHeap() { return 180000; }
+    uint32_t getCpuFreqMHz() { return 240; }
+    const char* getSdkVersion() { return "host"; }
+
+    [[noreturn]] void restart()
+    {
+        fflush(stdout);
+        fprintf(stderr, "ESP.restart() called\n");
+        exit(3);
+    }
+};
+
+inline EspClass ESP;
+
+#endif // HOST_ARDUINO_H
@@ -0,0 +1,17 @@
+#ifndef HOST_CLIENT_H
+#define HOST_CLIENT_H
+
+#include <Arduino.h>
+
+class Client : public Stream
+{
+public:
+    virtual int connect(const char* host, uint16_t port) = 0;
+    virtual uint8_t connected() = 0;
+    virtual void stop() = 0;
+
+    using Stream::read;
+    virtual int read(uint8_t* buffer, size_t size) = 0;
+};
+
+#endif // HOST_CLIENT_H
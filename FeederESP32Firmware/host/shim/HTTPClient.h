@@ -0,0 +1,81 @@
+#ifndef HOST_HTTP_CLIENT_H
+#define HOST_HTTP_CLIENT_H
+
+#include <Arduino.h>
+#include "WiFiClientSecure.h"
+#include "HostNet.h"
+
+#define HTTPC_ERROR_CONNECTION_REFUSED (-1)
+#define HTTPC_ERROR_READ_TIMEOUT (-11)
+
+// Requests go to HostNet's HTTP handler. The calling task blocks for the round trip the handler reports,
+// as it does on the chip, so the other tasks keep running meanwhile
+class HTTPClient
+{
+private:
+    String url;
+    WiFiClient* client = nullptr;
+    String responseBody;
+    String dateHeader;
+    uint16_t timeout = 5000;
+
+public:
+    bool begin(const String& requestUrl)
+    {
+        url = requestUrl;
+        client = nullptr;
+        return true;
+    }
+
+    bool begin(WiFiClient& connection, const String& requestUrl)
+    {
+        url = requestUrl;
+        client = &connection;
+        return true;
+    }
+
+    void end() {}
+    void setReuse(bool reuse) { (void)reuse; }
+    void setTimeout(uint16_t timeoutMs) { timeout = timeoutMs; }
+    void addHeader(const String& name, const String& value) { (void)name; (void)value; }
+    void collectHeaders(const char* headerKeys[], size_t count) { (void)headerKeys; (void)count; }
+
+    String header(const char* name)
+    {
+        return strcmp(name, "Date") == 0 ? dateHeader : String();
+    }
+
+    int sendRequest(const char* method, const String& payload = String())
+    {
+        responseBody = String();
+        dateHeader = String();
+
+        HostNet::HttpHandler& handler = HostNet::state().http;
+        if (!HostNet::isWifiUp() || !handler || (client != nullptr && !client->connected()))
+        {
+            return HTTPC_ERROR_CONNECTION_REFUSED;
+        }
+
+        HostNet::HttpResponse response = handler(method, url, payload);
+        if (response.latency > (int64_t)timeout * 1000)
+        {
+            HostRtos::sleepFor((int64_t)timeout * 1000);
+            return HTTPC_ERROR_READ_TIMEOUT;
+        }
+        HostRtos::sleepFor(response.latency);
+
+        if (response.code > 0)
+        {
+            responseBody = response.body;
+            dateHeader = response.date;
+        }
+        return response.code;
+    }
+
+    String getString()
+    {
+        return responseBody;
+    }
+};
+
+#endif // HOST_HTTP_CLIENT_H
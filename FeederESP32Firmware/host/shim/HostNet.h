@@ -0,0 +1,202 @@
+#ifndef HOST_NET_H
+#define HOST_NET_H
+
+#include <Arduino.h>
+#include <deque>
+#include <functional>
+#include <map>
+#include <memory>
+#include "HostRtos.h"
+#include <vector>
+
+// Network of the host build. Wi-Fi is up or down as the simulation says; HTTP requests, SNTP datagrams
+// and TCP connects go to handlers registered by the simulation (a stand-in backend, an SNTP server, a
+// broker). Without a handler, requests fail as on a network that drops them
+struct HostNet
+{
+    // A TCP connection from a client of the host build (WiFiClient) to a server of the simulation. What
+    // one side sends arrives at the other after the one-way latency, in order
+    struct TcpConnection
+    {
+        // Bytes from the client, with the time they reach the server
+        typedef std::function<void(const uint8_t* data, size_t size, int64_t arrivalTime)> DataHandler;
+
+        struct Segment
+        {
+            int64_t arrivalTime;
+            std::vector<uint8_t> data;
+        };
+
+        int64_t latency = 15000; // One way (us)
+        bool isOpen = true;
+        int board = 0;           // Board of the client, whose socket numbers fd belongs to
+        int fd = -1;
+        DataHandler onServerReceive;
+        std::function<void()> onClientClose; // The client closed its socket, also after the server closed
+        std::deque<Segment> inbound; // To the client, by arrival time
+        size_t readOffset = 0;       // Into the first inbound segment
+        HostRtos::WaitList selectors; // Tasks in lwip_select() on the client socket
+
+        // Bytes from the server, leaving it at the given time (now for a push)
+        void sendToClient(const uint8_t* data, size_t size, int64_t sendTime)
+        {
+            if (!isOpen || size == 0)
+            {
+                return;
+            }
+            int64_t arrivalTime = sendTime + latency;
+            if (!inbound.empty() && inbound.back().arrivalTime > arrivalTime)
+            {
+                arrivalTime = inbound.back().arrivalTime;
+            }
+            inbound.push_back({arrivalTime, std::vector<uint8_t>(data, data + size)});
+            wakeSelectors();
+        }
+
+        // The server ends the connection; the client reads what has arrived, then sees it closed
+        void closeFromServer()
+        {
+            isOpen = false;
+            wakeSelectors();
+        }
+
+        size_t getArrivedBytes() const
+        {
+            size_t count = 0;
+            for (const Segment& segment : inbound)
+            {
+                if (segment.arrivalTime > HostRtos::now())
+                {
+                    break;
+                }
+                count += segment.data.size();
+            }
+            return count - readOffset;
+        }
+
+        // Time the next bytes arrive, FOREVER for none in flight
+        int64_t getNextArrivalTime() const
+        {
+            for (const Segment& segment : inbound)
+            {
+                if (segment.arrivalTime > HostRtos::now())
+                {
+                    return segment.arrivalTime;
+                }
+            }
+            return HostRtos::FOREVER;
+        }
+
+        size_t read(uint8_t* buffer, size_t size)
+        {
+            size_t count = 0;
+            while (count < size && !inbound.empty() && inbound.front().arrivalTime <= HostRtos::now())
+            {
+                Segment& segment = inbound.front();
+                size_t chunk = std::min(size - count, segment.data.size() - readOffset);
+                memcpy(buffer + count, segment.data.data() + readOffset, chunk);
+                count += chunk;
+                readOffset += chunk;
+                if (readOffset == segment.data.size())
+                {
+                    inbound.pop_front();
+                    readOffset = 0;
+                }
+            }
+            return count;
+        }
+
+        // Let the tasks in lwip_select() look again, new bytes may change when they have to wake. Those
+        // woken register again before this returns when they preempt the caller
+        void wakeSelectors()
+        {
+            HostRtos::WaitList waiting;
+            waiting.swap(selectors);
+            while (!waiting.empty())
+            {
+                HostRtos::wakeFirst(waiting);
+            }
+        }
+    };
+
+    struct HttpResponse
+    {
+        int code;        // HTTP status, or a negative HTTPClient error
+        String body;
+        String date;     // Date header, "" for none
+        int64_t latency; // Round trip, spent blocked in sendRequest() (us)
+    };
+
+    typedef std::function<HttpResponse(const String& method, const String& url, const String& body)> HttpHandler;
+    // Reply to a datagram, empty for none. Sets the delay after which the reply is received (us)
+    typedef std::function<std::vector<uint8_t>(const String& host, uint16_t port, const std::vector<uint8_t>& request, int64_t& latency)> UdpHandler;
+    // The server end of a new connection, nullptr when refused
+    typedef std::function<std::shared_ptr<TcpConnection>(const String& host, uint16_t port)> ConnectHandler;
+
+    static constexpr int FIRST_SOCKET = 54; // lwIP numbers its sockets after the VFS file descriptors
+
+    struct State
+    {
+        bool isWifiUp = false;
+        bool joinsOnBegin = true;   // WiFi.begin() brings the link up after joinDelay
+        int64_t joinDelay = 2000000;
+        int64_t wifiUpTime = -1;    // Time the link comes up, -1 while it does not
+        HttpHandler http;
+        UdpHandler udp;
+        ConnectHandler connect;
+        std::map<std::pair<int, int>, TcpConnection*> sockets; // By board and socket number
+    };
+
+    static State& state()
+    {
+        static State instance;
+        return instance;
+    }
+
+    static bool isWifiUp()
+    {
+        State& s = state();
+        if (!s.isWifiUp && s.wifiUpTime >= 0 && HostRtos::now() >= s.wifiUpTime)
+        {
+            s.isWifiUp = true;
+        }
+        return s.isWifiUp;
+    }
+
+    // Give a connection of the current task's board the lowest free socket number
+    static void openSocket(TcpConnection* connection)
+    {
+        std::map<std::pair<int, int>, TcpConnection*>& sockets = state().sockets;
+        connection->board = HostRtos::currentTask()->board;
+        connection->fd = FIRST_SOCKET;
+        while (sockets.count({connection->board, connection->fd}) > 0)
+        {
+            connection->fd++;
+        }
+        sockets[{connection->board, connection->fd}] = connection;
+    }
+
+    static void closeSocket(TcpConnection* connection)
+    {
+        state().sockets.erase({connection->board, connection->fd});
+        connection->fd = -1;
+    }
+
+    // Connection of a socket number of the current task's board, nullptr for none
+    static TcpConnection* findSocket(int fd)
+    {
+        std::map<std::pair<int, int>, TcpConnection*>& sockets = state().sockets;
+        auto it = sockets.find({HostRtos::currentTask()->board, fd});
+        return it != sockets.end() ? it->second : nullptr;
+    }
+
+    // Take the link down (e.g. an access point outage) or up again
+    static void setWifiUp(bool up)
+    {
+        State& s = state();
+        s.isWifiUp = up;
+        s.wifiUpTime = up ? HostRtos::now() : -1;
+    }
+};
+
+#endif // HOST_NET_H
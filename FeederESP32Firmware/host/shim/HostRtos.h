@@ -0,0 +1,417 @@
+#ifndef HOST_RTOS_H
+#define HOST_RTOS_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <ucontext.h>
+#include <deque>
+#include <memory>
+#include <set>
+#include <utility>
+#include <vector>
+
+// Single-core FreeRTOS and esp_timer in virtual time, for the host build. Every task is a ucontext
+// coroutine and only one runs at a time: the highest-priority ready one, round robin among equals.
+// A task runs until it blocks (or wakes a task of higher priority); the clock stands still while it runs.
+// When every task is blocked, the clock jumps to the next timeout or timer, and the due esp_timer
+// callbacks run inline. A simulated week takes as long as the work done in it
+namespace HostRtos
+{
+    typedef void (*TaskFunction)(void*);
+    typedef void (*TimerCallback)(void*);
+
+    static constexpr int64_t FOREVER = INT64_MAX;
+    static constexpr size_t DEFAULT_STACK_SIZE = 256 * 1024; // The host stacks are not sized like the ESP32 ones
+
+    struct Task
+    {
+        const char* name = "main";
+        unsigned priority = 0;
+        bool isReady = true;
+        bool isDeleted = false;
+        bool timedOut = false;
+        bool waitsForNotification = false;
+        uint32_t notificationValue = 0;
+        uint64_t readyOrder = 0;  // Round robin among the ready tasks of the same priority
+        int64_t wakeTime = FOREVER;
+        int board = 0;            // Simulated board the task runs on (its NVS partition), inherited by the tasks it creates
+        ucontext_t context;
+        std::unique_ptr<char[]> stack; // Left uninitialized, so only the pages a task uses are committed
+        TaskFunction function = nullptr;
+        void* parameter = nullptr;
+    };
+
+    // Highest priority first, then the longest ready
+    struct RunsBefore
+    {
+        bool operator()(const Task* a, const Task* b) const
+        {
+            return a->priority != b->priority ? a->priority > b->priority : a->readyOrder < b->readyOrder;
+        }
+    };
+
+    struct Timer
+    {
+        TimerCallback callback = nullptr;
+        void* arg = nullptr;
+        const char* name = "";
+        bool isActive = false;
+        int64_t dueTime = 0;
+        uint64_t period = 0; // 0 for a one-shot timer
+    };
+
+    // Tasks blocked on a queue or a semaphore, in the order they started waiting
+    typedef std::deque<Task*> WaitList;
+
+    // The ready and sleeping tasks are kept ordered, so a fleet of thousands of tasks schedules in log time
+    struct State
+    {
+        int64_t now = 0;
+        Task mainTask;
+        Task* current = &mainTask;
+        std::vector<Task*> tasks{&mainTask};
+        std::set<Task*, RunsBefore> ready{&mainTask};
+        std::set<std::pair<int64_t, Task*>> sleeping; // Blocked tasks with a timeout, by wake time
+        std::vector<Timer*> timers;
+        uint64_t readyCounter = 0;
+        bool inTimerCallback = false;
+        uint64_t contextSwitches = 0;
+        size_t stackSize = DEFAULT_STACK_SIZE;
+    };
+
+    inline State& state()
+    {
+        static State instance;
+        return instance;
+    }
+
+    inline int64_t now()
+    {
+        return state().now;
+    }
+
+    inline Task* currentTask()
+    {
+        return state().current;
+    }
+
+    inline bool inTimerCallback()
+    {
+        return state().inTimerCallback;
+    }
+
+    inline uint64_t getContextSwitches()
+    {
+        return state().contextSwitches;
+    }
+
+    inline void cancelTimeout(Task* task)
+    {
+        if (task->wakeTime != FOREVER)
+        {
+            state().sleeping.erase({task->wakeTime, task});
+            task->wakeTime = FOREVER;
+        }
+    }
+
+    inline void makeReady(Task* task)
+    {
+        State& s = state();
+        cancelTimeout(task);
+        s.ready.erase(task); // The order key changes below
+        task->isReady = true;
+        task->readyOrder = ++s.readyCounter;
+        s.ready.insert(task);
+    }
+
+    // Not ready any more: blocked (until the given time, FOREVER for none) or deleted
+    inline void makeBlocked(Task* task, int64_t wakeTime)
+    {
+        State& s = state();
+        s.ready.erase(task);
+        cancelTimeout(task);
+        task->isReady = false;
+        task->wakeTime = wakeTime;
+        if (wakeTime != FOREVER)
+        {
+            s.sleeping.insert({wakeTime, task});
+        }
+    }
+
+    inline Task* pickReadyTask()
+    {
+        std::set<Task*, RunsBefore>& ready = state().ready;
+        return ready.empty() ? nullptr : *ready.begin();
+    }
+
+    // Run the callbacks of the timers due at the current time, earliest first
+    inline void fireDueTimers()
+    {
+        State& s = state();
+        for (;;)
+        {
+            Timer* due = nullptr;
+            for (Timer* timer : s.timers)
+            {
+                if (timer->isActive && timer->dueTime <= s.now && (due == nullptr || timer->dueTime < due->dueTime))
+                {
+                    due = timer;
+                }
+            }
+            if (due == nullptr)
+            {
+                return;
+            }
+
+            if (due->period > 0)
+            {
+                due->dueTime += due->period;
+            }
+            else
+            {
+                due->isActive = false;
+            }
+
+            s.inTimerCallback = true;
+            due->callback(due->arg);
+            s.inTimerCallback = false;
+        }
+    }
+
+    // Advance the clock to the next event: a task timeout or a timer
+    inline void advanceClock()
+    {
+        State& s = state();
+        int64_t next = s.sleeping.empty() ? FOREVER : s.sleeping.begin()->first;
+        for (Timer* timer : s.timers)
+        {
+            if (timer->isActive && timer->dueTime < next)
+            {
+                next = timer->dueTime;
+            }
+        }
+
+        if (next == FOREVER)
+        {
+            fprintf(stderr, "HostRtos: every task is blocked forever at %lld us\n", (long long)s.now);
+            abort();
+        }
+
+        if (next > s.now)
+        {
+            s.now = next;
+        }
+
+        fireDueTimers();
+        while (!s.sleeping.empty() && s.sleeping.begin()->first <= s.now)
+        {
+            Task* task = s.sleeping.begin()->second;
+            makeReady(task);
+            task->timedOut = true;
+        }
+    }
+
+    inline void switchTo(Task* next)
+    {
+        State& s = state();
+        Task* previous = s.current;
+        if (next == previous)
+        {
+            return;
+        }
+        s.current = next;
+        s.contextSwitches++;
+        swapcontext(&previous->context, &next->context);
+    }
+
+    // Give the CPU to the highest-priority ready task, advancing the clock until one is ready
+    inline void reschedule()
+    {
+        Task* next;
+        while ((next = pickReadyTask()) == nullptr)
+        {
+            advanceClock();
+        }
+        switchTo(next);
+    }
+
+    // Block the current task until wake() or the timeout (us, FOREVER for none). True if woken
+    inline bool block(int64_t timeout)
+    {
+        Task* task = currentTask();
+        if (timeout <= 0)
+        {
+            return false;
+        }
+        if (inTimerCallback())
+        {
+            fprintf(stderr, "HostRtos: blocking call from a timer callback\n");
+            abort();
+        }
+
+        task->timedOut = false;
+        makeBlocked(task, timeout == FOREVER ? FOREVER : state().now + timeout);
+        reschedule();
+        return !task->timedOut;
+    }
+
+    // Let the other ready tasks of the same priority run
+    inline void yield()
+    {
+        makeReady(currentTask());
+        reschedule();
+    }
+
+    // Wake a blocked task. A task of higher priority than the current one preempts it, except from a timer callback
+    inline void wake(Task* task)
+    {
+        if (task->isReady || task->isDeleted)
+        {
+            return;
+        }
+        task->timedOut = false;
+        makeReady(task);
+
+        if (!inTimerCallback() && task->priority > currentTask()->priority)
+        {
+            yield();
+        }
+    }
+
+    inline void wakeFirst(WaitList& waiters)
+    {
+        if (!waiters.empty())
+        {
+            Task* task = waiters.front();
+            waiters.pop_front();
+            wake(task);
+        }
+    }
+
+    inline void removeWaiter(WaitList& waiters, Task* task)
+    {
+        for (auto it = waiters.begin(); it != waiters.end(); ++it)
+        {
+            if (*it == task)
+            {
+                waiters.erase(it);
+                return;
+            }
+        }
+    }
+
+    inline void runTask()
+    {
+        Task* task = currentTask();
+        task->function(task->parameter);
+
+        // A FreeRTOS task must not return
+        fprintf(stderr, "HostRtos: task %s returned\n", task->name);
+        abort();
+    }
+
+    inline Task* createTask(TaskFunction function, const char* name, void* parameter, unsigned priority)
+    {
+        Task* task = new Task();
+        task->name = name;
+        task->priority = priority;
+        task->function = function;
+        task->parameter = parameter;
+        task->board = currentTask()->board;
+        task->stack.reset(new char[state().stackSize]);
+
+        getcontext(&task->context);
+        task->context.uc_stack.ss_sp = task->stack.get();
+        task->context.uc_stack.ss_size = state().stackSize;
+        task->context.uc_link = nullptr;
+        makecontext(&task->context, runTask, 0);
+
+        state().tasks.push_back(task);
+        makeReady(task);
+        if (!inTimerCallback() && priority > currentTask()->priority)
+        {
+            yield();
+        }
+        return task;
+    }
+
+    inline void deleteTask(Task* task)
+    {
+        makeBlocked(task, FOREVER);
+        task->isDeleted = true;
+    }
+
+    inline void deleteCurrentTask()
+    {
+        deleteTask(currentTask());
+        reschedule();
+    }
+
+    // Priority of the caller of main(), e.g. above the firmware tasks for a simulation driver
+    inline void setMainPriority(unsigned priority)
+    {
+        State& s = state();
+        s.ready.erase(&s.mainTask);
+        s.mainTask.priority = priority;
+        if (s.mainTask.isReady)
+        {
+            s.ready.insert(&s.mainTask);
+        }
+    }
+
+    // Stack of the tasks created from now on. A fleet of boards needs less than the default per task
+    inline void setStackSize(size_t size)
+    {
+        state().stackSize = size;
+    }
+
+    inline void sleepFor(int64_t micros)
+    {
+        if (micros <= 0)
+        {
+            yield();
+            return;
+        }
+        block(micros);
+    }
+
+    // Sleep until an absolute time on the virtual clock
+    inline void sleepUntil(int64_t time)
+    {
+        sleepFor(time - now());
+    }
+
+    inline Timer* createTimer(TimerCallback callback, void* arg, const char* name)
+    {
+        Timer* timer = new Timer();
+        timer->callback = callback;
+        timer->arg = arg;
+        timer->name = name;
+        state().timers.push_back(timer);
+        return timer;
+    }
+
+    inline void startTimer(Timer* timer, uint64_t delay, uint64_t period)
+    {
+        timer->isActive = true;
+        timer->dueTime = now() + (int64_t)delay;
+        timer->period = period;
+    }
+
+    inline void deleteTimer(Timer* timer)
+    {
+        std::vector<Timer*>& timers = state().timers;
+        for (auto it = timers.begin(); it != timers.end(); ++it)
+        {
+            if (*it == timer)
+            {
+                timers.erase(it);
+                break;
+            }
+        }
+        delete timer;
+    }
+}
+
+#endif // HOST_RTOS_H
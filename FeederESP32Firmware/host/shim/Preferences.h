@@ -0,0 +1,169 @@
+#ifndef HOST_PREFERENCES_H
+#define HOST_PREFERENCES_H
+
+#include <Arduino.h>
+#include <map>
+#include <string>
+#include <vector>
+
+// NVS in memory. Each simulated board has its own partition, the one of the board the running task
+// belongs to (HostRtos::Task::board). Select it before creating that board's controllers and tasks
+struct HostNvs
+{
+    typedef std::map<std::string, std::vector<uint8_t>> Namespace;
+    typedef std::map<std::string, Namespace> Partition;
+
+    static std::vector<Partition>& partitions()
+    {
+        static std::vector<Partition> instance(1);
+        return instance;
+    }
+
+    static void setPartition(int index)
+    {
+        if (index >= (int)partitions().size())
+        {
+            partitions().resize(index + 1);
+        }
+        HostRtos::currentTask()->board = index;
+    }
+
+    static Partition& current()
+    {
+        return partitions()[HostRtos::currentTask()->board];
+    }
+
+    // Entry writes, counted like the flash writes of the NVS library: an unchanged value is not written again
+    static uint64_t& writes()
+    {
+        static uint64_t count = 0;
+        return count;
+    }
+};
+
+class Preferences
+{
+private:
+    std::string name;
+    bool isOpen = false;
+    bool isReadOnly = true;
+
+    HostNvs::Namespace* space()
+    {
+        return isOpen ? &HostNvs::current()[name] : nullptr;
+    }
+
+    const std::vector<uint8_t>* find(const char* key)
+    {
+        HostNvs::Namespace* entries = space();
+        if (entries == nullptr)
+        {
+            return nullptr;
+        }
+        auto entry = entries->find(key);
+        return entry == entries->end() ? nullptr : &entry->second;
+    }
+
+    size_t put(const char* key, const void* value, size_t size)
+    {
+        HostNvs::Namespace* entries = space();
+        if (entries == nullptr || isReadOnly)
+        {
+            return 0;
+        }
+
+        const uint8_t* bytes = static_cast<const uint8_t*>(value);
+        std::vector<uint8_t> stored(bytes, bytes + size);
+        std::vector<uint8_t>& entry = (*entries)[key];
+        if (entry != stored)
+        {
+            entry = stored;
+            HostNvs::writes()++;
+        }
+        return size;
+    }
+
+    template <typename T>
+    T get(const char* key, T defaultValue)
+    {
+        const std::vector<uint8_t>* entry = find(key);
+        if (entry == nullptr || entry->size() != sizeof(T))
+        {
+            return defaultValue;
+        }
+        T value;
+        memcpy(&value, entry->data(), sizeof(T));
+        return value;
+    }
+
+public:
+    bool begin(const char* nvsNamespace, bool readOnly = false)
+    {
+        name = nvsNamespace;
+        isOpen = true;
+        isReadOnly = readOnly;
+        return true;
+    }
+
+    void end()
+    {
+        isOpen = false;
+    }
+
+    bool isKey(const char* key) { return find(key) != nullptr; }
+
+    bool remove(const char* key)
+    {
+        HostNvs::Namespace* entries = space();
+        return entries != nullptr && !isReadOnly && entries->erase(key) > 0;
+    }
+
+    bool clear()
+    {
+        HostNvs::Namespace* entries = space();
+        if (entries == nullptr || isReadOnly)
+        {
+            return false;
+        }
+        entries->clear();
+        return true;
+    }
+
+    size_t putString(const char* key, const String& value) { return put(key, value.c_str(), value.length() + 1) > 0 ? value.length() : 0; }
+    String getString(const char* key, const String& defaultValue = String())
+    {
+        const std::vector<uint8_t>* entry = find(key);
+        return entry == nullptr || entry->empty() ? defaultValue : String((const char*)entry->data());
+    }
+
+    size_t putBytes(const char* key, const void* value, size_t size) { return size == 0 ? 0 : put(key, value, size); }
+    size_t getBytesLength(const char* key)
+    {
+        const std::vector<uint8_t>* entry = find(key);
+        return entry == nullptr ? 0 : entry->size();
+    }
+    size_t getBytes(const char* key, void* buffer, size_t maxSize)
+    {
+        const std::vector<uint8_t>* entry = find(key);
+        if (entry == nullptr || entry->size() > maxSize)
+        {
+            return 0;
+        }
+        memcpy(buffer, entry->data(), entry->size());
+        return entry->size();
+    }
+
+    size_t putInt(const char* key, int32_t value) { return put(key, &value, sizeof(value)); }
+    int32_t getInt(const char* key, int32_t defaultValue = 0) { return get(key, defaultValue); }
+    size_t putUInt(const char* key, uint32_t value) { return put(key, &value, sizeof(value)); }
+    uint32_t getUInt(const char* key, uint32_t defaultValue = 0) { return get(key, defaultValue); }
+    // unsigned long is 32 bits on the ESP32, so is the stored value
+    size_t putULong(const char* key, unsigned long value) { uint32_t stored = (uint32_t)value; return put(key, &stored, sizeof(stored)); }
+    unsigned long getULong(const char* key, unsigned long defaultValue = 0) { return get(key, (uint32_t)defaultValue); }
+    size_t putFloat(const char* key, float value) { return put(key, &value, sizeof(value)); }
+    float getFloat(const char* key, float defaultValue = 0) { return get(key, defaultValue); }
+    size_t putBool(const char* key, bool value) { uint8_t stored = value; return put(key, &stored, sizeof(stored)); }
+    bool getBool(const char* key, bool defaultValue = false) { return get(key, (uint8_t)defaultValue) != 0; }
+};
+
+#endif // HOST_PREFERENCES_H
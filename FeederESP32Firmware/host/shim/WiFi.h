@@ -0,0 +1,63 @@
+#ifndef HOST_WIFI_H
+#define HOST_WIFI_H
+
+#include <Arduino.h>
+#include "HostNet.h"
+
+typedef enum
+{
+    WL_IDLE_STATUS = 0,
+    WL_NO_SSID_AVAIL = 1,
+    WL_CONNECTED = 3,
+    WL_CONNECT_FAILED = 4,
+    WL_CONNECTION_LOST = 5,
+    WL_DISCONNECTED = 6
+} wl_status_t;
+
+// Station interface only: the link state comes from HostNet
+class WiFiClass
+{
+public:
+    void begin(const char* ssid, const char* password)
+    {
+        (void)ssid;
+        (void)password;
+        HostNet::State& net = HostNet::state();
+        if (net.joinsOnBegin && !net.isWifiUp)
+        {
+            net.wifiUpTime = HostRtos::now() + net.joinDelay;
+        }
+    }
+
+    bool disconnect(bool wifiOff = false)
+    {
+        (void)wifiOff;
+        HostNet::setWifiUp(false);
+        return true;
+    }
+
+    wl_status_t status()
+    {
+        return HostNet::isWifiUp() ? WL_CONNECTED : WL_DISCONNECTED;
+    }
+
+    int hostByName(const char* host, IPAddress& address)
+    {
+        (void)host;
+        if (!HostNet::isWifiUp())
+        {
+            return 0;
+        }
+        address = IPAddress(192, 0, 2, 1);
+        return 1;
+    }
+
+    IPAddress localIP()
+    {
+        return IPAddress(192, 168, 1, 50);
+    }
+};
+
+inline WiFiClass WiFi;
+
+#endif // HOST_WIFI_H
@@ -0,0 +1,123 @@
+#ifndef HOST_WIFI_CLIENT_H
+#define HOST_WIFI_CLIENT_H
+
+#include <Arduino.h>
+#include <memory>
+#include "Client.h"
+#include "HostNet.h"
+
+// TCP connection to a server of the simulation, as HostNet's connect handler decides (refused without
+// one). The connection breaks when the link goes down
+class WiFiClient : public Client
+{
+protected:
+    bool isConnected = false;
+    std::shared_ptr<HostNet::TcpConnection> connection;
+
+    void closeConnection()
+    {
+        if (connection == nullptr)
+        {
+            return;
+        }
+
+        connection->isOpen = false;
+        HostNet::closeSocket(connection.get());
+        connection->wakeSelectors();
+        if (connection->onClientClose)
+        {
+            connection->onClientClose();
+        }
+        connection.reset();
+    }
+
+public:
+    ~WiFiClient()
+    {
+        closeConnection();
+    }
+
+    int connect(const char* host, uint16_t port) override
+    {
+        stop();
+        HostNet::ConnectHandler& handler = HostNet::state().connect;
+        if (HostNet::isWifiUp() && handler)
+        {
+            connection = handler(host, port);
+        }
+        if (connection != nullptr)
+        {
+            HostNet::openSocket(connection.get());
+        }
+        isConnected = connection != nullptr;
+        return isConnected ? 1 : 0;
+    }
+
+    // Connected until the server closed and everything it sent was read
+    uint8_t connected() override
+    {
+        if (connection != nullptr && connection->isOpen && !HostNet::isWifiUp())
+        {
+            closeConnection();
+        }
+        if (connection != nullptr)
+        {
+            isConnected = connection->isOpen || connection->getArrivedBytes() > 0;
+        }
+        isConnected = isConnected && HostNet::isWifiUp();
+        return isConnected ? 1 : 0;
+    }
+
+    void stop() override
+    {
+        closeConnection();
+        isConnected = false;
+    }
+
+    // Socket number, for lwip_select()
+    int fd() const
+    {
+        return connection != nullptr ? connection->fd : -1;
+    }
+
+    using Print::write;
+    size_t write(uint8_t c) override
+    {
+        return write(&c, 1);
+    }
+
+    size_t write(const uint8_t* buffer, size_t size) override
+    {
+        if (connection == nullptr)
+        {
+            return isConnected ? size : 0; // The HTTPS session of WiFiClientSecure sends through HTTPClient
+        }
+        if (!connection->isOpen || !HostNet::isWifiUp())
+        {
+            return 0;
+        }
+        if (connection->onServerReceive)
+        {
+            connection->onServerReceive(buffer, size, HostRtos::now() + connection->latency);
+        }
+        return size;
+    }
+
+    int available() override
+    {
+        return connection != nullptr ? (int)connection->getArrivedBytes() : 0;
+    }
+
+    int read() override
+    {
+        uint8_t value;
+        return read(&value, 1) == 1 ? value : -1;
+    }
+
+    int read(uint8_t* buffer, size_t size) override
+    {
+        return connection != nullptr ? (int)connection->read(buffer, size) : 0;
+    }
+};
+
+#endif // HOST_WIFI_CLIENT_H
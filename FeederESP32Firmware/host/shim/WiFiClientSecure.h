@@ -0,0 +1,27 @@
+#ifndef HOST_WIFI_CLIENT_SECURE_H
+#define HOST_WIFI_CLIENT_SECURE_H
+
+#include "WiFiClient.h"
+
+// The connection of the HTTPS session to the backend opens whenever the link is up; the requests
+// themselves go through HTTPClient to HostNet's HTTP handler
+class WiFiClientSecure : public WiFiClient
+{
+public:
+    void setInsecure() {}
+
+    using WiFiClient::connect;
+    int connect(IPAddress address, uint16_t port, const char* host, const char* rootCa, const char* clientCert, const char* clientKey)
+    {
+        (void)address;
+        (void)port;
+        (void)host;
+        (void)rootCa;
+        (void)clientCert;
+        (void)clientKey;
+        isConnected = HostNet::isWifiUp() && HostNet::state().http;
+        return isConnected ? 1 : 0;
+    }
+};
+
+#endif // HOST_WIFI_CLIENT_SECURE_H
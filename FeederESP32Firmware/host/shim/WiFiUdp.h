@@ -0,0 +1,113 @@
+#ifndef HOST_WIFI_UDP_H
+#define HOST_WIFI_UDP_H
+
+#include <Arduino.h>
+#include <algorithm>
+#include <deque>
+#include <vector>
+#include "HostNet.h"
+
+// Datagrams go to HostNet's UDP handler; its reply is queued and can be received once the latency it
+// reported has passed. As on the device, a reply nobody reads stays queued for the next parsePacket()
+class WiFiUDP
+{
+private:
+    struct Datagram
+    {
+        int64_t arrivalTime;
+        std::vector<uint8_t> data;
+    };
+
+    String host;
+    uint16_t port = 0;
+    std::vector<uint8_t> request;
+    std::deque<Datagram> received; // In arrival order
+    std::vector<uint8_t> reply;    // Packet taken by parsePacket()
+    size_t readPosition = 0;
+
+public:
+    uint8_t begin(uint16_t localPort)
+    {
+        (void)localPort;
+        return 1;
+    }
+
+    void stop()
+    {
+        received.clear();
+        flush();
+    }
+
+    int beginPacket(const char* remoteHost, uint16_t remotePort)
+    {
+        if (!HostNet::isWifiUp())
+        {
+            return 0;
+        }
+        host = remoteHost;
+        port = remotePort;
+        request.clear();
+        return 1;
+    }
+
+    size_t write(const uint8_t* buffer, size_t size)
+    {
+        size_t position = request.size();
+        request.resize(position + size);
+        memcpy(request.data() + position, buffer, size);
+        return size;
+    }
+
+    int endPacket()
+    {
+        if (!HostNet::isWifiUp())
+        {
+            return 0;
+        }
+
+        HostNet::UdpHandler& handler = HostNet::state().udp;
+        if (handler)
+        {
+            int64_t latency = 0;
+            std::vector<uint8_t> data = handler(host, port, request, latency);
+            if (!data.empty())
+            {
+                Datagram datagram{HostRtos::now() + latency, std::move(data)};
+                auto position = std::upper_bound(received.begin(), received.end(), datagram.arrivalTime, [](int64_t time, const Datagram& other) { return time < other.arrivalTime; });
+                received.insert(position, std::move(datagram));
+            }
+        }
+        return 1; // Sent, whether or not anything answers
+    }
+
+    // Take the next datagram that has arrived, dropping what is left of the previous one
+    int parsePacket()
+    {
+        flush();
+        if (received.empty() || HostRtos::now() < received.front().arrivalTime)
+        {
+            return 0;
+        }
+
+        reply = std::move(received.front().data);
+        received.pop_front();
+        return (int)reply.size();
+    }
+
+    int read(uint8_t* buffer, size_t size)
+    {
+        size_t count = std::min(size, reply.size() - readPosition);
+        memcpy(buffer, reply.data() + readPosition, count);
+        readPosition += count;
+        return (int)count;
+    }
+
+    // Drop the rest of the packet taken by parsePacket()
+    void flush()
+    {
+        reply.clear();
+        readPosition = 0;
+    }
+};
+
+#endif // HOST_WIFI_UDP_H
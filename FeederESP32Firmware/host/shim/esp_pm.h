@@ -0,0 +1,36 @@
+#ifndef HOST_ESP_PM_H
+#define HOST_ESP_PM_H
+
+#include "esp_timer.h"
+
+// No power management on the host: locks are accepted and do nothing
+
+typedef void* esp_pm_lock_handle_t;
+
+typedef enum
+{
+    ESP_PM_CPU_FREQ_MAX,
+    ESP_PM_APB_FREQ_MAX,
+    ESP_PM_NO_LIGHT_SLEEP
+} esp_pm_lock_type_t;
+
+inline esp_err_t esp_pm_lock_create(esp_pm_lock_type_t type, int arg, const char* name, esp_pm_lock_handle_t* handle)
+{
+    (void)type;
+    (void)arg;
+    (void)name;
+    *handle = handle;
+    return ESP_OK;
+}
+
+inline esp_err_t esp_pm_lock_acquire(esp_pm_lock_handle_t)
+{
+    return ESP_OK;
+}
+
+inline esp_err_t esp_pm_lock_release(esp_pm_lock_handle_t)
+{
+    return ESP_OK;
+}
+
+#endif // HOST_ESP_PM_H
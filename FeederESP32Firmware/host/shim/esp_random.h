@@ -0,0 +1,11 @@
+#ifndef HOST_ESP_RANDOM_H
+#define HOST_ESP_RANDOM_H
+
+#include <Arduino.h>
+
+inline uint32_t esp_random()
+{
+    return HostRandom::generator()();
+}
+
+#endif // HOST_ESP_RANDOM_H
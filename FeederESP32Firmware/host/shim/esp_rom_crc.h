@@ -0,0 +1,21 @@
+#ifndef HOST_ESP_ROM_CRC_H
+#define HOST_ESP_ROM_CRC_H
+
+#include <stdint.h>
+
+// CRC-32 (IEEE 802.3, reflected), same convention as the ROM function: pass the previous result to continue
+inline uint32_t esp_rom_crc32_le(uint32_t crc, const uint8_t* buffer, uint32_t length)
+{
+    crc = ~crc;
+    for (uint32_t i = 0; i < length; i++)
+    {
+        crc ^= buffer[i];
+        for (int bit = 0; bit < 8; bit++)
+        {
+            crc = (crc >> 1) ^ (0xEDB88320u & (0u - (crc & 1u)));
+        }
+    }
+    return ~crc;
+}
+
+#endif // HOST_ESP_ROM_CRC_H
@@ -0,0 +1,86 @@
+#ifndef HOST_ESP_TIMER_H
+#define HOST_ESP_TIMER_H
+
+#include <stdint.h>
+#include "HostRtos.h"
+
+// esp_timer on the virtual clock of HostRtos. Callbacks run inline when the clock reaches them,
+// like ESP_TIMER_TASK dispatch on a chip that has nothing else to do
+
+typedef int esp_err_t;
+#define ESP_OK 0
+#define ESP_FAIL -1
+#define ESP_ERR_INVALID_STATE 0x103
+#define ESP_ERR_NOT_SUPPORTED 0x106
+
+typedef HostRtos::Timer* esp_timer_handle_t;
+typedef void (*esp_timer_cb_t)(void* arg);
+
+typedef enum
+{
+    ESP_TIMER_TASK,
+    ESP_TIMER_ISR
+} esp_timer_dispatch_t;
+
+typedef struct
+{
+    esp_timer_cb_t callback;
+    void* arg;
+    esp_timer_dispatch_t dispatch_method;
+    const char* name;
+    bool skip_unhandled_events;
+} esp_timer_create_args_t;
+
+inline esp_err_t esp_timer_create(const esp_timer_create_args_t* args, esp_timer_handle_t* handle)
+{
+    *handle = HostRtos::createTimer(args->callback, args->arg, args->name != nullptr ? args->name : "");
+    return ESP_OK;
+}
+
+inline esp_err_t esp_timer_start_once(esp_timer_handle_t timer, uint64_t timeoutMicros)
+{
+    if (timer->isActive)
+    {
+        return ESP_ERR_INVALID_STATE;
+    }
+    HostRtos::startTimer(timer, timeoutMicros, 0);
+    return ESP_OK;
+}
+
+inline esp_err_t esp_timer_start_periodic(esp_timer_handle_t timer, uint64_t periodMicros)
+{
+    if (timer->isActive)
+    {
+        return ESP_ERR_INVALID_STATE;
+    }
+    HostRtos::startTimer(timer, periodMicros, periodMicros);
+    return ESP_OK;
+}
+
+inline esp_err_t esp_timer_stop(esp_timer_handle_t timer)
+{
+    if (!timer->isActive)
+    {
+        return ESP_ERR_INVALID_STATE;
+    }
+    timer->isActive = false;
+    return ESP_OK;
+}
+
+inline esp_err_t esp_timer_delete(esp_timer_handle_t timer)
+{
+    HostRtos::deleteTimer(timer);
+    return ESP_OK;
+}
+
+inline bool esp_timer_is_active(esp_timer_handle_t timer)
+{
+    return timer->isActive;
+}
+
+inline int64_t esp_timer_get_time()
+{
+    return HostRtos::now();
+}
+
+#endif // HOST_ESP_TIMER_H
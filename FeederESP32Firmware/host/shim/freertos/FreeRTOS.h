@@ -0,0 +1,294 @@
+#ifndef HOST_FREERTOS_H
+#define HOST_FREERTOS_H
+
+#include <stdint.h>
+#include <string.h>
+#include <deque>
+#include <vector>
+#include "../HostRtos.h"
+
+// FreeRTOS API of the firmware on HostRtos. One tick is one ms, as configured on the ESP32.
+// Cores are ignored: the host runs one task at a time
+
+typedef int BaseType_t;
+typedef unsigned int UBaseType_t;
+typedef uint32_t TickType_t;
+typedef HostRtos::Task* TaskHandle_t;
+typedef void (*TaskFunction_t)(void*);
+
+#define pdTRUE 1
+#define pdFALSE 0
+#define pdPASS 1
+#define pdFAIL 0
+#define errQUEUE_FULL 0
+#define portMAX_DELAY ((TickType_t)0xFFFFFFFFUL)
+#define portTICK_PERIOD_MS 1
+#define pdMS_TO_TICKS(ms) ((TickType_t)(ms))
+#define tskNO_AFFINITY 0x7FFFFFFF
+#define configMAX_PRIORITIES 25
+
+// Only one task runs at a time, so critical sections have nothing to exclude
+typedef struct
+{
+    int owner;
+} portMUX_TYPE;
+#define portMUX_INITIALIZER_UNLOCKED {0}
+#define portENTER_CRITICAL(mux) ((void)(mux))
+#define portEXIT_CRITICAL(mux) ((void)(mux))
+#define portENTER_CRITICAL_ISR(mux) ((void)(mux))
+#define portEXIT_CRITICAL_ISR(mux) ((void)(mux))
+#define portYIELD_FROM_ISR() ((void)0)
+
+inline int64_t hostTicksToMicros(TickType_t ticks)
+{
+    return ticks == portMAX_DELAY ? HostRtos::FOREVER : (int64_t)ticks * 1000;
+}
+
+// Timer callbacks stand in for the interrupts and the esp_timer task
+inline BaseType_t xPortInIsrContext()
+{
+    return HostRtos::inTimerCallback() ? pdTRUE : pdFALSE;
+}
+
+inline BaseType_t xPortGetCoreID()
+{
+    return 0;
+}
+
+// Tasks
+
+inline BaseType_t xTaskCreatePinnedToCore(TaskFunction_t function, const char* name, uint32_t stackDepth, void* parameter, UBaseType_t priority, TaskHandle_t* handle, BaseType_t core)
+{
+    (void)stackDepth;
+    (void)core;
+    TaskHandle_t task = HostRtos::createTask(function, name, parameter, priority);
+    if (handle != nullptr)
+    {
+        *handle = task;
+    }
+    return pdPASS;
+}
+
+inline BaseType_t xTaskCreate(TaskFunction_t function, const char* name, uint32_t stackDepth, void* parameter, UBaseType_t priority, TaskHandle_t* handle)
+{
+    return xTaskCreatePinnedToCore(function, name, stackDepth, parameter, priority, handle, tskNO_AFFINITY);
+}
+
+inline void vTaskDelete(TaskHandle_t task)
+{
+    if (task == nullptr || task == HostRtos::currentTask())
+    {
+        HostRtos::deleteCurrentTask();
+        return;
+    }
+    HostRtos::deleteTask(task);
+}
+
+inline void vTaskDelay(TickType_t ticks)
+{
+    HostRtos::sleepFor(hostTicksToMicros(ticks));
+}
+
+inline TickType_t xTaskGetTickCount()
+{
+    return (TickType_t)(HostRtos::now() / 1000);
+}
+
+inline TaskHandle_t xTaskGetCurrentTaskHandle()
+{
+    return HostRtos::currentTask();
+}
+
+inline UBaseType_t uxTaskGetStackHighWaterMark(TaskHandle_t)
+{
+    return 0;
+}
+
+// Notifications, used as counting semaphores
+
+inline BaseType_t xTaskNotifyGive(TaskHandle_t task)
+{
+    task->notificationValue++;
+    if (task->waitsForNotification)
+    {
+        HostRtos::wake(task);
+    }
+    return pdPASS;
+}
+
+inline void vTaskNotifyGiveFromISR(TaskHandle_t task, BaseType_t* higherPriorityTaskWoken)
+{
+    if (higherPriorityTaskWoken != nullptr)
+    {
+        *higherPriorityTaskWoken = pdFALSE;
+    }
+    xTaskNotifyGive(task);
+}
+
+inline uint32_t ulTaskNotifyTake(BaseType_t clearCountOnExit, TickType_t ticksToWait)
+{
+    TaskHandle_t task = HostRtos::currentTask();
+    if (task->notificationValue == 0)
+    {
+        task->waitsForNotification = true;
+        HostRtos::block(hostTicksToMicros(ticksToWait));
+        task->waitsForNotification = false;
+    }
+
+    uint32_t value = task->notificationValue;
+    if (value > 0)
+    {
+        task->notificationValue = clearCountOnExit ? 0 : value - 1;
+    }
+    return value;
+}
+
+// Queues
+
+struct HostQueue
+{
+    UBaseType_t length;
+    UBaseType_t itemSize;
+    std::deque<std::vector<uint8_t>> items;
+    HostRtos::WaitList receivers;
+    HostRtos::WaitList senders;
+};
+
+typedef HostQueue* QueueHandle_t;
+
+// Wait on a list until woken or until the deadline. False once the deadline passed
+inline bool hostWaitOn(HostRtos::WaitList& waiters, int64_t deadline)
+{
+    int64_t timeout = deadline == HostRtos::FOREVER ? HostRtos::FOREVER : deadline - HostRtos::now();
+    if (timeout <= 0)
+    {
+        return false;
+    }
+
+    waiters.push_back(HostRtos::currentTask());
+    bool woken = HostRtos::block(timeout);
+    if (!woken)
+    {
+        HostRtos::removeWaiter(waiters, HostRtos::currentTask());
+    }
+    return true;
+}
+
+inline int64_t hostDeadline(TickType_t ticksToWait)
+{
+    int64_t timeout = hostTicksToMicros(ticksToWait);
+    return timeout == HostRtos::FOREVER ? HostRtos::FOREVER : HostRtos::now() + timeout;
+}
+
+inline QueueHandle_t xQueueCreate(UBaseType_t length, UBaseType_t itemSize)
+{
+    QueueHandle_t queue = new HostQueue();
+    queue->length = length;
+    queue->itemSize = itemSize;
+    return queue;
+}
+
+inline BaseType_t xQueueSend(QueueHandle_t queue, const void* item, TickType_t ticksToWait)
+{
+    int64_t deadline = hostDeadline(ticksToWait);
+    while (queue->items.size() >= queue->length)
+    {
+        if (HostRtos::inTimerCallback() || !hostWaitOn(queue->senders, deadline))
+        {
+            return errQUEUE_FULL;
+        }
+    }
+
+    const uint8_t* bytes = static_cast<const uint8_t*>(item);
+    queue->items.emplace_back(bytes, bytes + queue->itemSize);
+    HostRtos::wakeFirst(queue->receivers);
+    return pdPASS;
+}
+
+inline BaseType_t xQueueSendToBack(QueueHandle_t queue, const void* item, TickType_t ticksToWait)
+{
+    return xQueueSend(queue, item, ticksToWait);
+}
+
+inline BaseType_t xQueueSendFromISR(QueueHandle_t queue, const void* item, BaseType_t* higherPriorityTaskWoken)
+{
+    if (higherPriorityTaskWoken != nullptr)
+    {
+        *higherPriorityTaskWoken = pdFALSE;
+    }
+    return xQueueSend(queue, item, 0);
+}
+
+inline BaseType_t xQueueReceive(QueueHandle_t queue, void* item, TickType_t ticksToWait)
+{
+    int64_t deadline = hostDeadline(ticksToWait);
+    while (queue->items.empty())
+    {
+        if (!hostWaitOn(queue->receivers, deadline))
+        {
+            return pdFALSE;
+        }
+    }
+
+    memcpy(item, queue->items.front().data(), queue->itemSize);
+    queue->items.pop_front();
+    HostRtos::wakeFirst(queue->senders);
+    return pdTRUE;
+}
+
+inline UBaseType_t uxQueueMessagesWaiting(QueueHandle_t queue)
+{
+    return (UBaseType_t)queue->items.size();
+}
+
+// Semaphores and mutexes (no priority inheritance)
+
+struct HostSemaphore
+{
+    UBaseType_t count;
+    HostRtos::WaitList takers;
+};
+
+typedef HostSemaphore* SemaphoreHandle_t;
+
+inline SemaphoreHandle_t xSemaphoreCreateMutex()
+{
+    return new HostSemaphore{1, {}};
+}
+
+inline SemaphoreHandle_t xSemaphoreCreateBinary()
+{
+    return new HostSemaphore{0, {}};
+}
+
+inline BaseType_t xSemaphoreTake(SemaphoreHandle_t semaphore, TickType_t ticksToWait)
+{
+    int64_t deadline = hostDeadline(ticksToWait);
+    while (semaphore->count == 0)
+    {
+        if (!hostWaitOn(semaphore->takers, deadline))
+        {
+            return pdFALSE;
+        }
+    }
+    semaphore->count--;
+    return pdTRUE;
+}
+
+inline BaseType_t xSemaphoreGive(SemaphoreHandle_t semaphore)
+{
+    semaphore->count++;
+    HostRtos::wakeFirst(semaphore->takers);
+    return pdTRUE;
+}
+
+inline BaseType_t xSemaphoreGiveFromISR(SemaphoreHandle_t semaphore, BaseType_t* higherPriorityTaskWoken)
+{
+    if (higherPriorityTaskWoken != nullptr)
+    {
+        *higherPriorityTaskWoken = pdFALSE;
+    }
+    return xSemaphoreGive(semaphore);
+}
+
+#endif // HOST_FREERTOS_H
@@ -0,0 +1,87 @@
+#ifndef HOST_LWIP_SOCKETS_H
+#define HOST_LWIP_SOCKETS_H
+
+#include <errno.h>
+#include <sys/select.h>
+#include <sys/time.h>
+#include <vector>
+#include "../HostNet.h"
+
+// lwip_select() on the sockets of the host connections (WiFiClient::fd()), in virtual time. Readability
+// only: a socket is readable once bytes arrived or the server closed it. The caller blocks until then
+// or until the timeout (nullptr for none)
+inline int lwip_select(int maxfdp1, fd_set* readset, fd_set* writeset, fd_set* exceptset, struct timeval* timeout)
+{
+    (void)exceptset;
+    if (writeset != nullptr)
+    {
+        FD_ZERO(writeset);
+    }
+
+    std::vector<int> watched;
+    for (int fd = 0; readset != nullptr && fd < maxfdp1; fd++)
+    {
+        if (FD_ISSET(fd, readset))
+        {
+            watched.push_back(fd);
+        }
+    }
+
+    int64_t deadline = timeout == nullptr ? HostRtos::FOREVER : HostRtos::now() + timeout->tv_sec * 1000000LL + timeout->tv_usec;
+    for (;;)
+    {
+        // Looked up on every pass: the socket may be closed while the caller waits
+        std::vector<HostNet::TcpConnection*> connections;
+        for (int fd : watched)
+        {
+            HostNet::TcpConnection* connection = HostNet::findSocket(fd);
+            if (connection == nullptr)
+            {
+                errno = EBADF;
+                return -1;
+            }
+            connections.push_back(connection);
+        }
+
+        int ready = 0;
+        for (HostNet::TcpConnection* connection : connections)
+        {
+            ready += connection->getArrivedBytes() > 0 || !connection->isOpen ? 1 : 0;
+        }
+
+        if (ready > 0 || HostRtos::now() >= deadline)
+        {
+            if (readset != nullptr)
+            {
+                FD_ZERO(readset);
+                for (HostNet::TcpConnection* connection : connections)
+                {
+                    if (connection->getArrivedBytes() > 0 || !connection->isOpen)
+                    {
+                        FD_SET(connection->fd, readset);
+                    }
+                }
+            }
+            return ready;
+        }
+
+        // Sleep until the next bytes arrive; a send or a close wakes the caller to look again
+        int64_t wakeTime = deadline;
+        for (HostNet::TcpConnection* connection : connections)
+        {
+            wakeTime = std::min(wakeTime, connection->getNextArrivalTime());
+            connection->selectors.push_back(HostRtos::currentTask());
+        }
+        HostRtos::block(wakeTime == HostRtos::FOREVER ? HostRtos::FOREVER : wakeTime - HostRtos::now());
+        for (int fd : watched)
+        {
+            HostNet::TcpConnection* connection = HostNet::findSocket(fd);
+            if (connection != nullptr)
+            {
+                HostRtos::removeWaiter(connection->selectors, HostRtos::currentTask());
+            }
+        }
+    }
+}
+
+#endif // HOST_LWIP_SOCKETS_H